@@ -0,0 +1,930 @@
+//! Benchmark program for flog
+
+//! Run with an optional message count: ./bench [messages]
+
+#include "flog.h"
+#include "flog_alloc.h"
+#include "flog_string.h"
+#include "flog_stats.h"
+#include "flog_sample.h"
+#include "flog_filter.h"
+#include "flog_layout.h"
+#include "flog_escape.h"
+#include "flog_output_file.h"
+#include "flog_output_compressed.h"
+#include "flog_detach.h"
+#include "flog_breaker.h"
+#include "flog_output_shm.h"
+#include "flog_trace.h"
+#include "flog_context.h"
+#include "flog_governor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <pthread.h>
+
+
+static unsigned long bench_messages=200000;
+static FILE *devnull;
+
+
+//! Get a monotonic timestamp in nanoseconds
+static uint64_t bench_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return((uint64_t)ts.tv_sec*1000000000u+(uint64_t)ts.tv_nsec);
+}
+
+
+//! Print the result of a benchmark
+static void bench_result(const char *name,uint64_t ns,unsigned long n)
+{
+	printf("%-44s %10.1f ns/msg\n",name,(double)ns/(double)n);
+}
+
+
+//! Output function rendering messages to /dev/null
+static int bench_output_devnull(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	char buf[FLOG_STRING_BUF_SIZE],*str;
+	size_t len;
+	if(flog_get_str_message_log(&str,&len,buf,sizeof(buf),log,msg))
+		return(-1);
+	if(str)
+		fwrite(str,1,len,devnull);
+	if(str!=buf)
+		free(str);
+	return(0);
+}
+
+
+#ifdef FLOG_CONFIG_ARG_TYPES
+//! Output function storing format pointer and binary arguments to /dev/null
+static int bench_output_devnull_binary(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	unsigned char buf[256];
+	size_t len=0;
+	(void)log;
+	if(msg->arg_site) {
+		va_list ap;
+		va_copy(ap,*msg->args);
+		len=flog_args_encode(buf,sizeof(buf),msg->arg_site,ap);
+		va_end(ap);
+		if(len>sizeof(buf))
+			return(-1);
+	}
+	fwrite(&msg->format,sizeof(msg->format),1,devnull);
+	fwrite(buf,1,len,devnull);
+	return(0);
+}
+#endif //FLOG_CONFIG_ARG_TYPES
+
+
+//! Create a log rendering to /dev/null
+static FLOG_T * bench_create_devnull(const char *name,FLOG_MSG_TYPE_T accepted_msg_type)
+{
+	FLOG_T *p;
+	if((p=create_flog_t(name,accepted_msg_type))==NULL)
+		return(NULL);
+	p->output_func=bench_output_devnull;
+	return(p);
+}
+
+
+//! flog_printf() to one text output
+static void bench_printf(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	flog_append_sublog(root,out);
+	unsigned long i;
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+	bench_result("flog_printf, 1 text output",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+}
+
+
+//! flog_printf() to two and three text outputs with the same layout
+static void bench_printf_outputs(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out[3];
+	char name[64];
+	unsigned long i,n;
+	out[0]=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	flog_append_sublog(root,out[0]);
+	for(n=2;n<=3;n++) {
+		out[n-1]=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+		flog_append_sublog(root,out[n-1]);
+		uint64_t t=bench_time_ns();
+		for(i=0;i<bench_messages;i++)
+			flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+		snprintf(name,sizeof(name),"flog_printf, %lu text outputs",n);
+		bench_result(name,bench_time_ns()-t,bench_messages);
+	}
+	for(i=0;i<3;i++)
+		destroy_flog_t(out[i]);
+	destroy_flog_t(root);
+}
+
+
+#ifdef FLOG_CONFIG_LAYOUT
+//! flog_printf() to three text outputs with different layouts
+static void bench_printf_layouts(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out[3];
+	const char *layout[3]={NULL,"%T %L: %m%n","%{%S: %}%m%n"};
+	unsigned long i;
+	for(i=0;i<3;i++) {
+		out[i]=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+		flog_set_layout(out[i],layout[i]);
+		flog_append_sublog(root,out[i]);
+	}
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_WARNING,0,"message %lu of %lu",i,bench_messages);
+	bench_result("flog_printf, 3 text outputs, 3 layouts",bench_time_ns()-t,bench_messages);
+	for(i=0;i<3;i++)
+		destroy_flog_t(out[i]);
+	destroy_flog_t(root);
+}
+#endif //FLOG_CONFIG_LAYOUT
+
+
+//! flog_print() and flog_printf() into a message buffer, text copied or borrowed
+static void bench_print_buffered(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	root->msg_max=1000;
+	unsigned long i;
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++) {
+		flog_print(root,"bench",FLOG_INFO,0,"constant message");
+		if(root->msg_amount==root->msg_max)
+			flog_clear_msg_buffer(root);
+	}
+	bench_result("flog_print, buffered, text copied",bench_time_ns()-t,bench_messages);
+	flog_clear_msg_buffer(root);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++) {
+		flog_print_static(root,"bench",FLOG_INFO,0,"constant message");
+		if(root->msg_amount==root->msg_max)
+			flog_clear_msg_buffer(root);
+	}
+	bench_result("flog_print_static, buffered, text borrowed",bench_time_ns()-t,bench_messages);
+	flog_clear_msg_buffer(root);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++) {
+		flog_printf(root,"bench",FLOG_INFO,0,"message %lu",i);
+		if(root->msg_amount==root->msg_max)
+			flog_clear_msg_buffer(root);
+	}
+	bench_result("flog_printf, buffered, short text",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(root);
+}
+
+
+//! flog_printf() of a message type which is filtered out
+static void bench_printf_filtered(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_INFO);
+	flog_append_sublog(root,out);
+	unsigned long i;
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_DEBUG,0,"message %lu of %lu",i,bench_messages);
+	bench_result("flog_printf, filtered out",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+}
+
+
+#ifdef FLOG_CONFIG_ARG_TYPES
+//! flog_printf() to one binary output
+static void bench_printf_binary(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=create_flog_t(NULL,FLOG_ACCEPT_ALL);
+	out->output_func=bench_output_devnull_binary;
+	flog_append_sublog(root,out);
+	unsigned long i;
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+	bench_result("flog_printf, 1 binary output",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+}
+#endif //FLOG_CONFIG_ARG_TYPES
+
+
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+//! flog_printf() through two sublogs with a new subsystem each message, filling the intern table
+static void bench_printf_dynamic_subsystems(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *mid=create_flog_t("mid",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull("out",FLOG_ACCEPT_ALL);
+	char subsystem[32];
+	unsigned long i;
+	uint64_t t;
+	flog_append_sublog(root,mid);
+	flog_append_sublog(mid,out);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++) {
+		snprintf(subsystem,sizeof(subsystem),"req-%lu",i);
+		flog_printf(root,subsystem,FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+	}
+	bench_result("flog_printf, 2 sublogs, new subsystem",bench_time_ns()-t,bench_messages);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++) {
+		snprintf(subsystem,sizeof(subsystem),"new-%lu",i);
+		flog_printf(root,subsystem,FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+	}
+	bench_result("flog_printf, 2 sublogs, table filled",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(out);
+	destroy_flog_t(mid);
+	destroy_flog_t(root);
+	flog_intern_clear();
+}
+#endif //FLOG_CONFIG_INTERN_TABLE_SIZE
+
+#ifdef FLOG_CONFIG_SAMPLING
+//! flog_printf() of debug messages sampled 1 in 100
+static void bench_printf_sampled(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	flog_append_sublog(root,out);
+	flog_set_sampling(root,FLOG_DEBUG,FLOG_SAMPLE_EVERY_SITE,100);
+	unsigned long i;
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_DEBUG,0,"message %lu of %lu",i,bench_messages);
+	bench_result("flog_printf, sampled 1/100 per call site",bench_time_ns()-t,bench_messages);
+	flog_set_sampling(root,FLOG_DEBUG,FLOG_SAMPLE_RANDOM,100);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_DEBUG,0,"message %lu of %lu",i,bench_messages);
+	bench_result("flog_printf, sampled 1/100 randomly",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+}
+#endif //FLOG_CONFIG_SAMPLING
+
+
+#ifdef FLOG_CONFIG_FILTER
+//! flog_printf() through subsystem filter rules, half of the messages are muted
+static void bench_printf_filter_rules(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	flog_append_sublog(root,out);
+	flog_set_filter(out,"root/*:INFO+,root/bench/noisy:off,root/bench/chatty:DEBUG off");
+	unsigned long i;
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,(i&1) ? "bench/noisy" : "bench/quiet",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+	bench_result("flog_printf, filter rules, 1/2 muted",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+}
+#endif //FLOG_CONFIG_FILTER
+
+
+#ifdef FLOG_CONFIG_ESCAPE
+//! Escape text one byte at a time, as a baseline for flog_escape()
+static size_t bench_escape_bytewise(char *buf,size_t size,const char *s,size_t len)
+{
+	static const char hex[]="0123456789abcdef";
+	size_t i,n=0;
+	for(i=0;i<len && n+4<size;i++) {
+		unsigned char c=(unsigned char)s[i];
+		if(c=='\\') {
+			buf[n++]='\\';
+			buf[n++]='\\';
+		} else if(c<0x20) {
+			buf[n++]='\\';
+			buf[n++]='x';
+			buf[n++]=hex[c>>4];
+			buf[n++]=hex[c&15];
+		} else
+			buf[n++]=(char)c;
+	}
+	buf[n]=0;
+	return(n);
+}
+
+
+//! Escaping of message text, 1 in 10 messages has a newline
+static void bench_escape(void)
+{
+	static const size_t size[]={40,120,400};
+	char text[10][400],buf[2048],name[64];
+	volatile size_t sink=0;
+	unsigned int i,j;
+	unsigned long k;
+	uint64_t t;
+	for(i=0;i<sizeof(size)/sizeof(size[0]);i++) {
+		for(j=0;j<10;j++) {
+			memset(text[j],'a'+j,size[i]);
+			if(j==0)
+				text[j][size[i]/2]='\n';
+		}
+		t=bench_time_ns();
+		for(k=0;k<bench_messages;k++)
+			sink+=bench_escape_bytewise(buf,sizeof(buf),text[k%10],size[i]);
+		snprintf(name,sizeof(name),"escape %zu bytes, byte by byte",size[i]);
+		bench_result(name,bench_time_ns()-t,bench_messages);
+		t=bench_time_ns();
+		for(k=0;k<bench_messages;k++)
+			sink+=flog_escape(buf,sizeof(buf),text[k%10],size[i],FLOG_ESCAPE_TEXT);
+		snprintf(name,sizeof(name),"escape %zu bytes, flog_escape",size[i]);
+		bench_result(name,bench_time_ns()-t,bench_messages);
+	}
+	(void)sink;
+}
+#endif //FLOG_CONFIG_ESCAPE
+
+
+#ifdef FLOG_CONFIG_OUTPUT_COMPRESSED
+//! flog_printf() to one file output, and print the size of the file
+static void bench_printf_file(const char *name,FLOG_T *out,const char *filename)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	struct stat st;
+	char label[64];
+	unsigned long i;
+	flog_append_sublog(root,out);
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+	flog_flush(root);
+	bench_result(name,bench_time_ns()-t,bench_messages);
+	destroy_flog_t(root);
+	if(!stat(filename,&st)) {
+		snprintf(label,sizeof(label),"  %s, size",name);
+		printf("%-44s %10.1f bytes/msg\n",label,(double)st.st_size/(double)bench_messages);
+	}
+	unlink(filename);
+}
+
+
+//! Buffered and compressed file output
+static void bench_file_outputs(void)
+{
+	char filename[64];
+	FLOG_T *out;
+#ifdef FLOG_CONFIG_OUTPUT_FILE
+	snprintf(filename,sizeof(filename),"/tmp/flog_bench_%d.log",(int)getpid());
+	if((out=create_flog_output_file_buffered(NULL,FLOG_ACCEPT_ALL,filename,256*1024))) {
+		bench_printf_file("flog_printf, buffered file",out,filename);
+		destroy_flog_output_file(out);
+	}
+#endif
+	snprintf(filename,sizeof(filename),"/tmp/flog_bench_%d.flz",(int)getpid());
+	if((out=create_flog_output_compressed(NULL,FLOG_ACCEPT_ALL,filename,0))) {
+		bench_printf_file("flog_printf, compressed file",out,filename);
+		destroy_flog_output_compressed(out);
+	}
+}
+#endif //FLOG_CONFIG_OUTPUT_COMPRESSED
+
+
+#ifdef FLOG_CONFIG_DETACH
+//! Text output to /dev/null that stalls for 1ms every 256 messages, like a disk or network under load
+static int bench_output_slow(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	static unsigned int n;
+	if(!(++n%256))
+		usleep(1000);
+	return(bench_output_devnull(log,msg));
+}
+
+
+//! flog_printf() in bursts to a slow and a fast output, slow output inline or detached
+static void bench_printf_detached(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *fast=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	FLOG_T *slow=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	const unsigned long burst=1000;
+	unsigned long i,j,n;
+	uint64_t t,total;
+	int detached;
+	slow->output_func=bench_output_slow;
+	flog_append_sublog(root,fast);
+	flog_append_sublog(root,slow);
+	for(detached=0;detached<2;detached++) {
+		if(detached && flog_detach(slow,burst,FLOG_DETACH_BLOCK))
+			break;
+		total=0;
+		for(i=0;i<bench_messages;i+=burst) {
+			n=(bench_messages-i<burst) ? bench_messages-i : burst;
+			t=bench_time_ns();
+			for(j=0;j<n;j++)
+				flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i+j,bench_messages);
+			total+=bench_time_ns()-t;
+			//let the worker catch up between bursts, untimed
+			flog_flush(root);
+		}
+		bench_result(detached ? "flog_printf, slow output detached" : "flog_printf, slow output inline",total,bench_messages);
+	}
+	flog_attach(slow);
+	destroy_flog_t(slow);
+	destroy_flog_t(fast);
+	destroy_flog_t(root);
+}
+#endif //FLOG_CONFIG_DETACH
+
+
+#ifdef FLOG_CONFIG_BREAKER
+//! Output failing like a full disk, after the cost of trying to write
+static int bench_output_failing(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	bench_output_devnull(log,msg);
+	return(ENOSPC);
+}
+
+
+//! Report of the breaker in bench_printf_breaker(), not printed to keep the results readable
+static void bench_breaker_report(FLOG_T *log,const FLOG_BREAKER_T *b,uint_fast8_t state)
+{
+	(void)log;
+	(void)b;
+	(void)state;
+}
+
+
+//! flog_printf() to a failing output retried on every message, and behind a breaker
+static void bench_printf_breaker(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	unsigned long i;
+	int breaker;
+	out->output_func=bench_output_failing;
+	out->output_stop_on_error=0;
+	flog_append_sublog(root,out);
+	for(breaker=0;breaker<2;breaker++) {
+		if(breaker) {
+			if(flog_set_breaker(out,0,0,0))
+				break;
+			out->breaker->report=bench_breaker_report;
+		}
+		uint64_t t=bench_time_ns();
+		for(i=0;i<bench_messages;i++)
+			flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+		bench_result(breaker ? "flog_printf, failing output, breaker" : "flog_printf, failing output, retried",bench_time_ns()-t,bench_messages);
+	}
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+}
+#endif //FLOG_CONFIG_BREAKER
+
+
+#ifdef FLOG_CONFIG_DURABILITY
+//! Threads emitting in bench_printf_durability()
+#define BENCH_DURABILITY_THREADS 4
+
+
+//! Emit a share of the messages, one in 100 an error
+static void * bench_durability_thread(void *arg)
+{
+	FLOG_T *root=arg;
+	unsigned long i,n=bench_messages/BENCH_DURABILITY_THREADS;
+	for(i=0;i<n;i++) {
+		if(i%100==99)
+			flog_printf(root,"bench",FLOG_ERROR,0,"error %lu of %lu",i,n);
+		else
+			flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,n);
+	}
+	return(NULL);
+}
+
+
+//! flog_printf() from several threads to a buffered file, errors written or synced at once
+static void bench_printf_durability(void)
+{
+	static const char *label[]={"buffered","flush","fdatasync","group commit"};
+	pthread_t thread[BENCH_DURABILITY_THREADS];
+	char filename[64],name[64];
+	FLOG_OUTPUT_FILE_T *f;
+	FLOG_T *root,*out;
+	unsigned int d,i,started;
+	snprintf(filename,sizeof(filename),"/tmp/flog_bench_%d.log",(int)getpid());
+	for(d=FLOG_DURABILITY_NONE;d<=FLOG_DURABILITY_GROUP;d++) {
+		root=create_flog_t("root",FLOG_ACCEPT_ALL);
+		if((out=create_flog_output_file_buffered(NULL,FLOG_ACCEPT_ALL,filename,64*1024))==NULL)
+			break;
+		//any durability makes the output take its lock so the threads can share it, no FLOG_DEEP_DEBUG is emitted
+		flog_output_file_set_durability(out,FLOG_DEEP_DEBUG,FLOG_DURABILITY_FLUSH,0);
+		flog_output_file_set_durability(out,FLOG_ACCEPT_ONLY_ERROR,d,0);
+		flog_append_sublog(root,out);
+		uint64_t t=bench_time_ns();
+		for(i=0,started=0;i<BENCH_DURABILITY_THREADS;i++) {
+			if(!pthread_create(&thread[i],NULL,bench_durability_thread,root))
+				started++;
+		}
+		for(i=0;i<started;i++)
+			pthread_join(thread[i],NULL);
+		t=bench_time_ns()-t;
+		f=out->output_func_data;
+		snprintf(name,sizeof(name),"flog_printf, %u threads, errors %s",BENCH_DURABILITY_THREADS,label[d]);
+		bench_result(name,t,bench_messages);
+		if(f->syncs) {
+			snprintf(name,sizeof(name),"  errors per fdatasync");
+			printf("%-44s %10.1f\n",name,(double)(bench_messages/100)/(double)f->syncs);
+		}
+		destroy_flog_output_file(out);
+		destroy_flog_t(root);
+		unlink(filename);
+	}
+}
+#endif //FLOG_CONFIG_DURABILITY
+
+
+#ifdef FLOG_CONFIG_OUTPUT_SHM
+//! Shared memory ring, rendered and raw records
+static void bench_printf_shm(void)
+{
+	static const char *label[]={"flog_printf, shared memory ring","flog_printf, shared memory ring, raw"};
+	char shm_name[64];
+	FLOG_T *root,*out;
+	unsigned int raw;
+	unsigned long i;
+	snprintf(shm_name,sizeof(shm_name),"/flog_bench_%d",(int)getpid());
+	for(raw=0;raw<2;raw++) {
+		if((out=create_flog_output_shm(NULL,FLOG_ACCEPT_ALL,shm_name,0,0,raw ? FLOG_OUTPUT_SHM_RAW : 0))==NULL)
+			break;
+		root=create_flog_t("root",FLOG_ACCEPT_ALL);
+		flog_append_sublog(root,out);
+		uint64_t t=bench_time_ns();
+		for(i=0;i<bench_messages;i++)
+			flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+		bench_result(label[raw],bench_time_ns()-t,bench_messages);
+		destroy_flog_output_shm(out);
+		destroy_flog_t(root);
+		shm_unlink(shm_name);
+	}
+}
+#endif //FLOG_CONFIG_OUTPUT_SHM
+
+
+#ifdef FLOG_CONFIG_TRACE
+//! Function timed by a span
+static void bench_traced(FLOG_T *log,FLOG_MSG_TYPE_T type)
+{
+	flog_trace(log,"bench",type);
+}
+
+
+//! Function marked by flog_function_start() and flog_function_end()
+static void bench_function_marked(FLOG_T *log)
+{
+	flog_function_start(log,"bench");
+	flog_function_end(log,"bench");
+}
+
+
+//! Spans against function start and end messages, used and unused
+static void bench_trace(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_DEEP_DEBUG);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_DEEP_DEBUG);
+	flog_append_sublog(root,out);
+	unsigned long i;
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		bench_function_marked(root);
+	bench_result("flog_function_start/end, 1 text output",bench_time_ns()-t,bench_messages);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		bench_traced(root,FLOG_DEEP_DEBUG);
+	bench_result("flog_trace, 1 text output",bench_time_ns()-t,bench_messages);
+	out->accepted_msg_type=FLOG_ACCEPT_INFO;
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		bench_traced(root,FLOG_DEEP_DEBUG);
+	bench_result("flog_trace, type not used",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+
+	char filename[64];
+	snprintf(filename,sizeof(filename),"/tmp/flog_bench_%d.json",(int)getpid());
+	if((out=create_flog_output_trace(NULL,FLOG_ACCEPT_DEEP_DEBUG,filename))==NULL)
+		return;
+	root=create_flog_t("root",FLOG_ACCEPT_DEEP_DEBUG);
+	flog_append_sublog(root,out);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		bench_traced(root,FLOG_DEEP_DEBUG);
+	bench_result("flog_trace, trace output",bench_time_ns()-t,bench_messages);
+	destroy_flog_output_trace(out);
+	destroy_flog_t(root);
+	unlink(filename);
+}
+#endif //FLOG_CONFIG_TRACE
+
+
+#if defined(FLOG_CONFIG_CONTEXT_SIZE) && defined(FLOG_CONFIG_LAYOUT)
+//! Request id in the format of every message, against the thread context
+static void bench_printf_context(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	unsigned long i;
+	uint64_t t;
+	flog_append_sublog(root,out);
+	flog_set_layout(out,"%T %L: %m%n");
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_WARNING,0,"request=%lu user=%s: message %lu of %lu",i/10,"alice",i,bench_messages);
+	bench_result("flog_printf, request in format",bench_time_ns()-t,bench_messages);
+	flog_set_layout(out,"%T %L: %C: %m%n");
+	flog_context_push("user","alice");
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++) {
+		//a new request every 10 messages
+		if(i%10==0) {
+			if(i)
+				flog_context_pop();
+			flog_context_pushf("request","%lu",i/10);
+		}
+		flog_printf(root,"bench",FLOG_WARNING,0,"message %lu of %lu",i,bench_messages);
+	}
+	flog_context_pop();
+	bench_result("flog_printf, request in context",bench_time_ns()-t,bench_messages);
+	flog_context_pop();
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++) {
+		flog_context_pushf("request","%lu",i);
+		flog_context_pop();
+	}
+	bench_result("flog_context_pushf and pop",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+}
+#endif //FLOG_CONFIG_CONTEXT_SIZE && FLOG_CONFIG_LAYOUT
+
+
+#ifdef FLOG_CONFIG_GOVERNOR
+//! Set to make bench_output_stalling() stall
+static int bench_stalled;
+
+
+//! Text output to /dev/null that stalls for 2ms per message while bench_stalled is set
+static int bench_output_stalling(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	if(bench_stalled)
+		usleep(2000);
+	return(bench_output_devnull(log,msg));
+}
+
+
+//! flog_printf() to a log with and without a governor, and of a type the governor sheds
+static void bench_printf_governor(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	FLOG_GOVERNOR_STATS_T stats;
+	unsigned long i;
+	uint64_t t;
+	int governed;
+	out->output_func=bench_output_stalling;
+	flog_append_sublog(root,out);
+	for(governed=0;governed<2;governed++) {
+		if(governed && flog_set_governor(root,0,0,0))
+			break;
+		t=bench_time_ns();
+		for(i=0;i<bench_messages;i++)
+			flog_printf(root,"bench",FLOG_DEBUG,0,"message %lu of %lu",i,bench_messages);
+		bench_result(governed ? "flog_printf, governed" : "flog_printf, not governed",bench_time_ns()-t,bench_messages);
+	}
+	if(governed<2) {
+		destroy_flog_t(out);
+		destroy_flog_t(root);
+		return;
+	}
+	//stall the output until the governor sheds DEBUG, untimed
+	bench_stalled=1;
+	while(!flog_get_governor_stats(root,&stats) && !(stats.shed_msg_type & FLOG_DEBUG))
+		flog_printf(root,"bench",FLOG_WARNING,0,"stalled");
+	bench_stalled=0;
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_DEBUG,0,"message %lu of %lu",i,bench_messages);
+	bench_result("flog_printf, shed by governor",bench_time_ns()-t,bench_messages);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+}
+#endif //FLOG_CONFIG_GOVERNOR
+
+
+#ifdef FLOG_CONFIG_ALLOC
+//! Print the allocations of flog per message since before
+static void bench_alloc_result(const char *name,const FLOG_ALLOC_STATS_T *before,unsigned long n)
+{
+	FLOG_ALLOC_STATS_T after;
+	flog_get_alloc_stats(&after);
+	printf("%-44s %10.2f allocs/msg\n",name,(double)(after.allocs-before->allocs)/(double)n);
+}
+
+
+//! flog_printf() to a buffered log, time and allocations per message
+static void bench_alloc_buffered(const char *name)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_ALLOC_STATS_T before;
+	unsigned long i;
+	uint64_t t;
+	if(!root)
+		return;
+	root->msg_max=1000;
+	flog_get_alloc_stats(&before);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++) {
+		flog_printf(root,"bench",FLOG_INFO,0,"message %lu",i);
+		if(root->msg_amount==root->msg_max)
+			flog_clear_msg_buffer(root);
+	}
+	bench_result(name,bench_time_ns()-t,bench_messages);
+	bench_alloc_result(name,&before,bench_messages);
+	destroy_flog_t(root);
+}
+
+
+//! Allocations of flog_printf(), a buffered log within a budget, and the pool allocator
+static void bench_alloc(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	FLOG_ALLOC_STATS_T before,after;
+	FLOG_ALLOC_POOL_T pool;
+	char text[2000];
+	unsigned long i;
+	flog_append_sublog(root,out);
+	memset(text,'x',sizeof(text)-1);
+	text[sizeof(text)-1]=0;
+	flog_get_alloc_stats(&before);
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+	bench_alloc_result("flog_printf, 1 text output",&before,bench_messages);
+	flog_get_alloc_stats(&before);
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_INFO,0,"message %lu: %s",i,text);
+	bench_alloc_result("flog_printf, 1 text output, 2000 bytes",&before,bench_messages);
+
+	//buffer every message within a budget of 64 KiB more than in use, long messages still reach the output
+	flog_get_alloc_stats(&before);
+	flog_set_alloc_budget(before.used+65536);
+	root->msg_max=(uint_fast16_t)(bench_messages<65535 ? bench_messages : 65535);
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_INFO,0,"message %lu: %s",i,(i%2) ? "short" : text);
+	flog_get_alloc_stats(&after);
+	printf("%-44s %10lu of %lu buffered, %" PRIu64 " allocations refused, output %s\n","flog_printf, buffered, 64 KiB budget",
+	       (unsigned long)root->msg_amount,bench_messages,after.refused-before.refused,out->output_error ? "failed" : "ok");
+	flog_set_alloc_budget(0);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+
+	bench_alloc_buffered("flog_printf, buffered, malloc()");
+	if(flog_alloc_pool_init(&pool,NULL,4*1024*1024))
+		return;
+	flog_set_allocator_pool(&pool);
+	bench_alloc_buffered("flog_printf, buffered, pool allocator");
+	flog_set_allocator(NULL);
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+	//interned names may have come from the pool
+	flog_intern_clear();
+#endif
+	flog_alloc_pool_destroy(&pool);
+}
+#endif //FLOG_CONFIG_ALLOC
+
+
+#ifdef FLOG_CONFIG_SELF_TIMING
+//! Print one self timing histogram
+static void bench_dump_histogram(const char *name,const FLOG_HISTOGRAM_T *h)
+{
+	uint64_t n=flog_histogram_count(h);
+	printf("  %-8s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",name,n,
+		flog_histogram_percentile(h,50.0),flog_histogram_percentile(h,99.0),flog_histogram_percentile(h,99.9),h->max);
+}
+
+
+//! Dump the self timing histograms of a log
+static void bench_dump_timing(const FLOG_T *p)
+{
+	FLOG_TIMING_T *timing;
+	if((timing=malloc(sizeof(FLOG_TIMING_T)))==NULL)
+		return;
+	if(!flog_get_timing(p,timing)) {
+		printf("  %-8s %10s %10s %10s %10s %10s\n","phase","calls","p50 ns","p99 ns","p99.9 ns","max ns");
+		bench_dump_histogram("total",&timing->total);
+		bench_dump_histogram("format",&timing->format);
+		bench_dump_histogram("route",&timing->route);
+		bench_dump_histogram("output",&timing->output);
+	}
+	free(timing);
+}
+
+
+//! flog_printf() with self timing enabled
+static void bench_printf_self_timing(void)
+{
+	FLOG_T *root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	FLOG_T *out=bench_create_devnull(NULL,FLOG_ACCEPT_ALL);
+	flog_append_sublog(root,out);
+	flog_timing_enable(root);
+	unsigned long i;
+	uint64_t t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+	bench_result("flog_printf, 1 text output, self timing",bench_time_ns()-t,bench_messages);
+	bench_dump_timing(root);
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+}
+#endif //FLOG_CONFIG_SELF_TIMING
+
+
+int main(int argc,char **argv)
+{
+	if(argc>1)
+		bench_messages=strtoul(argv[1],NULL,10);
+	if(!bench_messages)
+		bench_messages=1;
+	if((devnull=fopen("/dev/null","w"))==NULL) {
+		perror("/dev/null");
+		return(1);
+	}
+	printf("-[flog benchmark, %lu messages]-\n",bench_messages);
+	bench_printf();
+	bench_printf_outputs();
+#ifdef FLOG_CONFIG_ARG_TYPES
+	bench_printf_binary();
+#endif
+#ifdef FLOG_CONFIG_LAYOUT
+	bench_printf_layouts();
+#endif
+	bench_printf_filtered();
+	bench_print_buffered();
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+	bench_printf_dynamic_subsystems();
+#endif
+#ifdef FLOG_CONFIG_SAMPLING
+	bench_printf_sampled();
+#endif
+#ifdef FLOG_CONFIG_FILTER
+	bench_printf_filter_rules();
+#endif
+#ifdef FLOG_CONFIG_ESCAPE
+	bench_escape();
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_COMPRESSED
+	bench_file_outputs();
+#endif
+#ifdef FLOG_CONFIG_DETACH
+	bench_printf_detached();
+#endif
+#ifdef FLOG_CONFIG_BREAKER
+	bench_printf_breaker();
+#endif
+#ifdef FLOG_CONFIG_DURABILITY
+	bench_printf_durability();
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_SHM
+	bench_printf_shm();
+#endif
+#ifdef FLOG_CONFIG_TRACE
+	bench_trace();
+#endif
+#if defined(FLOG_CONFIG_CONTEXT_SIZE) && defined(FLOG_CONFIG_LAYOUT)
+	bench_printf_context();
+#endif
+#ifdef FLOG_CONFIG_GOVERNOR
+	bench_printf_governor();
+#endif
+#ifdef FLOG_CONFIG_SELF_TIMING
+	bench_printf_self_timing();
+#endif
+#ifdef FLOG_CONFIG_ALLOC
+	bench_alloc();
+#endif
+	fclose(devnull);
+	return(0);
+}
@@ -0,0 +1,146 @@
+//! Benchmark of the C++ interface of flog against the C macros
+
+//! Run with an optional message count: ./benchpp [messages]
+
+#include "flog.hpp"
+extern "C" {
+#include "flog_string.h"
+}
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <ctime>
+
+
+static unsigned long bench_messages=200000;
+static FILE *devnull;
+static volatile size_t bench_sink;
+
+
+static uint64_t bench_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return((uint64_t)ts.tv_sec*1000000000u+(uint64_t)ts.tv_nsec);
+}
+
+
+//! Print the result of a benchmark
+static void bench_result(const char *name,uint64_t ns,unsigned long n)
+{
+	printf("%-44s %10.1f ns/msg\n",name,(double)ns/(double)n);
+}
+
+
+//! Output function rendering messages to /dev/null
+static int bench_output_devnull(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	char buf[FLOG_STRING_BUF_SIZE],*str;
+	size_t len;
+	if(flog_get_str_message_log(&str,&len,buf,sizeof(buf),log,msg))
+		return(-1);
+	if(str)
+		fwrite(str,1,len,devnull);
+	if(str!=buf)
+		free(str);
+	return(0);
+}
+
+
+//! Output function only looking at the text, so the formatting dominates
+static int bench_output_text(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	(void)log;
+	bench_sink+=msg->text ? strlen(msg->text) : 0;
+	return(0);
+}
+
+
+//! Create a log with an output function
+static flog::log bench_create(const char *name,int (*output_func)(FLOG_T *,const FLOG_MSG_T *))
+{
+	flog::log p=flog::log::create(name,FLOG_ACCEPT_INFO);
+	if(p)
+		p.get()->output_func=output_func;
+	return(p);
+}
+
+
+//! Argument costing some work, only worth computing for used messages
+static unsigned long bench_expensive(unsigned long i)
+{
+	unsigned long h=i,j;
+	for(j=0;j<64;j++)
+		h=h*6364136223846793005ul+1442695040888963407ul;
+	return(h);
+}
+
+
+//! flog_printf() against flogpp_printf() with one output
+static void bench_compare(const char *name,int (*output_func)(FLOG_T *,const FLOG_MSG_T *))
+{
+	char label[64];
+	unsigned long i;
+	flog::log out=bench_create(NULL,output_func);
+	flog::log root=flog::log::create("root",FLOG_ACCEPT_ALL);
+	std::string peer="198.51.100.7";
+	uint64_t t;
+	root.append(out);
+
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root.get(),"bench",FLOG_INFO,FLOG_MSG_NONE,"message %lu of %lu",i,bench_messages);
+	snprintf(label,sizeof(label),"flog_printf, ints, %s",name);
+	bench_result(label,bench_time_ns()-t,bench_messages);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flogpp_printf(root,"bench",FLOG_INFO,0,"message %lu of %lu",i,bench_messages);
+	snprintf(label,sizeof(label),"flogpp_printf, ints, %s",name);
+	bench_result(label,bench_time_ns()-t,bench_messages);
+
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root.get(),"bench",FLOG_INFO,FLOG_MSG_NONE,"%s sent %lu bytes in %.3f ms",peer.c_str(),i*13,(double)i/7.0);
+	snprintf(label,sizeof(label),"flog_printf, mixed, %s",name);
+	bench_result(label,bench_time_ns()-t,bench_messages);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flogpp_printf(root,"bench",FLOG_INFO,0,"%s sent %lu bytes in %.3f ms",peer,i*13,(double)i/7.0);
+	snprintf(label,sizeof(label),"flogpp_printf, mixed, %s",name);
+	bench_result(label,bench_time_ns()-t,bench_messages);
+}
+
+
+//! Messages of a type no log uses, with an argument costing some work
+static void bench_disabled(void)
+{
+	unsigned long i;
+	flog::log out=bench_create(NULL,bench_output_text);
+	flog::log root=flog::log::create("root",FLOG_ACCEPT_ALL);
+	uint64_t t;
+	root.append(out);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flog_printf(root.get(),"bench",FLOG_DEBUG,FLOG_MSG_NONE,"hash %lu",bench_expensive(i));
+	bench_result("flog_printf, unused type",bench_time_ns()-t,bench_messages);
+	t=bench_time_ns();
+	for(i=0;i<bench_messages;i++)
+		flogpp_printf(root,"bench",FLOG_DEBUG,0,"hash %lu",bench_expensive(i));
+	bench_result("flogpp_printf, unused type",bench_time_ns()-t,bench_messages);
+}
+
+
+int main(int argc,char **argv)
+{
+	if(argc>1)
+		bench_messages=strtoul(argv[1],NULL,10);
+	if(!bench_messages || (devnull=fopen("/dev/null","w"))==NULL)
+		return(1);
+	bench_compare("text only",bench_output_text);
+	bench_compare("1 text output",bench_output_devnull);
+	bench_disabled();
+	fclose(devnull);
+	return(0);
+}
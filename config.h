@@ -31,9 +31,10 @@
 
 
 //! @def FLOG_CONFIG_ABORT_ON_ASSERT
-//! If defined then flog_assert() will call abort() on assertion failure.
-//! This behaviour can be switched off for deeply embedded systems where
-//! calling abort() doesn't make any sense.
+//! If defined then flog_assert() will call abort() on assertion failure,
+//! after writing out buffered output with flog_flush(). This behaviour
+//! can be switched off for deeply embedded systems where calling abort()
+//! doesn't make any sense.
 #define FLOG_CONFIG_ABORT_ON_ASSERT
 
 
@@ -96,3 +97,180 @@
 //! @def FLOG_CONFIG_OUTPUT_FILE
 //! If defined, then flog will include the simple file output module.
 #define FLOG_CONFIG_OUTPUT_FILE
+
+
+//! @def FLOG_CONFIG_OUTPUT_ANSI_COLOR
+//! If defined, then string output can colorize message type labels with
+//! ANSI escape codes. Colors are only used by logs which have
+//! FLOG_OUTPUT_FLAG_ANSI_COLOR set in output_flags.
+#define FLOG_CONFIG_OUTPUT_ANSI_COLOR
+
+
+//! @def FLOG_CONFIG_STATS
+//! If defined, then each log keeps counters of seen, accepted, emitted and
+//! dropped messages, bytes written and a write latency histogram.
+//! Read them with the functions in flog_stats.h. Costs roughly 1.5k of
+//! memory per log and two clock reads per output function call.
+#define FLOG_CONFIG_STATS
+
+
+//! @def FLOG_CONFIG_SELF_TIMING
+//! If defined, then flog_print[f] calls can measure their own duration,
+//! split into formatting, routing and output time. Timing is switched on
+//! per log with flog_timing_enable(), until then it costs one pointer test
+//! per call. Undefine to remove it completely.
+#define FLOG_CONFIG_SELF_TIMING
+
+
+//! @def FLOG_CONFIG_CRASH_HANDLER
+//! If defined, then flog_crash_install() can install handlers for fatal
+//! signals (SIGSEGV, SIGABRT etc.) which write out buffered output with
+//! flog_flush_signal_safe() before the program dies. Requires POSIX signals.
+#define FLOG_CONFIG_CRASH_HANDLER
+
+
+//! @def FLOG_CONFIG_SAMPLING
+//! If defined, then logs can keep only 1 in N messages of chosen types,
+//! counted per type, per call site or randomly (see flog_sample.h).
+//! Kept messages are annotated with the sampling rate.
+#define FLOG_CONFIG_SAMPLING
+
+
+//! @def FLOG_CONFIG_INTERN_TABLE_SIZE
+//! If defined, then log names, subsystem paths, source files and function
+//! names are interned in a global lock-free table of this many strings
+//! (a power of two) instead of being duplicated per log and per message.
+//! Interned strings have small integer ids (see flog_intern.h).
+#define FLOG_CONFIG_INTERN_TABLE_SIZE 1024
+
+
+//! @def FLOG_CONFIG_FILTER
+//! If defined, then flog_set_filter() can attach rules to a log that change
+//! its accepted message types per subsystem path, such as "net/*:WARN+"
+//! (see flog_filter.h). Requires FLOG_CONFIG_INTERN_TABLE_SIZE.
+#define FLOG_CONFIG_FILTER
+
+
+//! @def FLOG_CONFIG_LOADER
+//! If defined, then a log tree can be built from a configuration file,
+//! and reloaded while messages are being emitted (see flog_conf.h).
+#define FLOG_CONFIG_LOADER
+
+
+//! @def FLOG_CONFIG_ARG_TYPES
+//! If defined, then flog_printf() records the types of its arguments at
+//! compile time, so outputs can store arguments in binary instead of
+//! formatted text (see flog_args.h). Uses _Generic and GNU statement
+//! expressions, and limits flog_printf() to FLOG_ARG_MAX arguments.
+#define FLOG_CONFIG_ARG_TYPES
+
+
+//! @def FLOG_CONFIG_LAYOUT
+//! If defined, then messages are rendered by compiled layouts such as
+//! "%T %S %L: %m%n", and each log can have its own layout set with
+//! flog_set_layout() (see flog_layout.h). Requires FLOG_CONFIG_STRING_OUTPUT.
+#define FLOG_CONFIG_LAYOUT
+
+
+//! @def FLOG_CONFIG_ESCAPE
+//! If defined, then message text can be escaped so every message stays on
+//! one line, or is safe inside a JSON string (see flog_escape.h). Layouts
+//! get the %e and %j fields, and FLOG_OUTPUT_FLAG_ESCAPE escapes %m.
+#define FLOG_CONFIG_ESCAPE
+
+
+//! @def FLOG_CONFIG_INLINE_TEXT_SIZE
+//! If defined, then flog_printf() formats text into a stack buffer of this
+//! size and only allocates longer texts, and flog_copy_msg() stores the
+//! text in the same allocation as the message.
+#define FLOG_CONFIG_INLINE_TEXT_SIZE 128
+
+
+//! @def FLOG_CONFIG_OUTPUT_COMPRESSED
+//! If defined, then an output is available which writes compressed
+//! files, with blocks compressed by a background thread into frames
+//! that can be read on their own (see flog_output_compressed.h and
+//! flogcat). Requires POSIX threads.
+#define FLOG_CONFIG_OUTPUT_COMPRESSED
+
+
+//! @def FLOG_CONFIG_INDEX
+//! If defined, then buffered file outputs can write a sidecar index of
+//! time ranges and message types every N records, which flogq uses to
+//! read only the matching parts of a file (see flog_index.h). Requires
+//! FLOG_CONFIG_TIMESTAMP and FLOG_CONFIG_OUTPUT_FILE.
+#define FLOG_CONFIG_INDEX
+
+
+//! @def FLOG_CONFIG_RENDER_CACHE_SIZE
+//! If defined, then a message going to several text outputs with the same
+//! layout is rendered once, and the line is kept in a stack buffer of this
+//! size for the other outputs (see flog_get_str_message_log()).
+#define FLOG_CONFIG_RENDER_CACHE_SIZE 1024
+
+
+//! @def FLOG_CONFIG_DETACH
+//! If defined, then a log can be detached with flog_detach(), giving it
+//! its own queue and worker thread, so a slow output or subtree does not
+//! delay the caller or the other outputs (see flog_detach.h). Requires
+//! POSIX threads.
+#define FLOG_CONFIG_DETACH
+
+
+//! @def FLOG_CONFIG_BREAKER
+//! If defined, then a log can have a circuit breaker with flog_set_breaker(),
+//! which stops calling a failing output and probes it again with an
+//! exponential backoff, instead of stopping it for good or failing on every
+//! message (see flog_breaker.h).
+#define FLOG_CONFIG_BREAKER
+
+
+//! @def FLOG_CONFIG_DURABILITY
+//! If defined, then buffered file outputs can write chosen message types
+//! at once, or put them on disk with fdatasync() before returning, alone
+//! or shared by concurrent threads in a group commit, while other types
+//! stay buffered (see flog_output_file_set_durability()). Requires POSIX
+//! threads.
+#define FLOG_CONFIG_DURABILITY
+
+
+//! @def FLOG_CONFIG_OUTPUT_SHM
+//! If defined, then logs can write to a lock-free ring of fixed size
+//! records in POSIX shared memory, shared by any amount of processes and
+//! followed live with flogtail (see flog_output_shm.h). Requires
+//! FLOG_CONFIG_STRING_OUTPUT.
+#define FLOG_CONFIG_OUTPUT_SHM
+
+
+//! @def FLOG_CONFIG_TRACE
+//! If defined, then scopes can be timed as spans with flog_trace(), each
+//! emitting one message with its duration and nesting depth when left,
+//! and logs can write Chrome trace event JSON with
+//! create_flog_output_trace() (see flog_trace.h). Requires gcc or clang
+//! for the cleanup attribute.
+#define FLOG_CONFIG_TRACE
+
+
+//! @def FLOG_CONFIG_CONTEXT_SIZE
+//! If defined, then each thread has a context of key=value entries of up
+//! to this many bytes, and its thread id and name, pushed and popped
+//! without allocating (see flog_context.h). Messages point to the context
+//! of their thread, rendered by the %C, %t and %N layout fields.
+#define FLOG_CONFIG_CONTEXT_SIZE 256
+
+
+//! @def FLOG_CONFIG_GOVERNOR
+//! If defined, then a log can have a load shedding governor with
+//! flog_set_governor(), which stops using the least severe message types
+//! while the log is slow to take messages or its detached queues fill up,
+//! and uses them again with hysteresis once the pressure is gone (see
+//! flog_governor.h).
+#define FLOG_CONFIG_GOVERNOR
+
+
+//! @def FLOG_CONFIG_ALLOC
+//! If defined, then flog counts its allocations, can keep them within a
+//! byte budget by dropping messages rather than growing, and allocates
+//! from the allocator set with flog_set_allocator() or from a built-in
+//! pool (see flog_alloc.h).
+#define FLOG_CONFIG_ALLOC
@@ -11,8 +11,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <strings.h>
+#include <ctype.h>
 
 #include "flog.h"
+#include "flog_alloc.h"
+#include "flog_stats.h"
+#include "flog_sample.h"
+#include "flog_filter.h"
+#include "flog_layout.h"
+#include "flog_detach.h"
+#include "flog_breaker.h"
+#include "flog_context.h"
+#include "flog_governor.h"
+
+#ifndef FLOG_CONFIG_INTERN_TABLE_SIZE
+typedef uint_fast8_t FLOG_INTERN_ID_T;
+#endif
 
 
 //! initialise a FLOG_MSG_T to defaults
@@ -36,6 +51,23 @@ void init_flog_msg_t(FLOG_MSG_T *p)
 }
 
 
+//! duplicate a string for a FLOG_MSG_T or FLOG_T, interning it if possible
+
+//! @param[in] *str string to duplicate
+//! @param[out] *id interned id, 0 if the returned string is allocated and must be freed
+//! @retval NULL error
+static char * flog_strdup_interned(const char *str,FLOG_INTERN_ID_T *id)
+{
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+	if((*id=flog_intern(str)))
+		return((char *)flog_intern_str(*id));
+#else
+	*id=0;
+#endif
+	return(flog_strdup(str));
+}
+
+
 //! create and return a FLOG_MSG_T type
 
 //! internal use only, or when creating flog output function
@@ -50,36 +82,46 @@ FLOG_MSG_T * create_flog_msg_t(const char *subsystem,
                                FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *text)
 {
 	FLOG_MSG_T *p;
-	if((p=malloc(sizeof(FLOG_MSG_T)))!=NULL) {
+	if((p=flog_malloc(sizeof(FLOG_MSG_T)))!=NULL) {
 		init_flog_msg_t(p);
 		p->type=type;
+		FLOG_INTERN_ID_T id;
 		if(subsystem && subsystem[0]) {
-			if((p->subsystem=strdup(subsystem))==NULL) {
+			if((p->subsystem=flog_strdup_interned(subsystem,&id))==NULL) {
 				destroy_flog_msg_t(p);
 				return(NULL);
 			}
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+			p->subsystem_id=id;
+#endif
 		}
 #ifdef FLOG_CONFIG_TIMESTAMP
 		p->timestamp=timestamp;
 #endif
 #ifdef FLOG_CONFIG_SRC_INFO
 		if(src_file && src_file[0]) {
-			if((p->src_file=strdup(src_file))==NULL) {
+			if((p->src_file=flog_strdup_interned(src_file,&id))==NULL) {
 				destroy_flog_msg_t(p);
 				return(NULL);
 			}
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+			p->src_file_id=id;
+#endif
 		}
 		p->src_line=src_line;
 		if(src_func && src_func[0]) {
-			if((p->src_func=strdup(src_func))==NULL) {
+			if((p->src_func=flog_strdup_interned(src_func,&id))==NULL) {
 				destroy_flog_msg_t(p);
 				return(NULL);
 			}
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+			p->src_func_id=id;
+#endif
 		}
 #endif
 		p->msg_id=msg_id;
 		if(text!=NULL) {
-			if((p->text=strdup(text))==NULL) {
+			if((p->text=flog_strdup(text))==NULL) {
 				destroy_flog_msg_t(p);
 				return(NULL);
 			}
@@ -95,18 +137,245 @@ FLOG_MSG_T * create_flog_msg_t(const char *subsystem,
 void destroy_flog_msg_t(FLOG_MSG_T *p)
 {
 	if(p) {
-		free(p->subsystem);
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+		//interned strings are owned by the intern table
+		if(!p->subsystem_id)
+			flog_free(p->subsystem);
 #ifdef FLOG_CONFIG_SRC_INFO
-		free(p->src_file);
-		free(p->src_func);
+		if(!(p->flags & FLOG_MSG_FLAG_STATIC_SRC)) {
+			if(!p->src_file_id)
+				flog_free(p->src_file);
+			if(!p->src_func_id)
+				flog_free(p->src_func);
+		}
+#endif
+#else //FLOG_CONFIG_INTERN_TABLE_SIZE
+		flog_free(p->subsystem);
+#ifdef FLOG_CONFIG_SRC_INFO
+		if(!(p->flags & FLOG_MSG_FLAG_STATIC_SRC)) {
+			flog_free(p->src_file);
+			flog_free(p->src_func);
+		}
 #endif
-		free(p->text);
-		free(p);
+#endif //FLOG_CONFIG_INTERN_TABLE_SIZE
+		if(!(p->flags & (FLOG_MSG_FLAG_STATIC_TEXT|FLOG_MSG_FLAG_INLINE_TEXT)))
+			flog_free(p->text);
+		flog_free(p);
 		p=NULL;
 	}
 }
 
 
+//! copy a FLOG_MSG_T which is only valid during the call, for keeping it
+
+//! Strings marked static in msg->flags and interned strings are borrowed,
+//! only transient strings (such as formatted text) are duplicated.
+//! With FLOG_CONFIG_INLINE_TEXT_SIZE the text is stored in the same
+//! allocation as the message, and so is a copy of the thread context with
+//! FLOG_CONFIG_CONTEXT_SIZE.
+//! Free the copy with destroy_flog_msg_t().
+//! @param[in] *msg message to copy
+//! @retval NULL error
+FLOG_MSG_T * flog_copy_msg(const FLOG_MSG_T *msg)
+{
+	FLOG_MSG_T *p;
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+	//the context of the thread changes, copies keep it as it was
+	size_t context_size=msg->context ? flog_context_size(msg->context) : 0;
+#else
+	const size_t context_size=0;
+#endif
+#ifdef FLOG_CONFIG_INLINE_TEXT_SIZE
+	size_t text_size=(msg->text && !(msg->flags & FLOG_MSG_FLAG_STATIC_TEXT)) ? strlen(msg->text)+1 : 0;
+	if((p=flog_malloc(sizeof(FLOG_MSG_T)+context_size+text_size))==NULL)
+		return(NULL);
+	*p=*msg;
+	p->flags&=(uint_fast8_t)~FLOG_MSG_FLAG_INLINE_TEXT;
+	if(text_size) {
+		p->text=memcpy((char *)(p+1)+context_size,msg->text,text_size);
+		p->flags|=FLOG_MSG_FLAG_INLINE_TEXT;
+	}
+#else //FLOG_CONFIG_INLINE_TEXT_SIZE
+	if((p=flog_malloc(sizeof(FLOG_MSG_T)+context_size))==NULL)
+		return(NULL);
+	*p=*msg;
+#endif //FLOG_CONFIG_INLINE_TEXT_SIZE
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+	if(context_size)
+		p->context=memcpy(p+1,msg->context,context_size);
+#endif
+	p->subsystem=NULL;
+#ifdef FLOG_CONFIG_SRC_INFO
+	if(!(p->flags & FLOG_MSG_FLAG_STATIC_SRC)) {
+		p->src_file=NULL;
+		p->src_func=NULL;
+	}
+#endif
+	if(!(p->flags & (FLOG_MSG_FLAG_STATIC_TEXT|FLOG_MSG_FLAG_INLINE_TEXT)))
+		p->text=NULL;
+#ifdef FLOG_CONFIG_ARG_TYPES
+	//the arguments are only valid while the message is emitted, copies keep the text
+	p->format=NULL;
+	p->arg_site=NULL;
+	p->args=NULL;
+#endif
+#ifdef FLOG_CONFIG_RENDER_CACHE_SIZE
+	p->render=NULL;
+#endif
+	FLOG_INTERN_ID_T id;
+	if(msg->subsystem) {
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+		if((id=msg->subsystem_id))
+			p->subsystem=(char *)flog_intern_str(id);
+		else
+#endif
+		p->subsystem=flog_strdup_interned(msg->subsystem,&id);
+		if(p->subsystem==NULL) {
+			destroy_flog_msg_t(p);
+			return(NULL);
+		}
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+		p->subsystem_id=id;
+#endif
+	}
+#ifdef FLOG_CONFIG_SRC_INFO
+	if(!(p->flags & FLOG_MSG_FLAG_STATIC_SRC)) {
+		if(msg->src_file) {
+			if((p->src_file=flog_strdup_interned(msg->src_file,&id))==NULL) {
+				destroy_flog_msg_t(p);
+				return(NULL);
+			}
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+			p->src_file_id=id;
+#endif
+		}
+		if(msg->src_func) {
+			if((p->src_func=flog_strdup_interned(msg->src_func,&id))==NULL) {
+				destroy_flog_msg_t(p);
+				return(NULL);
+			}
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+			p->src_func_id=id;
+#endif
+		}
+	}
+#endif
+	if(msg->text && !(p->flags & (FLOG_MSG_FLAG_STATIC_TEXT|FLOG_MSG_FLAG_INLINE_TEXT))) {
+		if((p->text=flog_strdup(msg->text))==NULL) {
+			destroy_flog_msg_t(p);
+			return(NULL);
+		}
+	}
+	return(p);
+}
+
+
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+//! get the interned id of the subsystem of a message, interning it if needed
+
+//! Subsystems may be built per message, so they are interned with flog_intern_transient().
+//! @retval 0 no subsystem, or it could not be interned
+FLOG_INTERN_ID_T flog_msg_subsystem_id(FLOG_MSG_T *p)
+{
+	if(!p->subsystem_id && p->subsystem)
+		p->subsystem_id=flog_intern_transient(p->subsystem,strlen(p->subsystem));
+	return(p->subsystem_id);
+}
+#endif
+
+
+//! Names of message types, as used in filter rules and configuration files
+static const struct {
+	const char *name;
+	FLOG_MSG_TYPE_T type;
+} flog_msg_type_name[] = {
+	{"CRIT",       FLOG_CRIT},
+	{"CRITICAL",   FLOG_CRIT},
+	{"ERR",        FLOG_ERR},
+	{"ERROR",      FLOG_ERR},
+	{"WARN",       FLOG_WARN},
+	{"WARNING",    FLOG_WARN},
+	{"NOTE",       FLOG_NOTE},
+	{"INFO",       FLOG_INFO},
+	{"VINFO",      FLOG_VINFO},
+	{"VERBOSE",    FLOG_VINFO},
+	{"DEBUG",      FLOG_DEBUG},
+	{"DEEP_DEBUG", FLOG_DEEP_DEBUG},
+	{NULL,         FLOG_NONE}
+};
+
+
+//! Get a message type from its name (case insensitive, such as "WARN" or "debug")
+
+//! @param[in] *name name of message type (need not be null terminated)
+//! @param[in] len length of name
+//! @retval FLOG_NONE unknown name
+FLOG_MSG_TYPE_T flog_get_msg_type_by_name(const char *name,size_t len)
+{
+	unsigned int i;
+	for(i=0;flog_msg_type_name[i].name;i++) {
+		if(strlen(flog_msg_type_name[i].name)==len && !strncasecmp(flog_msg_type_name[i].name,name,len))
+			return(flog_msg_type_name[i].type);
+	}
+	return(FLOG_NONE);
+}
+
+
+//! Parse an action on a mask of accepted message types
+
+//! The new mask is (mask & ~clear) | set. Actions are "LEVEL+" (that level
+//! and everything more severe), "LEVEL" (only that level), "LEVEL on",
+//! "LEVEL off", "all" or "off" (also "none").
+//! @param[in] *str action (need not be null terminated, no surrounding spaces)
+//! @param[in] len length of str
+//! @param[out] *clear message types to remove from the mask
+//! @param[out] *set message types to add to the mask
+//! @retval 0 success
+//! @retval 1 syntax error
+int flog_parse_msg_type_action(const char *str,size_t len,FLOG_MSG_TYPE_T *clear,FLOG_MSG_TYPE_T *set)
+{
+	const char *word2;
+	size_t len1,len2;
+	FLOG_MSG_TYPE_T type;
+	for(len1=0;len1<len && !isspace((unsigned char)str[len1]);len1++);
+	for(word2=str+len1;word2<str+len && isspace((unsigned char)*word2);word2++);
+	len2=len-(size_t)(word2-str);
+	if(!len1)
+		return(1);
+	if(!len2 && len1==3 && !strncasecmp(str,"all",3)) {
+		*clear=0xff;
+		*set=0xff;
+		return(0);
+	}
+	if(!len2 && ((len1==3 && !strncasecmp(str,"off",3)) || (len1==4 && !strncasecmp(str,"none",4)))) {
+		*clear=0xff;
+		*set=0;
+		return(0);
+	}
+	if(str[len1-1]=='+') {
+		if(len2 || (type=flog_get_msg_type_by_name(str,len1-1))==FLOG_NONE)
+			return(1);
+		*clear=0xff;
+		*set=(type<<1)-1;
+		return(0);
+	}
+	if((type=flog_get_msg_type_by_name(str,len1))==FLOG_NONE)
+		return(1);
+	if(!len2) {
+		*clear=0xff;
+		*set=type;
+	} else if(len2==2 && !strncasecmp(word2,"on",2)) {
+		*clear=0;
+		*set=type;
+	} else if(len2==3 && !strncasecmp(word2,"off",3)) {
+		*clear=type;
+		*set=0;
+	} else
+		return(1);
+	return(0);
+}
+
+
 //! initialise a FLOG_T to defaults
 
 //! mainly internal use, or when extending flog
@@ -117,8 +386,10 @@ void init_flog_t(FLOG_T *p)
 	p->accepted_msg_type=FLOG_ACCEPT_ALL;
 	//p->output_func=NULL;
 	//p->output_func_data=NULL;
+	//p->output_flush_func=NULL;
 	//p->output_error=0;
 	p->output_stop_on_error=1;
+	//p->output_flags=0;
 	//p->error_log=NULL;
 	//p->msg=NULL;
 	//p->msg_amount=0;
@@ -134,14 +405,18 @@ void init_flog_t(FLOG_T *p)
 FLOG_T * create_flog_t(const char *name, FLOG_MSG_TYPE_T accepted_msg_type)
 {
 	FLOG_T *p;
-	if((p=malloc(sizeof(FLOG_T)))!=NULL) {
+	if((p=flog_malloc(sizeof(FLOG_T)))!=NULL) {
 		init_flog_t(p);
 		p->accepted_msg_type=accepted_msg_type;
 		if(name && name[0]) {
-			if((p->name=strdup(name))==NULL) {
+			FLOG_INTERN_ID_T id;
+			if((p->name=flog_strdup_interned(name,&id))==NULL) {
 				destroy_flog_t(p);
 				return(NULL);
 			}
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+			p->name_id=id;
+#endif
 		}
 	}
 	return(p);
@@ -152,74 +427,322 @@ FLOG_T * create_flog_t(const char *name, FLOG_MSG_TYPE_T accepted_msg_type)
 void destroy_flog_t(FLOG_T *p)
 {
 	if(p) {
-		free(p->name);
+#ifdef FLOG_CONFIG_DETACH
+		flog_attach(p);
+#endif
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+		if(!p->name_id)
+#endif
+			flog_free(p->name);
 		if(p->msg) {
 			uint_fast16_t i;
 			for(i=0;i<p->msg_amount;i++)
 				destroy_flog_msg_t(p->msg[i]);
-			free(p->msg);
+			flog_free(p->msg);
 		}
-		free(p->sublog); //! Note that sublogs are not freed
-		free(p);
+		flog_free(p->sublog); //! Note that sublogs are not freed
+#ifdef FLOG_CONFIG_SELF_TIMING
+		flog_free(p->timing);
+#endif
+#ifdef FLOG_CONFIG_SAMPLING
+		flog_free(p->sampler);
+#endif
+#ifdef FLOG_CONFIG_BREAKER
+		flog_free(p->breaker);
+#endif
+#ifdef FLOG_CONFIG_GOVERNOR
+		flog_free(p->governor);
+#endif
+#ifdef FLOG_CONFIG_FILTER
+		destroy_flog_filter(p->filter);
+		flog_free_retired_filters(p);
+#endif
+#ifdef FLOG_CONFIG_LAYOUT
+		destroy_flog_layout(p->layout);
+#endif
+		flog_free(p);
 		p=NULL;
 	}
 }
 
 
 #ifdef FLOG_CONFIG_RECURSIVE_MAX_STACK_DEPTH
-int stack_depth;
+//! depth of sublogs in this thread, detached logs route in their own thread
+static __thread int stack_depth;
 #endif
 
 
-//! add a FLOG_MSG_T to FLOG_T and do all required logic (used by flog_print[f] functions)
+#ifdef FLOG_CONFIG_SELF_TIMING
+//! non-zero while a timed flog_print[f] call is running in this thread
+static __thread int flog_timing_active;
+//! time spent in output functions by the running timed call (ns)
+static __thread uint64_t flog_timing_output_ns;
 
-//! internal use only, or when extending flog
-//! @param[in,out] *p target log
-//! @param[in] *msg message to add
-//! @retval 0 success
-int flog_add_msg(FLOG_T *p,FLOG_MSG_T *msg)
+
+//! State of one timed flog_print[f] call
+typedef struct {
+	FLOG_TIMING_T *timing;                  //!< histograms to record to (NULL if not timed)
+	uint64_t start;                         //!< time of call
+	uint64_t formatted;                     //!< time formatting was done (0 if not formatted)
+	int saved_active;                       //!< flog_timing_active of an outer call
+	uint64_t saved_output_ns;               //!< flog_timing_output_ns of an outer call
+} FLOG_TIMING_CALL_T;
+
+
+//! start timing a flog_print[f] call if timing is enabled for p
+static inline void flog_timing_call_start(FLOG_TIMING_CALL_T *c,FLOG_T *p)
+{
+	if((c->timing=__atomic_load_n(&p->timing,__ATOMIC_ACQUIRE))) {
+		c->saved_active=flog_timing_active;
+		c->saved_output_ns=flog_timing_output_ns;
+		flog_timing_active=1;
+		flog_timing_output_ns=0;
+		c->formatted=0;
+		c->start=flog_get_time_ns();
+	}
+}
+
+
+//! mark the end of formatting in a timed flog_printf call
+static inline void flog_timing_call_formatted(FLOG_TIMING_CALL_T *c)
 {
+	if(c->timing)
+		c->formatted=flog_get_time_ns();
+}
+
+
+//! stop timing a flog_print[f] call, only record it if the message was used
+static inline void flog_timing_call_end(FLOG_TIMING_CALL_T *c,int record)
+{
+	if(c->timing) {
+		if(record) {
+			uint64_t end=flog_get_time_ns();
+			uint64_t routed=c->formatted ? c->formatted : c->start;
+			flog_histogram_add(&c->timing->total,end-c->start);
+			if(c->formatted)
+				flog_histogram_add(&c->timing->format,c->formatted-c->start);
+			flog_histogram_add(&c->timing->output,flog_timing_output_ns);
+			flog_histogram_add(&c->timing->route,end-routed>flog_timing_output_ns ? end-routed-flog_timing_output_ns : 0);
+		}
+		//an outer timed call (from an output function) counts our time as its output time
+		flog_timing_active=c->saved_active;
+		flog_timing_output_ns=c->saved_output_ns;
+	}
+}
+#else //FLOG_CONFIG_SELF_TIMING
+#define flog_timing_call_start(c, p) (void)(0)
+#define flog_timing_call_formatted(c) (void)(0)
+#define flog_timing_call_end(c, record) (void)(0)
+#endif //FLOG_CONFIG_SELF_TIMING
+
+
+#if defined(FLOG_CONFIG_STATS) || defined(FLOG_CONFIG_SELF_TIMING)
+//! read the clock for timing an output function, if anyone needs it
+static inline uint64_t flog_output_clock(void)
+{
+#ifndef FLOG_CONFIG_STATS
+	if(!flog_timing_active)
+		return(0);
+#endif
+	return(flog_get_time_ns());
+}
+#endif
+
+
+//! Call the output function of a log, setting FLOG_T->output_error if it failed
+
+//! @param[out] *failed set if the output failed, not if it only dropped the
+//!                     message to stay within the memory budget (see flog_alloc.h)
+//! @return result of the output function
+static inline int flog_output_msg(FLOG_T *p,const FLOG_MSG_T *msg,int *failed)
+{
+#ifdef FLOG_CONFIG_ALLOC
+	unsigned int refused=flog_alloc_refused;
+#endif
+	int e=p->output_func(p,msg);
+	*failed=(e!=0);
+#ifdef FLOG_CONFIG_ALLOC
+	if(e && flog_alloc_refused!=refused)
+		*failed=0;
+#endif
+	if(*failed)
+		p->output_error=e;
+	return(e);
+}
+
+
+//! add a FLOG_MSG_T to FLOG_T, sampling already done by the caller if sampled is set
+static int flog_add_msg_sampled(FLOG_T *p,FLOG_MSG_T *msg,int sampled)
+{
+#ifdef FLOG_CONFIG_STATS
+	unsigned int type_index=flog_msg_type_index(msg->type);
+	flog_stats_count(p,seen,type_index);
+#endif
 	//compare if accepted message type
+#ifdef FLOG_CONFIG_FILTER
+	FLOG_FILTER_T *filter=__atomic_load_n(&p->filter,__ATOMIC_ACQUIRE);
+	if(filter) {
+		if(!(msg->type & (p->accepted_msg_type|filter->enable_mask)))
+			return(0);
+		if(!(msg->type & flog_filter_mask(filter,msg,p->accepted_msg_type)))
+			return(0);
+	} else
+#endif
 	if(!(msg->type & p->accepted_msg_type))
 		return(0);
+#ifdef FLOG_CONFIG_GOVERNOR
+	if(msg->type & __atomic_load_n(&p->shed_msg_type,__ATOMIC_RELAXED)) {
+		flog_governor_shed(p,msg->type);
+		return(0);
+	}
+#endif
 
 	//copy the input msg into a FLOG_MSG_T struct
 	FLOG_MSG_T outmsg;
 	outmsg=*msg;
 
+#ifdef FLOG_CONFIG_SAMPLING
+	if(p->sampler && !sampled) {
+		uint32_t rate;
+#ifdef FLOG_CONFIG_SRC_INFO
+		if(!(rate=flog_sample_msg(p->sampler,msg->type,msg->src_file,msg->src_line)))
+#else
+		if(!(rate=flog_sample_msg(p->sampler,msg->type)))
+#endif
+			return(0);
+		if(rate>1)
+			outmsg.sample_rate=(outmsg.sample_rate ? outmsg.sample_rate : 1)*rate;
+	}
+#else //FLOG_CONFIG_SAMPLING
+	(void)sampled;
+#endif //FLOG_CONFIG_SAMPLING
+	flog_stats_count(p,accepted,type_index);
+
+#ifdef FLOG_CONFIG_GOVERNOR
+	//a governor times the log taking the message, queueing included
+	FLOG_GOVERNOR_T *governor=__atomic_load_n(&p->governor,__ATOMIC_ACQUIRE);
+	uint64_t start=governor ? flog_get_time_ns() : 0;
+#endif
+	int e;
+#ifdef FLOG_CONFIG_DETACH
+	//a detached log routes the message in its worker thread
+	if(__atomic_load_n(&p->detach,__ATOMIC_ACQUIRE) && !flog_detach_in_worker(p))
+		e=flog_detach_msg(p,&outmsg);
+	else
+#endif
+		e=flog_route_msg(p,&outmsg);
+#ifdef FLOG_CONFIG_GOVERNOR
+	if(governor)
+		flog_governor_time(p,governor,start);
+#endif
+	return(e);
+}
+
+
+//! output an accepted message of a log and pass it on to the sublogs
+
+//! internal use only, the message is filtered and sampled by flog_add_msg()
+//! @param[in,out] *p log
+//! @param[in] *msg message, subsystem is changed while routing
+//! @retval 0 success
+int flog_route_msg(FLOG_T *p,FLOG_MSG_T *msg)
+{
+#ifdef FLOG_CONFIG_STATS
+	unsigned int type_index=flog_msg_type_index(msg->type);
+#endif
+	FLOG_MSG_T outmsg;
+	outmsg=*msg;
+
 	//append name to subsystem
 	int free_subsystem=0;
 	if(p->name) {
 		if(outmsg.subsystem) {
-			char *tmpstr;
-			if(asprintf(&tmpstr,"%s/%s",p->name,outmsg.subsystem)!=-1) { //We don't care if we can't allocate memory
-				outmsg.subsystem = tmpstr;
-				free_subsystem=1;
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+			//build the path on the stack and intern it, so no allocation is needed once seen,
+			//but only while the table has room, as dynamic subsystems give paths never seen again
+			char path[FLOG_INTERN_PATH_MAX];
+			size_t name_len=strlen(p->name),subsystem_len=strlen(outmsg.subsystem);
+			outmsg.subsystem_id=0;
+			if(name_len+1+subsystem_len<sizeof(path)) {
+				memcpy(path,p->name,name_len);
+				path[name_len]='/';
+				memcpy(path+name_len+1,outmsg.subsystem,subsystem_len);
+				if((outmsg.subsystem_id=flog_intern_transient(path,name_len+1+subsystem_len)))
+					outmsg.subsystem=(char *)flog_intern_str(outmsg.subsystem_id);
+			}
+			if(!outmsg.subsystem_id) {
+#endif
+				char *tmpstr;
+				if(flog_asprintf(&tmpstr,"%s/%s",p->name,outmsg.subsystem)!=-1) { //We don't care if we can't allocate memory
+					outmsg.subsystem = tmpstr;
+					free_subsystem=1;
+				}
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
 			}
+#endif
 		} else {
 			outmsg.subsystem=p->name;
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+			outmsg.subsystem_id=p->name_id;
+#endif
 		}
 	}
 
-	//! @todo add message to buffer
-	/*
+	//add message to buffer, static and interned strings are borrowed
 	if(p->msg_amount<p->msg_max) {
-		FLOG_MSG_T **new_msg;
-		if((new_msg=realloc(p->msg,(p->msg_amount+1)*sizeof(FLOG_MSG_T *)))!=NULL) {
-			p->msg=new_msg;
-			p->msg[p->msg_amount]=msg;
-			p->msg_amount++;
+		FLOG_MSG_T **new_msg,*copy;
+		if((copy=flog_copy_msg(&outmsg))!=NULL) {
+			if((new_msg=flog_realloc(p->msg,(p->msg_amount+1)*sizeof(FLOG_MSG_T *)))!=NULL) {
+				p->msg=new_msg;
+				p->msg[p->msg_amount]=copy;
+				p->msg_amount++;
+			} else
+				destroy_flog_msg_t(copy);
 		}
-	}*/
+	}
 
 	//! @todo invent a suitable error output strategy
 	int e=0;
 
 	//run output function
 	if(p->output_func) {
+#ifdef FLOG_CONFIG_BREAKER
+		FLOG_BREAKER_T *breaker=p->breaker;
+		if(breaker ? flog_breaker_allow(breaker) : (p->output_stop_on_error ? !p->output_error : 1)) {
+#else
 		if(p->output_stop_on_error ? !p->output_error : 1) {
-			if((e=p->output_func(p,&outmsg)))
-				p->output_error=e;
+#endif
+#if defined(FLOG_CONFIG_STATS) || defined(FLOG_CONFIG_SELF_TIMING)
+			uint64_t t=flog_output_clock();
+#endif
+			int failed;
+#ifdef FLOG_CONFIG_BREAKER
+			if(breaker) {
+				//reports of the output to the error log could reach it again
+				flog_breaker_quiet++;
+				e=flog_output_msg(p,&outmsg,&failed);
+				flog_breaker_quiet--;
+				flog_breaker_result(p,breaker,failed ? e : 0);
+			} else
+#endif
+			e=flog_output_msg(p,&outmsg,&failed);
+#if defined(FLOG_CONFIG_STATS) || defined(FLOG_CONFIG_SELF_TIMING)
+			if(t)
+				t=flog_output_clock()-t;
+#endif
+#ifdef FLOG_CONFIG_SELF_TIMING
+			flog_timing_output_ns+=t;
+#endif
+#ifdef FLOG_CONFIG_STATS
+			flog_histogram_add(&p->stats.write_latency,t);
+			if(e) {
+				__atomic_store_n(&p->stats.last_error,e,__ATOMIC_RELAXED);
+				flog_stats_count(p,dropped,type_index);
+			} else
+				flog_stats_count(p,emitted,type_index);
+		} else {
+			flog_stats_count(p,dropped,type_index);
+#endif
 		}
 	}
 
@@ -230,7 +753,7 @@ int flog_add_msg(FLOG_T *p,FLOG_MSG_T *msg)
 		//add message to sublogs
 		uint_fast8_t i;
 		for(i=0;i<p->sublog_amount;i++)
-			e+=flog_add_msg(p->sublog[i],&outmsg);
+			e+=flog_add_msg_sampled(__atomic_load_n(&p->sublog[i],__ATOMIC_ACQUIRE),&outmsg,0);
 #ifdef FLOG_CONFIG_RECURSIVE_MAX_STACK_DEPTH
 		stack_depth--;
 	}
@@ -238,12 +761,34 @@ int flog_add_msg(FLOG_T *p,FLOG_MSG_T *msg)
 
 	//if we allocated a string, free it
 	if(free_subsystem)
-		free(outmsg.subsystem);
+		flog_free(outmsg.subsystem);
 
 	return(e);
 }
 
 
+//! add a FLOG_MSG_T to FLOG_T and do all required logic (used by flog_print[f] functions)
+
+//! internal use only, or when extending flog
+//! @param[in,out] *p target log
+//! @param[in] *msg message to add
+//! @retval 0 success
+int flog_add_msg(FLOG_T *p,FLOG_MSG_T *msg)
+{
+#ifdef FLOG_CONFIG_RENDER_CACHE_SIZE
+	if(msg->render==NULL) {
+		FLOG_RENDER_CACHE_T render;
+		flog_render_cache_init(&render);
+		msg->render=&render;
+		int e=flog_add_msg_sampled(p,msg,0);
+		msg->render=NULL;
+		return(e);
+	}
+#endif
+	return(flog_add_msg_sampled(p,msg,0));
+}
+
+
 //! clear all messages stored in log
 void flog_clear_msg_buffer(FLOG_T *p)
 {
@@ -251,7 +796,7 @@ void flog_clear_msg_buffer(FLOG_T *p)
 		uint_fast16_t i;
 		for(i=0;i<p->msg_amount;i++)
 			destroy_flog_msg_t(p->msg[i]);
-		free(p->msg);
+		flog_free(p->msg);
 		p->msg=NULL;
 		p->msg_amount=0;
 	}
@@ -272,7 +817,7 @@ int flog_append_sublog(FLOG_T *p,FLOG_T *sublog)
 		return(1);
 	}
 	FLOG_T **new_sublog;
-	if((new_sublog=realloc(p->sublog,(p->sublog_amount+1)*sizeof(FLOG_T *)))==NULL)
+	if((new_sublog=flog_realloc(p->sublog,(p->sublog_amount+1)*sizeof(FLOG_T *)))==NULL)
 		return(1);
 	p->sublog=new_sublog;
 	p->sublog[p->sublog_amount]=sublog;
@@ -281,6 +826,96 @@ int flog_append_sublog(FLOG_T *p,FLOG_T *sublog)
 }
 
 
+
+//! Replace a sublog of a log (thread safe)
+
+//! Messages being emitted concurrently go to either the old or the new
+//! sublog, so the old sublog must be kept until they are done.
+//! @param[in,out] *p target log
+//! @param[in] index index of sublog to replace
+//! @param[in] *sublog new sublog
+//! @return the old sublog
+//! @retval NULL error (no such sublog)
+FLOG_T * flog_replace_sublog(FLOG_T *p,uint_fast8_t index,FLOG_T *sublog)
+{
+	if(!p || index>=p->sublog_amount || p==sublog)
+		return(NULL);
+	return(__atomic_exchange_n(&p->sublog[index],sublog,__ATOMIC_ACQ_REL));
+}
+
+//! Recursive part of flog_flush() and flog_flush_signal_safe()
+
+//! Uses its own depth counter as the global stack_depth may be in use when a signal arrives
+static int flog_flush_depth(FLOG_T *p,int signal_safe,unsigned int depth)
+{
+	int e=0;
+	uint_fast8_t i;
+	if(!p)
+		return(0);
+#ifdef FLOG_CONFIG_RECURSIVE_MAX_STACK_DEPTH
+	if(depth>=FLOG_CONFIG_RECURSIVE_MAX_STACK_DEPTH)
+		return(0);
+#endif
+#ifdef FLOG_CONFIG_DETACH
+	//queued messages are written by the worker, which then flushes the log
+	if(!signal_safe && __atomic_load_n(&p->detach,__ATOMIC_ACQUIRE) && !flog_detach_in_worker(p))
+		return(flog_detach_flush(p));
+#endif
+	if(p->output_flush_func) {
+#ifdef FLOG_CONFIG_BREAKER
+		FLOG_BREAKER_T *breaker=p->breaker;
+		if(breaker) {
+			//nothing is written while open, and a failing flush counts as a failed output
+			if(__atomic_load_n(&breaker->state,__ATOMIC_ACQUIRE)==FLOG_BREAKER_CLOSED) {
+				int r;
+				flog_breaker_quiet++;
+				r=p->output_flush_func(p,signal_safe);
+				flog_breaker_quiet--;
+				if(r) {
+					e++;
+					if(!signal_safe)
+						flog_breaker_result(p,breaker,r);
+				}
+			}
+		} else
+#endif
+		if(p->output_flush_func(p,signal_safe))
+			e++;
+	}
+	for(i=0;i<p->sublog_amount;i++)
+		e+=flog_flush_depth(__atomic_load_n(&p->sublog[i],__ATOMIC_ACQUIRE),signal_safe,depth+1);
+	return(e);
+}
+
+
+//! Write out all buffered output in a log and its sublogs
+
+//! @param[in,out] *p log to flush
+//! @retval 0 success
+//! @return amount of logs that failed to flush
+int flog_flush(FLOG_T *p)
+{
+	if(!p)
+		return(0);
+	return(flog_flush_depth(p,0,0));
+}
+
+
+//! Write out all buffered output in a log and its sublogs from a signal handler
+
+//! Output flush functions are told to only use async-signal-safe calls
+//! (write() but no malloc, stdio or localtime) and not to report errors.
+//! @param[in,out] *p log to flush
+//! @retval 0 success
+//! @return amount of logs that failed to flush
+int flog_flush_signal_safe(FLOG_T *p)
+{
+	if(!p)
+		return(0);
+	return(flog_flush_depth(p,1,0));
+}
+
+
 //! Is the message used in any way if put in this log?
 
 //! This function can be used to decide whether or not to drop a message immediately
@@ -290,10 +925,24 @@ int flog_append_sublog(FLOG_T *p,FLOG_T *sublog)
 //! @retval 1 Message is used
 int flog_is_message_used(FLOG_T *p,FLOG_MSG_TYPE_T type)
 {
-	if(type & p->accepted_msg_type) {
+	FLOG_MSG_TYPE_T accepted=p->accepted_msg_type;
+#ifdef FLOG_CONFIG_FILTER
+	FLOG_FILTER_T *filter=__atomic_load_n(&p->filter,__ATOMIC_ACQUIRE);
+	if(filter)
+		accepted|=filter->enable_mask; //the subsystem is not known here
+#endif
+#ifdef FLOG_CONFIG_GOVERNOR
+	accepted&=~__atomic_load_n(&p->shed_msg_type,__ATOMIC_RELAXED);
+#endif
+	if(type & accepted) {
 		if(p->msg_amount<p->msg_max)
 			return(1);
 		if(p->output_func) {
+#ifdef FLOG_CONFIG_BREAKER
+			//an open breaker still needs messages to probe the output
+			if(p->breaker)
+				return(1);
+#endif
 			if(p->output_stop_on_error ? !p->output_error : 1)
 				return(1);
 		}
@@ -303,7 +952,7 @@ int flog_is_message_used(FLOG_T *p,FLOG_MSG_TYPE_T type)
 #endif
 			uint_fast8_t i;
 			for(i=0;i<p->sublog_amount;i++) {
-				if(flog_is_message_used(p->sublog[i],type)) {
+				if(flog_is_message_used(__atomic_load_n(&p->sublog[i],__ATOMIC_ACQUIRE),type)) {
 #ifdef FLOG_CONFIG_RECURSIVE_MAX_STACK_DEPTH
 					stack_depth--;
 #endif
@@ -319,33 +968,48 @@ int flog_is_message_used(FLOG_T *p,FLOG_MSG_TYPE_T type)
 }
 
 
-//! do not call directly, use the flog_print() macro instead
-
-//! emit an flog message
-//! @param[in,out] *p log to emit message to
-//! @param[in] *subsystem which part of the program is outputing this message
-//! @param[in] *src_file source code file (flog_print() macro uses __FILE__ to fill this in)
-//! @param[in] src_line source code line (flog_print() macro uses __LINE__ to fill this in)
-//! @param[in] *src_func source code function (flog_print() macro uses __FUNCTION__ to fill this in)
-//! @param[in] type use one of the FLOG_* defines
-//! @param[in] msg_id optionally use errno or one of the FLOG_MSG_* defines
-//! @param[in] *text message text
-//! @retval 0 success
-//! @retval 1 error while adding message to log
-//! @retval 2 error unable to get time
-//! @retval 3 did not add null message (flog is configured not to allow null messages)
-//! @see flog_print()
-int _flog_print(FLOG_T *p,const char *subsystem,
+//! Common part of _flog_print() and _flog_print_static()
+static int flog_print_text(FLOG_T *p,const char *subsystem,
 #ifdef FLOG_CONFIG_SRC_INFO
-                const char *src_file,uint_fast16_t src_line,const char *src_func,
+                           const char *src_file,uint_fast16_t src_line,const char *src_func,
 #endif
-                FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *text)
+                           FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *text,uint_fast8_t flags)
 {
 	if(!p)
 		return(1);
+#ifdef FLOG_CONFIG_BREAKER
+	//discard reports of an output running with a breaker
+	if(flog_breaker_quiet)
+		return(0);
+#endif
+#ifdef FLOG_CONFIG_SELF_TIMING
+	FLOG_TIMING_CALL_T timing;
+#endif
+	flog_timing_call_start(&timing,p);
 	//Only add message if it will be used
-	if(!flog_is_message_used(p,type))
+	if(!flog_is_message_used(p,type)) {
+		flog_stats_count(p,seen,flog_msg_type_index(type));
+#ifdef FLOG_CONFIG_GOVERNOR
+		flog_governor_count(p,type);
+#endif
+		flog_timing_call_end(&timing,0);
 		return(0);
+	}
+#ifdef FLOG_CONFIG_SAMPLING
+	//Sample before doing any work on the message
+	uint32_t sample_rate=1;
+	if(p->sampler) {
+#ifdef FLOG_CONFIG_SRC_INFO
+		if(!(sample_rate=flog_sample_msg(p->sampler,type,src_file,src_line))) {
+#else
+		if(!(sample_rate=flog_sample_msg(p->sampler,type))) {
+#endif
+			flog_stats_count(p,seen,flog_msg_type_index(type));
+			flog_timing_call_end(&timing,0);
+			return(0);
+		}
+	}
+#endif //FLOG_CONFIG_SAMPLING
 
 	//Convert the input into a FLOG_MSG_T struct
 	FLOG_MSG_T msg;
@@ -354,15 +1018,19 @@ int _flog_print(FLOG_T *p,const char *subsystem,
 	if(text && text[0])
 		msg.text = text;
 #ifndef FLOG_CONFIG_ALLOW_NULL_MESSAGES
-	if(!msg.msg_id && !msg.text)
+	if(!msg.msg_id && !msg.text) {
+		flog_timing_call_end(&timing,0);
 		return(3);
+	}
 #endif //FLOG_CONFIG_ALLOW_NULL_MESSAGES
 	if(subsystem && subsystem[0])
 		msg.subsystem = subsystem;
 #ifdef FLOG_CONFIG_TIMESTAMP
 #ifdef FLOG_CONFIG_TIMESTAMP_USEC
-	if(gettimeofday(&msg.timestamp,NULL))
+	if(gettimeofday(&msg.timestamp,NULL)) {
+		flog_timing_call_end(&timing,0);
 		return(2);
+	}
 #else //FLOG_CONFIG_TIMESTAMP_USEC
 	msg.timestamp = time(NULL);
 #endif //FLOG_CONFIG_TIMESTAMP_USEC
@@ -378,50 +1046,163 @@ int _flog_print(FLOG_T *p,const char *subsystem,
 	msg.msg_id = msg_id;
 	if(text && text[0])
 		msg.text = text;
+	msg.flags = msg.text ? flags : (flags & ~FLOG_MSG_FLAG_STATIC_TEXT);
+#ifdef FLOG_CONFIG_SAMPLING
+	if(sample_rate>1)
+		msg.sample_rate = sample_rate;
+#endif
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+	msg.context = flog_context();
+#endif
 
 	//Add message to log
-	if(flog_add_msg(p,&msg)) {
+#ifdef FLOG_CONFIG_RENDER_CACHE_SIZE
+	FLOG_RENDER_CACHE_T render;
+	flog_render_cache_init(&render);
+	msg.render=&render;
+#endif
+	int e=flog_add_msg_sampled(p,&msg,1);
+	flog_timing_call_end(&timing,1);
+	if(e)
 		return(1);
-	}
 	return(0);
 }
 
 
-//! do not call directly, use the flog_printf() macro instead
+//! do not call directly, use the flog_print() macro instead
 
-//! emit a formatted flog message (calls _flog_print())
+//! emit an flog message
+//! src_file and src_func are borrowed when the message is buffered, so they must be string literals
 //! @param[in,out] *p log to emit message to
 //! @param[in] *subsystem which part of the program is outputing this message
-//! @param[in] *src_file source code file (flog_printf() macro uses __FILE__ to fill this in)
-//! @param[in] src_line source code line (flog_printf() macro uses __LINE__ to fill this in)
-//! @param[in] *src_func source code function (flog_printf() macro uses __FUNCTION__ to fill this in)
+//! @param[in] *src_file source code file (flog_print() macro uses __FILE__ to fill this in)
+//! @param[in] src_line source code line (flog_print() macro uses __LINE__ to fill this in)
+//! @param[in] *src_func source code function (flog_print() macro uses __FUNCTION__ to fill this in)
 //! @param[in] type use one of the FLOG_* defines
 //! @param[in] msg_id optionally use errno or one of the FLOG_MSG_* defines
-//! @param[in] *textf formatted message text
+//! @param[in] *text message text
 //! @retval 0 success
 //! @retval 1 error while adding message to log
 //! @retval 2 error unable to get time
 //! @retval 3 did not add null message (flog is configured not to allow null messages)
-//! @see flog_printf()
-int _flog_printf(FLOG_T *p,const char *subsystem,
+//! @see flog_print()
+int _flog_print(FLOG_T *p,const char *subsystem,
 #ifdef FLOG_CONFIG_SRC_INFO
-                 const char *src_file,uint_fast16_t src_line,const char *src_func,
+                const char *src_file,uint_fast16_t src_line,const char *src_func,
 #endif
-                 FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf, ...)
+                FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *text)
+{
+#ifdef FLOG_CONFIG_SRC_INFO
+	return(flog_print_text(p,subsystem,src_file,src_line,src_func,type,msg_id,text,FLOG_MSG_FLAG_STATIC_SRC));
+#else
+	return(flog_print_text(p,subsystem,type,msg_id,text,0));
+#endif
+}
+
+
+//! do not call directly, use the flog_print_static() macro instead
+
+//! emit an flog message with static text, see _flog_print()
+//! @param[in] *text message text, must stay valid for the rest of the program
+//! @see flog_print_static()
+int _flog_print_static(FLOG_T *p,const char *subsystem,
+#ifdef FLOG_CONFIG_SRC_INFO
+                       const char *src_file,uint_fast16_t src_line,const char *src_func,
+#endif
+                       FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *text)
+{
+#ifdef FLOG_CONFIG_SRC_INFO
+	return(flog_print_text(p,subsystem,src_file,src_line,src_func,type,msg_id,text,FLOG_MSG_FLAG_STATIC_TEXT|FLOG_MSG_FLAG_STATIC_SRC));
+#else
+	return(flog_print_text(p,subsystem,type,msg_id,text,FLOG_MSG_FLAG_STATIC_TEXT));
+#endif
+}
+
+
+#ifdef FLOG_CONFIG_INLINE_TEXT_SIZE
+//! free text formatted by flog_vprintf_text(), unless it is in the stack buffer
+#define flog_free_text(text) do { if((text)!=inline_text) flog_free(text); } while(0)
+#else
+#define flog_free_text(text) flog_free(text)
+#endif
+
+
+//! Common part of _flog_printf() and _flog_printf_site()
+static int flog_vprintf_text(FLOG_T *p,const char *subsystem,
+#ifdef FLOG_CONFIG_SRC_INFO
+                             const char *src_file,uint_fast16_t src_line,const char *src_func,
+#endif
+#ifdef FLOG_CONFIG_ARG_TYPES
+                             const FLOG_ARG_SITE_T *site,
+#endif
+                             FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf,va_list ap)
 {
 	if(!p)
 		return(1);
+#ifdef FLOG_CONFIG_BREAKER
+	//discard reports of an output running with a breaker
+	if(flog_breaker_quiet)
+		return(0);
+#endif
+#ifdef FLOG_CONFIG_SELF_TIMING
+	FLOG_TIMING_CALL_T timing;
+#endif
+	flog_timing_call_start(&timing,p);
 	//Only add message if it will be used
-	if(!flog_is_message_used(p,type))
+	if(!flog_is_message_used(p,type)) {
+		flog_stats_count(p,seen,flog_msg_type_index(type));
+#ifdef FLOG_CONFIG_GOVERNOR
+		flog_governor_count(p,type);
+#endif
+		flog_timing_call_end(&timing,0);
 		return(0);
+	}
+#ifdef FLOG_CONFIG_SAMPLING
+	//Sample before doing any work on the message
+	uint32_t sample_rate=1;
+	if(p->sampler) {
+#ifdef FLOG_CONFIG_SRC_INFO
+		if(!(sample_rate=flog_sample_msg(p->sampler,type,src_file,src_line))) {
+#else
+		if(!(sample_rate=flog_sample_msg(p->sampler,type))) {
+#endif
+			flog_stats_count(p,seen,flog_msg_type_index(type));
+			flog_timing_call_end(&timing,0);
+			return(0);
+		}
+	}
+#endif //FLOG_CONFIG_SAMPLING
 
 	//Parse format string
 	char *text;
-	va_list ap;
-	va_start(ap,textf);
-	if(vasprintf(&text,textf,ap)==-1)
+#ifdef FLOG_CONFIG_ARG_TYPES
+	//keep the arguments for outputs that store them instead of the text
+	va_list args;
+	va_copy(args,ap);
+#endif
+#ifdef FLOG_CONFIG_INLINE_TEXT_SIZE
+	//short texts are formatted on the stack, only long texts are allocated
+	char inline_text[FLOG_CONFIG_INLINE_TEXT_SIZE];
+	va_list ap_long;
+	int len;
+	va_copy(ap_long,ap);
+	text=inline_text;
+	if((len=vsnprintf(inline_text,sizeof(inline_text),textf,ap))<0 ||
+	   ((size_t)len>=sizeof(inline_text) && flog_vasprintf(&text,textf,ap_long)==-1)) {
+		va_end(ap_long);
+#else //FLOG_CONFIG_INLINE_TEXT_SIZE
+	if(flog_vasprintf(&text,textf,ap)==-1) {
+#endif //FLOG_CONFIG_INLINE_TEXT_SIZE
+#ifdef FLOG_CONFIG_ARG_TYPES
+		va_end(args);
+#endif
+		flog_timing_call_end(&timing,0);
 		return(1);
-	va_end(ap);
+	}
+#ifdef FLOG_CONFIG_INLINE_TEXT_SIZE
+	va_end(ap_long);
+#endif
+	flog_timing_call_formatted(&timing);
 
 	//Convert the input into a FLOG_MSG_T struct
 	FLOG_MSG_T msg;
@@ -430,15 +1211,27 @@ int _flog_printf(FLOG_T *p,const char *subsystem,
 	if(text && text[0])
 		msg.text = text;
 #ifndef FLOG_CONFIG_ALLOW_NULL_MESSAGES
-	if(!msg.msg_id && !msg.text)
+	if(!msg.msg_id && !msg.text) {
+		flog_free_text(text);
+#ifdef FLOG_CONFIG_ARG_TYPES
+		va_end(args);
+#endif
+		flog_timing_call_end(&timing,0);
 		return(1);
+	}
 #endif //FLOG_CONFIG_ALLOW_NULL_MESSAGES
 	if(subsystem && subsystem[0])
 		msg.subsystem = subsystem;
 #ifdef FLOG_CONFIG_TIMESTAMP
 #ifdef FLOG_CONFIG_TIMESTAMP_USEC
-	if(gettimeofday(&msg.timestamp,NULL))
+	if(gettimeofday(&msg.timestamp,NULL)) {
+		flog_free_text(text);
+#ifdef FLOG_CONFIG_ARG_TYPES
+		va_end(args);
+#endif
+		flog_timing_call_end(&timing,0);
 		return(1);
+	}
 #else //FLOG_CONFIG_TIMESTAMP_USEC
 	msg.timestamp = time(NULL);
 #endif //FLOG_CONFIG_TIMESTAMP_USEC
@@ -451,17 +1244,107 @@ int _flog_printf(FLOG_T *p,const char *subsystem,
 		msg.src_func = src_func;
 #endif //FLOG_CONFIG_SRC_INFO
 	msg.type = type;
+#ifdef FLOG_CONFIG_SRC_INFO
+	msg.flags = FLOG_MSG_FLAG_STATIC_SRC;
+#endif
+#ifdef FLOG_CONFIG_ARG_TYPES
+	msg.format = textf;
+	msg.arg_site = site;
+	msg.args = &args;
+#endif
+#ifdef FLOG_CONFIG_SAMPLING
+	if(sample_rate>1)
+		msg.sample_rate = sample_rate;
+#endif
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+	msg.context = flog_context();
+#endif
 
 	//Add message to log
-	if(flog_add_msg(p,&msg)) {
-		free(text);
+#ifdef FLOG_CONFIG_RENDER_CACHE_SIZE
+	FLOG_RENDER_CACHE_T render;
+	flog_render_cache_init(&render);
+	msg.render=&render;
+#endif
+	int e=flog_add_msg_sampled(p,&msg,1);
+	flog_free_text(text);
+#ifdef FLOG_CONFIG_ARG_TYPES
+	va_end(args);
+#endif
+	flog_timing_call_end(&timing,1);
+	if(e)
 		return(1);
-	}
-	free(text);
 	return(0);
 }
 
 
+//! do not call directly, use the flog_printf() macro instead
+
+//! emit a formatted flog message (calls _flog_print())
+//! @param[in,out] *p log to emit message to
+//! @param[in] *subsystem which part of the program is outputing this message
+//! @param[in] *src_file source code file (flog_printf() macro uses __FILE__ to fill this in)
+//! @param[in] src_line source code line (flog_printf() macro uses __LINE__ to fill this in)
+//! @param[in] *src_func source code function (flog_printf() macro uses __FUNCTION__ to fill this in)
+//! @param[in] type use one of the FLOG_* defines
+//! @param[in] msg_id optionally use errno or one of the FLOG_MSG_* defines
+//! @param[in] *textf formatted message text
+//! @retval 0 success
+//! @retval 1 error while adding message to log
+//! @retval 2 error unable to get time
+//! @retval 3 did not add null message (flog is configured not to allow null messages)
+//! @see flog_printf()
+int _flog_printf(FLOG_T *p,const char *subsystem,
+#ifdef FLOG_CONFIG_SRC_INFO
+                 const char *src_file,uint_fast16_t src_line,const char *src_func,
+#endif
+                 FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf, ...)
+{
+	va_list ap;
+	va_start(ap,textf);
+#ifdef FLOG_CONFIG_SRC_INFO
+#ifdef FLOG_CONFIG_ARG_TYPES
+	int e=flog_vprintf_text(p,subsystem,src_file,src_line,src_func,NULL,type,msg_id,textf,ap);
+#else
+	int e=flog_vprintf_text(p,subsystem,src_file,src_line,src_func,type,msg_id,textf,ap);
+#endif
+#else //FLOG_CONFIG_SRC_INFO
+#ifdef FLOG_CONFIG_ARG_TYPES
+	int e=flog_vprintf_text(p,subsystem,NULL,type,msg_id,textf,ap);
+#else
+	int e=flog_vprintf_text(p,subsystem,type,msg_id,textf,ap);
+#endif
+#endif //FLOG_CONFIG_SRC_INFO
+	va_end(ap);
+	return(e);
+}
+
+
+#ifdef FLOG_CONFIG_ARG_TYPES
+//! do not call directly, use the flog_printf() macro instead
+
+//! emit a formatted flog message with the argument types of the call site, see _flog_printf()
+//! @param[in] *site argument types, captured at compile time by the flog_printf() macro
+//! @see flog_printf(), flog_args.h
+int _flog_printf_site(FLOG_T *p,const char *subsystem,
+#ifdef FLOG_CONFIG_SRC_INFO
+                      const char *src_file,uint_fast16_t src_line,const char *src_func,
+#endif
+                      const FLOG_ARG_SITE_T *site,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf, ...)
+{
+	va_list ap;
+	va_start(ap,textf);
+#ifdef FLOG_CONFIG_SRC_INFO
+	int e=flog_vprintf_text(p,subsystem,src_file,src_line,src_func,site,type,msg_id,textf,ap);
+#else
+	int e=flog_vprintf_text(p,subsystem,site,type,msg_id,textf,ap);
+#endif
+	va_end(ap);
+	return(e);
+}
+#endif //FLOG_CONFIG_ARG_TYPES
+
+
 #ifdef DEBUG
 //! Test various flog features
 void flog_test(FLOG_T *p)
@@ -11,11 +11,20 @@
 #define FLOG_H
 
 //! We need asprintf() for flog.c and flog_string.c
+#ifndef _GNU_SOURCE
 #define _GNU_SOURCE
+#endif
 
 #include "config.h"
 #include "flog_msg_id.h"
+#include "flog_intern.h"
+#include "flog_args.h"
 #include <stdint.h>
+#include <stddef.h>
+
+#if defined(FLOG_CONFIG_STATS) || defined(FLOG_CONFIG_SELF_TIMING)
+#include "flog_histogram.h"
+#endif
 
 #ifdef FLOG_CONFIG_TIMESTAMP
 #ifdef FLOG_CONFIG_TIMESTAMP_USEC
@@ -161,6 +170,38 @@ typedef uint_fast8_t FLOG_MSG_TYPE_T;
 #endif //FLOG_CONFIG_MSG_TYPE_ENUM_API
 
 
+//! Amount of distinct message types (one per bit of FLOG_MSG_TYPE_T)
+#define FLOG_MSG_TYPE_AMOUNT 8
+
+
+//! Get the bit position of a message type
+
+//! Useful for indexing tables by message type
+//! @param[in] type one of the FLOG_* message types
+//! @return bit position (0 for FLOG_CRIT etc.)
+//! @retval FLOG_MSG_TYPE_AMOUNT type is FLOG_NONE or has more than one bit set
+static inline unsigned int flog_msg_type_index(const FLOG_MSG_TYPE_T type)
+{
+	if(!type || (type & (type-1)))
+		return(FLOG_MSG_TYPE_AMOUNT);
+	return((unsigned int)__builtin_ctz(type));
+}
+
+
+//! @addtogroup FLOG_OUTPUT_FLAGS
+//! @brief Options for output functions
+//! @details Set the variable @ref FLOG_T->output_flags
+//! @{
+
+//! Colorize message type labels with ANSI escape codes (requires FLOG_CONFIG_OUTPUT_ANSI_COLOR)
+#define FLOG_OUTPUT_FLAG_ANSI_COLOR 0x01
+
+//! Escape control characters in the message text, so each message is one line (requires FLOG_CONFIG_ESCAPE and FLOG_CONFIG_LAYOUT)
+#define FLOG_OUTPUT_FLAG_ESCAPE 0x02
+
+//! @}
+
+
 // Macros to insert source info into print strings
 // Maybe it is better to use __func__ than __FUNCTION__ ?
 
@@ -185,6 +226,24 @@ typedef uint_fast8_t FLOG_MSG_TYPE_T;
 #endif
 
 
+//! emit an flog message with a string literal as text
+
+//! Same as flog_print(), but the text is borrowed instead of copied when
+//! the message is buffered. Use for constant messages in hot paths.
+//! Using anything but a string literal as text is a compile error.
+//! @param[in,out] p log to emit message to
+//! @param[in] subsystem which part of the program is outputing this message
+//! @param[in] type use one of the FLOG_* defines
+//! @param[in] msg_id optionally use errno or one of the FLOG_MSG_* defines
+//! @param[in] text message text (string literal)
+//! @see flog_print()
+#ifdef FLOG_CONFIG_SRC_INFO
+#define flog_print_static(p, subsystem, type, msg_id, text) _flog_print_static(p,subsystem,__FILE__,__LINE__,__FUNCTION__,type,msg_id,"" text "")
+#else
+#define flog_print_static(p, subsystem, type, msg_id, text) _flog_print_static(p,subsystem,type,msg_id,"" text "")
+#endif
+
+
 //! emit a formatted flog message (calls flog_print())
 
 //! use this when you need to emit formatted text messages and flog_print() when no formatting is needed
@@ -193,16 +252,34 @@ typedef uint_fast8_t FLOG_MSG_TYPE_T;
 //! @param[in] type use one of the FLOG_* defines
 //! @param[in] msg_id optionally use errno or one of the FLOG_MSG_* defines
 //! @param[in] ... formatted message text
+//! With FLOG_CONFIG_ARG_TYPES the types of the arguments are recorded per
+//! call site, for at most FLOG_ARG_MAX arguments after the format (see flog_args.h).
 //! @retval 0 success
 //! @retval 1 error while adding message to log
 //! @retval 2 error unable to get time
 //! @retval 3 did not add null message (flog is configured not to allow null messages)
 //! @see _flog_printf(), flog_print(), flog_dprintf()
+#if defined(FLOG_CONFIG_ARG_TYPES) && !defined(__cplusplus)
+#ifdef FLOG_CONFIG_SRC_INFO
+#define flog_printf(p, subsystem, type, msg_id, ...) \
+({ \
+	static const FLOG_ARG_SITE_T flog_arg_site_=FLOG_ARG_SITE_INIT(__VA_ARGS__); \
+	_flog_printf_site(p,subsystem,__FILE__,__LINE__,__FUNCTION__,&flog_arg_site_,type,msg_id,__VA_ARGS__); \
+})
+#else
+#define flog_printf(p, subsystem, type, msg_id, ...) \
+({ \
+	static const FLOG_ARG_SITE_T flog_arg_site_=FLOG_ARG_SITE_INIT(__VA_ARGS__); \
+	_flog_printf_site(p,subsystem,&flog_arg_site_,type,msg_id,__VA_ARGS__); \
+})
+#endif
+#else //FLOG_CONFIG_ARG_TYPES
 #ifdef FLOG_CONFIG_SRC_INFO
 #define flog_printf(p, subsystem, type, msg_id, ...) _flog_printf(p,subsystem,__FILE__,__LINE__,__FUNCTION__,type,msg_id,__VA_ARGS__)
 #else
 #define flog_printf(p, subsystem, type, msg_id, ...) _flog_printf(p,subsystem,type,msg_id,__VA_ARGS__)
 #endif
+#endif //FLOG_CONFIG_ARG_TYPES
 
 
 //! @addtogroup flog_runtime_debug_macros
@@ -214,12 +291,14 @@ typedef uint_fast8_t FLOG_MSG_TYPE_T;
 //! Macro to signify function start
 
 //! Use this macro for deep debugging of program flow
+//! @see flog_trace() of flog_trace.h, timing the function as one message
 #define flog_function_start(p, subsystem) flog_printf(p,subsystem,FLOG_DEEP_DEBUG,FLOG_MSG_FUNCTION_START,"%s()",__FUNCTION__)
 
 
 //! Macro to signify function end
 
 //! Use this macro for deep debugging of program flow
+//! @see flog_trace() of flog_trace.h, timing the function as one message
 #define flog_function_end(p, subsystem) flog_printf(p,subsystem,FLOG_DEEP_DEBUG,FLOG_MSG_FUNCTION_END,"%s()",__FUNCTION__)
 
 
@@ -232,6 +311,7 @@ typedef uint_fast8_t FLOG_MSG_TYPE_T;
 { \
 	if(!(cond)) { \
 		flog_printf(p,NULL,FLOG_ERROR,FLOG_MSG_ASSERTION_FAILED,#cond); \
+		flog_flush(p); \
 		abort(); \
 	} \
 }
@@ -300,9 +380,58 @@ typedef uint_fast8_t FLOG_MSG_TYPE_T;
 //! @}
 
 
+//! @addtogroup FLOG_MSG_FLAGS
+//! @brief Ownership of the strings of a message
+//! @details Set in @ref FLOG_MSG_T->flags, strings marked static are borrowed
+//! by flog_copy_msg() instead of copied, and never freed
+//! @{
+
+//! text is a string literal (see flog_print_static())
+#define FLOG_MSG_FLAG_STATIC_TEXT 0x01
+//! src_file and src_func are string literals (__FILE__ and __FUNCTION__)
+#define FLOG_MSG_FLAG_STATIC_SRC  0x02
+//! text is stored after the message in the same allocation (see flog_copy_msg())
+#define FLOG_MSG_FLAG_INLINE_TEXT 0x04
+
+//! @}
+
+
+#ifdef FLOG_CONFIG_RENDER_CACHE_SIZE
+//! Most renderings of one message kept by a FLOG_RENDER_CACHE_T
+#define FLOG_RENDER_CACHE_ENTRIES 4
+
+//! Rendered lines of a message being emitted, shared by all its outputs
+
+//! Lives on the stack of the function emitting the message. Outputs
+//! rendering with the same layout, flags and subsystem path copy the line
+//! instead of rendering it again (see flog_get_str_message_log()).
+typedef struct flog_render_cache_t {
+	struct {
+		const void *layout;             //!< layout rendered with (NULL for the default)
+		const char *subsystem;          //!< subsystem path rendered, copied into buf
+#ifdef FLOG_CONFIG_SAMPLING
+		uint32_t sample_rate;           //!< sampling rate rendered
+#endif
+		uint_fast8_t flags;             //!< output flags rendered with
+		const char *str;                //!< rendered line in buf (NULL if there was nothing to output)
+		size_t len;                     //!< length of rendered line
+	} entry[FLOG_RENDER_CACHE_ENTRIES];
+	uint_fast8_t amount;                    //!< entries used
+	size_t used;                            //!< bytes used in buf
+	char buf[FLOG_CONFIG_RENDER_CACHE_SIZE]; //!< rendered lines
+} FLOG_RENDER_CACHE_T;
+
+//! Empty a FLOG_RENDER_CACHE_T
+#define flog_render_cache_init(c) do { (c)->amount=0; (c)->used=0; } while(0)
+#endif //FLOG_CONFIG_RENDER_CACHE_SIZE
+
+
 //! Message structure - Holds all data related to a single message
 typedef struct {
 	char *subsystem;                        //!< subsystem which is outputting the msg
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+	FLOG_INTERN_ID_T subsystem_id;          //!< interned subsystem (0 if not interned, see flog_msg_subsystem_id())
+#endif
 #ifdef FLOG_CONFIG_TIMESTAMP
 	FLOG_TIMESTAMP_T timestamp;             //!< timestamp
 #endif
@@ -310,13 +439,67 @@ typedef struct {
 	char *src_file;                         //!< source file emitting message
 	uint_fast16_t src_line;                 //!< source line number emitting message
 	char *src_func;                         //!< source function emitting message
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+	FLOG_INTERN_ID_T src_file_id;           //!< interned src_file (0 if not interned)
+	FLOG_INTERN_ID_T src_func_id;           //!< interned src_func (0 if not interned)
+#endif
 #endif
 	FLOG_MSG_TYPE_T type;                   //!< type of message
 	FLOG_MSG_ID_T msg_id;                   //!< message id (instead of, or with text) see flog_msg_id.h
 	char *text;                             //!< message text
+	uint_fast8_t flags;                     //!< which strings are borrowed, see FLOG_MSG_FLAGS
+#ifdef FLOG_CONFIG_ARG_TYPES
+	const char *format;                     //!< format of text (NULL if text was not formatted)
+	const FLOG_ARG_SITE_T *arg_site;        //!< argument types of format (NULL if unknown)
+	va_list *args;                          //!< arguments of format, only valid while the message is emitted
+#endif
+#ifdef FLOG_CONFIG_SAMPLING
+	uint32_t sample_rate;                   //!< message was kept by sampling 1 in sample_rate (0 if not sampled)
+#endif
+#ifdef FLOG_CONFIG_TRACE
+	uint64_t span_ns;                       //!< duration of the span (see flog_trace.h)
+	uint32_t span_tid;                      //!< thread the span ran in
+	uint16_t span_depth;                    //!< nesting depth of the span, 1 if outermost (0 if not a span)
+#endif
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+	const struct flog_context_t *context;   //!< context of the emitting thread (NULL for none, see flog_context.h)
+#endif
+#ifdef FLOG_CONFIG_RENDER_CACHE_SIZE
+	FLOG_RENDER_CACHE_T *render;            //!< rendered lines, only valid while the message is emitted
+#endif
 } FLOG_MSG_T;
 
 
+#ifdef FLOG_CONFIG_STATS
+//! Statistics structure - counters kept by each log (see flog_stats.h)
+
+//! Counters are indexed by flog_msg_type_index() and updated atomically.
+typedef struct {
+	uint64_t seen[FLOG_MSG_TYPE_AMOUNT];     //!< messages routed to log
+	uint64_t accepted[FLOG_MSG_TYPE_AMOUNT]; //!< messages passing accepted_msg_type
+	uint64_t emitted[FLOG_MSG_TYPE_AMOUNT];  //!< messages successfully written by output_func
+	uint64_t dropped[FLOG_MSG_TYPE_AMOUNT];  //!< messages lost to output errors
+	uint64_t bytes_written;                 //!< bytes written by output_func
+	int last_error;                         //!< last error returned by output_func
+	uint64_t last_print;                    //!< time of last flog_print_stats_interval() (ns)
+	FLOG_HISTOGRAM_T write_latency;         //!< time spent in output_func (ns)
+} FLOG_STATS_T;
+#endif //FLOG_CONFIG_STATS
+
+
+#ifdef FLOG_CONFIG_SELF_TIMING
+//! Self timing structure - where time is spent in flog_print[f] calls (see flog_stats.h)
+
+//! Kept by the log that flog_print[f] is called with, after flog_timing_enable()
+typedef struct {
+	FLOG_HISTOGRAM_T total;                 //!< whole call (ns)
+	FLOG_HISTOGRAM_T format;                //!< formatting text in flog_printf() (ns)
+	FLOG_HISTOGRAM_T route;                 //!< flog_add_msg() excluding output functions (ns)
+	FLOG_HISTOGRAM_T output;                //!< output functions (ns)
+} FLOG_TIMING_T;
+#endif //FLOG_CONFIG_SELF_TIMING
+
+
 //! Main log structure - typedefined as @ref FLOG_T
 
 //! These can be appended to each other in a tree structure (by using flog_append_sublog())
@@ -324,17 +507,48 @@ typedef struct {
 //! Sublogs are created for 3 main purposes: namespacing, multiple outputs and filtering
 typedef struct flog_t {
 	char *name;                             //!< name of log
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+	FLOG_INTERN_ID_T name_id;               //!< interned name (0 if name is allocated)
+#endif
 	FLOG_MSG_TYPE_T accepted_msg_type;      //!< bitmask of which messages to accept
 	int (*output_func)(struct flog_t *,const FLOG_MSG_T *); //!< function to output messages to
 	void *output_func_data;                 //!< data passed to output func
+	int (*output_flush_func)(struct flog_t *,int); //!< function to write out buffered output (see flog_flush())
 	uint_fast16_t output_error;             //!< errors occurred on output
 	uint_fast8_t output_stop_on_error;      //!< stop outputting messages on error
+	uint_fast8_t output_flags;              //!< output options (see FLOG_OUTPUT_FLAG_*)
 	struct flog_t *error_log;               //!< error log for flog errors
 	FLOG_MSG_T **msg;                       //!< array of messages
 	uint_fast16_t msg_amount;               //!< amount of messages in array
 	uint_fast16_t msg_max;                  //!< maximum amount of buffered messages
 	struct flog_t **sublog;                 //!< array of sublogs
 	uint_fast8_t sublog_amount;             //!< amount of sublogs in array
+#ifdef FLOG_CONFIG_STATS
+	FLOG_STATS_T stats;                     //!< instrumentation counters
+#endif
+#ifdef FLOG_CONFIG_SELF_TIMING
+	FLOG_TIMING_T *timing;                  //!< self timing histograms (NULL when disabled)
+#endif
+#ifdef FLOG_CONFIG_SAMPLING
+	struct flog_sampler_t *sampler;         //!< sampling of accepted messages (NULL to keep all, see flog_sample.h)
+#endif
+#ifdef FLOG_CONFIG_BREAKER
+	struct flog_breaker_t *breaker;         //!< circuit breaker of the output (NULL for none, see flog_breaker.h)
+#endif
+#ifdef FLOG_CONFIG_FILTER
+	struct flog_filter_t *filter;           //!< subsystem filter rules (NULL for none, see flog_filter.h)
+	struct flog_filter_t *filter_retired;   //!< filters replaced by flog_set_filter()
+#endif
+#ifdef FLOG_CONFIG_LAYOUT
+	struct flog_layout_t *layout;           //!< layout of rendered messages (NULL for the default, see flog_layout.h)
+#endif
+#ifdef FLOG_CONFIG_DETACH
+	struct flog_detach_t *detach;           //!< queue and worker thread (NULL if not detached, see flog_detach.h)
+#endif
+#ifdef FLOG_CONFIG_GOVERNOR
+	FLOG_MSG_TYPE_T shed_msg_type;          //!< message types shed under backpressure, not used though accepted
+	struct flog_governor_t *governor;       //!< load shedding governor (NULL for none, see flog_governor.h)
+#endif
 } FLOG_T;
 
 
@@ -350,21 +564,41 @@ FLOG_MSG_T * create_flog_msg_t(const char *subsystem,
                                FLOG_MSG_TYPE_T msg_type,FLOG_MSG_ID_T msg_id,const char *text);
 
 void destroy_flog_msg_t(FLOG_MSG_T *p);
+FLOG_MSG_T * flog_copy_msg(const FLOG_MSG_T *msg);
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+FLOG_INTERN_ID_T flog_msg_subsystem_id(FLOG_MSG_T *p);
+#endif
+
+FLOG_MSG_TYPE_T flog_get_msg_type_by_name(const char *name,size_t len);
+int flog_parse_msg_type_action(const char *str,size_t len,FLOG_MSG_TYPE_T *clear,FLOG_MSG_TYPE_T *set);
 
 void init_flog_t(FLOG_T *p);
 FLOG_T * create_flog_t(const char *name, FLOG_MSG_TYPE_T accepted_msg_type);
 void destroy_flog_t(FLOG_T *p);
 
 int flog_add_msg(FLOG_T *p,FLOG_MSG_T *msg);
+int flog_route_msg(FLOG_T *p,FLOG_MSG_T *msg);
 void flog_clear_msg_buffer(FLOG_T *p);
 int flog_append_sublog(FLOG_T *p,FLOG_T *sublog);
+FLOG_T * flog_replace_sublog(FLOG_T *p,uint_fast8_t index,FLOG_T *sublog);
+int flog_flush(FLOG_T *p);
+int flog_flush_signal_safe(FLOG_T *p);
+int flog_is_message_used(FLOG_T *p,FLOG_MSG_TYPE_T type);
 
 #ifdef FLOG_CONFIG_SRC_INFO
 int _flog_print(FLOG_T *p,const char *subsystem,const char *src_file,uint_fast16_t src_line,const char *src_func,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *text);
-int _flog_printf(FLOG_T *p,const char *subsystem,const char *src_file,uint_fast16_t src_line,const char *src_func,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf, ...);
+int _flog_print_static(FLOG_T *p,const char *subsystem,const char *src_file,uint_fast16_t src_line,const char *src_func,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *text);
+int _flog_printf(FLOG_T *p,const char *subsystem,const char *src_file,uint_fast16_t src_line,const char *src_func,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf, ...) __attribute__((format(printf,8,9)));
+#ifdef FLOG_CONFIG_ARG_TYPES
+int _flog_printf_site(FLOG_T *p,const char *subsystem,const char *src_file,uint_fast16_t src_line,const char *src_func,const FLOG_ARG_SITE_T *site,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf, ...) __attribute__((format(printf,9,10)));
+#endif
 #else
 int _flog_print(FLOG_T *p,const char *subsystem,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *text);
-int _flog_printf(FLOG_T *p,const char *subsystem,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf, ...);
+int _flog_print_static(FLOG_T *p,const char *subsystem,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *text);
+int _flog_printf(FLOG_T *p,const char *subsystem,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf, ...) __attribute__((format(printf,5,6)));
+#ifdef FLOG_CONFIG_ARG_TYPES
+int _flog_printf_site(FLOG_T *p,const char *subsystem,const FLOG_ARG_SITE_T *site,FLOG_MSG_TYPE_T type,FLOG_MSG_ID_T msg_id,const char *textf, ...) __attribute__((format(printf,6,7)));
+#endif
 #endif
 
 #ifdef DEBUG
@@ -0,0 +1,813 @@
+//! Flog - C++ interface of the F logging library
+
+//! @file flog.hpp
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Header only, requires C++17 and GNU support (like flog.h).
+//!
+//! - flog::log owns a FLOG_T and frees it with the destroy function of its
+//!   output, so logs can be kept in members and containers.
+//! - flogpp_printf() is flog_printf() with the format checked at compile
+//!   time against the types of the arguments. The arguments are only
+//!   evaluated when the message is used, and the text is formatted straight
+//!   into a stack buffer of FLOGPP_TEXT_SIZE bytes without going through a
+//!   va_list or vasprintf().
+//! - flog::trace_scope and flogpp_trace() time a scope as a span, like
+//!   flog_trace() of flog_trace.h.
+//! - flog::context_scope pushes an entry to the thread context for its
+//!   lifetime, like flog_context_scope() of flog_context.h.
+//!
+//! Formats use the printf() conversions diouxXcsfFeEgGaAp with flags, width
+//! and precision. Length modifiers are accepted and ignored, as each value
+//! is printed as its own type (%d of an unsigned value prints it
+//! unsigned). * widths and %n are compile errors. %s takes C strings,
+//! std::string and std::string_view.
+//!
+//! Example:
+//!
+//!     flog::log out=flog::log::create_stderr("main",FLOG_ACCEPT_ALL);
+//!     flogpp_printf(out,"net",FLOG_INFO,0,"%s connected after %.2fs",peer,seconds);
+
+
+#ifndef FLOG_HPP
+#define FLOG_HPP
+
+#if __cplusplus < 201703L
+#error flog.hpp requires C++17
+#endif
+
+extern "C" {
+#include "flog.h"
+#include "flog_alloc.h"
+#include "flog_output_stdio.h"
+#include "flog_output_file.h"
+#include "flog_trace.h"
+#include "flog_context.h"
+}
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+//! Size of the stack buffer messages are formatted into before allocating
+#ifndef FLOGPP_TEXT_SIZE
+#define FLOGPP_TEXT_SIZE 256
+#endif
+
+
+namespace flog {
+
+
+//! Log owning a FLOG_T
+
+//! A log does not own its sublogs, so sublogs must outlive the logs they
+//! are appended to (declare them first).
+class log {
+public:
+	//! Function freeing the FLOG_T
+	typedef void (*destroy_t)(FLOG_T *);
+
+	log() noexcept : p_(nullptr), destroy_(nullptr) {}
+
+	//! Take ownership of a log from the C interface, freed with destroy
+	explicit log(FLOG_T *p, destroy_t destroy=destroy_flog_t) noexcept : p_(p), destroy_(destroy) {}
+
+	log(const log &)=delete;
+	log & operator=(const log &)=delete;
+
+	log(log &&o) noexcept : p_(o.p_), destroy_(o.destroy_) {
+		o.p_=nullptr;
+	}
+
+	log & operator=(log &&o) noexcept {
+		if(this!=&o) {
+			reset();
+			p_=o.p_;
+			destroy_=o.destroy_;
+			o.p_=nullptr;
+		}
+		return(*this);
+	}
+
+	~log() {
+		reset();
+	}
+
+	//! Free the FLOG_T
+	void reset() noexcept {
+		if(p_)
+			destroy_(p_);
+		p_=nullptr;
+	}
+
+	//! Give up ownership of the FLOG_T
+	FLOG_T * release() noexcept {
+		FLOG_T *p=p_;
+		p_=nullptr;
+		return(p);
+	}
+
+	FLOG_T * get() const noexcept {
+		return(p_);
+	}
+
+	//! false if creating the log failed
+	explicit operator bool() const noexcept {
+		return(p_!=nullptr);
+	}
+
+	//! Is a message of this type used in any way? (see flog_is_message_used())
+	bool used(FLOG_MSG_TYPE_T type) const noexcept {
+		return(p_ && flog_is_message_used(p_,type));
+	}
+
+	//! Append a sublog (see flog_append_sublog())
+	bool append(const log &sublog) noexcept {
+		return(p_ && sublog.p_ && !flog_append_sublog(p_,sublog.p_));
+	}
+
+	//! @return amount of logs that failed to flush (see flog_flush())
+	int flush() noexcept {
+		return(flog_flush(p_));
+	}
+
+	//! Log without output, empty on error
+	static log create(const char *name, FLOG_MSG_TYPE_T accepted_msg_type) noexcept {
+		return(log(create_flog_t(name,accepted_msg_type)));
+	}
+
+#ifdef FLOG_CONFIG_OUTPUT_STDIO
+	//! stdout output, empty on error
+	static log create_stdout(const char *name, FLOG_MSG_TYPE_T accepted_msg_type) noexcept {
+		return(log(create_flog_output_stdout(name,accepted_msg_type)));
+	}
+
+	//! stderr output, empty on error
+	static log create_stderr(const char *name, FLOG_MSG_TYPE_T accepted_msg_type) noexcept {
+		return(log(create_flog_output_stderr(name,accepted_msg_type)));
+	}
+#endif
+
+#ifdef FLOG_CONFIG_OUTPUT_FILE
+	//! File output, buffered when buffer_size is not 0, empty on error
+	static log create_file(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *filename, std::size_t buffer_size=0) noexcept {
+		return(log(buffer_size ? create_flog_output_file_buffered(name,accepted_msg_type,filename,buffer_size) :
+		                         create_flog_output_file(name,accepted_msg_type,filename),destroy_flog_output_file));
+	}
+#endif
+
+#ifdef FLOG_CONFIG_TRACE
+	//! Chrome trace event output, empty on error
+	static log create_trace(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *filename) noexcept {
+		return(log(create_flog_output_trace(name,accepted_msg_type,filename),destroy_flog_output_trace));
+	}
+#endif
+
+private:
+	FLOG_T *p_;
+	destroy_t destroy_;
+};
+
+
+#ifdef FLOG_CONFIG_TRACE
+//! Span timing the rest of a scope, emitted when it is destroyed (see flog_trace.h)
+
+//! The name is copied if the message is buffered. Use flogpp_trace() to
+//! fill in the source position.
+class trace_scope {
+public:
+	trace_scope(FLOG_T *p, const char *subsystem, FLOG_MSG_TYPE_T type, const char *name,
+	            const char *file=nullptr, uint_fast16_t line=0, const char *func=nullptr) noexcept
+#ifdef FLOG_CONFIG_SRC_INFO
+		: s_(flog_trace_begin(p,subsystem,file,line,func,type,name)) {}
+#else
+		: s_(flog_trace_begin(p,subsystem,type,name)) {
+		(void)file;
+		(void)line;
+		(void)func;
+	}
+#endif
+
+	trace_scope(const log &p, const char *subsystem, FLOG_MSG_TYPE_T type, const char *name,
+	            const char *file=nullptr, uint_fast16_t line=0, const char *func=nullptr) noexcept
+		: trace_scope(p.get(),subsystem,type,name,file,line,func) {}
+
+	trace_scope(const trace_scope &)=delete;
+	trace_scope & operator=(const trace_scope &)=delete;
+
+	~trace_scope() {
+		flog_trace_end(&s_);
+	}
+
+	//! false if the log does not use the type, and nothing is timed
+	explicit operator bool() const noexcept {
+		return(s_.log!=nullptr);
+	}
+
+private:
+	FLOG_TRACE_SPAN_T s_;
+};
+#endif //FLOG_CONFIG_TRACE
+
+
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+//! Entry of the thread context, popped when it is destroyed (see flog_context.h)
+
+//! Integer values are formatted straight into the context.
+class context_scope {
+public:
+	context_scope(const char *key, const char *value) noexcept {
+		flog_context_push(key,value);
+	}
+
+	context_scope(const char *key, std::string_view value) noexcept {
+		flog_context_pushf(key,"%.*s",static_cast<int>(value.size()),value.data());
+	}
+
+	template<class T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T,bool>, int> = 0>
+	context_scope(const char *key, T value) noexcept {
+		if constexpr(std::is_signed_v<T>)
+			flog_context_pushf(key,"%lld",static_cast<long long>(value));
+		else
+			flog_context_pushf(key,"%llu",static_cast<unsigned long long>(value));
+	}
+
+	context_scope(const context_scope &)=delete;
+	context_scope & operator=(const context_scope &)=delete;
+
+	~context_scope() {
+		flog_context_pop();
+	}
+};
+#endif //FLOG_CONFIG_CONTEXT_SIZE
+
+
+//! Implementation of flogpp_printf()
+namespace detail {
+
+
+//! Source position of a message (ignored without FLOG_CONFIG_SRC_INFO)
+struct src {
+	const char *file;
+	uint_fast16_t line;
+	const char *func;
+};
+
+
+inline FLOG_T * get(FLOG_T *p) noexcept {
+	return(p);
+}
+
+inline FLOG_T * get(const log &p) noexcept {
+	return(p.get());
+}
+
+
+//! Result of the format parser for invalid formats or no mismatch
+constexpr std::size_t bad=static_cast<std::size_t>(-1);
+
+//! @addtogroup FLOGPP_FLAGS
+//! @brief printf() flags of a conversion
+//! @{
+constexpr unsigned char flag_minus=0x01;
+constexpr unsigned char flag_plus =0x02;
+constexpr unsigned char flag_space=0x04;
+constexpr unsigned char flag_hash =0x08;
+constexpr unsigned char flag_zero =0x10;
+//! @}
+
+
+//! One conversion of a format
+struct spec {
+	std::size_t start=0;                    //!< offset of '%'
+	std::size_t end=0;                      //!< offset after the conversion character
+	char conv=0;                            //!< conversion character, '%' for "%%"
+	unsigned char flags=0;                  //!< FLOGPP_FLAGS
+	int width=-1;                           //!< field width (-1 if none)
+	int precision=-1;                       //!< precision (-1 if none)
+};
+
+
+//! Parse the conversion starting at f[i]
+
+//! @return offset after the conversion, bad if invalid
+constexpr std::size_t parse_spec(std::string_view f, std::size_t i, spec &s)
+{
+	s=spec();
+	s.start=i++;
+	if(i<f.size() && f[i]=='%') {
+		s.conv='%';
+		return(s.end=i+1);
+	}
+	for(;i<f.size();i++) {
+		if(f[i]=='-')
+			s.flags|=flag_minus;
+		else if(f[i]=='+')
+			s.flags|=flag_plus;
+		else if(f[i]==' ')
+			s.flags|=flag_space;
+		else if(f[i]=='#')
+			s.flags|=flag_hash;
+		else if(f[i]=='0')
+			s.flags|=flag_zero;
+		else
+			break;
+	}
+	for(;i<f.size() && f[i]>='0' && f[i]<='9';i++)
+		s.width=(s.width<0 ? 0 : s.width*10)+(f[i]-'0');
+	if(i<f.size() && f[i]=='.') {
+		s.precision=0;
+		for(i++;i<f.size() && f[i]>='0' && f[i]<='9';i++)
+			s.precision=s.precision*10+(f[i]-'0');
+	}
+	//the type of the argument decides, not the length modifier
+	while(i<f.size() && (f[i]=='h' || f[i]=='l' || f[i]=='L' || f[i]=='q' || f[i]=='j' || f[i]=='z' || f[i]=='t'))
+		i++;
+	if(i>=f.size())
+		return(bad);
+	switch(f[i]) {
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c': case 's': case 'p':
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		s.conv=f[i];
+		return(s.end=i+1);
+	default:
+		return(bad);
+	}
+}
+
+
+//! Amount of conversions taking an argument, bad if the format is invalid
+constexpr std::size_t count_specs(std::string_view f)
+{
+	std::size_t n=0,i=0;
+	spec s;
+	while(i<f.size()) {
+		if(f[i]!='%') {
+			i++;
+			continue;
+		}
+		if((i=parse_spec(f,i,s))==bad)
+			return(bad);
+		if(s.conv!='%')
+			n++;
+	}
+	return(n);
+}
+
+
+//! Conversions taking an argument, "%%" is left in the literal text
+template<std::size_t N>
+constexpr std::array<spec,N> parse_specs(std::string_view f)
+{
+	std::array<spec,N> a{};
+	std::size_t n=0,i=0;
+	spec s;
+	while(i<f.size() && n<N) {
+		if(f[i]!='%') {
+			i++;
+			continue;
+		}
+		i=parse_spec(f,i,s);
+		if(s.conv!='%')
+			a[n++]=s;
+	}
+	return(a);
+}
+
+
+//! What an argument can be printed as
+enum class kind : unsigned char {
+	other,
+	boolean,
+	character,
+	integer,
+	floating,
+	cstring,
+	string,
+	pointer
+};
+
+
+template<class T>
+constexpr kind kind_of()
+{
+	typedef std::decay_t<T> U;
+	if constexpr(std::is_same_v<U,bool>)
+		return(kind::boolean);
+	else if constexpr(std::is_same_v<U,char> || std::is_same_v<U,signed char> || std::is_same_v<U,unsigned char>)
+		return(kind::character);
+	else if constexpr(std::is_integral_v<U> || std::is_enum_v<U>)
+		return(kind::integer);
+	else if constexpr(std::is_floating_point_v<U>)
+		return(kind::floating);
+	else if constexpr(std::is_same_v<U,char *> || std::is_same_v<U,const char *>)
+		return(kind::cstring);
+	else if constexpr(std::is_convertible_v<const U &,std::string_view>)
+		return(kind::string);
+	else if constexpr(std::is_pointer_v<U> || std::is_null_pointer_v<U>)
+		return(kind::pointer);
+	else
+		return(kind::other);
+}
+
+
+constexpr bool compatible(char conv, kind k)
+{
+	switch(conv) {
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+		return(k==kind::integer || k==kind::character || k==kind::boolean);
+	case 'c':
+		return(k==kind::integer || k==kind::character);
+	case 's':
+		return(k==kind::cstring || k==kind::string);
+	case 'p':
+		return(k==kind::pointer || k==kind::cstring);
+	default:
+		return(k==kind::floating);
+	}
+}
+
+
+//! Index of the first argument not matching its conversion, bad if none
+template<class... A, std::size_t N>
+constexpr std::size_t mismatch(const std::array<spec,N> &s)
+{
+	constexpr kind k[]={kind_of<A>()...,kind::other};
+	for(std::size_t i=0;i<N;i++) {
+		if(!compatible(s[i].conv,k[i]))
+			return(i);
+	}
+	return(bad);
+}
+
+
+//! Text being formatted, on the stack until it outgrows FLOGPP_TEXT_SIZE
+class writer {
+public:
+	writer() noexcept : buf_(stack_), size_(sizeof(stack_)), len_(0), failed_(false) {}
+
+	writer(const writer &)=delete;
+	writer & operator=(const writer &)=delete;
+
+	~writer() {
+		if(buf_!=stack_)
+			flog_free(buf_);
+	}
+
+	//! Room for n more bytes and a NUL, nullptr when out of memory
+	char * reserve(std::size_t n) noexcept {
+		if(len_+n+1>size_) {
+			std::size_t size=size_*2;
+			char *buf;
+			while(size<len_+n+1)
+				size*=2;
+			if(failed_ || (buf=static_cast<char *>(buf_==stack_ ? flog_malloc(size) : flog_realloc(buf_,size)))==nullptr) {
+				failed_=true;
+				return(nullptr);
+			}
+			if(buf_==stack_)
+				std::memcpy(buf,stack_,len_);
+			buf_=buf;
+			size_=size;
+		}
+		return(buf_+len_);
+	}
+
+	//! Keep n bytes written after reserve()
+	void commit(std::size_t n) noexcept {
+		len_+=n;
+	}
+
+	void put(const char *s, std::size_t n) noexcept {
+		char *d;
+		if((d=reserve(n))) {
+			std::memcpy(d,s,n);
+			len_+=n;
+		}
+	}
+
+	void fill(char c, std::size_t n) noexcept {
+		char *d;
+		if((d=reserve(n))) {
+			std::memset(d,c,n);
+			len_+=n;
+		}
+	}
+
+	//! Literal text of a format, "%%" is written as '%'
+	void literal(const char *s, std::size_t n) noexcept {
+		const char *p;
+		while(n && (p=static_cast<const char *>(std::memchr(s,'%',n)))) {
+			put(s,static_cast<std::size_t>(p-s)+1);
+			n-=static_cast<std::size_t>(p-s)+2;
+			s=p+2;
+		}
+		put(s,n);
+	}
+
+	//! NUL terminated text, nullptr when out of memory
+	const char * str() noexcept {
+		if(failed_)
+			return(nullptr);
+		buf_[len_]=0;
+		return(buf_);
+	}
+
+private:
+	char stack_[FLOGPP_TEXT_SIZE];
+	char *buf_;
+	std::size_t size_;
+	std::size_t len_;
+	bool failed_;
+};
+
+
+//! Write a value with snprintf(), for conversions with flags or a width
+
+//! @param[in] mod length modifier of the value ("" or "ll" or "L")
+template<class V>
+void put_printf(writer &w, const spec &s, const char *mod, V v) noexcept
+{
+	char f[32],*d;
+	int n,len=0;
+	f[len++]='%';
+	if(s.flags & flag_minus)
+		f[len++]='-';
+	if(s.flags & flag_plus)
+		f[len++]='+';
+	if(s.flags & flag_space)
+		f[len++]=' ';
+	if(s.flags & flag_hash)
+		f[len++]='#';
+	if(s.flags & flag_zero)
+		f[len++]='0';
+	if(s.width>=0)
+		len+=std::snprintf(f+len,8,"%d",s.width%10000000);
+	if(s.precision>=0)
+		len+=std::snprintf(f+len,9,".%d",s.precision%10000000);
+	while(*mod)
+		f[len++]=*mod++;
+	f[len++]=s.conv;
+	f[len]=0;
+	if((d=w.reserve(64))==nullptr || (n=std::snprintf(d,65,f,v))<0)
+		return;
+	if(n>64) {
+		if((d=w.reserve(static_cast<std::size_t>(n)))==nullptr)
+			return;
+		std::snprintf(d,static_cast<std::size_t>(n)+1,f,v);
+	}
+	w.commit(static_cast<std::size_t>(n));
+}
+
+
+//! Write text padded to the width of a conversion
+inline void put_padded(writer &w, const spec &s, const char *str, std::size_t len) noexcept
+{
+	std::size_t pad=(s.width>0 && static_cast<std::size_t>(s.width)>len) ? static_cast<std::size_t>(s.width)-len : 0;
+	if(!(s.flags & flag_minus))
+		w.fill(' ',pad);
+	w.put(str,len);
+	if(s.flags & flag_minus)
+		w.fill(' ',pad);
+}
+
+
+template<class T>
+void put_integer(writer &w, const spec &s, T v) noexcept
+{
+	typedef std::conditional_t<std::is_signed_v<T>,long long,unsigned long long> L;
+	typedef std::make_unsigned_t<T> U;
+	unsigned long long u=static_cast<U>(v);
+	char *d,*end;
+	if(s.conv=='c') {
+		char c=static_cast<char>(v);
+		put_padded(w,s,&c,1);
+		return;
+	}
+	if(s.flags || s.width>=0 || s.precision>=0) {
+		if(std::is_signed_v<T> && (s.conv=='d' || s.conv=='i'))
+			put_printf(w,s,"ll",static_cast<L>(v));
+		else if(s.conv=='d' || s.conv=='i') {
+			spec us=s;
+			us.conv='u';
+			put_printf(w,us,"ll",u);
+		} else
+			put_printf(w,s,"ll",u);
+		return;
+	}
+	if((d=w.reserve(24))==nullptr)
+		return;
+	switch(s.conv) {
+	case 'o':
+		end=std::to_chars(d,d+24,u,8).ptr;
+		break;
+	case 'x':
+		end=std::to_chars(d,d+24,u,16).ptr;
+		break;
+	case 'X':
+		end=std::to_chars(d,d+24,u,16).ptr;
+		for(char *c=d;c<end;c++) {
+			if(*c>='a')
+				*c=static_cast<char>(*c-'a'+'A');
+		}
+		break;
+	case 'u':
+		end=std::to_chars(d,d+24,u).ptr;
+		break;
+	default:
+		end=std::to_chars(d,d+24,static_cast<L>(v)).ptr;
+		break;
+	}
+	w.commit(static_cast<std::size_t>(end-d));
+}
+
+
+template<class T>
+void put_floating(writer &w, const spec &s, T v) noexcept
+{
+	typedef std::conditional_t<std::is_same_v<T,long double>,long double,double> D;
+#ifdef __cpp_lib_to_chars
+	std::chars_format format;
+	char *d,*end;
+	std::to_chars_result r;
+	switch(s.conv) {
+	case 'f': case 'F':
+		format=std::chars_format::fixed;
+		break;
+	case 'e': case 'E':
+		format=std::chars_format::scientific;
+		break;
+	case 'g': case 'G':
+		format=std::chars_format::general;
+		break;
+	default:
+		format=std::chars_format::hex;
+		break;
+	}
+	if(!s.flags && s.width<0 && format!=std::chars_format::hex && (d=w.reserve(64))) {
+		r=std::to_chars(d,d+64,static_cast<D>(v),format,s.precision<0 ? 6 : s.precision);
+		if(r.ec==std::errc()) {
+			end=r.ptr;
+			if(s.conv=='F' || s.conv=='E' || s.conv=='G') {
+				for(char *c=d;c<end;c++) {
+					if(*c>='a' && *c<='z')
+						*c=static_cast<char>(*c-'a'+'A');
+				}
+			}
+			w.commit(static_cast<std::size_t>(end-d));
+			return;
+		}
+	}
+#endif
+	put_printf(w,s,std::is_same_v<D,long double> ? "L" : "",static_cast<D>(v));
+}
+
+
+inline void put_string(writer &w, const spec &s, std::string_view v) noexcept
+{
+	if(s.precision>=0 && static_cast<std::size_t>(s.precision)<v.size())
+		v=v.substr(0,static_cast<std::size_t>(s.precision));
+	put_padded(w,s,v.data(),v.size());
+}
+
+
+inline void put_pointer(writer &w, const spec &s, const void *v) noexcept
+{
+	char buf[24]="0x";
+	if(s.flags || s.width>=0 || s.precision>=0)
+		put_printf(w,s,"",v);
+	else if(!v)
+		w.put("(nil)",5);
+	else
+		w.put(buf,static_cast<std::size_t>(std::to_chars(buf+2,buf+sizeof(buf),reinterpret_cast<std::uintptr_t>(v),16).ptr-buf));
+}
+
+
+//! Write one argument as its conversion
+template<class T>
+void put_arg(writer &w, const spec &s, const T &v) noexcept
+{
+	constexpr kind k=kind_of<T>();
+	if constexpr(k==kind::boolean)
+		put_integer(w,s,static_cast<int>(v));
+	else if constexpr(k==kind::character)
+		put_integer(w,s,s.conv=='d' || s.conv=='i' ? static_cast<int>(v) : static_cast<int>(static_cast<unsigned char>(v)));
+	else if constexpr(k==kind::integer && std::is_enum_v<T>)
+		put_integer(w,s,static_cast<std::underlying_type_t<T>>(v));
+	else if constexpr(k==kind::integer)
+		put_integer(w,s,v);
+	else if constexpr(k==kind::floating)
+		put_floating(w,s,v);
+	else if constexpr(k==kind::cstring) {
+		const char *c=v;
+		if(s.conv=='p')
+			put_pointer(w,s,c);
+		else
+			put_string(w,s,c ? std::string_view(c) : std::string_view("(null)"));
+	} else if constexpr(k==kind::string)
+		put_string(w,s,std::string_view(v));
+	else
+		put_pointer(w,s,static_cast<const void *>(v));
+}
+
+
+template<std::size_t N, std::size_t... I, class... A>
+void put_all(writer &w, std::string_view f, const std::array<spec,N> &s, std::index_sequence<I...>, const A &... args) noexcept
+{
+	std::size_t pos=0;
+	((w.literal(f.data()+pos,s[I].start-pos),put_arg(w,s[I],args),pos=s[I].end),...);
+	w.literal(f.data()+pos,f.size()-pos);
+}
+
+
+//! Format and emit a message, called by flogpp_printf() once the message is known to be used
+
+//! @param[in] format constexpr function returning the format
+template<class F, class... A>
+int print_format(FLOG_T *p, const src &src, const char *subsystem, FLOG_MSG_TYPE_T type, FLOG_MSG_ID_T msg_id, F format, const A &... args) noexcept
+{
+	constexpr std::string_view f=format();
+	constexpr std::size_t n=count_specs(f);
+	static_assert(n!=bad,"flogpp_printf: invalid conversion in format");
+	static_assert(n==bad || n==sizeof...(A),"flogpp_printf: amount of arguments does not match the format");
+	if constexpr(n==sizeof...(A)) {
+		static constexpr std::array<spec,sizeof...(A)> s=parse_specs<sizeof...(A)>(f);
+		static_assert(mismatch<A...>(s)==bad,"flogpp_printf: type of an argument does not match its conversion");
+		writer w;
+		const char *text;
+		put_all(w,f,s,std::index_sequence_for<A...>(),args...);
+		if((text=w.str())==nullptr)
+			return(1);
+#ifdef FLOG_CONFIG_SRC_INFO
+		return(_flog_print(p,subsystem,src.file,src.line,src.func,type,msg_id,text));
+#else
+		(void)src;
+		return(_flog_print(p,subsystem,type,msg_id,text));
+#endif
+	} else
+		return(1);
+}
+
+
+} //namespace detail
+} //namespace flog
+
+
+#ifdef FLOG_CONFIG_SRC_INFO
+#define FLOGPP_SRC ::flog::detail::src{__FILE__,__LINE__,__FUNCTION__}
+#else
+#define FLOGPP_SRC ::flog::detail::src{nullptr,0,nullptr}
+#endif
+
+
+//! emit a formatted flog message from C++
+
+//! Same as flog_printf(), but the format must be a string literal and is
+//! checked against the arguments at compile time (see flog.hpp). The
+//! arguments are not evaluated when the log does not use the type.
+//! @param[in,out] p log to emit message to (flog::log or FLOG_T *)
+//! @param[in] subsystem which part of the program is outputing this message
+//! @param[in] type use one of the FLOG_* defines
+//! @param[in] msg_id optionally use errno or one of the FLOG_MSG_* defines
+//! @param[in] format format (string literal)
+//! @param[in] ... arguments of format
+//! @return as flog_printf(), 0 when the message is not used
+#define flogpp_printf(p, subsystem, type, msg_id, format, ...) \
+({ \
+	FLOG_T *flogpp_p_=::flog::detail::get(p); \
+	FLOG_MSG_TYPE_T flogpp_type_=static_cast<FLOG_MSG_TYPE_T>(type); \
+	(flogpp_p_ && flog_is_message_used(flogpp_p_,flogpp_type_)) ? \
+		::flog::detail::print_format(flogpp_p_,FLOGPP_SRC,subsystem,flogpp_type_,static_cast<FLOG_MSG_ID_T>(msg_id), \
+		                             []() constexpr { return(::std::string_view(format)); }, ##__VA_ARGS__) : 0; \
+})
+
+
+#ifdef FLOG_CONFIG_TRACE
+//! Time the rest of the scope as a span named name (see flog::trace_scope)
+
+//! @param[in,out] p log to emit the span to (flog::log or FLOG_T *)
+//! @param[in] subsystem subsystem of the span
+//! @param[in] type message type of the span, use one of the FLOG_* defines
+//! @param[in] name name of the span
+#define flogpp_trace_named(p, subsystem, type, name) \
+	::flog::trace_scope FLOG_TRACE_VAR(__LINE__)(::flog::detail::get(p),subsystem,static_cast<FLOG_MSG_TYPE_T>(type),name,__FILE__,__LINE__,__FUNCTION__)
+
+//! Time the rest of the function as a span named after it
+#define flogpp_trace(p, subsystem, type) flogpp_trace_named(p,subsystem,type,__FUNCTION__)
+#endif //FLOG_CONFIG_TRACE
+
+
+//! Same as flogpp_printf() but only defined if DEBUG is set
+#ifdef DEBUG
+#define flogpp_dprintf(p, subsystem, type, msg_id, format, ...) flogpp_printf(p,subsystem,type,msg_id,format, ##__VA_ARGS__)
+#else
+#define flogpp_dprintf(p, subsystem, type, msg_id, format, ...) (void)(0)
+#endif
+
+#endif //FLOG_HPP
@@ -0,0 +1,376 @@
+//! Allocator hooks and memory budget for Flog
+
+//! @file flog_alloc.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Counters are shared by all threads and updated atomically, the bytes in
+//! use are reserved before the allocator is called, so concurrent
+//! allocations can not overshoot the budget together. The header of an
+//! allocation points to its allocator, NULL for malloc().
+
+#define _GNU_SOURCE
+
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_ALLOC
+
+#include <stdint.h>
+
+
+__thread unsigned int flog_alloc_refused;
+
+//! Header in front of each allocation
+typedef struct {
+	size_t size;                            //!< size asked for
+	const FLOG_ALLOCATOR_T *allocator;      //!< allocator of the block (NULL for malloc())
+} FLOG_ALLOC_HEADER_T;
+
+_Static_assert(sizeof(FLOG_ALLOC_HEADER_T)<=FLOG_ALLOC_HEADER_SIZE,"FLOG_ALLOC_HEADER_SIZE too small");
+
+//! Allocator of new allocations (NULL for malloc())
+static const FLOG_ALLOCATOR_T *flog_allocator;
+
+//! Budget in bytes (0 for none)
+static size_t flog_alloc_budget;
+
+//! Allocation counters
+static struct {
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t refused;
+	uint64_t failed;
+	size_t used;
+	size_t peak;
+} flog_alloc_count;
+
+
+//! Set the allocator of flog allocations from now on
+
+//! Memory allocated before is freed by the allocator it came from.
+//! @param[in] *a allocator, kept until no memory of it is left (NULL for malloc())
+//! @retval 0 success
+//! @retval 1 a function of a is missing
+int flog_set_allocator(const FLOG_ALLOCATOR_T *a)
+{
+	if(a && (!a->alloc || !a->resize || !a->release))
+		return(1);
+	__atomic_store_n(&flog_allocator,a,__ATOMIC_RELEASE);
+	return(0);
+}
+
+
+//! Set the budget of all flog allocations
+
+//! Allocations taking flog over the budget fail. Lowering it below the
+//! bytes in use frees nothing, it only makes allocations fail until enough
+//! is freed.
+//! @param[in] bytes budget, headers included (0 for none)
+void flog_set_alloc_budget(size_t bytes)
+{
+	__atomic_store_n(&flog_alloc_budget,bytes,__ATOMIC_RELAXED);
+}
+
+
+//! Get the allocation statistics of flog
+
+//! @param[out] *stats allocation statistics
+void flog_get_alloc_stats(FLOG_ALLOC_STATS_T *stats)
+{
+	stats->allocs=__atomic_load_n(&flog_alloc_count.allocs,__ATOMIC_RELAXED);
+	stats->frees=__atomic_load_n(&flog_alloc_count.frees,__ATOMIC_RELAXED);
+	stats->refused=__atomic_load_n(&flog_alloc_count.refused,__ATOMIC_RELAXED);
+	stats->failed=__atomic_load_n(&flog_alloc_count.failed,__ATOMIC_RELAXED);
+	stats->used=__atomic_load_n(&flog_alloc_count.used,__ATOMIC_RELAXED);
+	stats->peak=__atomic_load_n(&flog_alloc_count.peak,__ATOMIC_RELAXED);
+	stats->budget=__atomic_load_n(&flog_alloc_budget,__ATOMIC_RELAXED);
+}
+
+
+//! Reserve bytes of the budget
+
+//! @retval 0 success
+//! @retval 1 over budget
+static int flog_alloc_reserve(size_t bytes)
+{
+	size_t used=__atomic_add_fetch(&flog_alloc_count.used,bytes,__ATOMIC_RELAXED);
+	size_t budget=__atomic_load_n(&flog_alloc_budget,__ATOMIC_RELAXED),peak;
+	if(budget && used>budget) {
+		__atomic_sub_fetch(&flog_alloc_count.used,bytes,__ATOMIC_RELAXED);
+		__atomic_fetch_add(&flog_alloc_count.refused,1,__ATOMIC_RELAXED);
+		flog_alloc_refused++;
+		return(1);
+	}
+	peak=__atomic_load_n(&flog_alloc_count.peak,__ATOMIC_RELAXED);
+	while(used>peak && !__atomic_compare_exchange_n(&flog_alloc_count.peak,&peak,used,1,__ATOMIC_RELAXED,__ATOMIC_RELAXED));
+	return(0);
+}
+
+
+//! Give back bytes of a failed or freed allocation
+static inline void flog_alloc_unreserve(size_t bytes)
+{
+	__atomic_sub_fetch(&flog_alloc_count.used,bytes,__ATOMIC_RELAXED);
+}
+
+
+//! malloc() of flog
+
+//! @param[in] size bytes to allocate
+//! @return allocated memory, free with flog_free() (NULL on failure or over budget)
+void * flog_malloc(size_t size)
+{
+	const FLOG_ALLOCATOR_T *a=__atomic_load_n(&flog_allocator,__ATOMIC_ACQUIRE);
+	size_t total=size+FLOG_ALLOC_HEADER_SIZE;
+	FLOG_ALLOC_HEADER_T *h;
+	if(total<size || flog_alloc_reserve(total))
+		return(NULL);
+	if((h=a ? a->alloc(a->data,total) : malloc(total))==NULL) {
+		flog_alloc_unreserve(total);
+		__atomic_fetch_add(&flog_alloc_count.failed,1,__ATOMIC_RELAXED);
+		return(NULL);
+	}
+	h->size=size;
+	h->allocator=a;
+	__atomic_fetch_add(&flog_alloc_count.allocs,1,__ATOMIC_RELAXED);
+	return((char *)h+FLOG_ALLOC_HEADER_SIZE);
+}
+
+
+//! calloc() of flog
+void * flog_calloc(size_t nmemb,size_t size)
+{
+	void *p;
+	if(size && nmemb>SIZE_MAX/size)
+		return(NULL);
+	if((p=flog_malloc(nmemb*size)))
+		memset(p,0,nmemb*size);
+	return(p);
+}
+
+
+//! realloc() of flog
+
+//! Growing reserves the growth of the budget first, on failure ptr is left as it was.
+//! @param[in] *ptr memory of flog_malloc() (NULL to allocate)
+//! @param[in] size new size (0 to free)
+//! @return resized memory (NULL on failure or over budget)
+void * flog_realloc(void *ptr,size_t size)
+{
+	size_t old,total=size+FLOG_ALLOC_HEADER_SIZE;
+	const FLOG_ALLOCATOR_T *a;
+	FLOG_ALLOC_HEADER_T *h;
+	if(!ptr)
+		return(flog_malloc(size));
+	if(!size) {
+		flog_free(ptr);
+		return(NULL);
+	}
+	h=(FLOG_ALLOC_HEADER_T *)((char *)ptr-FLOG_ALLOC_HEADER_SIZE);
+	old=h->size;
+	a=h->allocator;
+	if(total<size || (size>old && flog_alloc_reserve(size-old)))
+		return(NULL);
+	if((h=a ? a->resize(a->data,h,old+FLOG_ALLOC_HEADER_SIZE,total) : realloc(h,total))==NULL) {
+		if(size>old)
+			flog_alloc_unreserve(size-old);
+		__atomic_fetch_add(&flog_alloc_count.failed,1,__ATOMIC_RELAXED);
+		return(NULL);
+	}
+	if(size<old)
+		flog_alloc_unreserve(old-size);
+	h->size=size;
+	return((char *)h+FLOG_ALLOC_HEADER_SIZE);
+}
+
+
+//! free() of flog
+
+//! @param[in] *ptr memory of flog_malloc() and friends (NULL does nothing)
+void flog_free(void *ptr)
+{
+	FLOG_ALLOC_HEADER_T *h;
+	size_t total;
+	if(!ptr)
+		return;
+	h=(FLOG_ALLOC_HEADER_T *)((char *)ptr-FLOG_ALLOC_HEADER_SIZE);
+	total=h->size+FLOG_ALLOC_HEADER_SIZE;
+	if(h->allocator)
+		h->allocator->release(h->allocator->data,h,total);
+	else
+		free(h);
+	flog_alloc_unreserve(total);
+	__atomic_fetch_add(&flog_alloc_count.frees,1,__ATOMIC_RELAXED);
+}
+
+
+//! strdup() of flog
+char * flog_strdup(const char *s)
+{
+	return(flog_strndup(s,SIZE_MAX));
+}
+
+
+//! strndup() of flog
+char * flog_strndup(const char *s,size_t n)
+{
+	size_t len=strnlen(s,n);
+	char *p;
+	if((p=flog_malloc(len+1))) {
+		memcpy(p,s,len);
+		p[len]=0;
+	}
+	return(p);
+}
+
+
+//! vasprintf() of flog
+
+//! Short strings are formatted once, into a stack buffer first.
+//! @param[out] **strp formatted string (NULL on error), free with flog_free()
+//! @return length of string (-1 on error)
+int flog_vasprintf(char **strp,const char *format,va_list ap)
+{
+	char buf[256];
+	va_list aq;
+	int n;
+	va_copy(aq,ap);
+	n=vsnprintf(buf,sizeof(buf),format,aq);
+	va_end(aq);
+	if(n<0 || (*strp=flog_malloc((size_t)n+1))==NULL) {
+		*strp=NULL;
+		return(-1);
+	}
+	if((size_t)n<sizeof(buf))
+		memcpy(*strp,buf,(size_t)n+1);
+	else
+		vsnprintf(*strp,(size_t)n+1,format,ap);
+	return(n);
+}
+
+
+//! asprintf() of flog
+
+//! @see flog_vasprintf()
+int flog_asprintf(char **strp,const char *format,...)
+{
+	va_list ap;
+	int n;
+	va_start(ap,format);
+	n=flog_vasprintf(strp,format,ap);
+	va_end(ap);
+	return(n);
+}
+
+
+//! Get the size class of a block of a pool
+
+//! @return class (FLOG_ALLOC_POOL_CLASSES if too large)
+static unsigned int flog_alloc_pool_class(size_t size)
+{
+	unsigned int c=0;
+	while(c<FLOG_ALLOC_POOL_CLASSES && ((size_t)FLOG_ALLOC_POOL_MIN<<c)<size)
+		c++;
+	return(c);
+}
+
+
+//! Allocate a block of a pool
+static void * flog_alloc_pool_alloc(void *data,size_t size)
+{
+	FLOG_ALLOC_POOL_T *pool=data;
+	unsigned int c=flog_alloc_pool_class(size);
+	void *p=NULL;
+	if(c>=FLOG_ALLOC_POOL_CLASSES)
+		return(NULL);
+	pthread_mutex_lock(&pool->lock);
+	if((p=pool->free_list[c])) {
+		pool->free_list[c]=*(void **)p;
+	} else if(pool->size-pool->used>=((size_t)FLOG_ALLOC_POOL_MIN<<c)) {
+		p=pool->mem+pool->used;
+		pool->used+=(size_t)FLOG_ALLOC_POOL_MIN<<c;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return(p);
+}
+
+
+//! Free a block of a pool
+static void flog_alloc_pool_release(void *data,void *ptr,size_t size)
+{
+	FLOG_ALLOC_POOL_T *pool=data;
+	unsigned int c=flog_alloc_pool_class(size);
+	pthread_mutex_lock(&pool->lock);
+	*(void **)ptr=pool->free_list[c];
+	pool->free_list[c]=ptr;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+
+//! Resize a block of a pool, in place while it stays in its size class
+static void * flog_alloc_pool_resize(void *data,void *ptr,size_t old_size,size_t size)
+{
+	void *p;
+	if(flog_alloc_pool_class(size)==flog_alloc_pool_class(old_size))
+		return(ptr);
+	if((p=flog_alloc_pool_alloc(data,size))==NULL)
+		return(NULL);
+	memcpy(p,ptr,old_size<size ? old_size : size);
+	flog_alloc_pool_release(data,ptr,old_size);
+	return(p);
+}
+
+
+//! Set up a pool allocator
+
+//! The arena is carved into blocks of FLOG_ALLOC_POOL_CLASSES size classes
+//! as they are first needed, freed blocks are kept for their class. Blocks
+//! larger than the largest class can not be allocated.
+//! @param[out] *pool pool to set up
+//! @param[in] *mem arena, aligned like malloc() (NULL to allocate one)
+//! @param[in] size size of arena
+//! @retval 0 success
+//! @retval 1 error
+int flog_alloc_pool_init(FLOG_ALLOC_POOL_T *pool,void *mem,size_t size)
+{
+	memset(pool,0,sizeof(*pool));
+	if(!mem) {
+		if((mem=malloc(size))==NULL)
+			return(1);
+		pool->own_mem=1;
+	}
+	if(pthread_mutex_init(&pool->lock,NULL)) {
+		if(pool->own_mem)
+			free(mem);
+		return(1);
+	}
+	pool->allocator.alloc=flog_alloc_pool_alloc;
+	pool->allocator.resize=flog_alloc_pool_resize;
+	pool->allocator.release=flog_alloc_pool_release;
+	pool->allocator.data=pool;
+	pool->mem=mem;
+	pool->size=size;
+	return(0);
+}
+
+
+//! Free a pool allocator, only when no flog memory of it is left
+void flog_alloc_pool_destroy(FLOG_ALLOC_POOL_T *pool)
+{
+	pthread_mutex_destroy(&pool->lock);
+	if(pool->own_mem)
+		free(pool->mem);
+	pool->mem=NULL;
+}
+
+
+//! Allocate flog memory from a pool from now on
+
+//! @param[in,out] *pool pool set up with flog_alloc_pool_init(), kept until no memory of it is left
+//! @retval 0 success
+//! @see flog_set_allocator()
+int flog_set_allocator_pool(FLOG_ALLOC_POOL_T *pool)
+{
+	return(flog_set_allocator(&pool->allocator));
+}
+
+#endif //FLOG_CONFIG_ALLOC
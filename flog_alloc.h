@@ -0,0 +1,122 @@
+//! Allocator hooks and memory budget for Flog
+
+//! @file flog_alloc.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Flog allocates through flog_malloc() and friends, never through
+//! malloc() directly. Without FLOG_CONFIG_ALLOC they are malloc() and
+//! friends. With it every allocation is counted, can be kept within a byte
+//! budget (flog_set_alloc_budget()), and comes from the allocator set with
+//! flog_set_allocator(), such as the built-in pool of size classes carved
+//! out of a fixed arena (flog_set_allocator_pool()).
+//!
+//! An allocation the budget does not allow fails like malloc() returning
+//! NULL, so flog drops rather than grows: a message is not buffered, not
+//! queued or not rendered, and an output dropping a message this way does
+//! not count as failing (see FLOG_T->output_stop_on_error).
+//!
+//! Each allocation keeps its size and allocator in FLOG_ALLOC_HEADER_SIZE
+//! bytes in front of it, so it goes back to the allocator it came from
+//! whenever the allocator is changed. Strings handed to callers, of
+//! flog_string.h and flog_args_decode(), are not flog allocations: they
+//! come from malloc() and are freed with free() as always, so they are
+//! neither counted nor kept within the budget. This includes a line
+//! rendered by flog_get_str_message_log() or flog_get_str_message_layout()
+//! that does not fit the buffer the output offers: such long lines
+//! allocate outside of the budget.
+
+
+#ifndef FLOG_ALLOC_H
+#define FLOG_ALLOC_H
+
+#include "flog.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#ifdef FLOG_CONFIG_ALLOC
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+//! Bytes in front of each allocation, keeping its size and allocator and the alignment of malloc()
+#define FLOG_ALLOC_HEADER_SIZE (sizeof(max_align_t))
+
+//! Amount of size classes of a pool, the smallest FLOG_ALLOC_POOL_MIN bytes and each twice the size of the one before
+#define FLOG_ALLOC_POOL_CLASSES 17
+//! Smallest size class of a pool (a power of 2, at least FLOG_ALLOC_HEADER_SIZE)
+#define FLOG_ALLOC_POOL_MIN 32
+
+
+//! Allocator used by flog - set with flog_set_allocator()
+
+//! Sizes include FLOG_ALLOC_HEADER_SIZE, and blocks must be aligned like
+//! malloc(). The functions must be thread safe.
+typedef struct flog_allocator_t {
+	void * (*alloc)(void *data,size_t size);                             //!< allocate size bytes (NULL on failure)
+	void * (*resize)(void *data,void *ptr,size_t old_size,size_t size); //!< resize a block (NULL on failure, leaving it as it was)
+	void (*release)(void *data,void *ptr,size_t size);                   //!< free a block of size bytes
+	void *data;                                                          //!< passed to the functions above
+} FLOG_ALLOCATOR_T;
+
+
+//! Pool allocator - blocks of size classes carved out of one arena, see flog_set_allocator_pool()
+typedef struct {
+	FLOG_ALLOCATOR_T allocator;             //!< allocator of the pool
+	char *mem;                              //!< arena
+	size_t size;                            //!< size of arena
+	size_t used;                            //!< bytes of arena carved into blocks
+	void *free_list[FLOG_ALLOC_POOL_CLASSES]; //!< freed blocks per size class
+	int own_mem;                            //!< arena was allocated by flog_alloc_pool_init()
+	pthread_mutex_t lock;                   //!< protects everything above
+} FLOG_ALLOC_POOL_T;
+
+
+//! Allocation statistics
+typedef struct {
+	uint64_t allocs;                        //!< allocations made
+	uint64_t frees;                         //!< allocations freed
+	uint64_t refused;                       //!< allocations refused by the budget
+	uint64_t failed;                        //!< allocations failed by the allocator
+	size_t used;                            //!< bytes in use, headers included
+	size_t peak;                            //!< most bytes in use so far
+	size_t budget;                          //!< budget (0 for none)
+} FLOG_ALLOC_STATS_T;
+
+
+//! Allocations refused by the budget in this thread so far
+extern __thread unsigned int flog_alloc_refused;
+
+void * flog_malloc(size_t size) __attribute__((malloc));
+void * flog_calloc(size_t nmemb,size_t size) __attribute__((malloc));
+void * flog_realloc(void *ptr,size_t size);
+void flog_free(void *ptr);
+char * flog_strdup(const char *s) __attribute__((malloc));
+char * flog_strndup(const char *s,size_t n) __attribute__((malloc));
+int flog_vasprintf(char **strp,const char *format,va_list ap) __attribute__((format(printf,2,0)));
+int flog_asprintf(char **strp,const char *format,...) __attribute__((format(printf,2,3)));
+
+int flog_set_allocator(const FLOG_ALLOCATOR_T *a);
+void flog_set_alloc_budget(size_t bytes);
+void flog_get_alloc_stats(FLOG_ALLOC_STATS_T *stats);
+
+int flog_alloc_pool_init(FLOG_ALLOC_POOL_T *pool,void *mem,size_t size);
+void flog_alloc_pool_destroy(FLOG_ALLOC_POOL_T *pool);
+int flog_set_allocator_pool(FLOG_ALLOC_POOL_T *pool);
+
+#else //FLOG_CONFIG_ALLOC
+
+#define flog_malloc(size) malloc(size)
+#define flog_calloc(nmemb, size) calloc(nmemb,size)
+#define flog_realloc(ptr, size) realloc(ptr,size)
+#define flog_free(ptr) free(ptr)
+#define flog_strdup(s) strdup(s)
+#define flog_strndup(s, n) strndup(s,n)
+#define flog_vasprintf(strp, format, ap) vasprintf(strp,format,ap)
+#define flog_asprintf(strp, ...) asprintf(strp,__VA_ARGS__)
+
+#endif //FLOG_CONFIG_ALLOC
+
+#endif //FLOG_ALLOC_H
@@ -0,0 +1,291 @@
+//! Argument type capture for Flog
+
+//! @file flog_args.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Binary encoding of flog_printf() arguments, using the argument types
+//! captured at compile time, so no format string is parsed when encoding.
+//! Values are stored in native byte order one after the other, see
+//! FLOG_ARG_TYPE_T for the sizes.
+
+#define _GNU_SOURCE
+#include "flog_args.h"
+
+#ifdef FLOG_CONFIG_ARG_TYPES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//! Length stored for a NULL string argument
+#define FLOG_ARGS_NULL_STR UINT32_MAX
+
+//! Printed by flog_args_decode() in place of an argument that does not fit its conversion
+#define FLOG_ARGS_MISMATCH "(?)"
+
+
+//! Append a value to an encoding buffer, if it fits
+static inline void flog_args_put(unsigned char *out,size_t size,size_t *n,const void *v,size_t len)
+{
+	if(*n+len<=size)
+		memcpy(out+*n,v,len);
+	*n+=len;
+}
+
+
+//! Encode the arguments of a flog_printf() call
+
+//! Like snprintf(), the buffer is only written up to size, but the
+//! full length is returned so a larger buffer can be tried.
+//! @param[out] *buf buffer to encode into
+//! @param[in] size size of buf
+//! @param[in] *site argument types
+//! @param[in] ap arguments (a va_copy() of FLOG_MSG_T.args)
+//! @return length of encoded arguments
+size_t flog_args_encode(void *buf, size_t size, const FLOG_ARG_SITE_T *site, va_list ap)
+{
+	unsigned char *out=buf;
+	size_t n=0;
+	unsigned int i;
+	for(i=0;i<site->amount;i++) {
+		switch(site->type[i]) {
+		case FLOG_ARG_INT: {
+			int v=va_arg(ap,int);
+			flog_args_put(out,size,&n,&v,sizeof(v));
+			break;
+		}
+		case FLOG_ARG_LONG: {
+			long v=va_arg(ap,long);
+			flog_args_put(out,size,&n,&v,sizeof(v));
+			break;
+		}
+		case FLOG_ARG_LLONG: {
+			long long v=va_arg(ap,long long);
+			flog_args_put(out,size,&n,&v,sizeof(v));
+			break;
+		}
+		case FLOG_ARG_DOUBLE: {
+			double v=va_arg(ap,double);
+			flog_args_put(out,size,&n,&v,sizeof(v));
+			break;
+		}
+		case FLOG_ARG_LDOUBLE: {
+			long double v=va_arg(ap,long double);
+			flog_args_put(out,size,&n,&v,sizeof(v));
+			break;
+		}
+		case FLOG_ARG_STR: {
+			const char *v=va_arg(ap,const char *);
+			uint32_t len=v ? (uint32_t)strlen(v) : FLOG_ARGS_NULL_STR;
+			flog_args_put(out,size,&n,&len,sizeof(len));
+			if(v)
+				flog_args_put(out,size,&n,v,len);
+			break;
+		}
+		default: {
+			void *v=va_arg(ap,void *);
+			flog_args_put(out,size,&n,&v,sizeof(v));
+			break;
+		}
+		}
+	}
+	return(n);
+}
+
+
+//! Take a value from an encoding buffer
+
+//! @retval 0 success
+//! @retval 1 buffer too short
+static inline int flog_args_get(const unsigned char *in,size_t len,size_t *pos,void *v,size_t size)
+{
+	if(*pos+size>len)
+		return(1);
+	memcpy(v,in+*pos,size);
+	*pos+=size;
+	return(0);
+}
+
+
+//! fprintf() one conversion with 0 to 2 '*' width and precision arguments, or FLOG_ARGS_MISMATCH if !ok
+#define flog_args_fprintf(f, ok, spec, stars, star, v) \
+	(!(ok) ? fputs(FLOG_ARGS_MISMATCH,f) : (stars)==0 ? fprintf(f,spec,v) : (stars)==1 ? fprintf(f,spec,(star)[0],v) : fprintf(f,spec,(star)[0],(star)[1],v))
+
+
+//! Check that a captured argument type fits a conversion specification
+
+//! Integers only have to match in size, as they are read back the same.
+//! @param[in] *spec conversion specification, such as "%-5lu"
+//! @param[in] spec_len length of spec (at least 2)
+//! @param[in] type FLOG_ARG_TYPE_T of the argument
+//! @retval 1 the argument can be formatted with spec
+//! @retval 0 mismatch
+static int flog_args_match(const char *spec,size_t spec_len,uint8_t type)
+{
+	char conv=spec[spec_len-1];
+	char mod=spec[spec_len-2];
+	size_t size;
+	if(strchr("eEfFgGaA",conv))
+		return(type==(mod=='L' ? FLOG_ARG_LDOUBLE : FLOG_ARG_DOUBLE));
+	if(conv=='s')
+		return(type==FLOG_ARG_STR && mod!='l');
+	if(conv=='p')
+		return(type==FLOG_ARG_PTR);
+	if(conv=='c')
+		return(type==FLOG_ARG_INT);
+	switch(mod) {
+		case 'l':
+			size=(spec_len>=4 && spec[spec_len-3]=='l') ? sizeof(long long) : sizeof(long);
+			break;
+		case 'q':
+			size=sizeof(long long);
+			break;
+		case 'j':
+			size=sizeof(intmax_t);
+			break;
+		case 'z':
+			size=sizeof(size_t);
+			break;
+		case 't':
+			size=sizeof(ptrdiff_t);
+			break;
+		default:
+			size=sizeof(int);
+	}
+	switch(type) {
+		case FLOG_ARG_INT:
+			return(size==sizeof(int));
+		case FLOG_ARG_LONG:
+			return(size==sizeof(long));
+		case FLOG_ARG_LLONG:
+			return(size==sizeof(long long));
+		default:
+			return(0);
+	}
+}
+
+
+//! Format encoded arguments into a string
+
+//! An argument whose captured type does not fit its conversion (such as
+//! a pointer given to %s) is printed as FLOG_ARGS_MISMATCH.
+//! @param[out] **strp formatted string (NULL on error), free after use
+//! @param[in] *format format given to flog_printf()
+//! @param[in] *site argument types
+//! @param[in] *buf encoded arguments from flog_args_encode()
+//! @param[in] len length of encoded arguments
+//! @retval 0 success
+//! @retval -1 error (out of memory, or the arguments do not match the format)
+int flog_args_decode(char **strp, const char *format, const FLOG_ARG_SITE_T *site, const void *buf, size_t len)
+{
+	const unsigned char *in=buf;
+	size_t pos=0,str_size,spec_len;
+	unsigned int arg=0;
+	char spec[32];
+	int star[2],stars,ok,e=0;
+	FILE *f;
+	if((f=open_memstream(strp,&str_size))==NULL) {
+		*strp=NULL;
+		return(-1);
+	}
+	while(*format && !e) {
+		if(*format!='%') {
+			const char *end=strchrnul(format,'%');
+			fwrite(format,1,(size_t)(end-format),f);
+			format=end;
+			continue;
+		}
+		if(format[1]=='%') {
+			fputc('%',f);
+			format+=2;
+			continue;
+		}
+		//collect one conversion specification, taking '*' arguments on the way
+		spec_len=0;
+		stars=0;
+		spec[spec_len++]=*format++;
+		while(*format && !strchr("diouxXeEfFgGaAcsp",*format)) {
+			if(*format=='*') {
+				if(stars==2 || arg>=site->amount || site->type[arg++]!=FLOG_ARG_INT || flog_args_get(in,len,&pos,&star[stars++],sizeof(int))) {
+					e=1;
+					break;
+				}
+			}
+			if(*format=='n' || spec_len>=sizeof(spec)-2) {
+				e=1;
+				break;
+			}
+			spec[spec_len++]=*format++;
+		}
+		if(e || !*format || arg>=site->amount) {
+			e=1;
+			break;
+		}
+		spec[spec_len++]=*format++;
+		spec[spec_len]=0;
+		ok=flog_args_match(spec,spec_len,site->type[arg]);
+		switch(site->type[arg++]) {
+		case FLOG_ARG_INT: {
+			int v;
+			if(!(e=flog_args_get(in,len,&pos,&v,sizeof(v))))
+				flog_args_fprintf(f,ok,spec,stars,star,v);
+			break;
+		}
+		case FLOG_ARG_LONG: {
+			long v;
+			if(!(e=flog_args_get(in,len,&pos,&v,sizeof(v))))
+				flog_args_fprintf(f,ok,spec,stars,star,v);
+			break;
+		}
+		case FLOG_ARG_LLONG: {
+			long long v;
+			if(!(e=flog_args_get(in,len,&pos,&v,sizeof(v))))
+				flog_args_fprintf(f,ok,spec,stars,star,v);
+			break;
+		}
+		case FLOG_ARG_DOUBLE: {
+			double v;
+			if(!(e=flog_args_get(in,len,&pos,&v,sizeof(v))))
+				flog_args_fprintf(f,ok,spec,stars,star,v);
+			break;
+		}
+		case FLOG_ARG_LDOUBLE: {
+			long double v;
+			if(!(e=flog_args_get(in,len,&pos,&v,sizeof(v))))
+				flog_args_fprintf(f,ok,spec,stars,star,v);
+			break;
+		}
+		case FLOG_ARG_STR: {
+			uint32_t str_len;
+			char *v=NULL;
+			if((e=flog_args_get(in,len,&pos,&str_len,sizeof(str_len))))
+				break;
+			if(str_len!=FLOG_ARGS_NULL_STR) {
+				if(pos+str_len>len || (ok && (v=strndup((const char *)in+pos,str_len))==NULL)) {
+					e=1;
+					break;
+				}
+				pos+=str_len;
+			}
+			flog_args_fprintf(f,ok,spec,stars,star,v);
+			free(v);
+			break;
+		}
+		default: {
+			void *v;
+			if(!(e=flog_args_get(in,len,&pos,&v,sizeof(v))))
+				flog_args_fprintf(f,ok,spec,stars,star,v);
+			break;
+		}
+		}
+	}
+	if(fclose(f) || e) {
+		free(*strp);
+		*strp=NULL;
+		return(-1);
+	}
+	return(0);
+}
+
+#endif //FLOG_CONFIG_ARG_TYPES
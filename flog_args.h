@@ -0,0 +1,105 @@
+//! Argument type capture for Flog
+
+//! @file flog_args.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! With FLOG_CONFIG_ARG_TYPES, flog_printf() records the types of its
+//! arguments at compile time in a static descriptor per call site. Messages
+//! then carry the format, the descriptor and the arguments, so an output
+//! can store the arguments in binary with flog_args_encode() instead of
+//! formatting text. flog_args_decode() formats them later.
+//!
+//! In an output function:
+//!
+//!     if(msg->arg_site) {
+//!         va_list ap;
+//!         va_copy(ap,*msg->args);
+//!         len=flog_args_encode(buf,sizeof(buf),msg->arg_site,ap);
+//!         va_end(ap);
+//!     }
+
+
+#ifndef FLOG_ARGS_H
+#define FLOG_ARGS_H
+
+#include "config.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+#ifdef FLOG_CONFIG_ARG_TYPES
+
+//! Most arguments flog_printf() accepts after the format
+#define FLOG_ARG_MAX 16
+
+
+//! Argument types, after default argument promotion
+typedef enum {
+	FLOG_ARG_INT,                           //!< int and smaller integers, encoded as 4 bytes
+	FLOG_ARG_LONG,                          //!< long, encoded as sizeof(long) bytes
+	FLOG_ARG_LLONG,                         //!< long long, encoded as 8 bytes
+	FLOG_ARG_DOUBLE,                        //!< float and double, encoded as 8 bytes
+	FLOG_ARG_LDOUBLE,                       //!< long double, encoded as sizeof(long double) bytes
+	FLOG_ARG_STR,                           //!< string, encoded as 4 bytes length and the characters
+	FLOG_ARG_PTR                            //!< any other pointer, encoded as sizeof(void *) bytes
+} FLOG_ARG_TYPE_T;
+
+
+//! Argument types of a flog_printf() call site
+typedef struct {
+	uint8_t amount;                         //!< amount of arguments after the format
+	uint8_t type[FLOG_ARG_MAX];             //!< FLOG_ARG_TYPE_T of each argument
+} FLOG_ARG_SITE_T;
+
+
+//! Get the FLOG_ARG_TYPE_T of an expression at compile time (it is not evaluated)
+#define flog_arg_type(x) _Generic((x), \
+	_Bool: FLOG_ARG_INT, char: FLOG_ARG_INT, signed char: FLOG_ARG_INT, unsigned char: FLOG_ARG_INT, \
+	short: FLOG_ARG_INT, unsigned short: FLOG_ARG_INT, int: FLOG_ARG_INT, unsigned int: FLOG_ARG_INT, \
+	long: FLOG_ARG_LONG, unsigned long: FLOG_ARG_LONG, \
+	long long: FLOG_ARG_LLONG, unsigned long long: FLOG_ARG_LLONG, \
+	float: FLOG_ARG_DOUBLE, double: FLOG_ARG_DOUBLE, long double: FLOG_ARG_LDOUBLE, \
+	char *: FLOG_ARG_STR, const char *: FLOG_ARG_STR, \
+	signed char *: FLOG_ARG_STR, const signed char *: FLOG_ARG_STR, \
+	unsigned char *: FLOG_ARG_STR, const unsigned char *: FLOG_ARG_STR, \
+	default: FLOG_ARG_PTR)
+
+
+//! Count macro arguments (0 to FLOG_ARG_MAX)
+#define flog_arg_count(...) flog_arg_count_(0, ##__VA_ARGS__,16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0)
+#define flog_arg_count_(_0,_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16,n,...) n
+
+#define flog_arg_cat(a, b) flog_arg_cat_(a,b)
+#define flog_arg_cat_(a, b) a##b
+
+//! Comma separated FLOG_ARG_TYPE_T of each macro argument
+#define flog_arg_types(...) flog_arg_cat(flog_arg_types_,flog_arg_count(__VA_ARGS__))(__VA_ARGS__)
+#define flog_arg_types_0()
+#define flog_arg_types_1(a) flog_arg_type(a)
+#define flog_arg_types_2(a, ...) flog_arg_type(a),flog_arg_types_1(__VA_ARGS__)
+#define flog_arg_types_3(a, ...) flog_arg_type(a),flog_arg_types_2(__VA_ARGS__)
+#define flog_arg_types_4(a, ...) flog_arg_type(a),flog_arg_types_3(__VA_ARGS__)
+#define flog_arg_types_5(a, ...) flog_arg_type(a),flog_arg_types_4(__VA_ARGS__)
+#define flog_arg_types_6(a, ...) flog_arg_type(a),flog_arg_types_5(__VA_ARGS__)
+#define flog_arg_types_7(a, ...) flog_arg_type(a),flog_arg_types_6(__VA_ARGS__)
+#define flog_arg_types_8(a, ...) flog_arg_type(a),flog_arg_types_7(__VA_ARGS__)
+#define flog_arg_types_9(a, ...) flog_arg_type(a),flog_arg_types_8(__VA_ARGS__)
+#define flog_arg_types_10(a, ...) flog_arg_type(a),flog_arg_types_9(__VA_ARGS__)
+#define flog_arg_types_11(a, ...) flog_arg_type(a),flog_arg_types_10(__VA_ARGS__)
+#define flog_arg_types_12(a, ...) flog_arg_type(a),flog_arg_types_11(__VA_ARGS__)
+#define flog_arg_types_13(a, ...) flog_arg_type(a),flog_arg_types_12(__VA_ARGS__)
+#define flog_arg_types_14(a, ...) flog_arg_type(a),flog_arg_types_13(__VA_ARGS__)
+#define flog_arg_types_15(a, ...) flog_arg_type(a),flog_arg_types_14(__VA_ARGS__)
+#define flog_arg_types_16(a, ...) flog_arg_type(a),flog_arg_types_15(__VA_ARGS__)
+
+
+//! Initializer of a FLOG_ARG_SITE_T for a format and its arguments
+#define FLOG_ARG_SITE_INIT(format, ...) {flog_arg_count(__VA_ARGS__),{flog_arg_types(__VA_ARGS__)}}
+
+
+size_t flog_args_encode(void *buf, size_t size, const FLOG_ARG_SITE_T *site, va_list ap);
+int flog_args_decode(char **strp, const char *format, const FLOG_ARG_SITE_T *site, const void *buf, size_t len);
+
+#endif //FLOG_CONFIG_ARG_TYPES
+
+#endif //FLOG_ARGS_H
@@ -0,0 +1,184 @@
+//! Circuit breaker of failing outputs for Flog
+
+//! @file flog_breaker.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! While a breaker is closed the only cost per message is loading its
+//! state. While open, each message costs a clock read and a counter
+//! increment, the output is not called. Only the caller winning the
+//! switch to half-open probes the output, other callers keep dropping.
+
+#include "flog_breaker.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_BREAKER
+
+#include "flog_histogram.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+
+__thread uint_fast8_t flog_breaker_quiet;
+
+
+//! Set up a circuit breaker of the output of a log
+
+//! The breaker is created on first use and freed by destroy_flog_t().
+//! Set up the breaker before the log is used by other threads.
+//! FLOG_T->output_stop_on_error is not used while a log has a breaker.
+//! @param[in,out] *p log
+//! @param[in] threshold failures in a row opening the breaker, 0 for FLOG_BREAKER_THRESHOLD
+//! @param[in] backoff_min_ms first backoff, 0 for FLOG_BREAKER_BACKOFF_MIN_MS
+//! @param[in] backoff_max_ms longest backoff, 0 for FLOG_BREAKER_BACKOFF_MAX_MS
+//! @retval 0 success
+//! @retval 1 error
+int flog_set_breaker(FLOG_T *p,uint32_t threshold,uint32_t backoff_min_ms,uint32_t backoff_max_ms)
+{
+	if(!p)
+		return(1);
+	if(!p->breaker) {
+		if((p->breaker=flog_calloc(1,sizeof(FLOG_BREAKER_T)))==NULL)
+			return(1);
+	}
+	p->breaker->threshold=threshold ? threshold : FLOG_BREAKER_THRESHOLD;
+	p->breaker->backoff_min_ms=backoff_min_ms ? backoff_min_ms : FLOG_BREAKER_BACKOFF_MIN_MS;
+	p->breaker->backoff_max_ms=backoff_max_ms ? backoff_max_ms : FLOG_BREAKER_BACKOFF_MAX_MS;
+	if(p->breaker->backoff_max_ms<p->breaker->backoff_min_ms)
+		p->breaker->backoff_max_ms=p->breaker->backoff_min_ms;
+	return(0);
+}
+
+
+//! Report a new state of a breaker, rate limited
+
+//! Opening is reported at most once per FLOG_BREAKER_REPORT_INTERVAL_MS,
+//! closing only when the opening was reported.
+static void flog_breaker_report(FLOG_T *p,FLOG_BREAKER_T *b,uint_fast8_t state)
+{
+	uint64_t now,last;
+	if(state==FLOG_BREAKER_OPEN) {
+		now=flog_get_time_ns();
+		last=__atomic_load_n(&b->last_report,__ATOMIC_RELAXED);
+		if(last && now-last<(uint64_t)FLOG_BREAKER_REPORT_INTERVAL_MS*1000000u)
+			return;
+		if(!__atomic_compare_exchange_n(&b->last_report,&last,now,0,__ATOMIC_RELAXED,__ATOMIC_RELAXED))
+			return;
+		__atomic_store_n(&b->open_reported,1,__ATOMIC_RELAXED);
+	} else if(!__atomic_exchange_n(&b->open_reported,0,__ATOMIC_RELAXED))
+		return;
+	(b->report ? b->report : flog_breaker_report_stderr)(p,b,state);
+}
+
+
+//! Open a breaker for backoff_ms
+static void flog_breaker_open(FLOG_BREAKER_T *b,uint32_t backoff_ms)
+{
+	__atomic_store_n(&b->backoff_ms,backoff_ms,__ATOMIC_RELAXED);
+	__atomic_store_n(&b->retry_at,flog_get_time_ns()+(uint64_t)backoff_ms*1000000u,__ATOMIC_RELAXED);
+	__atomic_store_n(&b->state,FLOG_BREAKER_OPEN,__ATOMIC_RELEASE);
+}
+
+
+//! Decide whether a message is given to the output (thread safe)
+
+//! Called before the output function, which must then be followed by
+//! flog_breaker_result().
+//! @retval 1 call the output
+//! @retval 0 drop the message
+int flog_breaker_allow(FLOG_BREAKER_T *b)
+{
+	uint_fast8_t state=__atomic_load_n(&b->state,__ATOMIC_ACQUIRE);
+	if(state==FLOG_BREAKER_CLOSED)
+		return(1);
+	//one caller probes the output once the backoff has passed
+	if(state==FLOG_BREAKER_OPEN && flog_get_time_ns()>=__atomic_load_n(&b->retry_at,__ATOMIC_RELAXED) &&
+	   __atomic_compare_exchange_n(&b->state,&state,FLOG_BREAKER_HALF_OPEN,0,__ATOMIC_ACQ_REL,__ATOMIC_RELAXED))
+		return(1);
+	__atomic_fetch_add(&b->skipped,1,__ATOMIC_RELAXED);
+	return(0);
+}
+
+
+//! Record the result of an output call allowed by flog_breaker_allow() (thread safe)
+
+//! @param[in,out] *p log of the output
+//! @param[in,out] *b breaker of the log
+//! @param[in] e result of the output function (0 for success)
+void flog_breaker_result(FLOG_T *p,FLOG_BREAKER_T *b,int e)
+{
+	uint_fast8_t state=__atomic_load_n(&b->state,__ATOMIC_ACQUIRE);
+	uint32_t backoff;
+	if(!e) {
+		if(state==FLOG_BREAKER_HALF_OPEN) {
+			__atomic_store_n(&b->failures,0,__ATOMIC_RELAXED);
+			__atomic_store_n(&b->backoff_ms,0,__ATOMIC_RELAXED);
+			p->output_error=0;
+			__atomic_store_n(&b->state,FLOG_BREAKER_CLOSED,__ATOMIC_RELEASE);
+			flog_breaker_report(p,b,FLOG_BREAKER_CLOSED);
+		} else if(__atomic_load_n(&b->failures,__ATOMIC_RELAXED))
+			__atomic_store_n(&b->failures,0,__ATOMIC_RELAXED);
+		return;
+	}
+	__atomic_fetch_add(&b->failed,1,__ATOMIC_RELAXED);
+	__atomic_store_n(&b->last_error,e,__ATOMIC_RELAXED);
+	if(state==FLOG_BREAKER_HALF_OPEN) {
+		backoff=__atomic_load_n(&b->backoff_ms,__ATOMIC_RELAXED);
+		backoff=(backoff>b->backoff_max_ms/2) ? b->backoff_max_ms : backoff*2;
+		flog_breaker_open(b,backoff);
+	} else if(state==FLOG_BREAKER_CLOSED && __atomic_add_fetch(&b->failures,1,__ATOMIC_RELAXED)==b->threshold) {
+		__atomic_fetch_add(&b->opened,1,__ATOMIC_RELAXED);
+		__atomic_store_n(&b->skipped_at_open,__atomic_load_n(&b->skipped,__ATOMIC_RELAXED),__ATOMIC_RELAXED);
+		flog_breaker_open(b,b->backoff_min_ms);
+		flog_breaker_report(p,b,FLOG_BREAKER_OPEN);
+	}
+}
+
+
+//! Default report of a breaker, one line written to stderr without using any log
+
+//! @param[in] *p log of the output
+//! @param[in] *b breaker of the log
+//! @param[in] state FLOG_BREAKER_OPEN or FLOG_BREAKER_CLOSED
+void flog_breaker_report_stderr(FLOG_T *p,const FLOG_BREAKER_T *b,uint_fast8_t state)
+{
+	char line[256];
+	int e=__atomic_load_n(&b->last_error,__ATOMIC_RELAXED),len;
+	const char *name=p->name ? p->name : "(unnamed)";
+	if(state==FLOG_BREAKER_OPEN)
+		len=snprintf(line,sizeof(line),"flog: %s: output failing (%s), dropping messages, retrying in %" PRIu32 "ms\n",
+		             name,e>0 ? strerror(e) : "error",__atomic_load_n(&b->backoff_ms,__ATOMIC_RELAXED));
+	else
+		len=snprintf(line,sizeof(line),"flog: %s: output recovered, %" PRIu64 " messages dropped\n",name,
+		             __atomic_load_n(&b->skipped,__ATOMIC_RELAXED)-__atomic_load_n(&b->skipped_at_open,__ATOMIC_RELAXED));
+	if(len>0) {
+		if((size_t)len>=sizeof(line))
+			len=sizeof(line)-1;
+		if(write(STDERR_FILENO,line,(size_t)len)) {} //nothing to do on error
+	}
+}
+
+
+//! Get the statistics of the breaker of a log
+
+//! @param[in] *p log
+//! @param[out] *stats breaker statistics
+//! @retval 0 success
+//! @retval 1 log has no breaker
+int flog_get_breaker_stats(const FLOG_T *p,FLOG_BREAKER_STATS_T *stats)
+{
+	const FLOG_BREAKER_T *b;
+	if(p==NULL || (b=p->breaker)==NULL)
+		return(1);
+	stats->state=__atomic_load_n(&b->state,__ATOMIC_ACQUIRE);
+	stats->backoff_ms=__atomic_load_n(&b->backoff_ms,__ATOMIC_RELAXED);
+	stats->opened=__atomic_load_n(&b->opened,__ATOMIC_RELAXED);
+	stats->failed=__atomic_load_n(&b->failed,__ATOMIC_RELAXED);
+	stats->skipped=__atomic_load_n(&b->skipped,__ATOMIC_RELAXED);
+	stats->last_error=__atomic_load_n(&b->last_error,__ATOMIC_RELAXED);
+	return(0);
+}
+
+#endif //FLOG_CONFIG_BREAKER
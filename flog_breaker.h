@@ -0,0 +1,95 @@
+//! Circuit breaker of failing outputs for Flog
+
+//! @file flog_breaker.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Without a breaker a failing output is either stopped for good
+//! (FLOG_T->output_stop_on_error) or tried again on every message, each
+//! failure reporting to the error log. A breaker instead stops giving
+//! messages to the output after a few failures in a row (open), and lets
+//! a single message through to probe it after a backoff (half-open). A
+//! successful probe closes the breaker again, a failed one doubles the
+//! backoff up to a maximum.
+//!
+//! While the output of a log with a breaker runs, its own reports to the
+//! error log are discarded, as they could reach the failing output again.
+//! Failures are counted instead (see flog_get_breaker_stats()), and the
+//! breaker opening and closing is reported out of band through
+//! FLOG_BREAKER_T->report, at most once per FLOG_BREAKER_REPORT_INTERVAL_MS.
+
+
+#ifndef FLOG_BREAKER_H
+#define FLOG_BREAKER_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_BREAKER
+
+#include <stdint.h>
+
+//! @addtogroup FLOG_BREAKER_STATES
+//! @brief State of a breaker
+//! @{
+
+//! Messages are given to the output
+#define FLOG_BREAKER_CLOSED     0
+//! Messages are dropped until the backoff has passed
+#define FLOG_BREAKER_OPEN       1
+//! One message is probing the output
+#define FLOG_BREAKER_HALF_OPEN  2
+
+//! @}
+
+//! Failures in a row opening the breaker, used when 0 is given
+#define FLOG_BREAKER_THRESHOLD 3
+//! First backoff in ms, used when 0 is given
+#define FLOG_BREAKER_BACKOFF_MIN_MS 100
+//! Longest backoff in ms, used when 0 is given
+#define FLOG_BREAKER_BACKOFF_MAX_MS 60000
+//! Shortest time between reports of a breaker
+#define FLOG_BREAKER_REPORT_INTERVAL_MS 1000
+
+
+//! Breaker structure - attached to a log with flog_set_breaker(), members are updated atomically
+typedef struct flog_breaker_t {
+	uint32_t threshold;                     //!< failures in a row opening the breaker
+	uint32_t backoff_min_ms;                //!< first backoff
+	uint32_t backoff_max_ms;                //!< longest backoff
+	uint_fast8_t state;                     //!< one of FLOG_BREAKER_STATES
+	uint32_t failures;                      //!< failures in a row
+	uint32_t backoff_ms;                    //!< current backoff
+	uint64_t retry_at;                      //!< time of the next probe (flog_get_time_ns())
+	uint64_t opened;                        //!< times opened from closed
+	uint64_t failed;                        //!< failed output calls
+	uint64_t skipped;                       //!< messages dropped while open
+	uint64_t skipped_at_open;               //!< skipped when last opened from closed
+	int last_error;                         //!< last error returned by the output
+	uint64_t last_report;                   //!< time opening was last reported (flog_get_time_ns())
+	uint_fast8_t open_reported;             //!< opening was reported, so closing is reported too
+	void (*report)(FLOG_T *,const struct flog_breaker_t *,uint_fast8_t); //!< out of band report of a new state (NULL for flog_breaker_report_stderr())
+} FLOG_BREAKER_T;
+
+
+//! Breaker statistics
+typedef struct {
+	uint_fast8_t state;                     //!< one of FLOG_BREAKER_STATES
+	uint32_t backoff_ms;                    //!< current backoff
+	uint64_t opened;                        //!< times opened from closed
+	uint64_t failed;                        //!< failed output calls
+	uint64_t skipped;                       //!< messages dropped while open
+	int last_error;                         //!< last error returned by the output
+} FLOG_BREAKER_STATS_T;
+
+
+//! Non-zero while an output with a breaker runs in this thread, flog_print[f] then does nothing
+extern __thread uint_fast8_t flog_breaker_quiet;
+
+int flog_set_breaker(FLOG_T *p,uint32_t threshold,uint32_t backoff_min_ms,uint32_t backoff_max_ms);
+int flog_breaker_allow(FLOG_BREAKER_T *b);
+void flog_breaker_result(FLOG_T *p,FLOG_BREAKER_T *b,int e);
+void flog_breaker_report_stderr(FLOG_T *p,const FLOG_BREAKER_T *b,uint_fast8_t state);
+int flog_get_breaker_stats(const FLOG_T *p,FLOG_BREAKER_STATS_T *stats);
+
+#endif //FLOG_CONFIG_BREAKER
+
+#endif //FLOG_BREAKER_H
@@ -0,0 +1,790 @@
+//! Configuration loader for Flog
+
+//! @file flog_conf.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! The configuration is parsed completely and a new log tree is built
+//! before anything is changed, so a broken file leaves the running tree
+//! alone. The new tree is then swapped in with flog_replace_sublog() below
+//! the root, which producers keep emitting to without locking. Replaced
+//! trees are flushed and kept until flog_conf_free_retired() or
+//! destroy_flog_conf(), as other threads may still be emitting to them.
+
+#define _GNU_SOURCE
+#include "flog_conf.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_LOADER
+
+#include "flog_output_stdio.h"
+#include "flog_output_file.h"
+#include "flog_output_compressed.h"
+#include "flog_output_shm.h"
+#include "flog_trace.h"
+#include "flog_filter.h"
+#include "flog_layout.h"
+#include "flog_detach.h"
+#include "flog_breaker.h"
+#include "flog_governor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+
+
+//! Outputs of a configured log
+enum {
+	FLOG_CONF_OUTPUT_NONE,
+	FLOG_CONF_OUTPUT_STDOUT,
+	FLOG_CONF_OUTPUT_STDERR,
+	FLOG_CONF_OUTPUT_FILE,
+	FLOG_CONF_OUTPUT_COMPRESSED,
+	FLOG_CONF_OUTPUT_SHM,
+	FLOG_CONF_OUTPUT_TRACE
+};
+
+
+//! Color settings of a configured log
+enum {
+	FLOG_CONF_COLOR_OFF,
+	FLOG_CONF_COLOR_ON,
+	FLOG_CONF_COLOR_AUTO
+};
+
+
+//! One [section] of a configuration, strings point into the parsed text
+typedef struct {
+	const char *section;                    //!< section name
+	unsigned int line;                      //!< line of section header
+	const char *name;                       //!< log name (NULL to use section name)
+	FLOG_MSG_TYPE_T accept;                 //!< accepted message types
+	int output;                             //!< one of FLOG_CONF_OUTPUT_*
+	const char *file;                       //!< file name
+	size_t buffer;                          //!< file buffer size (0 for unbuffered)
+	size_t index;                           //!< records per index entry (0 for no index)
+	size_t detach;                          //!< queue size of a detached log (0 to not detach)
+	size_t records;                         //!< records in a shared memory ring (0 for the default)
+	int raw;                                //!< write raw shared memory records (FLOG_OUTPUT_SHM_RAW)
+	FLOG_MSG_TYPE_T flush_on;               //!< types written at once (FLOG_DURABILITY_FLUSH)
+	FLOG_MSG_TYPE_T sync_on;                //!< types synced at once (FLOG_DURABILITY_SYNC)
+	FLOG_MSG_TYPE_T group_on;               //!< types synced by a group commit (FLOG_DURABILITY_GROUP)
+	size_t group_ms;                        //!< group commit window
+	int color;                              //!< one of FLOG_CONF_COLOR_*
+	int stop_on_error;                      //!< value for FLOG_T.output_stop_on_error
+	int breaker;                            //!< use a circuit breaker (see flog_set_breaker())
+	int governor;                           //!< use a load shedding governor (see flog_set_governor())
+	const char *parent;                     //!< section of parent log
+	const char *error_log;                  //!< section of error log
+	const char *filter;                     //!< subsystem filter rules
+	const char *layout;                     //!< layout pattern
+	int escape;                             //!< escape message text (FLOG_OUTPUT_FLAG_ESCAPE)
+	FLOG_T *log;                            //!< log built from section
+} FLOG_CONF_SECTION_T;
+
+
+//! Parsed configuration
+typedef struct {
+	const char *source;                     //!< file name, for error messages
+	FLOG_CONF_SECTION_T *section;           //!< array of sections
+	unsigned int section_amount;            //!< amount of sections in array
+} FLOG_CONF_PARSED_T;
+
+
+//! Report a configuration error
+
+//! @retval 1 always, to be returned by the caller
+static int flog_conf_error(const FLOG_CONF_T *p,const char *source,unsigned int line,const char *error,const char *value)
+{
+	if(value)
+		flog_printf(p->error_log,"flog_conf",FLOG_ERROR,FLOG_MSG_CONF_ERROR,"%s:%u: %s: %s",source,line,error,value);
+	else
+		flog_printf(p->error_log,"flog_conf",FLOG_ERROR,FLOG_MSG_CONF_ERROR,"%s:%u: %s",source,line,error);
+	return(1);
+}
+
+
+//! Remove leading and trailing white space from a string in place
+static char * flog_conf_trim(char *str)
+{
+	char *end;
+	while(isspace((unsigned char)*str))
+		str++;
+	for(end=str+strlen(str);end>str && isspace((unsigned char)end[-1]);end--);
+	*end=0;
+	return(str);
+}
+
+
+//! Parse a boolean value
+
+//! @retval 0 success
+static int flog_conf_parse_bool(const char *value,int *b)
+{
+	if(!strcasecmp(value,"yes") || !strcasecmp(value,"on") || !strcasecmp(value,"true") || !strcmp(value,"1"))
+		*b=1;
+	else if(!strcasecmp(value,"no") || !strcasecmp(value,"off") || !strcasecmp(value,"false") || !strcmp(value,"0"))
+		*b=0;
+	else
+		return(1);
+	return(0);
+}
+
+
+//! Parse a size in bytes with an optional k or M suffix
+
+//! @retval 0 success
+static int flog_conf_parse_size(const char *value,size_t *size)
+{
+	char *end;
+	unsigned long n;
+	errno=0;
+	n=strtoul(value,&end,10);
+	if(errno || end==value)
+		return(1);
+	if(*end=='k' || *end=='K') {
+		n*=1024;
+		end++;
+	} else if(*end=='M') {
+		n*=1024*1024;
+		end++;
+	}
+	if(*end)
+		return(1);
+	*size=n;
+	return(0);
+}
+
+
+//! Parse accepted message types, actions separated by ',' are applied in order
+
+//! @retval 0 success
+static int flog_conf_parse_accept(const char *value,FLOG_MSG_TYPE_T *accept)
+{
+	FLOG_MSG_TYPE_T clear,set;
+	const char *end;
+	size_t len;
+	for(;;value=end+1) {
+		for(end=value;*end && *end!=',';end++);
+		while(isspace((unsigned char)*value))
+			value++;
+		for(len=(size_t)(end-value);len && isspace((unsigned char)value[len-1]);len--);
+		if(flog_parse_msg_type_action(value,len,&clear,&set))
+			return(1);
+		*accept=(*accept & ~clear) | set;
+		if(!*end)
+			return(0);
+	}
+}
+
+
+//! Find a section by name
+static FLOG_CONF_SECTION_T * flog_conf_find_section(const FLOG_CONF_PARSED_T *ps,const char *section)
+{
+	unsigned int i;
+	for(i=0;i<ps->section_amount;i++) {
+		if(!strcmp(ps->section[i].section,section))
+			return(&ps->section[i]);
+	}
+	return(NULL);
+}
+
+
+//! Parse a key of a section
+
+//! @retval 0 success
+static int flog_conf_parse_key(const FLOG_CONF_T *p,const FLOG_CONF_PARSED_T *ps,FLOG_CONF_SECTION_T *s,unsigned int line,const char *key,const char *value)
+{
+	if(!strcasecmp(key,"name")) {
+		s->name=value;
+	} else if(!strcasecmp(key,"accept")) {
+		if(flog_conf_parse_accept(value,&s->accept))
+			return(flog_conf_error(p,ps->source,line,"invalid message types",value));
+	} else if(!strcasecmp(key,"parent")) {
+		s->parent=value;
+	} else if(!strcasecmp(key,"error_log")) {
+		s->error_log=value;
+	} else if(!strcasecmp(key,"output")) {
+		if(!strcasecmp(value,"none"))
+			s->output=FLOG_CONF_OUTPUT_NONE;
+#ifdef FLOG_CONFIG_OUTPUT_STDIO
+		else if(!strcasecmp(value,"stdout"))
+			s->output=FLOG_CONF_OUTPUT_STDOUT;
+		else if(!strcasecmp(value,"stderr"))
+			s->output=FLOG_CONF_OUTPUT_STDERR;
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_FILE
+		else if(!strcasecmp(value,"file"))
+			s->output=FLOG_CONF_OUTPUT_FILE;
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_COMPRESSED
+		else if(!strcasecmp(value,"compressed"))
+			s->output=FLOG_CONF_OUTPUT_COMPRESSED;
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_SHM
+		else if(!strcasecmp(value,"shm"))
+			s->output=FLOG_CONF_OUTPUT_SHM;
+#endif
+#ifdef FLOG_CONFIG_TRACE
+		else if(!strcasecmp(value,"trace"))
+			s->output=FLOG_CONF_OUTPUT_TRACE;
+#endif
+		else
+			return(flog_conf_error(p,ps->source,line,"unknown output",value));
+	} else if(!strcasecmp(key,"file")) {
+		s->file=value;
+	} else if(!strcasecmp(key,"buffer")) {
+		if(flog_conf_parse_size(value,&s->buffer))
+			return(flog_conf_error(p,ps->source,line,"invalid size",value));
+#ifdef FLOG_CONFIG_OUTPUT_SHM
+	} else if(!strcasecmp(key,"records")) {
+		if(flog_conf_parse_size(value,&s->records) || s->records>UINT32_MAX || (s->records & (s->records-1)))
+			return(flog_conf_error(p,ps->source,line,"invalid amount of records",value));
+	} else if(!strcasecmp(key,"raw")) {
+		if(flog_conf_parse_bool(value,&s->raw))
+			return(flog_conf_error(p,ps->source,line,"invalid boolean",value));
+#endif
+#ifdef FLOG_CONFIG_INDEX
+	} else if(!strcasecmp(key,"index")) {
+		if(flog_conf_parse_size(value,&s->index) || s->index>UINT32_MAX)
+			return(flog_conf_error(p,ps->source,line,"invalid size",value));
+#endif
+#ifdef FLOG_CONFIG_DURABILITY
+	} else if(!strcasecmp(key,"flush_on")) {
+		if(flog_conf_parse_accept(value,&s->flush_on))
+			return(flog_conf_error(p,ps->source,line,"invalid message types",value));
+	} else if(!strcasecmp(key,"sync_on")) {
+		if(flog_conf_parse_accept(value,&s->sync_on))
+			return(flog_conf_error(p,ps->source,line,"invalid message types",value));
+	} else if(!strcasecmp(key,"group_on")) {
+		if(flog_conf_parse_accept(value,&s->group_on))
+			return(flog_conf_error(p,ps->source,line,"invalid message types",value));
+	} else if(!strcasecmp(key,"group_ms")) {
+		if(flog_conf_parse_size(value,&s->group_ms) || s->group_ms>UINT32_MAX)
+			return(flog_conf_error(p,ps->source,line,"invalid size",value));
+#endif
+#ifdef FLOG_CONFIG_DETACH
+	} else if(!strcasecmp(key,"detach")) {
+		if(flog_conf_parse_size(value,&s->detach) || s->detach>UINT32_MAX)
+			return(flog_conf_error(p,ps->source,line,"invalid size",value));
+#endif
+	} else if(!strcasecmp(key,"color")) {
+		int b;
+		if(!strcasecmp(value,"auto"))
+			s->color=FLOG_CONF_COLOR_AUTO;
+		else if(!flog_conf_parse_bool(value,&b))
+			s->color=b ? FLOG_CONF_COLOR_ON : FLOG_CONF_COLOR_OFF;
+		else
+			return(flog_conf_error(p,ps->source,line,"invalid color setting",value));
+	} else if(!strcasecmp(key,"stop_on_error")) {
+		if(flog_conf_parse_bool(value,&s->stop_on_error))
+			return(flog_conf_error(p,ps->source,line,"invalid boolean",value));
+#ifdef FLOG_CONFIG_BREAKER
+	} else if(!strcasecmp(key,"breaker")) {
+		if(flog_conf_parse_bool(value,&s->breaker))
+			return(flog_conf_error(p,ps->source,line,"invalid boolean",value));
+#endif
+#ifdef FLOG_CONFIG_GOVERNOR
+	} else if(!strcasecmp(key,"governor")) {
+		if(flog_conf_parse_bool(value,&s->governor))
+			return(flog_conf_error(p,ps->source,line,"invalid boolean",value));
+#endif
+#ifdef FLOG_CONFIG_FILTER
+	} else if(!strcasecmp(key,"filter")) {
+		s->filter=value;
+#endif
+#ifdef FLOG_CONFIG_LAYOUT
+	} else if(!strcasecmp(key,"layout")) {
+#ifdef FLOG_CONFIG_ESCAPE
+		if(!strcasecmp(value,"json"))
+			value=FLOG_LAYOUT_JSON;
+#endif
+		s->layout=value;
+#endif
+#ifdef FLOG_CONFIG_ESCAPE
+	} else if(!strcasecmp(key,"escape")) {
+		if(flog_conf_parse_bool(value,&s->escape))
+			return(flog_conf_error(p,ps->source,line,"invalid boolean",value));
+#endif
+	} else
+		return(flog_conf_error(p,ps->source,line,"unknown key",key));
+	return(0);
+}
+
+
+//! Parse a configuration into sections
+
+//! @param[in] *p configuration (for error reporting)
+//! @param[out] *ps parsed sections
+//! @param[in,out] *text configuration text, modified in place
+//! @retval 0 success
+static int flog_conf_parse(const FLOG_CONF_T *p,FLOG_CONF_PARSED_T *ps,char *text)
+{
+	char *line,*next,*eq,*key,*value;
+	size_t len;
+	unsigned int n=0;
+	FLOG_CONF_SECTION_T *s=NULL,*new_section;
+	for(line=text;line;line=next) {
+		n++;
+		if((next=strchr(line,'\n')))
+			*next++=0;
+		line=flog_conf_trim(line);
+		if(!*line || *line=='#' || *line==';')
+			continue;
+		if(*line=='[') {
+			len=strlen(line);
+			if(line[len-1]!=']')
+				return(flog_conf_error(p,ps->source,n,"missing ]",line));
+			line[len-1]=0;
+			line=flog_conf_trim(line+1);
+			if(!*line)
+				return(flog_conf_error(p,ps->source,n,"empty section name",NULL));
+			if(flog_conf_find_section(ps,line))
+				return(flog_conf_error(p,ps->source,n,"duplicate section",line));
+			if((new_section=flog_realloc(ps->section,(ps->section_amount+1)*sizeof(FLOG_CONF_SECTION_T)))==NULL)
+				return(flog_conf_error(p,ps->source,n,"out of memory",NULL));
+			ps->section=new_section;
+			s=&ps->section[ps->section_amount++];
+			memset(s,0,sizeof(FLOG_CONF_SECTION_T));
+			s->section=line;
+			s->line=n;
+			s->accept=FLOG_ACCEPT_ALL;
+			s->stop_on_error=1;
+			continue;
+		}
+		if(!s)
+			return(flog_conf_error(p,ps->source,n,"key outside of section",line));
+		if((eq=strchr(line,'='))==NULL)
+			return(flog_conf_error(p,ps->source,n,"expected key = value",line));
+		*eq=0;
+		key=flog_conf_trim(line);
+		value=flog_conf_trim(eq+1);
+		len=strlen(value);
+		if(len>=2 && value[0]=='"' && value[len-1]=='"') {
+			value[len-1]=0;
+			value++;
+		}
+		if(flog_conf_parse_key(p,ps,s,n,key,value))
+			return(1);
+	}
+	return(0);
+}
+
+
+//! Does the parent chain of a section lead back to itself?
+static int flog_conf_has_cycle(const FLOG_CONF_PARSED_T *ps,const FLOG_CONF_SECTION_T *s)
+{
+	const FLOG_CONF_SECTION_T *t=s;
+	unsigned int i;
+	for(i=0;i<ps->section_amount && t->parent;i++) {
+		if((t=flog_conf_find_section(ps,t->parent))==NULL)
+			return(0);
+		if(t==s)
+			return(1);
+	}
+	return(0);
+}
+
+
+//! Free a log created from a section
+static void flog_conf_destroy_log(FLOG_T *log)
+{
+#ifdef FLOG_CONFIG_OUTPUT_FILE
+	if(log->output_func==flog_output_file || log->output_func==flog_output_file_buffered) {
+		destroy_flog_output_file(log);
+		return;
+	}
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_COMPRESSED
+	if(log->output_func==flog_output_compressed) {
+		destroy_flog_output_compressed(log);
+		return;
+	}
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_SHM
+	if(log->output_func==flog_output_shm) {
+		destroy_flog_output_shm(log);
+		return;
+	}
+#endif
+#ifdef FLOG_CONFIG_TRACE
+	if(log->output_func==flog_output_trace) {
+		destroy_flog_output_trace(log);
+		return;
+	}
+#endif
+	destroy_flog_t(log);
+}
+
+
+//! Free a log tree built from a configuration
+static void flog_conf_destroy_tree(FLOG_CONF_TREE_T *tree)
+{
+	unsigned int i;
+	if(tree) {
+#ifdef FLOG_CONFIG_DETACH
+		//drain every queue while the logs they route to still exist
+		for(i=0;i<tree->log_amount;i++)
+			flog_attach(tree->log[i]);
+#endif
+		for(i=0;i<tree->log_amount;i++)
+			flog_conf_destroy_log(tree->log[i]);
+		flog_free(tree->log);
+		destroy_flog_t(tree->top);
+		flog_free(tree);
+	}
+}
+
+
+//! Create an empty log tree with room for log_max logs
+static FLOG_CONF_TREE_T * flog_conf_create_tree(unsigned int log_max)
+{
+	FLOG_CONF_TREE_T *tree;
+	if((tree=flog_calloc(1,sizeof(FLOG_CONF_TREE_T)))==NULL)
+		return(NULL);
+	if((tree->log=flog_calloc(log_max ? log_max : 1,sizeof(FLOG_T *)))==NULL) {
+		flog_free(tree);
+		return(NULL);
+	}
+	if((tree->top=create_flog_t(NULL,FLOG_ACCEPT_DEEP_DEBUG))==NULL) {
+		flog_conf_destroy_tree(tree);
+		return(NULL);
+	}
+	return(tree);
+}
+
+
+//! Create the log of a section
+static FLOG_T * flog_conf_create_log(const FLOG_CONF_SECTION_T *s)
+{
+	const char *name=s->name ? s->name : s->section;
+	FLOG_T *log;
+	if(!name[0])
+		name=NULL;
+	switch(s->output) {
+#ifdef FLOG_CONFIG_OUTPUT_STDIO
+	case FLOG_CONF_OUTPUT_STDOUT:
+		log=create_flog_output_stdout(name,s->accept);
+		break;
+	case FLOG_CONF_OUTPUT_STDERR:
+		log=create_flog_output_stderr(name,s->accept);
+		break;
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_FILE
+	case FLOG_CONF_OUTPUT_FILE:
+		if(s->buffer)
+			log=create_flog_output_file_buffered(name,s->accept,s->file,s->buffer);
+		else
+			log=create_flog_output_file(name,s->accept,s->file);
+#ifdef FLOG_CONFIG_INDEX
+		if(log && s->index && flog_output_file_set_index(log,(uint32_t)s->index)) {
+			flog_conf_destroy_log(log);
+			return(NULL);
+		}
+#endif
+#ifdef FLOG_CONFIG_DURABILITY
+		if(log && (s->flush_on|s->sync_on|s->group_on) &&
+		   (flog_output_file_set_durability(log,s->flush_on,FLOG_DURABILITY_FLUSH,0) ||
+		    flog_output_file_set_durability(log,s->sync_on,FLOG_DURABILITY_SYNC,0) ||
+		    flog_output_file_set_durability(log,s->group_on,FLOG_DURABILITY_GROUP,(uint32_t)s->group_ms))) {
+			flog_conf_destroy_log(log);
+			return(NULL);
+		}
+#endif
+		break;
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_COMPRESSED
+	case FLOG_CONF_OUTPUT_COMPRESSED:
+		log=create_flog_output_compressed(name,s->accept,s->file,s->buffer);
+		break;
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_SHM
+	case FLOG_CONF_OUTPUT_SHM:
+		log=create_flog_output_shm(name,s->accept,s->file,0,(uint32_t)s->records,s->raw ? FLOG_OUTPUT_SHM_RAW : 0);
+		break;
+#endif
+#ifdef FLOG_CONFIG_TRACE
+	case FLOG_CONF_OUTPUT_TRACE:
+		log=create_flog_output_trace(name,s->accept,s->file);
+		break;
+#endif
+	default:
+		log=create_flog_t(name,s->accept);
+		break;
+	}
+	if(log==NULL)
+		return(NULL);
+	log->output_stop_on_error=s->stop_on_error;
+#ifdef FLOG_CONFIG_BREAKER
+	if(s->breaker && flog_set_breaker(log,0,0,0)) {
+		flog_conf_destroy_log(log);
+		return(NULL);
+	}
+#endif
+#ifdef FLOG_CONFIG_GOVERNOR
+	if(s->governor && flog_set_governor(log,0,0,0)) {
+		flog_conf_destroy_log(log);
+		return(NULL);
+	}
+#endif
+#ifdef FLOG_CONFIG_OUTPUT_ANSI_COLOR
+	//only a terminal shows colors, files and shared memory would get the escapes
+	if((s->output==FLOG_CONF_OUTPUT_STDOUT || s->output==FLOG_CONF_OUTPUT_STDERR) &&
+	   (s->color==FLOG_CONF_COLOR_ON ||
+	    (s->color==FLOG_CONF_COLOR_AUTO && isatty(s->output==FLOG_CONF_OUTPUT_STDOUT ? STDOUT_FILENO : STDERR_FILENO))))
+		log->output_flags|=FLOG_OUTPUT_FLAG_ANSI_COLOR;
+#endif
+#ifdef FLOG_CONFIG_ESCAPE
+	if(s->escape)
+		log->output_flags|=FLOG_OUTPUT_FLAG_ESCAPE;
+#endif
+	return(log);
+}
+
+
+//! Build a log tree from parsed sections
+
+//! @retval NULL error (reported to p->error_log)
+static FLOG_CONF_TREE_T * flog_conf_build(const FLOG_CONF_T *p,FLOG_CONF_PARSED_T *ps)
+{
+	FLOG_CONF_TREE_T *tree;
+	FLOG_CONF_SECTION_T *s,*t;
+	unsigned int i;
+	if((tree=flog_conf_create_tree(ps->section_amount))==NULL) {
+		flog_conf_error(p,ps->source,0,"out of memory",NULL);
+		return(NULL);
+	}
+	for(i=0;i<ps->section_amount;i++) {
+		s=&ps->section[i];
+		if(s->output==FLOG_CONF_OUTPUT_FILE && !s->file) {
+			flog_conf_error(p,ps->source,s->line,"output = file requires file",s->section);
+			goto error;
+		}
+		if(s->index && (s->output!=FLOG_CONF_OUTPUT_FILE || !s->buffer)) {
+			flog_conf_error(p,ps->source,s->line,"index requires output = file and buffer",s->section);
+			goto error;
+		}
+		if((s->flush_on|s->sync_on|s->group_on) && (s->output!=FLOG_CONF_OUTPUT_FILE || !s->buffer)) {
+			flog_conf_error(p,ps->source,s->line,"flush_on, sync_on and group_on require output = file and buffer",s->section);
+			goto error;
+		}
+		if(s->color==FLOG_CONF_COLOR_ON && s->output!=FLOG_CONF_OUTPUT_STDOUT && s->output!=FLOG_CONF_OUTPUT_STDERR) {
+			flog_conf_error(p,ps->source,s->line,"color = on requires output = stdout or stderr",s->section);
+			goto error;
+		}
+		if(s->output==FLOG_CONF_OUTPUT_COMPRESSED && !s->file) {
+			flog_conf_error(p,ps->source,s->line,"output = compressed requires file",s->section);
+			goto error;
+		}
+		if(s->output==FLOG_CONF_OUTPUT_SHM && !s->file) {
+			flog_conf_error(p,ps->source,s->line,"output = shm requires file",s->section);
+			goto error;
+		}
+		if(s->output==FLOG_CONF_OUTPUT_TRACE && !s->file) {
+			flog_conf_error(p,ps->source,s->line,"output = trace requires file",s->section);
+			goto error;
+		}
+		if((s->log=flog_conf_create_log(s))==NULL) {
+			flog_conf_error(p,ps->source,s->line,"cannot create log",s->section);
+			goto error;
+		}
+		tree->log[tree->log_amount++]=s->log;
+#ifdef FLOG_CONFIG_FILTER
+		if(s->filter && flog_set_filter(s->log,s->filter)) {
+			flog_conf_error(p,ps->source,s->line,"invalid filter",s->filter);
+			goto error;
+		}
+#endif
+#ifdef FLOG_CONFIG_LAYOUT
+		if(s->layout && flog_set_layout(s->log,s->layout)) {
+			flog_conf_error(p,ps->source,s->line,"invalid layout",s->layout);
+			goto error;
+		}
+#endif
+	}
+	for(i=0;i<ps->section_amount;i++) {
+		s=&ps->section[i];
+		if(s->parent) {
+			if((t=flog_conf_find_section(ps,s->parent))==NULL) {
+				flog_conf_error(p,ps->source,s->line,"unknown parent",s->parent);
+				goto error;
+			}
+			if(flog_conf_has_cycle(ps,s)) {
+				flog_conf_error(p,ps->source,s->line,"circular parent",s->parent);
+				goto error;
+			}
+		} else
+			t=NULL;
+		if(flog_append_sublog(t ? t->log : tree->top,s->log)) {
+			flog_conf_error(p,ps->source,s->line,"out of memory",NULL);
+			goto error;
+		}
+		if(s->error_log) {
+			if((t=flog_conf_find_section(ps,s->error_log))==NULL) {
+				flog_conf_error(p,ps->source,s->line,"unknown error_log",s->error_log);
+				goto error;
+			}
+			s->log->error_log=t->log;
+		}
+	}
+#ifdef FLOG_CONFIG_DETACH
+	//start the workers once the tree is complete
+	for(i=0;i<ps->section_amount;i++) {
+		s=&ps->section[i];
+		if(s->detach && flog_detach(s->log,(uint32_t)s->detach,0)) {
+			flog_conf_error(p,ps->source,s->line,"cannot detach log",s->section);
+			goto error;
+		}
+	}
+#endif
+	return(tree);
+error:
+	flog_conf_destroy_tree(tree);
+	return(NULL);
+}
+
+
+//! Parse a configuration, build its tree and swap it in
+static int flog_conf_load_text(FLOG_CONF_T *p,const char *source,const char *text)
+{
+	FLOG_CONF_PARSED_T ps;
+	FLOG_CONF_TREE_T *tree=NULL,*old;
+	char *copy;
+	memset(&ps,0,sizeof(ps));
+	ps.source=source;
+	if((copy=flog_strdup(text))==NULL)
+		return(1);
+	if(!flog_conf_parse(p,&ps,copy))
+		tree=flog_conf_build(p,&ps);
+	flog_free(ps.section);
+	flog_free(copy);
+	if(tree==NULL)
+		return(1);
+	flog_replace_sublog(p->root,0,tree->top);
+	if((old=p->tree)) {
+		flog_flush(old->top);
+		old->retired=p->retired;
+		p->retired=old;
+	}
+	p->tree=tree;
+	return(0);
+}
+
+
+//! Create a configured log tree, empty until a configuration is loaded
+
+//! @param[in] *name name of root log (may be NULL)
+//! @param[in] *error_log log to report configuration errors to (may be NULL)
+//! @retval NULL error
+FLOG_CONF_T * create_flog_conf(const char *name, FLOG_T *error_log)
+{
+	FLOG_CONF_T *p;
+	if((p=flog_calloc(1,sizeof(FLOG_CONF_T)))==NULL)
+		return(NULL);
+	p->error_log=error_log;
+	if((p->root=create_flog_t(name,FLOG_ACCEPT_DEEP_DEBUG))==NULL) {
+		flog_free(p);
+		return(NULL);
+	}
+	if((p->tree=flog_conf_create_tree(0))==NULL || flog_append_sublog(p->root,p->tree->top)) {
+		destroy_flog_conf(p);
+		return(NULL);
+	}
+	return(p);
+}
+
+
+//! Free a configured log tree, including replaced trees
+void destroy_flog_conf(FLOG_CONF_T *p)
+{
+	if(p) {
+		flog_conf_free_retired(p);
+		flog_conf_destroy_tree(p->tree);
+		destroy_flog_t(p->root);
+		flog_free(p->filename);
+		flog_free(p);
+	}
+}
+
+
+//! Load a configuration from a string
+
+//! On error the current tree is kept, and the error is reported to p->error_log
+//! @param[in,out] *p configured log tree
+//! @param[in] *text configuration
+//! @retval 0 success
+//! @retval 1 error
+int flog_conf_load_str(FLOG_CONF_T *p, const char *text)
+{
+	if(!p || !text)
+		return(1);
+	return(flog_conf_load_text(p,"(string)",text));
+}
+
+
+//! Load a configuration file
+
+//! On error the current tree is kept, and the error is reported to p->error_log
+//! @param[in,out] *p configured log tree
+//! @param[in] *filename file to load, remembered for flog_conf_reload()
+//! @retval 0 success
+//! @retval 1 error
+int flog_conf_load(FLOG_CONF_T *p, const char *filename)
+{
+	FILE *f;
+	char *text=NULL,*name;
+	size_t size=0;
+	int e;
+	if(!p || !filename)
+		return(1);
+	if((f=fopen(filename,"r"))==NULL) {
+		flog_printf(p->error_log,"flog_conf",FLOG_ERROR,FLOG_MSG_CONF_ERROR,"%s (%s)",filename,strerror(errno));
+		return(1);
+	}
+	//the text is only kept while it is parsed, so it comes from malloc()
+	if(getdelim(&text,&size,0,f)==-1 && !feof(f)) {
+		flog_printf(p->error_log,"flog_conf",FLOG_ERROR,FLOG_MSG_CONF_ERROR,"%s (%s)",filename,strerror(errno));
+		free(text);
+		fclose(f);
+		return(1);
+	}
+	fclose(f);
+	e=flog_conf_load_text(p,filename,text ? text : "");
+	free(text);
+	if(!e && filename!=p->filename) {
+		if((name=flog_strdup(filename))) {
+			flog_free(p->filename);
+			p->filename=name;
+		}
+	}
+	return(e);
+}
+
+
+//! Load the last loaded configuration file again
+
+//! @retval 0 success
+//! @retval 1 error, or no file loaded yet
+int flog_conf_reload(FLOG_CONF_T *p)
+{
+	if(!p || !p->filename)
+		return(1);
+	return(flog_conf_load(p,p->filename));
+}
+
+
+//! Free the trees replaced by loading a new configuration
+
+//! Only call when no other thread may still be emitting to them
+void flog_conf_free_retired(FLOG_CONF_T *p)
+{
+	FLOG_CONF_TREE_T *tree;
+	while((tree=p->retired)) {
+		p->retired=tree->retired;
+		flog_conf_destroy_tree(tree);
+	}
+}
+
+#endif //FLOG_CONFIG_LOADER
@@ -0,0 +1,112 @@
+//! Configuration loader for Flog
+
+//! @file flog_conf.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Builds a log tree from a configuration file, and swaps in a new tree
+//! when the file is reloaded. Emit messages to the root of a FLOG_CONF_T,
+//! it stays the same while the tree below it is replaced.
+//!
+//! The file has one [section] per log, and "key = value" lines.
+//! Lines starting with '#' or ';' are comments. Keys are:
+//! - name: log name (default is the section name, empty for an unnamed log)
+//! - accept: accepted message types, such as "INFO+", "DEBUG" or "all",
+//!   actions separated by ',' are applied in order to the default
+//!   FLOG_ACCEPT_ALL (see flog_parse_msg_type_action())
+//! - parent: section of the log to append this log to (default is the root)
+//! - error_log: section of the log to report output errors to
+//! - output: none, stdout, stderr, file, compressed, shm or trace
+//!   (default is none, compressed requires FLOG_CONFIG_OUTPUT_COMPRESSED,
+//!   shm requires FLOG_CONFIG_OUTPUT_SHM, trace writes Chrome trace events
+//!   and requires FLOG_CONFIG_TRACE)
+//! - file: file name (output = file, compressed or trace), or name of the
+//!   shared memory object such as /program.log (output = shm)
+//! - records: records in the shared memory ring, a power of two (output =
+//!   shm, default FLOG_SHM_RECORD_AMOUNT)
+//! - raw: yes to write only the message text, rendered by flogtail
+//!   (output = shm, see FLOG_OUTPUT_SHM_RAW)
+//! - buffer: buffer size in bytes with an optional k or M suffix, writes
+//!   the file through a buffer when set (output = file), or the size of
+//!   each compressed block (output = compressed)
+//! - index: records per entry of a sidecar index of the file (output =
+//!   file with buffer, see flog_index.h, requires FLOG_CONFIG_INDEX)
+//! - flush_on, sync_on, group_on: message types written at once, synced
+//!   to disk at once, or synced by a group commit, like accept but applied
+//!   to no types (output = file with buffer, see
+//!   flog_output_file_set_durability(), requires FLOG_CONFIG_DURABILITY)
+//! - group_ms: how long a group commit waits for other threads (default
+//!   FLOG_DURABILITY_GROUP_MS)
+//! - color: on, off or auto (output = stdout or stderr, other outputs
+//!   never get colors)
+//! - stop_on_error: yes or no (default is yes)
+//! - breaker: yes to stop calling a failing output and retry it with a
+//!   backoff, instead of stop_on_error (see flog_breaker.h, requires
+//!   FLOG_CONFIG_BREAKER)
+//! - governor: yes to shed the least severe message types while the log
+//!   or its detached queues can't keep up (see flog_governor.h, requires
+//!   FLOG_CONFIG_GOVERNOR)
+//! - filter: subsystem filter rules (see flog_filter.h, requires FLOG_CONFIG_FILTER)
+//! - layout: layout of rendered messages, such as "%T %L: %m%n" (see
+//!   flog_layout.h, requires FLOG_CONFIG_LAYOUT), or json for FLOG_LAYOUT_JSON
+//! - escape: yes to escape control characters in message text (requires
+//!   FLOG_CONFIG_ESCAPE)
+//! - detach: queue size, gives the log its own worker thread so its
+//!   output and sublogs don't delay the rest of the tree (see
+//!   flog_detach.h, requires FLOG_CONFIG_DETACH)
+//!
+//! Example:
+//!
+//!     [main]
+//!     accept = DEBUG+
+//!     error_log = main
+//!
+//!     [console]
+//!     name =
+//!     parent = main
+//!     output = stderr
+//!     accept = INFO+
+//!     color = auto
+//!
+//!     [file]
+//!     parent = main
+//!     output = file
+//!     file = /var/log/program.log
+//!     buffer = 64k
+
+
+#ifndef FLOG_CONF_H
+#define FLOG_CONF_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_LOADER
+
+//! Log tree built from a configuration
+typedef struct flog_conf_tree_t {
+	FLOG_T *top;                            //!< unnamed log holding the logs without a parent
+	FLOG_T **log;                           //!< logs created from the configuration, one per section
+	unsigned int log_amount;                //!< amount of logs in array
+	struct flog_conf_tree_t *retired;       //!< next tree in the list of replaced trees
+} FLOG_CONF_TREE_T;
+
+
+//! Configured log tree
+typedef struct {
+	FLOG_T *root;                           //!< log to emit messages to
+	FLOG_T *error_log;                      //!< log to report configuration errors to
+	char *filename;                         //!< file loaded last (NULL if none)
+	FLOG_CONF_TREE_T *tree;                 //!< current tree
+	FLOG_CONF_TREE_T *retired;              //!< replaced trees, freed later
+} FLOG_CONF_T;
+
+
+FLOG_CONF_T * create_flog_conf(const char *name, FLOG_T *error_log);
+void destroy_flog_conf(FLOG_CONF_T *p);
+int flog_conf_load_str(FLOG_CONF_T *p, const char *text);
+int flog_conf_load(FLOG_CONF_T *p, const char *filename);
+int flog_conf_reload(FLOG_CONF_T *p);
+void flog_conf_free_retired(FLOG_CONF_T *p);
+
+#endif //FLOG_CONFIG_LOADER
+
+#endif //FLOG_CONF_H
@@ -0,0 +1,141 @@
+//! Thread context of messages for Flog
+
+//! @file flog_context.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+
+#define _GNU_SOURCE
+
+#include "flog_context.h"
+
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+
+__thread FLOG_CONTEXT_T flog_context_thread;
+
+
+//! Set up the context of the calling thread with its id and name
+void flog_context_init(FLOG_CONTEXT_T *c)
+{
+	char name[FLOG_CONTEXT_NAME_SIZE+1]="";
+	c->tid=(uint32_t)syscall(SYS_gettid);
+	if(!c->name[0] && !prctl(PR_GET_NAME,name,0,0,0)) {
+		name[FLOG_CONTEXT_NAME_SIZE-1]=0;
+		memcpy(c->name,name,FLOG_CONTEXT_NAME_SIZE);
+	}
+}
+
+
+//! Start an entry, as the next entry if it is stored
+
+//! @param[in] *key key of entry
+//! @return offset of the value in text, 0 if the entry is not stored
+static size_t flog_context_start(FLOG_CONTEXT_T *c,const char *key)
+{
+	size_t start=c->len ? c->len+1U : 0,key_len=strlen(key);
+	c->amount++;
+	//once an entry is left out, the entries above it are too
+	if(c->stored+1U!=c->amount || c->stored>=FLOG_CONTEXT_ENTRIES || start+key_len+1>=sizeof(c->text))
+		return(0);
+	if(start)
+		c->text[start-1]=' ';
+	memcpy(c->text+start,key,key_len);
+	c->text[start+key_len]='=';
+	c->entry[c->stored].start=(uint16_t)start;
+	c->entry[c->stored].key_len=(uint16_t)key_len;
+	return(start+key_len+1);
+}
+
+
+//! Store an entry started by flog_context_start() with a value of len bytes
+static int flog_context_end(FLOG_CONTEXT_T *c,size_t value,size_t len)
+{
+	if(value+len>=sizeof(c->text)) {
+		c->text[c->len]=0;
+		return(-1);
+	}
+	c->len=(uint16_t)(value+len);
+	c->text[c->len]=0;
+	c->stored++;
+	return(0);
+}
+
+
+//! Push an entry to the context of the calling thread
+
+//! Pop it again with flog_context_pop(), also when it did not fit.
+//! @param[in] *key key of entry, without '=' or spaces
+//! @param[in] *value value of entry (NULL for empty)
+//! @retval 0 success
+//! @retval -1 entry did not fit, and is left out
+int flog_context_push(const char *key,const char *value)
+{
+	FLOG_CONTEXT_T *c=flog_context();
+	size_t v,len=value ? strlen(value) : 0;
+	if((v=flog_context_start(c,key))==0)
+		return(-1);
+	if(v+len<sizeof(c->text))
+		memcpy(c->text+v,value,len);
+	return(flog_context_end(c,v,len));
+}
+
+
+//! Push an entry with a formatted value to the context of the calling thread
+
+//! The value is formatted straight into the context.
+//! @see flog_context_push()
+int flog_context_pushf(const char *key,const char *format,...)
+{
+	FLOG_CONTEXT_T *c=flog_context();
+	va_list ap;
+	size_t v;
+	int n;
+	if((v=flog_context_start(c,key))==0)
+		return(-1);
+	va_start(ap,format);
+	n=vsnprintf(c->text+v,sizeof(c->text)-v,format,ap);
+	va_end(ap);
+	return(flog_context_end(c,v,n<0 ? sizeof(c->text) : (size_t)n));
+}
+
+
+//! Pop the last entry pushed to the context of the calling thread
+void flog_context_pop(void)
+{
+	FLOG_CONTEXT_T *c=&flog_context_thread;
+	if(!c->amount)
+		return;
+	if(c->amount--==c->stored) {
+		c->stored--;
+		c->len=c->entry[c->stored].start ? (uint16_t)(c->entry[c->stored].start-1U) : 0;
+		c->text[c->len]=0;
+	}
+}
+
+
+//! do not call directly, pops the entry of flog_context_scope() when its scope is left
+void flog_context_scope_end(int *pushed)
+{
+	(void)pushed;
+	flog_context_pop();
+}
+
+
+//! Name the calling thread in its context
+
+//! Only flog sees the name, the thread name of the system stays as it is.
+//! @param[in] *name name, cut to FLOG_CONTEXT_NAME_SIZE-1 characters
+void flog_context_set_name(const char *name)
+{
+	FLOG_CONTEXT_T *c=flog_context();
+	strncpy(c->name,name ? name : "",sizeof(c->name)-1);
+	c->name[sizeof(c->name)-1]=0;
+}
+
+#endif //FLOG_CONFIG_CONTEXT_SIZE
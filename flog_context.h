@@ -0,0 +1,132 @@
+//! Thread context of messages for Flog
+
+//! @file flog_context.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Instead of putting a request id into the format of every message, push
+//! it to the context of the thread once. Each message points to the
+//! context of the thread emitting it, and outputs asking for it render it
+//! with the %C, %t and %N fields of layouts (see flog_layout.h), others
+//! pay nothing for it:
+//!
+//!     void handle(FLOG_T *log,unsigned long id)
+//!     {
+//!         flog_context_scopef("request","%lu",id);
+//!         flog_print(log,"http",FLOG_INFO,FLOG_MSG_NONE,"started");
+//!         ...
+//!     } //the context entry is popped here
+//!
+//! The context holds the thread id and name, read once per thread, and a
+//! stack of key=value entries kept rendered as "key=value key=value", so
+//! pushing copies the entry into a thread local buffer and popping only
+//! shortens it. Neither allocates. Entries not fitting in
+//! FLOG_CONFIG_CONTEXT_SIZE bytes or FLOG_CONTEXT_ENTRIES entries are left
+//! out until they are popped again.
+//!
+//! Messages kept beyond the call emitting them (buffered, or queued for a
+//! detached log) get a copy of the context as it was (see flog_copy_msg()).
+
+
+#ifndef FLOG_CONTEXT_H
+#define FLOG_CONTEXT_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+
+// Sanity checks
+#if FLOG_CONFIG_CONTEXT_SIZE > UINT16_MAX
+#error FLOG_CONFIG_CONTEXT_SIZE must fit in 16 bits
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+//! Deepest stack of entries kept
+#define FLOG_CONTEXT_ENTRIES 16
+
+//! Size of the thread name, like pthread_setname_np() allows
+#define FLOG_CONTEXT_NAME_SIZE 16
+
+
+//! Context of a thread
+
+//! Copies of messages keep only the first flog_context_size() bytes.
+typedef struct flog_context_t {
+	uint32_t tid;                           //!< thread id (0 until set up by flog_context())
+	uint16_t amount;                        //!< entries pushed
+	uint16_t stored;                        //!< entries in text, the rest did not fit
+	uint16_t len;                           //!< length of text
+	char name[FLOG_CONTEXT_NAME_SIZE];      //!< thread name (empty if unnamed)
+	struct {
+		uint16_t start;                 //!< offset of the key in text
+		uint16_t key_len;               //!< length of the key, the value follows after a '='
+	} entry[FLOG_CONTEXT_ENTRIES];          //!< stored entries
+	char text[FLOG_CONFIG_CONTEXT_SIZE];    //!< stored entries as "key=value key=value", terminated
+} FLOG_CONTEXT_T;
+
+
+//! Context of the calling thread, use flog_context()
+extern __thread FLOG_CONTEXT_T flog_context_thread;
+
+void flog_context_init(FLOG_CONTEXT_T *c);
+
+
+//! Get the context of the calling thread
+static inline FLOG_CONTEXT_T * flog_context(void)
+{
+	if(__builtin_expect(!flog_context_thread.tid,0))
+		flog_context_init(&flog_context_thread);
+	return(&flog_context_thread);
+}
+
+
+//! Bytes of a context used, kept by copies of messages
+static inline size_t flog_context_size(const FLOG_CONTEXT_T *c)
+{
+	return(offsetof(FLOG_CONTEXT_T,text)+c->len+1);
+}
+
+
+//! Get the value of stored entry i of a context
+
+//! @param[out] *len length of value
+//! @return value, not terminated
+static inline const char * flog_context_value(const FLOG_CONTEXT_T *c,unsigned int i,size_t *len)
+{
+	size_t start=c->entry[i].start+c->entry[i].key_len+1U;
+	*len=((i+1U<c->stored) ? c->entry[i+1].start-1U : c->len)-start;
+	return(c->text+start);
+}
+
+
+//! Unique name of the scope variable of a line
+#define FLOG_CONTEXT_VAR_(line) flog_context_scope_##line
+#define FLOG_CONTEXT_VAR(line) FLOG_CONTEXT_VAR_(line)
+
+
+//! Push an entry to the context for the rest of the scope
+
+//! Declares a variable, so use it where a declaration may be.
+//! @param[in] key key of entry
+//! @param[in] value value of entry
+#define flog_context_scope(key, value) \
+	int FLOG_CONTEXT_VAR(__LINE__) __attribute__((cleanup(flog_context_scope_end),unused))=flog_context_push(key,value)
+
+
+//! Push an entry with a formatted value to the context for the rest of the scope
+
+//! @see flog_context_scope()
+#define flog_context_scopef(key, ...) \
+	int FLOG_CONTEXT_VAR(__LINE__) __attribute__((cleanup(flog_context_scope_end),unused))=flog_context_pushf(key,__VA_ARGS__)
+
+
+int flog_context_push(const char *key,const char *value);
+int flog_context_pushf(const char *key,const char *format,...) __attribute__((format(printf,2,3)));
+void flog_context_pop(void);
+void flog_context_scope_end(int *pushed);
+void flog_context_set_name(const char *name);
+
+#endif //FLOG_CONFIG_CONTEXT_SIZE
+
+#endif //FLOG_CONTEXT_H
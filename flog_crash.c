@@ -0,0 +1,140 @@
+//! Crash handling for Flog
+
+//! @file flog_crash.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Flush buffered output when the program dies from a fatal signal.
+//! The handler only calls async-signal-safe functions: it writes a
+//! notice to stderr, calls flog_flush_signal_safe() and then re-raises
+//! the signal with the previous handler restored.
+
+#include "flog_crash.h"
+
+#ifdef FLOG_CONFIG_CRASH_HANDLER
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+
+//! Signals treated as fatal
+static const int flog_crash_signal[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+
+//! Amount of signals in flog_crash_signal
+#define FLOG_CRASH_SIGNAL_AMOUNT (sizeof(flog_crash_signal)/sizeof(flog_crash_signal[0]))
+
+//! Handlers that were installed before flog_crash_install()
+static struct sigaction flog_crash_old_action[FLOG_CRASH_SIGNAL_AMOUNT];
+
+//! Log to flush on crash (NULL when not installed)
+static FLOG_T * volatile flog_crash_log;
+
+//! Set while flushing, so a crash during the flush doesn't flush again
+static volatile sig_atomic_t flog_crash_flushing;
+
+//! Alternate signal stack, so stack overflows can be handled
+static char flog_crash_stack[65536];
+
+
+//! Write the crash notice to stderr (async-signal-safe)
+static void flog_crash_notice(int sig)
+{
+	char str[64]="flog: fatal signal ";
+	char num[12];
+	size_t len=strlen(str);
+	int i=0;
+	do {
+		num[i++]=(char)('0'+sig%10);
+		sig/=10;
+	} while(sig && i<(int)sizeof(num));
+	while(i)
+		str[len++]=num[--i];
+	memcpy(str+len,", flushing logs\n",16);
+	len+=16;
+	if(write(STDERR_FILENO,str,len)) {} //nothing to do on error
+}
+
+
+//! Signal handler for fatal signals
+static void flog_crash_handler(int sig)
+{
+	unsigned int i;
+	if(!flog_crash_flushing && flog_crash_log) {
+		flog_crash_flushing=1;
+		flog_crash_notice(sig);
+		flog_flush_signal_safe(flog_crash_log);
+	}
+	//restore the previous handler and let it (or the default action) take over
+	for(i=0;i<FLOG_CRASH_SIGNAL_AMOUNT;i++) {
+		if(flog_crash_signal[i]==sig) {
+			sigaction(sig,&flog_crash_old_action[i],NULL);
+			break;
+		}
+	}
+	raise(sig);
+}
+
+
+//! Install handlers for fatal signals which flush a log tree
+
+//! Handles SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT. Only one log tree
+//! can be installed at a time, installing again replaces the log.
+//! The alternate signal stack is only set for the calling thread.
+//! @param[in] *p log to flush on crash (normally the root of the log tree)
+//! @retval 0 success
+//! @retval 1 error
+int flog_crash_install(FLOG_T *p)
+{
+	struct sigaction sa;
+	stack_t ss;
+	unsigned int i;
+	if(!p)
+		return(1);
+	if(flog_crash_log) {
+		flog_crash_log=p;
+		return(0);
+	}
+	ss.ss_sp=flog_crash_stack;
+	ss.ss_size=sizeof(flog_crash_stack);
+	ss.ss_flags=0;
+	sigaltstack(&ss,NULL); //not fatal if it fails, only stack overflows can't be handled
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler=flog_crash_handler;
+	sa.sa_flags=SA_ONSTACK;
+	sigemptyset(&sa.sa_mask);
+	flog_crash_log=p;
+	for(i=0;i<FLOG_CRASH_SIGNAL_AMOUNT;i++) {
+		if(sigaction(flog_crash_signal[i],&sa,&flog_crash_old_action[i])) {
+			while(i--)
+				sigaction(flog_crash_signal[i],&flog_crash_old_action[i],NULL);
+			flog_crash_log=NULL;
+			return(1);
+		}
+	}
+	return(0);
+}
+
+
+//! Restore the signal handlers that were installed before flog_crash_install()
+void flog_crash_uninstall(void)
+{
+	unsigned int i;
+	if(!flog_crash_log)
+		return;
+	for(i=0;i<FLOG_CRASH_SIGNAL_AMOUNT;i++)
+		sigaction(flog_crash_signal[i],&flog_crash_old_action[i],NULL);
+	flog_crash_log=NULL;
+}
+
+
+//! Flush the installed log tree (async-signal-safe)
+
+//! For use by programs with their own fatal signal handlers
+//! @retval 0 success
+//! @return amount of logs that failed to flush
+int flog_crash_flush(void)
+{
+	return(flog_flush_signal_safe(flog_crash_log));
+}
+
+#endif //FLOG_CONFIG_CRASH_HANDLER
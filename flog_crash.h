@@ -0,0 +1,22 @@
+//! Crash handling for Flog
+
+//! @file flog_crash.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Flush buffered output when the program dies from a fatal signal
+
+
+#ifndef FLOG_CRASH_H
+#define FLOG_CRASH_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_CRASH_HANDLER
+
+int flog_crash_install(FLOG_T *p);
+void flog_crash_uninstall(void);
+int flog_crash_flush(void);
+
+#endif //FLOG_CONFIG_CRASH_HANDLER
+
+#endif //FLOG_CRASH_H
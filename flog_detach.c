@@ -0,0 +1,230 @@
+//! Detached logs for Flog
+
+//! @file flog_detach.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! The caller only copies the message and takes the queue lock for a
+//! moment. The worker outputs one message at a time without holding the
+//! lock, and runs flushes between messages. A flush runs as soon as the
+//! messages queued before it was asked for are output, so it covers them
+//! without waiting for the queue to run empty.
+
+#include "flog_detach.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_DETACH
+
+#include "flog_stats.h"
+#include <stdlib.h>
+#include <errno.h>
+
+
+//! Queue of the worker running in this thread (NULL if not a worker)
+static __thread FLOG_DETACH_T *flog_detach_current;
+
+
+//! worker thread of a detached log
+static void * flog_detach_worker(void *arg)
+{
+	FLOG_DETACH_T *d=arg;
+	FLOG_MSG_T *copy,msg;
+	uint64_t done=0,flush_at=0; //messages output, and queued when the pending flush was picked up
+	unsigned int req=0;
+	int flushing=0,e;
+	flog_detach_current=d;
+	pthread_mutex_lock(&d->lock);
+	for(;;) {
+		if(!flushing && d->flush_done!=d->flush_req) {
+			//covers every flush asked for so far, and what was queued before them
+			req=d->flush_req;
+			flush_at=d->queued;
+			flushing=1;
+		}
+		if(flushing && done>=flush_at) {
+			pthread_mutex_unlock(&d->lock);
+			e=flog_flush(d->log);
+			pthread_mutex_lock(&d->lock);
+			d->flush_result=e;
+			d->flush_done=req;
+			flushing=0;
+			pthread_cond_broadcast(&d->flushed);
+		} else if(d->depth) {
+			copy=d->queue[d->head];
+			d->head=(d->head+1)%d->size;
+			d->depth--;
+			pthread_cond_signal(&d->space);
+			pthread_mutex_unlock(&d->lock);
+			//route a copy, as routing changes the subsystem
+			msg=*copy;
+#ifdef FLOG_CONFIG_RENDER_CACHE_SIZE
+			FLOG_RENDER_CACHE_T render;
+			flog_render_cache_init(&render);
+			msg.render=&render;
+#endif
+			flog_route_msg(d->log,&msg);
+			destroy_flog_msg_t(copy);
+			done++;
+			pthread_mutex_lock(&d->lock);
+		} else if(d->stop) {
+			break;
+		} else
+			pthread_cond_wait(&d->work,&d->lock);
+	}
+	pthread_mutex_unlock(&d->lock);
+	return(NULL);
+}
+
+
+//! detach a log, giving it its own queue and worker thread
+
+//! @param[in,out] *p log to detach
+//! @param[in] queue_size most messages waiting for the worker, 0 for FLOG_DETACH_QUEUE_SIZE
+//! @param[in] flags FLOG_DETACH_BLOCK to wait when the queue is full (default is to drop)
+//! @retval 0 success
+//! @return errno on error
+int flog_detach(FLOG_T *p, uint32_t queue_size, uint_fast8_t flags)
+{
+	FLOG_DETACH_T *d;
+	int e;
+	if(p==NULL || p->detach)
+		return(EINVAL);
+	if((d=flog_calloc(1,sizeof(FLOG_DETACH_T)))==NULL)
+		return(errno);
+	d->log=p;
+	d->size=queue_size ? queue_size : FLOG_DETACH_QUEUE_SIZE;
+	d->flags=flags;
+	if((d->queue=flog_malloc(d->size*sizeof(FLOG_MSG_T *)))==NULL) {
+		e=errno;
+		flog_free(d);
+		return(e);
+	}
+	pthread_mutex_init(&d->lock,NULL);
+	pthread_cond_init(&d->work,NULL);
+	pthread_cond_init(&d->space,NULL);
+	pthread_cond_init(&d->flushed,NULL);
+	if((e=pthread_create(&d->thread,NULL,flog_detach_worker,d))) {
+		pthread_cond_destroy(&d->flushed);
+		pthread_cond_destroy(&d->space);
+		pthread_cond_destroy(&d->work);
+		pthread_mutex_destroy(&d->lock);
+		flog_free(d->queue);
+		flog_free(d);
+		return(e);
+	}
+	__atomic_store_n(&p->detach,d,__ATOMIC_RELEASE);
+	return(0);
+}
+
+
+//! stop the worker of a detached log, after it has output every queued message
+
+//! Messages are then handled by the caller again. No messages may reach
+//! the log while it is attached. Destroying a log attaches it.
+void flog_attach(FLOG_T *p)
+{
+	FLOG_DETACH_T *d;
+	if(p==NULL || (d=p->detach)==NULL)
+		return;
+	pthread_mutex_lock(&d->lock);
+	d->stop=1;
+	pthread_cond_signal(&d->work);
+	pthread_mutex_unlock(&d->lock);
+	pthread_join(d->thread,NULL);
+	__atomic_store_n(&p->detach,NULL,__ATOMIC_RELEASE);
+	pthread_cond_destroy(&d->flushed);
+	pthread_cond_destroy(&d->space);
+	pthread_cond_destroy(&d->work);
+	pthread_mutex_destroy(&d->lock);
+	flog_free(d->queue);
+	flog_free(d);
+}
+
+
+//! queue a message for the worker of a detached log
+
+//! internal use only, called by flog_add_msg() once the message is accepted
+//! @retval 0 success
+//! @retval 1 message dropped
+int flog_detach_msg(FLOG_T *p, const FLOG_MSG_T *msg)
+{
+	FLOG_DETACH_T *d=p->detach;
+	FLOG_MSG_T *copy;
+	if((copy=flog_copy_msg(msg))==NULL)
+		goto dropped;
+	pthread_mutex_lock(&d->lock);
+	if(d->depth==d->size) {
+		if(!(d->flags & FLOG_DETACH_BLOCK) || flog_detach_current==d) {
+			pthread_mutex_unlock(&d->lock);
+			destroy_flog_msg_t(copy);
+			goto dropped;
+		}
+		while(d->depth==d->size)
+			pthread_cond_wait(&d->space,&d->lock);
+	}
+	d->queue[(d->head+d->depth)%d->size]=copy;
+	if(++d->depth>d->depth_max)
+		d->depth_max=d->depth;
+	d->queued++;
+	pthread_cond_signal(&d->work);
+	pthread_mutex_unlock(&d->lock);
+	return(0);
+dropped:
+	__atomic_fetch_add(&d->dropped,1,__ATOMIC_RELAXED);
+	flog_stats_count(p,dropped,flog_msg_type_index(msg->type));
+	return(1);
+}
+
+
+//! flush a detached log
+
+//! internal use only, called by flog_flush(). Waits until the worker has
+//! output every message queued so far and flushed the log.
+//! @return result of flog_flush() in the worker
+int flog_detach_flush(FLOG_T *p)
+{
+	FLOG_DETACH_T *d=p->detach;
+	unsigned int req;
+	int e;
+	pthread_mutex_lock(&d->lock);
+	req=++d->flush_req;
+	pthread_cond_signal(&d->work);
+	while((int)(d->flush_done-req)<0)
+		pthread_cond_wait(&d->flushed,&d->lock);
+	e=d->flush_result;
+	pthread_mutex_unlock(&d->lock);
+	return(e);
+}
+
+
+//! check if called by the worker of a detached log
+
+//! @retval 1 called by the worker of p
+//! @retval 0 called by any other thread
+int flog_detach_in_worker(const FLOG_T *p)
+{
+	return(p->detach!=NULL && flog_detach_current==p->detach);
+}
+
+
+//! get the queue statistics of a detached log
+
+//! @param[in] *p log
+//! @param[out] *stats queue statistics
+//! @retval 0 success
+//! @retval 1 log is not detached
+int flog_get_detach_stats(FLOG_T *p, FLOG_DETACH_STATS_T *stats)
+{
+	FLOG_DETACH_T *d;
+	if(p==NULL || (d=__atomic_load_n(&p->detach,__ATOMIC_ACQUIRE))==NULL)
+		return(1);
+	pthread_mutex_lock(&d->lock);
+	stats->size=d->size;
+	stats->depth=d->depth;
+	stats->depth_max=d->depth_max;
+	stats->queued=d->queued;
+	stats->dropped=__atomic_load_n(&d->dropped,__ATOMIC_RELAXED);
+	pthread_mutex_unlock(&d->lock);
+	return(0);
+}
+
+#endif //FLOG_CONFIG_DETACH
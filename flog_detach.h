@@ -0,0 +1,79 @@
+//! Detached logs for Flog
+
+//! @file flog_detach.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! A detached log has its own queue and worker thread. Messages reaching
+//! it are copied into the queue, and the worker outputs them and passes
+//! them on to its sublogs. A slow output then only delays itself, not
+//! the caller or the other outputs of the tree.
+//!
+//! The output, message buffer and sublogs of a detached log are used by
+//! its worker thread, so they must not be shared with other threads.
+//! Messages keep their text but lose the arguments of flog_printf(), as
+//! they are copied. Flushing a detached log waits until the worker has
+//! written every message queued before it. flog_flush_signal_safe() can
+//! not wait, and flushes the outputs directly; queued messages are lost
+//! in a crash.
+
+
+#ifndef FLOG_DETACH_H
+#define FLOG_DETACH_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_DETACH
+
+#include <stdint.h>
+#include <pthread.h>
+
+//! Wait for room when the queue is full, instead of dropping the message
+#define FLOG_DETACH_BLOCK 0x01
+
+//! Queue size used when 0 is given
+#define FLOG_DETACH_QUEUE_SIZE 1024
+
+
+//! Queue and worker of a detached log - stored in log.detach
+typedef struct flog_detach_t {
+	FLOG_T *log;                            //!< detached log
+	FLOG_MSG_T **queue;                     //!< ring of copied messages
+	uint32_t size;                          //!< size of queue
+	uint32_t head;                          //!< oldest message in queue
+	uint32_t depth;                         //!< messages in queue
+	uint32_t depth_max;                     //!< most messages in queue so far
+	uint_fast8_t flags;                     //!< FLOG_DETACH_* options
+	uint64_t queued;                        //!< messages queued
+	uint64_t dropped;                       //!< messages dropped as the queue was full
+	unsigned int flush_req;                 //!< flushes requested
+	unsigned int flush_done;                //!< flushes done by the worker
+	int flush_result;                       //!< result of the last flush
+	int stop;                               //!< tells the worker to exit when the queue is empty
+	pthread_t thread;                       //!< worker thread
+	pthread_mutex_t lock;                   //!< protects everything above
+	pthread_cond_t work;                    //!< signalled when there is something for the worker
+	pthread_cond_t space;                   //!< signalled when a message leaves the queue
+	pthread_cond_t flushed;                 //!< signalled when a flush is done
+} FLOG_DETACH_T;
+
+
+//! Queue statistics of a detached log
+typedef struct {
+	uint32_t size;                          //!< size of queue
+	uint32_t depth;                         //!< messages in queue
+	uint32_t depth_max;                     //!< most messages in queue so far
+	uint64_t queued;                        //!< messages queued
+	uint64_t dropped;                       //!< messages dropped as the queue was full
+} FLOG_DETACH_STATS_T;
+
+
+int flog_detach(FLOG_T *p, uint32_t queue_size, uint_fast8_t flags);
+void flog_attach(FLOG_T *p);
+int flog_detach_msg(FLOG_T *p, const FLOG_MSG_T *msg);
+int flog_detach_flush(FLOG_T *p);
+int flog_detach_in_worker(const FLOG_T *p);
+int flog_get_detach_stats(FLOG_T *p, FLOG_DETACH_STATS_T *stats);
+
+#endif //FLOG_CONFIG_DETACH
+
+#endif //FLOG_DETACH_H
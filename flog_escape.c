@@ -0,0 +1,184 @@
+//! Escaping of message text for Flog
+
+//! @file flog_escape.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! The vector scans compare a whole block against the characters needing
+//! escape and find the first hit from the resulting bit mask. Bytes below
+//! 0x20 are found with an unsigned minimum: min(x,0x1f)==x. AVX2 is
+//! chosen at run time, so the library can be built for any x86 CPU.
+
+#include "flog_escape.h"
+
+#ifdef FLOG_CONFIG_ESCAPE
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define FLOG_ESCAPE_SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLOG_ESCAPE_AVX2
+#endif
+#endif
+
+
+//! Check if a byte needs escaping
+#define flog_escape_needed(c, mode) ((unsigned char)(c)<0x20 || (c)=='\\' || ((c)=='"' && (mode)==FLOG_ESCAPE_JSON))
+
+
+//! Get the length of text before the first byte needing escape, one byte at a time
+
+//! @param[in] *s text
+//! @param[in] len length of text
+//! @param[in] mode FLOG_ESCAPE_TEXT or FLOG_ESCAPE_JSON
+//! @return length of the clean run (len if nothing needs escaping)
+size_t flog_escape_span_scalar(const char *s, size_t len, uint_fast8_t mode)
+{
+	size_t i;
+	for(i=0;i<len;i++) {
+		if(flog_escape_needed(s[i],mode))
+			break;
+	}
+	return(i);
+}
+
+
+#ifdef FLOG_ESCAPE_SSE2
+//! flog_escape_span() 16 bytes at a time
+static size_t flog_escape_span_sse2(const char *s, size_t len, uint_fast8_t mode)
+{
+	const __m128i ctrl=_mm_set1_epi8(0x1f);
+	const __m128i backslash=_mm_set1_epi8('\\');
+	const __m128i quote=_mm_set1_epi8(mode==FLOG_ESCAPE_JSON ? '"' : '\\');
+	unsigned int bits;
+	size_t i;
+	for(i=0;i+16<=len;i+=16) {
+		__m128i x=_mm_loadu_si128((const __m128i *)(s+i));
+		__m128i m=_mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(x,ctrl),x),
+		                       _mm_or_si128(_mm_cmpeq_epi8(x,backslash),_mm_cmpeq_epi8(x,quote)));
+		if((bits=(unsigned int)_mm_movemask_epi8(m)))
+			return(i+(size_t)__builtin_ctz(bits));
+	}
+	return(i+flog_escape_span_scalar(s+i,len-i,mode));
+}
+#endif //FLOG_ESCAPE_SSE2
+
+
+#ifdef FLOG_ESCAPE_AVX2
+//! flog_escape_span() 32 bytes at a time
+__attribute__((target("avx2")))
+static size_t flog_escape_span_avx2(const char *s, size_t len, uint_fast8_t mode)
+{
+	const __m256i ctrl=_mm256_set1_epi8(0x1f);
+	const __m256i backslash=_mm256_set1_epi8('\\');
+	const __m256i quote=_mm256_set1_epi8(mode==FLOG_ESCAPE_JSON ? '"' : '\\');
+	unsigned int bits;
+	size_t i;
+	for(i=0;i+32<=len;i+=32) {
+		__m256i x=_mm256_loadu_si256((const __m256i *)(s+i));
+		__m256i m=_mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(x,ctrl),x),
+		                          _mm256_or_si256(_mm256_cmpeq_epi8(x,backslash),_mm256_cmpeq_epi8(x,quote)));
+		if((bits=(unsigned int)_mm256_movemask_epi8(m)))
+			return(i+(size_t)__builtin_ctz(bits));
+	}
+	_mm256_zeroupper(); //avoid the AVX to SSE transition penalty in the tail
+	return(i+flog_escape_span_sse2(s+i,len-i,mode));
+}
+#endif //FLOG_ESCAPE_AVX2
+
+
+//! Scan function chosen for this CPU, NULL until first use
+static size_t (*flog_escape_span_func)(const char *, size_t, uint_fast8_t);
+
+
+//! Get the length of text before the first byte needing escape
+
+//! Uses the fastest scan this CPU supports.
+//! @param[in] *s text
+//! @param[in] len length of text
+//! @param[in] mode FLOG_ESCAPE_TEXT or FLOG_ESCAPE_JSON
+//! @return length of the clean run (len if nothing needs escaping)
+size_t flog_escape_span(const char *s, size_t len, uint_fast8_t mode)
+{
+	size_t (*f)(const char *, size_t, uint_fast8_t)=__atomic_load_n(&flog_escape_span_func,__ATOMIC_RELAXED);
+	if(f==NULL) {
+		f=flog_escape_span_scalar;
+#ifdef FLOG_ESCAPE_SSE2
+		f=flog_escape_span_sse2;
+#endif
+#ifdef FLOG_ESCAPE_AVX2
+		if(__builtin_cpu_supports("avx2"))
+			f=flog_escape_span_avx2;
+#endif
+		__atomic_store_n(&flog_escape_span_func,f,__ATOMIC_RELAXED);
+	}
+	return(f(s,len,mode));
+}
+
+
+//! Write the escape sequence of one byte
+
+//! @return length of sequence (at most 6)
+static size_t flog_escape_char(char *e, unsigned char c, uint_fast8_t mode)
+{
+	static const char hex[]="0123456789abcdef";
+	e[0]='\\';
+	switch(c) {
+	case '\n': e[1]='n'; return(2);
+	case '\r': e[1]='r'; return(2);
+	case '\t': e[1]='t'; return(2);
+	case '\\':
+	case '"': e[1]=(char)c; return(2);
+	}
+	if(mode==FLOG_ESCAPE_JSON) {
+		memcpy(e+1,"u00",3);
+		e[4]=hex[c>>4];
+		e[5]=hex[c&15];
+		return(6);
+	}
+	e[1]='x';
+	e[2]=hex[c>>4];
+	e[3]=hex[c&15];
+	return(4);
+}
+
+
+//! Append to an escape buffer, as much as fits
+static inline void flog_escape_put(char *buf, size_t size, size_t *n, const char *s, size_t len)
+{
+	if(*n<size)
+		memcpy(buf+*n,s,(len<size-*n) ? len : size-*n);
+	*n+=len;
+}
+
+
+//! Escape text
+
+//! Like snprintf(), the buffer is only written up to size and always
+//! terminated, but the full length is returned.
+//! @param[out] *buf buffer for escaped text
+//! @param[in] size size of buf
+//! @param[in] *s text
+//! @param[in] len length of text
+//! @param[in] mode FLOG_ESCAPE_TEXT or FLOG_ESCAPE_JSON
+//! @return length of escaped text
+size_t flog_escape(char *buf, size_t size, const char *s, size_t len, uint_fast8_t mode)
+{
+	size_t n=0,run;
+	char e[8];
+	for(;;) {
+		run=flog_escape_span(s,len,mode);
+		flog_escape_put(buf,size,&n,s,run);
+		if(run==len)
+			break;
+		flog_escape_put(buf,size,&n,e,flog_escape_char(e,(unsigned char)s[run],mode));
+		s+=run+1;
+		len-=run+1;
+	}
+	if(size)
+		buf[(n<size) ? n : size-1]=0;
+	return(n);
+}
+
+#endif //FLOG_CONFIG_ESCAPE
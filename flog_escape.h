@@ -0,0 +1,38 @@
+//! Escaping of message text for Flog
+
+//! @file flog_escape.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Keeps every message on one line for line oriented log readers, and
+//! makes text safe inside JSON strings. Text is scanned 16 or 32 bytes at
+//! a time with SSE2 or AVX2 where available, and clean runs are copied
+//! whole, so the usual message without special characters costs little
+//! more than a memcpy().
+//!
+//! FLOG_ESCAPE_TEXT escapes control characters as \n, \r, \t or \xNN and
+//! '\' as "\\". FLOG_ESCAPE_JSON also escapes '"', and uses \u00NN.
+
+
+#ifndef FLOG_ESCAPE_H
+#define FLOG_ESCAPE_H
+
+#include "config.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef FLOG_CONFIG_ESCAPE
+
+//! Escape control characters and '\'
+#define FLOG_ESCAPE_TEXT 0
+
+//! Escape for the inside of a JSON string
+#define FLOG_ESCAPE_JSON 1
+
+
+size_t flog_escape_span(const char *s, size_t len, uint_fast8_t mode);
+size_t flog_escape_span_scalar(const char *s, size_t len, uint_fast8_t mode);
+size_t flog_escape(char *buf, size_t size, const char *s, size_t len, uint_fast8_t mode);
+
+#endif //FLOG_CONFIG_ESCAPE
+
+#endif //FLOG_ESCAPE_H
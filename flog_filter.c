@@ -0,0 +1,240 @@
+//! Subsystem filters for Flog
+
+//! @file flog_filter.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Rules are compiled into a hashed prefix table: a subsystem path is
+//! hashed once, and at every '/' the hash of the prefix so far is looked
+//! up. The result for each interned subsystem is cached in the filter,
+//! so in the steady state filtering a message costs one array lookup.
+//! Filters are never changed after compilation, reloading swaps in a
+//! new filter atomically so producers are never locked.
+
+#include "flog_filter.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_FILTER
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+
+//! FNV-1a start value
+#define FLOG_FILTER_HASH_INIT 2166136261u
+
+//! FNV-1a step
+#define flog_filter_hash_step(h, c) (((h)^(unsigned char)(c))*16777619u)
+
+
+//! Combine the operation of a rule applied after another
+static void flog_filter_compose(uint8_t *clear,uint8_t *set,uint8_t next_clear,uint8_t next_set)
+{
+	*set=(uint8_t)((*set & ~next_clear) | next_set);
+	*clear|=next_clear;
+}
+
+
+//! Find a rule in the rule table
+static FLOG_FILTER_RULE_T * flog_filter_find(const FLOG_FILTER_T *f,const char *path,size_t len,uint32_t hash,uint_fast8_t prefix)
+{
+	unsigned int i;
+	for(i=hash&(f->rule_slots-1);f->rule[i].pattern;i=(i+1)&(f->rule_slots-1)) {
+		FLOG_FILTER_RULE_T *r=&f->rule[i];
+		if(r->hash==hash && r->len==len && r->prefix==prefix && !memcmp(r->pattern,path,len))
+			return(r);
+	}
+	return(NULL);
+}
+
+
+//! Add one rule to a filter being compiled
+
+//! @retval 0 success
+static int flog_filter_add_rule(FLOG_FILTER_T *f,const char *str,size_t len)
+{
+	const char *colon,*action;
+	size_t pattern_len,action_len;
+	FLOG_MSG_TYPE_T clear,set;
+	uint_fast8_t prefix=0;
+	uint32_t hash=FLOG_FILTER_HASH_INIT;
+	size_t i;
+	FLOG_FILTER_RULE_T *r;
+
+	//split at the last ':'
+	for(colon=str+len;colon>str && colon[-1]!=':';colon--);
+	if(colon==str)
+		return(1);
+	action=colon;
+	action_len=len-(size_t)(colon-str);
+	for(;action_len && isspace((unsigned char)*action);action++,action_len--);
+	for(;action_len && isspace((unsigned char)action[action_len-1]);action_len--);
+	if(flog_parse_msg_type_action(action,action_len,&clear,&set))
+		return(1);
+	for(pattern_len=(size_t)(colon-str)-1;pattern_len && isspace((unsigned char)str[pattern_len-1]);pattern_len--);
+	f->enable_mask|=set;
+
+	if(pattern_len==1 && str[0]=='*') {
+		flog_filter_compose(&f->global_clear,&f->global_set,clear,set);
+		return(0);
+	}
+	if(pattern_len>=2 && str[pattern_len-1]=='*' && str[pattern_len-2]=='/') {
+		prefix=1;
+		pattern_len-=2;
+	}
+	if(!pattern_len || memchr(str,'*',pattern_len))
+		return(1);
+	for(i=0;i<pattern_len;i++)
+		hash=flog_filter_hash_step(hash,str[i]);
+	if((r=flog_filter_find(f,str,pattern_len,hash,prefix))) {
+		flog_filter_compose(&r->clear,&r->set,clear,set);
+		return(0);
+	}
+	for(i=hash&(f->rule_slots-1);f->rule[i].pattern;i=(i+1)&(f->rule_slots-1));
+	r=&f->rule[i];
+	if((r->pattern=flog_malloc(pattern_len+1))==NULL)
+		return(1);
+	memcpy(r->pattern,str,pattern_len);
+	r->pattern[pattern_len]=0;
+	r->len=pattern_len;
+	r->hash=hash;
+	r->prefix=prefix;
+	r->clear=clear;
+	r->set=set;
+	return(0);
+}
+
+
+//! Compile filter rules
+
+//! @param[in] *rules rules, see flog_filter.h
+//! @retval NULL error (out of memory or syntax error)
+FLOG_FILTER_T * create_flog_filter(const char *rules)
+{
+	FLOG_FILTER_T *f;
+	const char *s,*end;
+	unsigned int n=1;
+	if(!rules)
+		return(NULL);
+	for(s=rules;*s;s++) {
+		if(*s==',' || *s==';' || *s=='\n')
+			n++;
+	}
+	if((f=flog_calloc(1,sizeof(FLOG_FILTER_T)))==NULL)
+		return(NULL);
+	//keep the rule table at most half full
+	for(f->rule_slots=4;f->rule_slots<2*n;f->rule_slots<<=1);
+	if((f->rule=flog_calloc(f->rule_slots,sizeof(FLOG_FILTER_RULE_T)))==NULL) {
+		flog_free(f);
+		return(NULL);
+	}
+	for(s=rules;*s;s=*end ? end+1 : end) {
+		for(end=s;*end && *end!=',' && *end!=';' && *end!='\n';end++);
+		for(;s<end && isspace((unsigned char)*s);s++);
+		if(s==end)
+			continue; //empty rule
+		if(flog_filter_add_rule(f,s,(size_t)(end-s))) {
+			destroy_flog_filter(f);
+			return(NULL);
+		}
+	}
+	return(f);
+}
+
+
+//! Free a compiled filter (but not the filters it retired)
+void destroy_flog_filter(FLOG_FILTER_T *f)
+{
+	unsigned int i;
+	if(f) {
+		for(i=0;i<f->rule_slots;i++)
+			flog_free(f->rule[i].pattern);
+		flog_free(f->rule);
+		flog_free(f);
+	}
+}
+
+
+//! Set or replace the filter rules of a log
+
+//! Messages being emitted concurrently keep using the old filter, which
+//! is kept until flog_free_retired_filters() or destroy_flog_t().
+//! Calls to flog_set_filter() for the same log must not run concurrently.
+//! @param[in,out] *p log
+//! @param[in] *rules rules (see flog_filter.h), NULL or "" to remove the filter
+//! @retval 0 success
+//! @retval 1 error, the old filter is kept
+int flog_set_filter(FLOG_T *p,const char *rules)
+{
+	FLOG_FILTER_T *f=NULL,*old;
+	if(!p)
+		return(1);
+	if(rules && rules[0]) {
+		if((f=create_flog_filter(rules))==NULL)
+			return(1);
+	}
+	if((old=__atomic_exchange_n(&p->filter,f,__ATOMIC_ACQ_REL))) {
+		old->retired=p->filter_retired;
+		p->filter_retired=old;
+	}
+	return(0);
+}
+
+
+//! Free the filters replaced by flog_set_filter()
+
+//! Only call when no messages are being emitted to the log
+void flog_free_retired_filters(FLOG_T *p)
+{
+	FLOG_FILTER_T *f;
+	while((f=p->filter_retired)) {
+		p->filter_retired=f->retired;
+		destroy_flog_filter(f);
+	}
+}
+
+
+//! Look up the combined rules matching a subsystem path
+static void flog_filter_lookup(const FLOG_FILTER_T *f,const char *path,size_t len,uint8_t *clear,uint8_t *set)
+{
+	const FLOG_FILTER_RULE_T *r;
+	uint32_t hash=FLOG_FILTER_HASH_INIT;
+	size_t i;
+	*clear=f->global_clear;
+	*set=f->global_set;
+	for(i=0;i<len;i++) {
+		if(path[i]=='/' && (r=flog_filter_find(f,path,i,hash,1)))
+			flog_filter_compose(clear,set,r->clear,r->set);
+		hash=flog_filter_hash_step(hash,path[i]);
+	}
+	if(!len)
+		return;
+	if((r=flog_filter_find(f,path,len,hash,1)))
+		flog_filter_compose(clear,set,r->clear,r->set);
+	if((r=flog_filter_find(f,path,len,hash,0)))
+		flog_filter_compose(clear,set,r->clear,r->set);
+}
+
+
+//! Apply a filter to the accepted message types of a log (thread safe)
+
+//! @param[in,out] *f filter
+//! @param[in,out] *msg message (its subsystem is interned if it isn't already)
+//! @param[in] mask accepted message types of the log
+//! @return message types accepted for the subsystem of msg
+FLOG_MSG_TYPE_T flog_filter_mask(FLOG_FILTER_T *f,FLOG_MSG_T *msg,FLOG_MSG_TYPE_T mask)
+{
+	FLOG_INTERN_ID_T id=0;
+	uint32_t c;
+	uint8_t clear,set;
+	if(msg->subsystem && (id=flog_msg_subsystem_id(msg))) {
+		if((c=__atomic_load_n(&f->cache[id-1],__ATOMIC_RELAXED)))
+			return((FLOG_MSG_TYPE_T)((mask & ~((c>>8)&0xff)) | (c&0xff)));
+	}
+	flog_filter_lookup(f,msg->subsystem,msg->subsystem ? strlen(msg->subsystem) : 0,&clear,&set);
+	if(id)
+		__atomic_store_n(&f->cache[id-1],0x10000u|((uint32_t)clear<<8)|set,__ATOMIC_RELAXED);
+	return((FLOG_MSG_TYPE_T)((mask & ~clear) | set));
+}
+
+#endif //FLOG_CONFIG_FILTER
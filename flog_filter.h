@@ -0,0 +1,65 @@
+//! Subsystem filters for Flog
+
+//! @file flog_filter.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Rule based filtering of messages by subsystem path, so single
+//! subsystems can be muted or made verbose without changing the log tree.
+//!
+//! Rules are separated by ',', ';' or newlines, each rule is "pattern:action".
+//! Patterns are a subsystem path ("db/query"), a path prefix ("net/*"
+//! matches "net" and everything below it) or "*" for all subsystems.
+//! Actions are "LEVEL+" (that level and everything more severe), "LEVEL"
+//! (only that level), "LEVEL on", "LEVEL off", "all" or "off".
+//! Levels are CRIT, ERR, WARN, NOTE, INFO, VINFO, DEBUG and DEEP_DEBUG.
+//! Less specific rules are applied first, so "net/*:off,net/dns:WARN+"
+//! mutes the net subsystem except for warnings and errors from net/dns.
+//!
+//! Example: flog_set_filter(log,"net/*:DEBUG off, db/query:INFO+");
+
+
+#ifndef FLOG_FILTER_H
+#define FLOG_FILTER_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_FILTER
+
+// Sanity checks
+#ifndef FLOG_CONFIG_INTERN_TABLE_SIZE
+#error FLOG_CONFIG_FILTER requires FLOG_CONFIG_INTERN_TABLE_SIZE
+#endif
+
+
+//! Compiled filter rule - one per pattern
+typedef struct {
+	char *pattern;                          //!< subsystem path or prefix (NULL for an unused slot)
+	size_t len;                             //!< length of pattern
+	uint32_t hash;                          //!< hash of pattern
+	uint_fast8_t prefix;                    //!< rule also matches paths below pattern
+	uint8_t clear;                          //!< message types to remove from the mask
+	uint8_t set;                            //!< message types to add to the mask
+} FLOG_FILTER_RULE_T;
+
+
+//! Compiled filter - attached to a log with flog_set_filter()
+typedef struct flog_filter_t {
+	FLOG_FILTER_RULE_T *rule;               //!< hash table of rules
+	unsigned int rule_slots;                //!< size of rule table (power of two)
+	uint8_t global_clear;                   //!< types removed by "*" rules
+	uint8_t global_set;                     //!< types added by "*" rules
+	FLOG_MSG_TYPE_T enable_mask;            //!< all types any rule can add
+	uint32_t cache[FLOG_CONFIG_INTERN_TABLE_SIZE]; //!< result per interned subsystem (0 = not cached yet)
+	struct flog_filter_t *retired;          //!< filters replaced by this one, freed later
+} FLOG_FILTER_T;
+
+
+FLOG_FILTER_T * create_flog_filter(const char *rules);
+void destroy_flog_filter(FLOG_FILTER_T *f);
+int flog_set_filter(FLOG_T *p,const char *rules);
+void flog_free_retired_filters(FLOG_T *p);
+FLOG_MSG_TYPE_T flog_filter_mask(FLOG_FILTER_T *f,FLOG_MSG_T *msg,FLOG_MSG_TYPE_T mask);
+
+#endif //FLOG_CONFIG_FILTER
+
+#endif //FLOG_FILTER_H
@@ -0,0 +1,281 @@
+//! Adaptive load shedding for Flog
+
+//! @file flog_governor.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Each message taken by a governed log costs two clock reads to time it.
+//! The backpressure is looked at by one thread at a time, once per
+//! FLOG_GOVERNOR_INTERVAL_MS, by the thread of a message taken or of every
+//! FLOG_GOVERNOR_TICK_SHED-th message shed, so a log only shedding still
+//! restores its levels.
+
+#include "flog_governor.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_GOVERNOR
+
+#include "flog_histogram.h"
+#ifdef FLOG_CONFIG_DETACH
+#include "flog_detach.h"
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <inttypes.h>
+
+
+//! Message types shed at each level
+static const FLOG_MSG_TYPE_T flog_governor_level_type[FLOG_GOVERNOR_LEVEL_MAX+1] = {
+	FLOG_NONE,
+	FLOG_DEEP_DEBUG | FLOG_DEBUG,
+	FLOG_DEEP_DEBUG | FLOG_DEBUG | FLOG_VINFO,
+	FLOG_DEEP_DEBUG | FLOG_DEBUG | FLOG_VINFO | FLOG_INFO,
+	FLOG_DEEP_DEBUG | FLOG_DEBUG | FLOG_VINFO | FLOG_INFO | FLOG_NOTE
+};
+
+//! Most severe message type shed at each level, as reported
+static const char *const flog_governor_level_name[FLOG_GOVERNOR_LEVEL_MAX+1] = {
+	"nothing","DEBUG","VINFO","INFO","NOTE"
+};
+
+//! Names of message types by flog_msg_type_index(), as reported
+static const char *const flog_governor_type_name[FLOG_MSG_TYPE_AMOUNT] = {
+	"CRIT","ERR","WARN","NOTE","INFO","VINFO","DEBUG","DEEP_DEBUG"
+};
+
+
+//! Set up a load shedding governor of a log
+
+//! The governor is created on first use and freed by destroy_flog_t().
+//! Set up the governor before the log is used by other threads, the limits
+//! may be changed later.
+//! @param[in,out] *p log, normally the root of a tree
+//! @param[in] latency_us moving average of the time to take a message shedding a level, 0 for FLOG_GOVERNOR_LATENCY_US
+//! @param[in] queue_percent fill of a detached queue shedding a level, 0 for FLOG_GOVERNOR_QUEUE_PERCENT
+//! @param[in] hold_ms time backpressure must stay low before a level is restored, 0 for FLOG_GOVERNOR_HOLD_MS
+//! @retval 0 success
+//! @retval 1 error
+int flog_set_governor(FLOG_T *p,uint32_t latency_us,uint32_t queue_percent,uint32_t hold_ms)
+{
+	FLOG_GOVERNOR_T *g;
+	if(!p)
+		return(1);
+	if((g=__atomic_load_n(&p->governor,__ATOMIC_ACQUIRE))==NULL) {
+		if((g=flog_calloc(1,sizeof(FLOG_GOVERNOR_T)))==NULL)
+			return(1);
+	}
+	__atomic_store_n(&g->latency_us,latency_us ? latency_us : FLOG_GOVERNOR_LATENCY_US,__ATOMIC_RELAXED);
+	__atomic_store_n(&g->queue_percent,queue_percent ? queue_percent : FLOG_GOVERNOR_QUEUE_PERCENT,__ATOMIC_RELAXED);
+	__atomic_store_n(&g->hold_ms,hold_ms ? hold_ms : FLOG_GOVERNOR_HOLD_MS,__ATOMIC_RELAXED);
+	__atomic_store_n(&p->governor,g,__ATOMIC_RELEASE);
+	return(0);
+}
+
+
+//! Get the message types shed at a level of a governor
+
+//! @param[in] level level, above FLOG_GOVERNOR_LEVEL_MAX counts as FLOG_GOVERNOR_LEVEL_MAX
+//! @return message types shed
+FLOG_MSG_TYPE_T flog_governor_level_msg_type(uint_fast8_t level)
+{
+	return(flog_governor_level_type[level>FLOG_GOVERNOR_LEVEL_MAX ? FLOG_GOVERNOR_LEVEL_MAX : level]);
+}
+
+
+//! Count a message shed by a log (thread safe)
+
+//! @param[in,out] *p log shedding the message
+//! @param[in] type message type
+void flog_governor_shed(FLOG_T *p,FLOG_MSG_TYPE_T type)
+{
+	FLOG_GOVERNOR_T *g=__atomic_load_n(&p->governor,__ATOMIC_ACQUIRE);
+	unsigned int i=flog_msg_type_index(type);
+	if(!g || i>=FLOG_MSG_TYPE_AMOUNT)
+		return;
+	if(!(__atomic_add_fetch(&g->shed[i],1,__ATOMIC_RELAXED) & (FLOG_GOVERNOR_TICK_SHED-1)))
+		flog_governor_look(p,g,flog_get_time_ns());
+}
+
+
+//! Record the time a governed log took to take a message (thread safe)
+
+//! @param[in,out] *p governed log
+//! @param[in,out] *g governor of the log
+//! @param[in] start time the log was given the message (flog_get_time_ns())
+void flog_governor_time(FLOG_T *p,FLOG_GOVERNOR_T *g,uint64_t start)
+{
+	uint64_t now=flog_get_time_ns(),latency;
+	//moving average over about 8 messages, updates lost to other threads do not matter
+	latency=__atomic_load_n(&g->latency_ns,__ATOMIC_RELAXED);
+	latency=latency-latency/8+(now-start)/8;
+	__atomic_store_n(&g->latency_ns,latency,__ATOMIC_RELAXED);
+	__atomic_fetch_add(&g->samples,1,__ATOMIC_RELAXED);
+	flog_governor_look(p,g,now);
+}
+
+
+#ifdef FLOG_CONFIG_DETACH
+//! Get the fill of the fullest detached queue at or below a log, in percent
+
+//! @param[in,out] *dropped messages dropped by the queues are added to it
+static uint32_t flog_governor_queue_fill(FLOG_T *p,unsigned int depth,uint64_t *dropped)
+{
+	FLOG_DETACH_STATS_T stats;
+	uint32_t fill=0,f;
+	uint_fast8_t i;
+	if(!flog_get_detach_stats(p,&stats) && stats.size) {
+		fill=(uint32_t)((uint64_t)stats.depth*100u/stats.size);
+		*dropped+=stats.dropped;
+	}
+	//trees are shallow, the limit only guards against loops
+	if(depth<16) {
+		for(i=0;i<p->sublog_amount;i++) {
+			if((f=flog_governor_queue_fill(__atomic_load_n(&p->sublog[i],__ATOMIC_ACQUIRE),depth+1,dropped))>fill)
+				fill=f;
+		}
+	}
+	return(fill);
+}
+#endif
+
+
+//! Append to a report, ignoring what does not fit
+static void flog_governor_append(char *buf,size_t size,size_t *len,const char *format,...)
+{
+	va_list ap;
+	int n;
+	if(*len>=size)
+		return;
+	va_start(ap,format);
+	n=vsnprintf(buf+*len,size-*len,format,ap);
+	va_end(ap);
+	if(n>0)
+		*len+=(size_t)n;
+}
+
+
+//! Change the level of a governor and report it to its log
+static void flog_governor_set_level(FLOG_T *p,FLOG_GOVERNOR_T *g,uint_fast8_t from,uint_fast8_t to,uint64_t now)
+{
+	char text[256];
+	size_t len=0;
+	uint64_t n,total=0;
+	unsigned int i,listed=0;
+	if(!from) {
+		__atomic_fetch_add(&g->raised,1,__ATOMIC_RELAXED);
+		for(i=0;i<FLOG_MSG_TYPE_AMOUNT;i++)
+			__atomic_store_n(&g->shed_at_start[i],__atomic_load_n(&g->shed[i],__ATOMIC_RELAXED),__ATOMIC_RELAXED);
+		__atomic_store_n(&g->started,now,__ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&g->level,to,__ATOMIC_RELAXED);
+	__atomic_store_n(&p->shed_msg_type,flog_governor_level_type[to],__ATOMIC_RELEASE);
+
+	//report what is shed from now on, and what was shed since shedding started
+	if(to)
+		flog_governor_append(text,sizeof(text),&len,"%s and below, latency %" PRIu64 " us, queue %" PRIu32 "%%",
+		                     flog_governor_level_name[to],__atomic_load_n(&g->latency_ns,__ATOMIC_RELAXED)/1000u,
+		                     __atomic_load_n(&g->queue_fill,__ATOMIC_RELAXED));
+	for(i=0;i<FLOG_MSG_TYPE_AMOUNT;i++)
+		total+=__atomic_load_n(&g->shed[i],__ATOMIC_RELAXED)-__atomic_load_n(&g->shed_at_start[i],__ATOMIC_RELAXED);
+	if(total || !to) {
+		flog_governor_append(text,sizeof(text),&len,"%sshed %" PRIu64 " in %" PRIu64 " ms",len ? ", " : "",total,
+		                     (now-__atomic_load_n(&g->started,__ATOMIC_RELAXED))/1000000u);
+		for(i=0;i<FLOG_MSG_TYPE_AMOUNT;i++) {
+			if((n=__atomic_load_n(&g->shed[i],__ATOMIC_RELAXED)-__atomic_load_n(&g->shed_at_start[i],__ATOMIC_RELAXED)))
+				flog_governor_append(text,sizeof(text),&len,"%s%s %" PRIu64,listed++ ? ", " : " (",flog_governor_type_name[i],n);
+		}
+		if(listed)
+			flog_governor_append(text,sizeof(text),&len,")");
+	}
+	flog_printf(p,"flog_governor",FLOG_WARN,to ? FLOG_MSG_SHEDDING_MESSAGES : FLOG_MSG_STOPPED_SHEDDING,"%s",text);
+}
+
+
+//! Look at the backpressure of a governed log if it is time to (thread safe)
+
+//! Sheds one more level when the backpressure is above a limit, and one
+//! level less when it stayed below FLOG_GOVERNOR_LOW_PERCENT of the limits
+//! for the hold time.
+//! @param[in,out] *p governed log
+//! @param[in,out] *g governor of the log
+//! @param[in] now current time (flog_get_time_ns())
+void flog_governor_look(FLOG_T *p,FLOG_GOVERNOR_T *g,uint64_t now)
+{
+	uint64_t latency,pressure,low_since;
+	uint32_t fill=0;
+	uint_fast8_t level;
+	if(now<__atomic_load_n(&g->next_look,__ATOMIC_RELAXED) || __atomic_exchange_n(&g->looking,1,__ATOMIC_ACQUIRE))
+		return;
+	if(now<__atomic_load_n(&g->next_look,__ATOMIC_RELAXED)) {
+		__atomic_store_n(&g->looking,0,__ATOMIC_RELEASE);
+		return;
+	}
+	__atomic_store_n(&g->next_look,now+(uint64_t)FLOG_GOVERNOR_INTERVAL_MS*1000000u,__ATOMIC_RELAXED);
+
+	//without messages to time, the average decays
+	latency=__atomic_load_n(&g->latency_ns,__ATOMIC_RELAXED);
+	if(!__atomic_exchange_n(&g->samples,0,__ATOMIC_RELAXED)) {
+		latency/=2;
+		__atomic_store_n(&g->latency_ns,latency,__ATOMIC_RELAXED);
+	}
+#ifdef FLOG_CONFIG_DETACH
+	//a queue dropping messages since the last look was full, whatever its fill is now
+	uint64_t dropped=0;
+	fill=flog_governor_queue_fill(p,0,&dropped);
+	if(dropped!=g->queue_dropped) {
+		fill=100;
+		g->queue_dropped=dropped;
+	}
+#endif
+	__atomic_store_n(&g->queue_fill,fill,__ATOMIC_RELAXED);
+
+	//backpressure in percent of the closest limit
+	pressure=latency/10u/__atomic_load_n(&g->latency_us,__ATOMIC_RELAXED);
+	if((uint64_t)fill*100u/__atomic_load_n(&g->queue_percent,__ATOMIC_RELAXED)>pressure)
+		pressure=(uint64_t)fill*100u/__atomic_load_n(&g->queue_percent,__ATOMIC_RELAXED);
+
+	level=__atomic_load_n(&g->level,__ATOMIC_RELAXED);
+	low_since=__atomic_load_n(&g->low_since,__ATOMIC_RELAXED);
+	if(pressure>=100) {
+		low_since=0;
+		if(level<FLOG_GOVERNOR_LEVEL_MAX)
+			flog_governor_set_level(p,g,level,level+1,now);
+	} else if(level) {
+		if(pressure>=FLOG_GOVERNOR_LOW_PERCENT)
+			low_since=0;
+		else if(!low_since)
+			low_since=now;
+		else if(now-low_since>=(uint64_t)__atomic_load_n(&g->hold_ms,__ATOMIC_RELAXED)*1000000u) {
+			//each level restored waits for the hold time again
+			low_since=now;
+			flog_governor_set_level(p,g,level,level-1,now);
+		}
+	}
+	__atomic_store_n(&g->low_since,low_since,__ATOMIC_RELAXED);
+	__atomic_store_n(&g->looking,0,__ATOMIC_RELEASE);
+}
+
+
+//! Get the statistics of the governor of a log
+
+//! @param[in] *p log
+//! @param[out] *stats governor statistics
+//! @retval 0 success
+//! @retval 1 log has no governor
+int flog_get_governor_stats(const FLOG_T *p,FLOG_GOVERNOR_STATS_T *stats)
+{
+	const FLOG_GOVERNOR_T *g;
+	unsigned int i;
+	if(p==NULL || (g=__atomic_load_n(&p->governor,__ATOMIC_ACQUIRE))==NULL)
+		return(1);
+	stats->level=__atomic_load_n(&g->level,__ATOMIC_RELAXED);
+	stats->shed_msg_type=__atomic_load_n(&p->shed_msg_type,__ATOMIC_ACQUIRE);
+	stats->latency_ns=__atomic_load_n(&g->latency_ns,__ATOMIC_RELAXED);
+	stats->queue_fill=__atomic_load_n(&g->queue_fill,__ATOMIC_RELAXED);
+	stats->raised=__atomic_load_n(&g->raised,__ATOMIC_RELAXED);
+	for(i=0;i<FLOG_MSG_TYPE_AMOUNT;i++)
+		stats->shed[i]=__atomic_load_n(&g->shed[i],__ATOMIC_RELAXED);
+	return(0);
+}
+
+#endif //FLOG_CONFIG_GOVERNOR
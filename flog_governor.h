@@ -0,0 +1,109 @@
+//! Adaptive load shedding for Flog
+
+//! @file flog_governor.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! When outputs cannot keep up, the messages worth keeping are the severe
+//! ones. A governor attached to a log (normally the root of a tree) with
+//! flog_set_governor() watches the backpressure below it and sheds the
+//! least severe message types first, a level at a time:
+//!
+//!     level 1: DEEP_DEBUG and DEBUG
+//!     level 2: and VINFO
+//!     level 3: and INFO
+//!     level 4: and NOTE
+//!
+//! WARN, ERR and CRIT are never shed. Backpressure is the time the log
+//! takes to take a message (a moving average of its output, sublogs and
+//! queueing together), and how full the queues of detached logs at or
+//! below it are (see flog_detach.h). It is looked at every
+//! FLOG_GOVERNOR_INTERVAL_MS. Above the limits one more level is shed;
+//! below FLOG_GOVERNOR_LOW_PERCENT of them for the hold time one level
+//! less, so the governor does not flap around a limit.
+//!
+//! The types being shed are kept in FLOG_T->shed_msg_type, taken out of
+//! the accepted types by flog_is_message_used(), so a shed message costs
+//! the same bit test as a message of a type not accepted at all, plus a
+//! counter increment. Each change of level is reported to the log itself
+//! as a FLOG_WARN message, which is never shed, with what was shed so far.
+
+
+#ifndef FLOG_GOVERNOR_H
+#define FLOG_GOVERNOR_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_GOVERNOR
+
+#include <stdint.h>
+
+//! Moving average of the time to take a message in µs shedding a level, used when 0 is given
+#define FLOG_GOVERNOR_LATENCY_US 1000
+//! Fill of a detached queue in percent shedding a level, used when 0 is given
+#define FLOG_GOVERNOR_QUEUE_PERCENT 75
+//! Time in ms backpressure must stay low before a level is restored, used when 0 is given
+#define FLOG_GOVERNOR_HOLD_MS 2000
+//! Time between looks at the backpressure
+#define FLOG_GOVERNOR_INTERVAL_MS 100
+//! Percent of the limits backpressure must stay below to restore a level
+#define FLOG_GOVERNOR_LOW_PERCENT 50
+//! Highest level of shedding
+#define FLOG_GOVERNOR_LEVEL_MAX 4
+//! Shed messages counted between looks at the clock while shedding (power of 2)
+#define FLOG_GOVERNOR_TICK_SHED 64
+
+
+//! Governor structure - attached to a log with flog_set_governor(), members are updated atomically
+typedef struct flog_governor_t {
+	uint32_t latency_us;                    //!< average time to take a message shedding a level
+	uint32_t queue_percent;                 //!< fill of a detached queue shedding a level
+	uint32_t hold_ms;                       //!< time backpressure must stay low to restore a level
+	uint_fast8_t level;                     //!< current level (0 for nothing shed)
+	uint64_t next_look;                     //!< time of the next look at the backpressure (flog_get_time_ns())
+	uint_fast8_t looking;                   //!< a thread is looking at the backpressure
+	uint64_t low_since;                     //!< time backpressure went low (0 while high)
+	uint64_t latency_ns;                    //!< moving average of the time to take a message
+	uint32_t samples;                       //!< messages timed since the last look
+	uint32_t queue_fill;                    //!< fill of the fullest detached queue at the last look, in percent
+	uint64_t queue_dropped;                 //!< messages dropped by detached queues at the last look
+	uint64_t raised;                        //!< times shedding started
+	uint64_t shed[FLOG_MSG_TYPE_AMOUNT];    //!< messages shed, indexed by flog_msg_type_index()
+	uint64_t shed_at_start[FLOG_MSG_TYPE_AMOUNT]; //!< shed when shedding last started
+	uint64_t started;                       //!< time shedding last started (flog_get_time_ns())
+} FLOG_GOVERNOR_T;
+
+
+//! Governor statistics
+typedef struct {
+	uint_fast8_t level;                     //!< current level (0 for nothing shed)
+	FLOG_MSG_TYPE_T shed_msg_type;          //!< message types being shed
+	uint64_t latency_ns;                    //!< moving average of the time to take a message
+	uint32_t queue_fill;                    //!< fill of the fullest detached queue at the last look, in percent
+	uint64_t raised;                        //!< times shedding started
+	uint64_t shed[FLOG_MSG_TYPE_AMOUNT];    //!< messages shed, indexed by flog_msg_type_index()
+} FLOG_GOVERNOR_STATS_T;
+
+
+void flog_governor_shed(FLOG_T *p,FLOG_MSG_TYPE_T type);
+void flog_governor_look(FLOG_T *p,FLOG_GOVERNOR_T *g,uint64_t now);
+void flog_governor_time(FLOG_T *p,FLOG_GOVERNOR_T *g,uint64_t start);
+
+
+//! Count a message not used by a log if its type is being shed
+
+//! Called where flog_is_message_used() turned a message down, only a bit
+//! test unless the log sheds the type.
+static inline void flog_governor_count(FLOG_T *p,FLOG_MSG_TYPE_T type)
+{
+	if(__builtin_expect((type & __atomic_load_n(&p->shed_msg_type,__ATOMIC_RELAXED))!=0,0))
+		flog_governor_shed(p,type);
+}
+
+
+int flog_set_governor(FLOG_T *p,uint32_t latency_us,uint32_t queue_percent,uint32_t hold_ms);
+FLOG_MSG_TYPE_T flog_governor_level_msg_type(uint_fast8_t level);
+int flog_get_governor_stats(const FLOG_T *p,FLOG_GOVERNOR_STATS_T *stats);
+
+#endif //FLOG_CONFIG_GOVERNOR
+
+#endif //FLOG_GOVERNOR_H
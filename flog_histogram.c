@@ -0,0 +1,132 @@
+//! Latency histograms for Flog
+
+//! @file flog_histogram.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Lock-free log-linear histograms, used for flog instrumentation.
+//! Writers only use relaxed atomic adds, so a snapshot taken while
+//! messages are flowing may be off by the messages in flight.
+
+#include "flog_histogram.h"
+#include <string.h>
+#include <time.h>
+
+
+//! Get a monotonic timestamp in nanoseconds
+
+//! @return nanoseconds since an arbitrary point in time, 0 on error
+uint64_t flog_get_time_ns(void)
+{
+	struct timespec ts;
+	if(clock_gettime(CLOCK_MONOTONIC,&ts))
+		return(0);
+	return((uint64_t)ts.tv_sec*1000000000u+(uint64_t)ts.tv_nsec);
+}
+
+
+//! Get the bucket a value belongs to
+
+//! @param[in] value value to look up
+//! @return bucket index (0 to FLOG_HISTOGRAM_BUCKETS-1)
+unsigned int flog_histogram_bucket(uint64_t value)
+{
+	unsigned int shift;
+	if(value<FLOG_HISTOGRAM_SUB_AMOUNT)
+		return((unsigned int)value);
+	if(value>>FLOG_HISTOGRAM_MAX_BITS)
+		return(FLOG_HISTOGRAM_BUCKETS-1);
+	shift=63-__builtin_clzll(value)-FLOG_HISTOGRAM_SUB_BITS;
+	return((shift+1)*FLOG_HISTOGRAM_SUB_AMOUNT+(unsigned int)((value>>shift)&(FLOG_HISTOGRAM_SUB_AMOUNT-1)));
+}
+
+
+//! Get the largest value that is counted in a bucket
+
+//! @param[in] bucket bucket index
+//! @return largest value of bucket
+uint64_t flog_histogram_bucket_upper(unsigned int bucket)
+{
+	unsigned int shift;
+	if(bucket<FLOG_HISTOGRAM_SUB_AMOUNT)
+		return(bucket);
+	shift=bucket/FLOG_HISTOGRAM_SUB_AMOUNT-1;
+	return((((uint64_t)FLOG_HISTOGRAM_SUB_AMOUNT+bucket%FLOG_HISTOGRAM_SUB_AMOUNT+1)<<shift)-1);
+}
+
+
+//! Add a value to a histogram (thread safe, lock-free)
+void flog_histogram_add(FLOG_HISTOGRAM_T *h,uint64_t value)
+{
+	__atomic_fetch_add(&h->count[flog_histogram_bucket(value)],1,__ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->total,value,__ATOMIC_RELAXED);
+	uint64_t max=__atomic_load_n(&h->max,__ATOMIC_RELAXED);
+	while(value>max) {
+		if(__atomic_compare_exchange_n(&h->max,&max,value,1,__ATOMIC_RELAXED,__ATOMIC_RELAXED))
+			break;
+	}
+}
+
+
+//! Copy a histogram which may be in use by other threads
+void flog_histogram_snapshot(const FLOG_HISTOGRAM_T *h,FLOG_HISTOGRAM_T *out)
+{
+	unsigned int i;
+	for(i=0;i<FLOG_HISTOGRAM_BUCKETS;i++)
+		out->count[i]=__atomic_load_n(&h->count[i],__ATOMIC_RELAXED);
+	out->total=__atomic_load_n(&h->total,__ATOMIC_RELAXED);
+	out->max=__atomic_load_n(&h->max,__ATOMIC_RELAXED);
+}
+
+
+//! Clear a histogram
+
+//! Values added concurrently with the reset may or may not be kept
+void flog_histogram_reset(FLOG_HISTOGRAM_T *h)
+{
+	unsigned int i;
+	for(i=0;i<FLOG_HISTOGRAM_BUCKETS;i++)
+		__atomic_store_n(&h->count[i],0,__ATOMIC_RELAXED);
+	__atomic_store_n(&h->total,0,__ATOMIC_RELAXED);
+	__atomic_store_n(&h->max,0,__ATOMIC_RELAXED);
+}
+
+
+//! Get the amount of values in a histogram
+uint64_t flog_histogram_count(const FLOG_HISTOGRAM_T *h)
+{
+	uint64_t n=0;
+	unsigned int i;
+	for(i=0;i<FLOG_HISTOGRAM_BUCKETS;i++)
+		n+=__atomic_load_n(&h->count[i],__ATOMIC_RELAXED);
+	return(n);
+}
+
+
+//! Get a percentile from a histogram
+
+//! The result is the upper bound of the bucket holding the percentile,
+//! so it is accurate to within 1/FLOG_HISTOGRAM_SUB_AMOUNT of the value.
+//! @param[in] *h histogram
+//! @param[in] percentile percentile to get (such as 50.0, 99.0 or 99.9)
+//! @return value at percentile, 0 if the histogram is empty
+uint64_t flog_histogram_percentile(const FLOG_HISTOGRAM_T *h,double percentile)
+{
+	uint64_t n,rank,seen=0;
+	unsigned int i;
+	if(!(n=flog_histogram_count(h)))
+		return(0);
+	if(percentile>=100.0)
+		return(__atomic_load_n(&h->max,__ATOMIC_RELAXED));
+	rank=(uint64_t)(n*percentile/100.0);
+	if(rank>=n)
+		rank=n-1;
+	for(i=0;i<FLOG_HISTOGRAM_BUCKETS;i++) {
+		seen+=__atomic_load_n(&h->count[i],__ATOMIC_RELAXED);
+		if(seen>rank) {
+			uint64_t upper=flog_histogram_bucket_upper(i);
+			uint64_t max=__atomic_load_n(&h->max,__ATOMIC_RELAXED);
+			return(upper<max ? upper : max);
+		}
+	}
+	return(__atomic_load_n(&h->max,__ATOMIC_RELAXED));
+}
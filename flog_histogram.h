@@ -0,0 +1,44 @@
+//! Latency histograms for Flog
+
+//! @file flog_histogram.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Lock-free log-linear histograms, used for flog instrumentation.
+//! Values (normally nanoseconds) are sorted into buckets where each power
+//! of two is split into FLOG_HISTOGRAM_SUB_AMOUNT linear sub-buckets.
+
+
+#ifndef FLOG_HISTOGRAM_H
+#define FLOG_HISTOGRAM_H
+
+#include <stdint.h>
+
+//! Bits of linear resolution within each power of two
+#define FLOG_HISTOGRAM_SUB_BITS 2
+//! Amount of linear sub-buckets within each power of two
+#define FLOG_HISTOGRAM_SUB_AMOUNT (1<<FLOG_HISTOGRAM_SUB_BITS)
+//! Values with more bits than this are counted in the last bucket (2^40ns is about 18 minutes)
+#define FLOG_HISTOGRAM_MAX_BITS 40
+//! Amount of buckets in a histogram
+#define FLOG_HISTOGRAM_BUCKETS ((FLOG_HISTOGRAM_MAX_BITS-FLOG_HISTOGRAM_SUB_BITS+1)*FLOG_HISTOGRAM_SUB_AMOUNT)
+
+
+//! Histogram structure - all members are updated atomically
+typedef struct {
+	uint64_t count[FLOG_HISTOGRAM_BUCKETS]; //!< amount of values per bucket
+	uint64_t total;                         //!< sum of all values
+	uint64_t max;                           //!< largest value
+} FLOG_HISTOGRAM_T;
+
+
+uint64_t flog_get_time_ns(void);
+
+unsigned int flog_histogram_bucket(uint64_t value);
+uint64_t flog_histogram_bucket_upper(unsigned int bucket);
+void flog_histogram_add(FLOG_HISTOGRAM_T *h,uint64_t value);
+void flog_histogram_snapshot(const FLOG_HISTOGRAM_T *h,FLOG_HISTOGRAM_T *out);
+void flog_histogram_reset(FLOG_HISTOGRAM_T *h);
+uint64_t flog_histogram_count(const FLOG_HISTOGRAM_T *h);
+uint64_t flog_histogram_percentile(const FLOG_HISTOGRAM_T *h,double percentile);
+
+#endif //FLOG_HISTOGRAM_H
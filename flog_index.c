@@ -0,0 +1,230 @@
+//! Sidecar index of log files for Flog
+
+//! @file flog_index.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Entries are encoded into a pending buffer when they end, and written
+//! by the file output right after the records they refer to, so an entry
+//! never points past the end of the log file. flog_index_write() only
+//! uses write(), so it can be called from a signal handler.
+
+#include "flog_index.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_INDEX
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+//! Write a little endian integer of n bytes
+static unsigned char * flog_index_put(unsigned char *p, uint64_t v, unsigned int n)
+{
+	while(n--) {
+		*p++=(unsigned char)v;
+		v>>=8;
+	}
+	return(p);
+}
+
+
+//! Read a little endian integer of n bytes
+static uint64_t flog_index_get(const unsigned char *p, unsigned int n)
+{
+	uint64_t v=0;
+	while(n--)
+		v=v<<8 | p[n];
+	return(v);
+}
+
+
+//! Get a message timestamp in microseconds since the epoch
+static int64_t flog_index_time(const FLOG_MSG_T *msg)
+{
+#ifdef FLOG_CONFIG_TIMESTAMP_USEC
+	return((int64_t)msg->timestamp.tv_sec*1000000+msg->timestamp.tv_usec);
+#else
+	return((int64_t)msg->timestamp*1000000);
+#endif
+}
+
+
+//! create an index next to a log file
+
+//! The index file is created with a header if it doesn't exist, and
+//! appended to if it does.
+//! @param[in] *log_filename name of the log file
+//! @param[in] every records per entry, 0 for FLOG_INDEX_EVERY
+//! @retval NULL error (see errno)
+FLOG_INDEX_T * create_flog_index(const char *log_filename, uint32_t every)
+{
+	FLOG_INDEX_T *x;
+	unsigned char header[FLOG_INDEX_HEADER_SIZE];
+	size_t len=strlen(log_filename);
+	off_t end;
+	int e;
+	if((x=flog_calloc(1,sizeof(FLOG_INDEX_T)))==NULL)
+		return(NULL);
+	x->fd=-1;
+	x->every=every ? every : FLOG_INDEX_EVERY;
+	if((x->filename=flog_malloc(len+sizeof(FLOG_INDEX_SUFFIX)))==NULL)
+		goto error;
+	memcpy(x->filename,log_filename,len);
+	memcpy(x->filename+len,FLOG_INDEX_SUFFIX,sizeof(FLOG_INDEX_SUFFIX));
+	if((x->fd=open(x->filename,O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC,0666))==-1)
+		goto error;
+	if((end=lseek(x->fd,0,SEEK_END))==-1)
+		goto error;
+	if(end==0) {
+		memcpy(header,FLOG_INDEX_MAGIC,4);
+		flog_index_put(header+4,x->every,4);
+		if(write(x->fd,header,sizeof(header))!=(ssize_t)sizeof(header))
+			goto error;
+	}
+	return(x);
+error:
+	e=errno;
+	destroy_flog_index(x);
+	errno=e;
+	return(NULL);
+}
+
+
+//! free an index
+
+//! Pending entries are written, but the records since the last entry are
+//! not made into an entry (see flog_index_end_entry()).
+void destroy_flog_index(FLOG_INDEX_T *x)
+{
+	if(x!=NULL) {
+		if(x->fd!=-1) {
+			flog_index_write(x);
+			close(x->fd);
+		}
+		flog_free(x->pending);
+		flog_free(x->filename);
+		flog_free(x);
+	}
+}
+
+
+//! add a record to an index
+
+//! @param[in] *x index
+//! @param[in] offset offset of the record in the log file
+//! @param[in] len length of the record in bytes
+//! @param[in] *msg message of the record
+//! @retval 0 success
+//! @return errno on error
+int flog_index_add(FLOG_INDEX_T *x, uint64_t offset, size_t len, const FLOG_MSG_T *msg)
+{
+	FLOG_INDEX_ENTRY_T *e=&x->cur;
+	int64_t t=flog_index_time(msg);
+	if(!e->records) {
+		e->offset=offset;
+		e->time_min=e->time_max=t;
+		e->types=0;
+	}
+	if(t<e->time_min)
+		e->time_min=t;
+	if(t>e->time_max)
+		e->time_max=t;
+	e->types|=msg->type;
+	e->length=offset+len-e->offset;
+	if(++e->records==x->every)
+		return(flog_index_end_entry(x));
+	return(0);
+}
+
+
+//! end the entry of the records added since the last entry
+
+//! The entry is written by the next flog_index_write()
+//! @retval 0 success
+//! @return errno on error
+int flog_index_end_entry(FLOG_INDEX_T *x)
+{
+	FLOG_INDEX_ENTRY_T *e=&x->cur;
+	unsigned char *p;
+	size_t size;
+	if(!e->records)
+		return(0);
+	if(x->pending_used+FLOG_INDEX_ENTRY_SIZE > x->pending_size) {
+		size=x->pending_size ? x->pending_size*2 : 8*FLOG_INDEX_ENTRY_SIZE;
+		if((p=flog_realloc(x->pending,size))==NULL)
+			return(errno);
+		x->pending=p;
+		x->pending_size=size;
+	}
+	p=x->pending+x->pending_used;
+	p=flog_index_put(p,e->offset,8);
+	p=flog_index_put(p,e->length,8);
+	p=flog_index_put(p,(uint64_t)e->time_min,8);
+	p=flog_index_put(p,(uint64_t)e->time_max,8);
+	p=flog_index_put(p,e->types,4);
+	flog_index_put(p,e->records,4);
+	x->pending_used+=FLOG_INDEX_ENTRY_SIZE;
+	e->records=0;
+	return(0);
+}
+
+
+//! write pending entries to the index file (async-signal-safe)
+
+//! Call after the records of the entries are written to the log file
+//! @retval 0 success
+//! @return errno on error
+int flog_index_write(FLOG_INDEX_T *x)
+{
+	size_t done=0;
+	ssize_t r;
+	while(done<x->pending_used) {
+		if((r=write(x->fd,x->pending+done,x->pending_used-done))<0) {
+			if(errno==EINTR)
+				continue;
+			//keep what is not written yet, to write on the next call
+			memmove(x->pending,x->pending+done,x->pending_used-done);
+			x->pending_used-=done;
+			return(errno);
+		}
+		done+=(size_t)r;
+	}
+	x->pending_used=0;
+	return(0);
+}
+
+
+//! parse the header of an index file
+
+//! @param[in] *header FLOG_INDEX_HEADER_SIZE bytes
+//! @param[out] *every records per entry
+//! @retval 0 success
+//! @retval -1 not an index file
+int flog_index_read_header(const void *header, uint32_t *every)
+{
+	if(memcmp(header,FLOG_INDEX_MAGIC,4))
+		return(-1);
+	*every=(uint32_t)flog_index_get((const unsigned char *)header+4,4);
+	return(0);
+}
+
+
+//! parse an index entry
+
+//! @param[in] *buf FLOG_INDEX_ENTRY_SIZE bytes
+//! @param[out] *e entry
+void flog_index_read_entry(const void *buf, FLOG_INDEX_ENTRY_T *e)
+{
+	const unsigned char *p=buf;
+	e->offset=flog_index_get(p,8);
+	e->length=flog_index_get(p+8,8);
+	e->time_min=(int64_t)flog_index_get(p+16,8);
+	e->time_max=(int64_t)flog_index_get(p+24,8);
+	e->types=(uint32_t)flog_index_get(p+32,4);
+	e->records=(uint32_t)flog_index_get(p+36,4);
+}
+
+#endif //FLOG_CONFIG_INDEX
@@ -0,0 +1,92 @@
+//! Sidecar index of log files for Flog
+
+//! @file flog_index.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! A buffered file output can write an index next to its file, named
+//! like the file with ".idx" appended. Every N records one entry is
+//! added, giving where the records are in the file, the time range they
+//! span and which message types they contain. flogq uses it to output
+//! only the parts of a large file matching a time range and types.
+//!
+//! Index file, numbers in little endian: "FLI1" and a uint32 with the
+//! records per entry, then entries of FLOG_INDEX_ENTRY_SIZE bytes:
+//! - uint64 offset of the first record in the log file
+//! - uint64 length of the records in bytes
+//! - int64 earliest timestamp in microseconds since the epoch
+//! - int64 latest timestamp in microseconds since the epoch
+//! - uint32 bitmask of message types present
+//! - uint32 amount of records
+//!
+//! Entries are written after the records they refer to. Records after
+//! the last entry are not indexed, and should be read as they are.
+
+
+#ifndef FLOG_INDEX_H
+#define FLOG_INDEX_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_INDEX
+
+// Sanity checks
+#ifndef FLOG_CONFIG_TIMESTAMP
+#error FLOG_CONFIG_INDEX requires FLOG_CONFIG_TIMESTAMP
+#endif
+#ifndef FLOG_CONFIG_OUTPUT_FILE
+#error FLOG_CONFIG_INDEX requires FLOG_CONFIG_OUTPUT_FILE
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+//! Magic bytes starting an index file
+#define FLOG_INDEX_MAGIC "FLI1"
+
+//! Size of the index file header
+#define FLOG_INDEX_HEADER_SIZE 8
+
+//! Size of an index entry
+#define FLOG_INDEX_ENTRY_SIZE 40
+
+//! Suffix of the index file name
+#define FLOG_INDEX_SUFFIX ".idx"
+
+//! Records per entry used when 0 is given
+#define FLOG_INDEX_EVERY 1024
+
+
+//! Index entry
+typedef struct {
+	uint64_t offset;                        //!< offset of the first record in the log file
+	uint64_t length;                        //!< length of the records in bytes
+	int64_t time_min;                       //!< earliest timestamp in microseconds
+	int64_t time_max;                       //!< latest timestamp in microseconds
+	uint32_t types;                         //!< message types present
+	uint32_t records;                       //!< amount of records
+} FLOG_INDEX_ENTRY_T;
+
+
+//! Index being written
+typedef struct {
+	char *filename;                         //!< name of index file
+	int fd;                                 //!< file descriptor
+	uint32_t every;                         //!< records per entry
+	FLOG_INDEX_ENTRY_T cur;                 //!< entry of the records since the last entry
+	unsigned char *pending;                 //!< encoded entries not yet written
+	size_t pending_used;                    //!< bytes used in pending
+	size_t pending_size;                    //!< size of pending
+} FLOG_INDEX_T;
+
+
+FLOG_INDEX_T * create_flog_index(const char *log_filename, uint32_t every);
+void destroy_flog_index(FLOG_INDEX_T *x);
+int flog_index_add(FLOG_INDEX_T *x, uint64_t offset, size_t len, const FLOG_MSG_T *msg);
+int flog_index_end_entry(FLOG_INDEX_T *x);
+int flog_index_write(FLOG_INDEX_T *x);
+int flog_index_read_header(const void *header, uint32_t *every);
+void flog_index_read_entry(const void *buf, FLOG_INDEX_ENTRY_T *e);
+
+#endif //FLOG_CONFIG_INDEX
+
+#endif //FLOG_INDEX_H
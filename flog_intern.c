@@ -0,0 +1,168 @@
+//! String interning for Flog
+
+//! @file flog_intern.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! A global lock-free open addressing hash table. Slots are claimed with
+//! compare-and-swap and never change afterwards, so readers need no locks
+//! and an id (slot index + 1) stays valid until flog_intern_clear().
+
+#include "flog_intern.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+
+#include <stdlib.h>
+#include <string.h>
+
+
+//! Interned string, allocated in one block
+typedef struct {
+	uint32_t hash;                          //!< hash of str
+	size_t len;                             //!< length of str
+	char str[];                             //!< the string itself
+} FLOG_INTERN_ENTRY_T;
+
+
+//! The intern table
+static FLOG_INTERN_ENTRY_T *flog_intern_table[FLOG_CONFIG_INTERN_TABLE_SIZE];
+
+//! Amount of strings in the table
+static unsigned int flog_intern_used;
+
+//! Slots looked at for a string
+#define FLOG_INTERN_PROBE (FLOG_INTERN_PROBE_MAX<FLOG_CONFIG_INTERN_TABLE_SIZE ? FLOG_INTERN_PROBE_MAX : FLOG_CONFIG_INTERN_TABLE_SIZE)
+
+
+//! FNV-1a hash of a string
+static uint32_t flog_intern_hash(const char *str,size_t len)
+{
+	uint32_t h=2166136261u;
+	while(len--) {
+		h^=(unsigned char)*str++;
+		h*=16777619u;
+	}
+	return(h);
+}
+
+
+//! Look up, and optionally insert, a string
+
+//! Strings are only inserted within FLOG_INTERN_PROBE slots of their hash,
+//! and slots are only emptied all together, so a string not found there
+//! is not in the table.
+//! @param[in] limit most strings in the table to insert a new one (0 to never insert)
+static FLOG_INTERN_ID_T flog_intern_lookup(const char *str,size_t len,unsigned int limit)
+{
+	uint32_t h=flog_intern_hash(str,len);
+	FLOG_INTERN_ENTRY_T *entry,*new_entry=NULL;
+	unsigned int i,n;
+	for(n=0,i=h&(FLOG_CONFIG_INTERN_TABLE_SIZE-1);n<FLOG_INTERN_PROBE;n++,i=(i+1)&(FLOG_CONFIG_INTERN_TABLE_SIZE-1)) {
+		entry=__atomic_load_n(&flog_intern_table[i],__ATOMIC_ACQUIRE);
+		if(!entry) {
+			if(__atomic_load_n(&flog_intern_used,__ATOMIC_RELAXED)>=limit) {
+				flog_free(new_entry);
+				return(0);
+			}
+			if(!new_entry) {
+				if((new_entry=flog_malloc(sizeof(FLOG_INTERN_ENTRY_T)+len+1))==NULL)
+					return(0);
+				new_entry->hash=h;
+				new_entry->len=len;
+				memcpy(new_entry->str,str,len);
+				new_entry->str[len]=0;
+			}
+			if(__atomic_compare_exchange_n(&flog_intern_table[i],&entry,new_entry,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE)) {
+				__atomic_fetch_add(&flog_intern_used,1,__ATOMIC_RELAXED);
+				return((FLOG_INTERN_ID_T)(i+1));
+			}
+			//another thread claimed the slot first, entry now holds its string
+		}
+		if(entry->hash==h && entry->len==len && !memcmp(entry->str,str,len)) {
+			flog_free(new_entry);
+			return((FLOG_INTERN_ID_T)(i+1));
+		}
+	}
+	flog_free(new_entry);
+	return(0); //no free slot near the hash
+}
+
+
+//! Intern a string (thread safe, lock-free)
+
+//! @param[in] *str string to intern
+//! @return id of string
+//! @retval 0 error (NULL string, out of memory or the table is full)
+FLOG_INTERN_ID_T flog_intern(const char *str)
+{
+	if(!str)
+		return(0);
+	return(flog_intern_lookup(str,strlen(str),FLOG_CONFIG_INTERN_TABLE_SIZE*FLOG_INTERN_LOAD_PERCENT/100));
+}
+
+
+//! Intern the first len characters of a string (thread safe, lock-free)
+
+//! @return id of string
+//! @retval 0 error (out of memory or the table is full)
+FLOG_INTERN_ID_T flog_intern_len(const char *str,size_t len)
+{
+	if(!str)
+		return(0);
+	return(flog_intern_lookup(str,len,FLOG_CONFIG_INTERN_TABLE_SIZE*FLOG_INTERN_LOAD_PERCENT/100));
+}
+
+
+//! Intern the first len characters of a string built per message (thread safe, lock-free)
+
+//! Such strings, like the subsystem paths of routed messages, may never
+//! repeat, so they are only interned while the table is less than
+//! FLOG_INTERN_TRANSIENT_PERCENT full, leaving the rest for names.
+//! @return id of string
+//! @retval 0 not interned (the caller copies the string itself)
+FLOG_INTERN_ID_T flog_intern_transient(const char *str,size_t len)
+{
+	if(!str)
+		return(0);
+	return(flog_intern_lookup(str,len,FLOG_CONFIG_INTERN_TABLE_SIZE*FLOG_INTERN_TRANSIENT_PERCENT/100));
+}
+
+
+//! Get the id of a string if it has been interned (never allocates)
+
+//! @retval 0 not interned
+FLOG_INTERN_ID_T flog_intern_find(const char *str)
+{
+	if(!str)
+		return(0);
+	return(flog_intern_lookup(str,strlen(str),0));
+}
+
+
+//! Get an interned string from its id
+
+//! @return interned string, valid until flog_intern_clear()
+//! @retval NULL invalid id
+const char * flog_intern_str(FLOG_INTERN_ID_T id)
+{
+	FLOG_INTERN_ENTRY_T *entry;
+	if(!id || id>FLOG_CONFIG_INTERN_TABLE_SIZE)
+		return(NULL);
+	if(!(entry=__atomic_load_n(&flog_intern_table[id-1],__ATOMIC_ACQUIRE)))
+		return(NULL);
+	return(entry->str);
+}
+
+
+//! Free all interned strings
+
+//! Only call when no logs or messages referring to interned strings are in use
+void flog_intern_clear(void)
+{
+	unsigned int i;
+	for(i=0;i<FLOG_CONFIG_INTERN_TABLE_SIZE;i++)
+		flog_free(__atomic_exchange_n(&flog_intern_table[i],NULL,__ATOMIC_ACQ_REL));
+	__atomic_store_n(&flog_intern_used,0,__ATOMIC_RELAXED);
+}
+
+#endif //FLOG_CONFIG_INTERN_TABLE_SIZE
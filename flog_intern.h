@@ -0,0 +1,50 @@
+//! String interning for Flog
+
+//! @file flog_intern.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Maps subsystem names, source files and function names to small
+//! integer ids, so they are stored once and can be compared by id.
+//!
+//! Interned strings are kept until flog_intern_clear(), so the table only
+//! fills up. Lookups look at FLOG_INTERN_PROBE_MAX slots at most, and once
+//! the table is FLOG_INTERN_LOAD_PERCENT full strings not yet interned are
+//! not interned any more, and callers fall back to a copy of their own.
+
+
+#ifndef FLOG_INTERN_H
+#define FLOG_INTERN_H
+
+#include "config.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+
+#if (FLOG_CONFIG_INTERN_TABLE_SIZE & (FLOG_CONFIG_INTERN_TABLE_SIZE-1)) || FLOG_CONFIG_INTERN_TABLE_SIZE>65535
+#error FLOG_CONFIG_INTERN_TABLE_SIZE must be a power of two below 65536
+#endif
+
+//! Id of an interned string, 0 means not interned
+typedef uint16_t FLOG_INTERN_ID_T;
+
+//! Most slots looked at for a string, so a lookup stays short however full the table is
+#define FLOG_INTERN_PROBE_MAX 16
+//! Percent of the table strings are interned into at most, beyond it only strings already interned are found
+#define FLOG_INTERN_LOAD_PERCENT 75
+//! Percent of the table strings built per message (flog_intern_transient()) are interned into at most
+#define FLOG_INTERN_TRANSIENT_PERCENT 50
+
+//! Longest subsystem path (including terminator) flog_add_msg() interns, longer paths are allocated per message
+#define FLOG_INTERN_PATH_MAX 256
+
+FLOG_INTERN_ID_T flog_intern(const char *str);
+FLOG_INTERN_ID_T flog_intern_len(const char *str,size_t len);
+FLOG_INTERN_ID_T flog_intern_transient(const char *str,size_t len);
+FLOG_INTERN_ID_T flog_intern_find(const char *str);
+const char * flog_intern_str(FLOG_INTERN_ID_T id);
+void flog_intern_clear(void);
+
+#endif //FLOG_CONFIG_INTERN_TABLE_SIZE
+
+#endif //FLOG_INTERN_H
@@ -0,0 +1,661 @@
+//! Line layouts for Flog
+
+//! @file flog_layout.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Patterns are compiled into a flat array of operations, groups point
+//! past their last operation. Every piece of text is classified as prefix,
+//! separator or suffix when compiling, so rendering only has to remember
+//! whether a field was written yet. Fields append straight into the
+//! output, snprintf() style: the full length is counted even when the
+//! buffer is too small, so the caller can retry with a larger buffer.
+
+#define _GNU_SOURCE
+#include "flog_layout.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_LAYOUT
+
+#include "flog_string.h"
+#include "flog_escape.h"
+#include "flog_trace.h"
+#include "flog_context.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+//! Deepest nesting of groups in a pattern
+#define FLOG_LAYOUT_MAX_DEPTH 8
+
+
+//! Append to the output, as much as fits
+static inline void flog_layout_put(FLOG_LAYOUT_OUT_T *o,const char *s,size_t len)
+{
+	if(o->len<o->size)
+		memcpy(o->buf+o->len,s,(len<o->size-o->len) ? len : o->size-o->len);
+	o->len+=len;
+}
+
+
+//! Append a string to the output (nothing if NULL)
+static inline void flog_layout_put_str(FLOG_LAYOUT_OUT_T *o,const char *s)
+{
+	if(s)
+		flog_layout_put(o,s,strlen(s));
+}
+
+
+//! Append an unsigned number to the output
+static void flog_layout_put_uint(FLOG_LAYOUT_OUT_T *o,unsigned long v)
+{
+	char d[24],*p=d+sizeof(d);
+	do
+		*--p=(char)('0'+v%10);
+	while(v/=10);
+	flog_layout_put(o,p,(size_t)(d+sizeof(d)-p));
+}
+
+
+//! Field renderer for fields which are not configured
+static void __attribute__((unused)) flog_layout_field_none(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)o;
+	(void)msg;
+	(void)flags;
+}
+
+
+#ifdef FLOG_CONFIG_TIMESTAMP
+//! Write a number as n digits with leading zeros
+static void flog_layout_digits(char *p,unsigned int v,int n)
+{
+	while(n--) {
+		p[n]=(char)('0'+v%10);
+		v/=10;
+	}
+}
+
+
+//! %T - timestamp in ISO-format
+
+//! The date and time are only converted when the second changes,
+//! the last conversion is kept per thread.
+static void flog_layout_field_timestamp(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	static __thread time_t cached_sec=(time_t)-1;
+	static __thread char cached[19];
+#ifdef FLOG_CONFIG_TIMESTAMP_USEC
+	time_t sec=msg->timestamp.tv_sec;
+#else
+	time_t sec=msg->timestamp;
+#endif
+	(void)flags;
+	if(sec!=cached_sec) {
+		struct tm tm;
+		localtime_r(&sec,&tm);
+		flog_layout_digits(cached,(unsigned int)tm.tm_year+1900,4);
+		cached[4]='-';
+		flog_layout_digits(cached+5,(unsigned int)tm.tm_mon+1,2);
+		cached[7]='-';
+		flog_layout_digits(cached+8,(unsigned int)tm.tm_mday,2);
+		cached[10]=' ';
+		flog_layout_digits(cached+11,(unsigned int)tm.tm_hour,2);
+		cached[13]=':';
+		flog_layout_digits(cached+14,(unsigned int)tm.tm_min,2);
+		cached[16]=':';
+		flog_layout_digits(cached+17,(unsigned int)tm.tm_sec,2);
+		cached_sec=sec;
+	}
+	flog_layout_put(o,cached,sizeof(cached));
+#ifdef FLOG_CONFIG_TIMESTAMP_USEC
+	char usec[7];
+	usec[0]='.';
+	flog_layout_digits(usec+1,(unsigned int)msg->timestamp.tv_usec,6);
+	flog_layout_put(o,usec,sizeof(usec));
+#endif
+}
+#else //FLOG_CONFIG_TIMESTAMP
+#define flog_layout_field_timestamp flog_layout_field_none
+#endif //FLOG_CONFIG_TIMESTAMP
+
+
+#ifdef FLOG_CONFIG_SRC_INFO
+//! %P - source position as "file:line|function()"
+static void flog_layout_field_src_info(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	flog_layout_put_str(o,msg->src_file);
+	if(msg->src_line) {
+		flog_layout_put(o,":",1);
+		flog_layout_put_uint(o,msg->src_line);
+	}
+	if(msg->src_func) {
+		if(msg->src_file || msg->src_line)
+			flog_layout_put(o,"|",1);
+		flog_layout_put_str(o,msg->src_func);
+		flog_layout_put(o,"()",2);
+	}
+}
+
+
+//! %F - source file
+static void flog_layout_field_src_file(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	flog_layout_put_str(o,msg->src_file);
+}
+
+
+//! %l - source line
+static void flog_layout_field_src_line(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	if(msg->src_line)
+		flog_layout_put_uint(o,msg->src_line);
+}
+
+
+//! %f - source function
+static void flog_layout_field_src_func(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	flog_layout_put_str(o,msg->src_func);
+}
+#else //FLOG_CONFIG_SRC_INFO
+#define flog_layout_field_src_info flog_layout_field_none
+#define flog_layout_field_src_file flog_layout_field_none
+#define flog_layout_field_src_line flog_layout_field_none
+#define flog_layout_field_src_func flog_layout_field_none
+#endif //FLOG_CONFIG_SRC_INFO
+
+
+//! %S - subsystem
+static void flog_layout_field_subsystem(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	flog_layout_put_str(o,msg->subsystem);
+}
+
+
+//! %L - message type label
+static void flog_layout_field_label(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	const char *label;
+	size_t len;
+	if((label=flog_get_msg_type_label(msg->type,&len))==NULL)
+		return;
+#ifdef FLOG_CONFIG_OUTPUT_ANSI_COLOR
+	const char *color;
+	if((flags & FLOG_OUTPUT_FLAG_ANSI_COLOR) && (color=flog_get_msg_type_color(msg->type))) {
+		flog_layout_put_str(o,color);
+		flog_layout_put(o,label,len);
+		flog_layout_put(o,FLOG_ANSI_COLOR_RESET,sizeof(FLOG_ANSI_COLOR_RESET)-1);
+		return;
+	}
+#else //FLOG_CONFIG_OUTPUT_ANSI_COLOR
+	(void)flags;
+#endif //FLOG_CONFIG_OUTPUT_ANSI_COLOR
+	flog_layout_put(o,label,len);
+}
+
+
+#ifdef FLOG_CONFIG_MSG_ID_STRINGS
+extern const char *flog_msg_id_str[];
+#endif //FLOG_CONFIG_MSG_ID_STRINGS
+
+
+//! %I - message ID, like flog_get_str_msg_id()
+static void flog_layout_field_msg_id(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	if(msg->msg_id==0)
+		return;
+	if(msg->msg_id>=FLOG_MSG_ID_AMOUNT_RESERVED_FOR_ERRNO) {
+#ifdef FLOG_CONFIG_MSG_ID_STRINGS
+#ifdef FLOG_CONFIG_OUTPUT_SHOW_MSG_ID
+		flog_layout_put(o,"(",1);
+		flog_layout_put_uint(o,msg->msg_id);
+		flog_layout_put(o,") ",2);
+#endif //FLOG_CONFIG_OUTPUT_SHOW_MSG_ID
+		flog_layout_put_str(o,flog_msg_id_str[msg->msg_id-FLOG_MSG_ID_AMOUNT_RESERVED_FOR_ERRNO]);
+#else //FLOG_CONFIG_MSG_ID_STRINGS
+		flog_layout_put_uint(o,msg->msg_id);
+#endif //FLOG_CONFIG_MSG_ID_STRINGS
+	} else {
+#ifdef FLOG_CONFIG_ERRNO_STRINGS
+		char buf[128];
+#ifdef FLOG_CONFIG_OUTPUT_SHOW_MSG_ID
+		flog_layout_put(o,"(",1);
+		flog_layout_put_uint(o,msg->msg_id);
+		flog_layout_put(o,") ",2);
+#endif //FLOG_CONFIG_OUTPUT_SHOW_MSG_ID
+		flog_layout_put_str(o,strerror_r(msg->msg_id,buf,sizeof(buf)));
+#else //FLOG_CONFIG_ERRNO_STRINGS
+		flog_layout_put(o,"(",1);
+		flog_layout_put_uint(o,msg->msg_id);
+		flog_layout_put(o,")",1);
+#endif //FLOG_CONFIG_ERRNO_STRINGS
+	}
+}
+
+
+#ifdef FLOG_CONFIG_ESCAPE
+//! Append escaped text to the output (nothing if NULL)
+static void flog_layout_put_escaped(FLOG_LAYOUT_OUT_T *o,const char *s,uint_fast8_t mode)
+{
+	if(s) {
+		if(o->len<o->size)
+			o->len+=flog_escape(o->buf+o->len,o->size-o->len,s,strlen(s),mode);
+		else
+			o->len+=flog_escape(NULL,0,s,strlen(s),mode);
+	}
+}
+
+
+//! Render a field escaped for a JSON string, without colors (%J)
+
+//! The field is rendered into a stack buffer first, or an allocated one
+//! if it does not fit. If that fails what fitted is escaped.
+static void flog_layout_put_field_json(FLOG_LAYOUT_OUT_T *o,FLOG_LAYOUT_FIELD_T field,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	char buf[256];
+	FLOG_LAYOUT_OUT_T f={buf,sizeof(buf),0};
+	flags&=(uint_fast8_t)~(FLOG_OUTPUT_FLAG_ANSI_COLOR|FLOG_OUTPUT_FLAG_ESCAPE);
+	field(&f,msg,flags);
+	if(f.len>sizeof(buf)) {
+		if((f.buf=flog_malloc(f.len))!=NULL) {
+			f.size=f.len;
+			f.len=0;
+			field(&f,msg,flags);
+		} else {
+			f.buf=buf;
+			f.len=sizeof(buf);
+		}
+	}
+	if(o->len<o->size)
+		o->len+=flog_escape(o->buf+o->len,o->size-o->len,f.buf,f.len,FLOG_ESCAPE_JSON);
+	else
+		o->len+=flog_escape(NULL,0,f.buf,f.len,FLOG_ESCAPE_JSON);
+	if(f.buf!=buf)
+		flog_free(f.buf);
+}
+
+
+//! %e - message text with control characters escaped
+static void flog_layout_field_text_escaped(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	flog_layout_put_escaped(o,msg->text,FLOG_ESCAPE_TEXT);
+}
+
+
+//! %j - message text escaped for a JSON string
+static void flog_layout_field_text_json(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	flog_layout_put_escaped(o,msg->text,FLOG_ESCAPE_JSON);
+}
+#endif //FLOG_CONFIG_ESCAPE
+
+
+//! %m - message text
+static void flog_layout_field_text(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+#ifdef FLOG_CONFIG_ESCAPE
+	if(flags & FLOG_OUTPUT_FLAG_ESCAPE) {
+		flog_layout_put_escaped(o,msg->text,FLOG_ESCAPE_TEXT);
+		return;
+	}
+#else //FLOG_CONFIG_ESCAPE
+	(void)flags;
+#endif //FLOG_CONFIG_ESCAPE
+	flog_layout_put_str(o,msg->text);
+}
+
+
+#ifdef FLOG_CONFIG_SAMPLING
+//! %r - sampling note
+static void flog_layout_field_sampled(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	if(msg->sample_rate>1) {
+		flog_layout_put(o,"(sampled 1/",11);
+		flog_layout_put_uint(o,msg->sample_rate);
+		flog_layout_put(o,")",1);
+	}
+}
+#else //FLOG_CONFIG_SAMPLING
+#define flog_layout_field_sampled flog_layout_field_none
+#endif //FLOG_CONFIG_SAMPLING
+
+
+#ifdef FLOG_CONFIG_TRACE
+//! %D - duration and depth of a span
+static void flog_layout_field_span(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	char str[64];
+	(void)flags;
+	if(msg->span_depth)
+		flog_layout_put(o,str,(size_t)flog_trace_str_span(str,sizeof(str),msg));
+}
+#else //FLOG_CONFIG_TRACE
+#define flog_layout_field_span flog_layout_field_none
+#endif //FLOG_CONFIG_TRACE
+
+
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+//! %C - context entries of the thread
+static void flog_layout_field_context(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	if(!msg->context)
+		return;
+#ifdef FLOG_CONFIG_ESCAPE
+	if(flags & FLOG_OUTPUT_FLAG_ESCAPE) {
+		flog_layout_put_escaped(o,msg->context->text,FLOG_ESCAPE_TEXT);
+		return;
+	}
+#else //FLOG_CONFIG_ESCAPE
+	(void)flags;
+#endif //FLOG_CONFIG_ESCAPE
+	flog_layout_put(o,msg->context->text,msg->context->len);
+}
+
+
+//! %t - thread id
+static void flog_layout_field_thread_id(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	if(msg->context)
+		flog_layout_put_uint(o,msg->context->tid);
+}
+
+
+//! %N - thread name
+static void flog_layout_field_thread_name(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	(void)flags;
+	if(msg->context)
+		flog_layout_put_str(o,msg->context->name);
+}
+#else //FLOG_CONFIG_CONTEXT_SIZE
+#define flog_layout_field_context flog_layout_field_none
+#define flog_layout_field_thread_id flog_layout_field_none
+#define flog_layout_field_thread_name flog_layout_field_none
+#endif //FLOG_CONFIG_CONTEXT_SIZE
+
+
+//! Get the renderer of a field character
+
+//! @return renderer, or NULL if c is not a field
+static FLOG_LAYOUT_FIELD_T flog_layout_get_field(char c)
+{
+	switch(c) {
+	case 'T': return(flog_layout_field_timestamp);
+	case 'P': return(flog_layout_field_src_info);
+	case 'F': return(flog_layout_field_src_file);
+	case 'l': return(flog_layout_field_src_line);
+	case 'f': return(flog_layout_field_src_func);
+	case 'S': return(flog_layout_field_subsystem);
+	case 'L': return(flog_layout_field_label);
+	case 'I': return(flog_layout_field_msg_id);
+	case 'm': return(flog_layout_field_text);
+#ifdef FLOG_CONFIG_ESCAPE
+	case 'e': return(flog_layout_field_text_escaped);
+	case 'j': return(flog_layout_field_text_json);
+#endif
+	case 'r': return(flog_layout_field_sampled);
+	case 'D': return(flog_layout_field_span);
+	case 'C': return(flog_layout_field_context);
+	case 't': return(flog_layout_field_thread_id);
+	case 'N': return(flog_layout_field_thread_name);
+	default: return(NULL);
+	}
+}
+
+
+//! Classify the text of a group as prefix, separator or suffix
+static void flog_layout_classify(FLOG_LAYOUT_T *l,unsigned int i,unsigned int end)
+{
+	unsigned int j,first=end,last=end;
+	for(j=i;j<end;j=(l->op[j].kind==FLOG_LAYOUT_OP_GROUP) ? l->op[j].pos : j+1) {
+		if(l->op[j].kind==FLOG_LAYOUT_OP_SEPARATOR)
+			continue;
+		if(first==end)
+			first=j;
+		last=j;
+		if(l->op[j].kind==FLOG_LAYOUT_OP_GROUP)
+			flog_layout_classify(l,j+1,l->op[j].pos);
+	}
+	for(j=i;j<end;j=(l->op[j].kind==FLOG_LAYOUT_OP_GROUP) ? l->op[j].pos : j+1) {
+		if(l->op[j].kind!=FLOG_LAYOUT_OP_SEPARATOR)
+			continue;
+		if(j<first)
+			l->op[j].kind=FLOG_LAYOUT_OP_PREFIX;
+		else if(j>last)
+			l->op[j].kind=FLOG_LAYOUT_OP_SUFFIX;
+	}
+}
+
+
+//! Compile a layout pattern
+
+//! @param[in] *pattern layout pattern (see flog_layout.h)
+//! @retval NULL invalid pattern or out of memory
+FLOG_LAYOUT_T * create_flog_layout(const char *pattern)
+{
+	FLOG_LAYOUT_T *l;
+	FLOG_LAYOUT_OP_T *op;
+	FLOG_LAYOUT_FIELD_T field;
+	size_t len=strlen(pattern);
+	uint16_t text_len=0,group[FLOG_LAYOUT_MAX_DEPTH];
+	unsigned int depth=0;
+	int text=0; //last operation is text which can be extended
+	int json=0; //next field is escaped for a JSON string
+	char c;
+	if(len>=UINT16_MAX)
+		return(NULL);
+	if((l=flog_calloc(1,sizeof(FLOG_LAYOUT_T)))==NULL)
+		return(NULL);
+	if((l->op=flog_malloc((len+1)*sizeof(FLOG_LAYOUT_OP_T)))==NULL || (l->text=flog_malloc(len+1))==NULL)
+		goto error;
+	while((c=*pattern++)) {
+		if(c=='%') {
+			c=*pattern++;
+#ifdef FLOG_CONFIG_ESCAPE
+			if(c=='J') {
+				//a field escaped for a JSON string
+				if(!flog_layout_get_field((c=*pattern++)))
+					goto error;
+				json=1;
+			}
+#endif
+			switch(c) {
+			case 'n':
+				c='\n';
+				break;
+			case '%':
+				break;
+			case '{':
+				if(depth==FLOG_LAYOUT_MAX_DEPTH)
+					goto error;
+				group[depth++]=l->op_amount;
+				op=&l->op[l->op_amount++];
+				op->field=NULL;
+				op->kind=FLOG_LAYOUT_OP_GROUP;
+				op->len=0;
+				text=0;
+				continue;
+			case '}':
+				if(!depth)
+					goto error;
+				l->op[group[--depth]].pos=l->op_amount;
+				text=0;
+				continue;
+			default:
+				if((field=flog_layout_get_field(c))==NULL)
+					goto error;
+				op=&l->op[l->op_amount++];
+				op->field=field;
+				op->kind=FLOG_LAYOUT_OP_FIELD;
+				op->json=json;
+				op->pos=0;
+				op->len=0;
+				json=0;
+				text=0;
+				continue;
+			}
+		}
+		//text, appended to the previous operation if that is text in the same group
+		if(text)
+			l->op[l->op_amount-1].len++;
+		else {
+			op=&l->op[l->op_amount++];
+			op->field=NULL;
+			op->kind=FLOG_LAYOUT_OP_SEPARATOR;
+			op->pos=text_len;
+			op->len=1;
+			text=1;
+		}
+		l->text[text_len++]=c;
+	}
+	if(depth)
+		goto error;
+	flog_layout_classify(l,0,l->op_amount);
+	return(l);
+error:
+	destroy_flog_layout(l);
+	return(NULL);
+}
+
+
+//! Free a compiled layout
+void destroy_flog_layout(FLOG_LAYOUT_T *l)
+{
+	if(l) {
+		flog_free(l->op);
+		flog_free(l->text);
+		flog_free(l);
+	}
+}
+
+
+//! Compiled FLOG_LAYOUT_DEFAULT, created on first use
+static FLOG_LAYOUT_T *flog_layout_default;
+
+
+//! Get the layout used by logs without their own layout
+
+//! @retval NULL out of memory
+const FLOG_LAYOUT_T * flog_get_default_layout(void)
+{
+	FLOG_LAYOUT_T *l,*expected=NULL;
+	if((l=__atomic_load_n(&flog_layout_default,__ATOMIC_ACQUIRE)))
+		return(l);
+	if((l=create_flog_layout(FLOG_LAYOUT_DEFAULT))==NULL)
+		return(NULL);
+	if(!__atomic_compare_exchange_n(&flog_layout_default,&expected,l,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE)) {
+		destroy_flog_layout(l); //another thread was first
+		l=expected;
+	}
+	return(l);
+}
+
+
+//! Free the layout used by logs without their own layout
+
+//! It is created again when next used. Only call when no messages are
+//! being output with it, like flog_intern_clear().
+void flog_layout_clear(void)
+{
+	destroy_flog_layout(__atomic_exchange_n(&flog_layout_default,NULL,__ATOMIC_ACQ_REL));
+}
+
+
+//! Set or replace the layout of a log
+
+//! Must not be called while messages are being output by p.
+//! @param[in,out] *p log
+//! @param[in] *pattern layout pattern (see flog_layout.h), NULL to use the default layout
+//! @retval 0 success
+//! @retval 1 error, the old layout is kept
+int flog_set_layout(FLOG_T *p,const char *pattern)
+{
+	FLOG_LAYOUT_T *l=NULL;
+	if(pattern && (l=create_flog_layout(pattern))==NULL)
+		return(1);
+	destroy_flog_layout(p->layout);
+	p->layout=l;
+	return(0);
+}
+
+
+//! Render the operations from i up to end
+
+//! @return 1 if any field was written, 0 if nothing was
+static int flog_layout_render_ops(const FLOG_LAYOUT_T *l,unsigned int i,unsigned int end,FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	const FLOG_LAYOUT_OP_T *op,*sep=NULL;
+	size_t start=o->len,mark,field_start;
+	int any=0,written;
+	while(i<end) {
+		op=&l->op[i++];
+		switch(op->kind) {
+		case FLOG_LAYOUT_OP_SEPARATOR:
+			sep=op;
+			break;
+		case FLOG_LAYOUT_OP_PREFIX:
+		case FLOG_LAYOUT_OP_SUFFIX:
+			flog_layout_put(o,l->text+op->pos,op->len);
+			break;
+		default:
+			mark=o->len;
+			if(any && sep)
+				flog_layout_put(o,l->text+sep->pos,sep->len);
+			field_start=o->len;
+			if(op->kind==FLOG_LAYOUT_OP_GROUP) {
+				written=flog_layout_render_ops(l,i,op->pos,o,msg,flags);
+				i=op->pos;
+			} else {
+#ifdef FLOG_CONFIG_ESCAPE
+				if(op->json)
+					flog_layout_put_field_json(o,op->field,msg,flags);
+				else
+#endif
+					op->field(o,msg,flags);
+				written=(o->len!=field_start);
+			}
+			if(written) {
+				any=1;
+				sep=NULL;
+			} else
+				o->len=mark;
+			break;
+		}
+	}
+	if(!any)
+		o->len=start;
+	return(any);
+}
+
+
+//! Render a message with a layout
+
+//! Like snprintf(), the buffer is only written up to size and always
+//! terminated, but the full length is returned.
+//! @param[in] *l compiled layout
+//! @param[out] *buf buffer to render into
+//! @param[in] size size of buf
+//! @param[in] *msg message
+//! @param[in] flags output options (see FLOG_OUTPUT_FLAG_*)
+//! @return length of rendered message (0 if nothing to output)
+size_t flog_layout_render(const FLOG_LAYOUT_T *l,char *buf,size_t size,const FLOG_MSG_T *msg,uint_fast8_t flags)
+{
+	FLOG_LAYOUT_OUT_T o={buf,size,0};
+	flog_layout_render_ops(l,0,l->op_amount,&o,msg,flags);
+	if(size)
+		buf[(o.len<size) ? o.len : size-1]=0;
+	return(o.len);
+}
+
+#endif //FLOG_CONFIG_LAYOUT
@@ -0,0 +1,110 @@
+//! Line layouts for Flog
+
+//! @file flog_layout.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! A layout is a pattern such as "%T %S %L: %m%n" which is compiled once
+//! into a list of operations, so rendering a message is a straight run of
+//! appends. Each log can have its own layout (see flog_set_layout()).
+//!
+//! Fields are:
+//! - %T timestamp
+//! - %P source position as "file:line|function()"
+//! - %F source file, %l source line, %f source function
+//! - %S subsystem
+//! - %L message type label (colored with FLOG_OUTPUT_FLAG_ANSI_COLOR)
+//! - %I message ID
+//! - %m message text (escaped with FLOG_OUTPUT_FLAG_ESCAPE)
+//! - %e message text with control characters escaped, %j message text
+//!   escaped for a JSON string (requires FLOG_CONFIG_ESCAPE)
+//! - %r sampling note "(sampled 1/N)"
+//! - %D duration and depth of spans "(1.250 ms, depth 2)" (requires
+//!   FLOG_CONFIG_TRACE, see flog_trace.h)
+//! - %C context entries of the thread as "key=value key=value" (escaped
+//!   with FLOG_OUTPUT_FLAG_ESCAPE), %t thread id, %N thread name (requires
+//!   FLOG_CONFIG_CONTEXT_SIZE, see flog_context.h)
+//!
+//! %J before a field, such as %JS, escapes it for a JSON string and
+//! leaves out colors (requires FLOG_CONFIG_ESCAPE), %j is the same as %Jm.
+//!
+//! %n is a newline and %% a '%'. Fields which are empty or not
+//! configured render nothing, and the text around them follows them:
+//! text between two fields is only written when both are non-empty, text
+//! before the first or after the last field only when any field is.
+//! %{ and %} make a group which counts as one field, so
+//! "%{[%T %S]%} %m" renders "[time subsystem] text", "[subsystem] text"
+//! or just "text".
+
+
+#ifndef FLOG_LAYOUT_H
+#define FLOG_LAYOUT_H
+
+#include "flog.h"
+#include <stddef.h>
+
+#ifdef FLOG_CONFIG_LAYOUT
+
+// Sanity checks
+#ifndef FLOG_CONFIG_STRING_OUTPUT
+#error FLOG_CONFIG_LAYOUT requires FLOG_CONFIG_STRING_OUTPUT
+#endif
+
+
+//! Layout used by logs without their own layout, renders like earlier versions of flog
+#define FLOG_LAYOUT_DEFAULT "%{[%T %P %S]%} %{%L: %I: %m%} %D %r%n"
+
+#ifdef FLOG_CONFIG_ESCAPE
+//! Layout writing one JSON object per line, fields which are empty are left out
+#define FLOG_LAYOUT_JSON "{%{\"time\":\"%T\"%},%{\"src\":\"%JP\"%},%{\"subsystem\":\"%JS\"%},%{\"type\":\"%JL\"%},%{\"id\":\"%JI\"%},%{\"text\":\"%j\"%}}%n"
+#endif //FLOG_CONFIG_ESCAPE
+
+//! Kinds of layout operations
+enum {
+	FLOG_LAYOUT_OP_PREFIX,                  //!< text before the first field of a group
+	FLOG_LAYOUT_OP_SEPARATOR,               //!< text between two fields
+	FLOG_LAYOUT_OP_SUFFIX,                  //!< text after the last field of a group
+	FLOG_LAYOUT_OP_FIELD,                   //!< field of the message
+	FLOG_LAYOUT_OP_GROUP                    //!< start of a group, ends at FLOG_LAYOUT_OP_T.pos
+};
+
+
+//! Output of a layout being rendered
+typedef struct {
+	char *buf;                              //!< buffer to render into
+	size_t size;                            //!< size of buffer
+	size_t len;                             //!< length of output, may be more than fits in buf
+} FLOG_LAYOUT_OUT_T;
+
+
+//! Field renderer, appends one field of a message
+typedef void (*FLOG_LAYOUT_FIELD_T)(FLOG_LAYOUT_OUT_T *o,const FLOG_MSG_T *msg,uint_fast8_t flags);
+
+
+//! Operation of a compiled layout
+typedef struct {
+	FLOG_LAYOUT_FIELD_T field;              //!< field renderer (NULL for text and groups)
+	uint8_t kind;                           //!< one of FLOG_LAYOUT_OP_*
+	uint8_t json;                           //!< field: escaped for a JSON string (%J)
+	uint16_t pos;                           //!< text: offset in FLOG_LAYOUT_T.text, group: index after its end
+	uint16_t len;                           //!< text: length
+} FLOG_LAYOUT_OP_T;
+
+
+//! Compiled layout
+typedef struct flog_layout_t {
+	FLOG_LAYOUT_OP_T *op;                   //!< array of operations
+	uint16_t op_amount;                     //!< amount of operations in array
+	char *text;                             //!< literal text of all operations
+} FLOG_LAYOUT_T;
+
+
+FLOG_LAYOUT_T * create_flog_layout(const char *pattern);
+void destroy_flog_layout(FLOG_LAYOUT_T *l);
+const FLOG_LAYOUT_T * flog_get_default_layout(void);
+void flog_layout_clear(void);
+int flog_set_layout(FLOG_T *p,const char *pattern);
+size_t flog_layout_render(const FLOG_LAYOUT_T *l,char *buf,size_t size,const FLOG_MSG_T *msg,uint_fast8_t flags);
+
+#endif //FLOG_CONFIG_LAYOUT
+
+#endif //FLOG_LAYOUT_H
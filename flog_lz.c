@@ -0,0 +1,312 @@
+//! Block compression for Flog
+
+//! @file flog_lz.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! The compressor finds matches through a hash table of the last position
+//! of each 4 byte sequence, and skips ahead faster in data that does not
+//! compress. Log text is repetitive, so this single probe finds most of
+//! what a slower search would. The decompressor checks every length and
+//! offset, so damaged files are detected instead of overrunning buffers.
+
+#include "flog_lz.h"
+
+#ifdef FLOG_CONFIG_OUTPUT_COMPRESSED
+
+#include <string.h>
+
+
+//! Bits of the match finder hash table
+#define FLOG_LZ_HASH_BITS 12
+
+//! Shortest match
+#define FLOG_LZ_MIN_MATCH 4
+
+//! Farthest match
+#define FLOG_LZ_MAX_OFFSET 65535
+
+
+//! Read 4 bytes from any address
+static inline uint32_t flog_lz_read32(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v,p,sizeof(v));
+	return(v);
+}
+
+
+//! Hash 4 bytes for the match finder
+static inline unsigned int flog_lz_hash(uint32_t v)
+{
+	return((unsigned int)((v*2654435761u)>>(32-FLOG_LZ_HASH_BITS)));
+}
+
+
+//! Write the rest of a length which did not fit in its nibble
+static inline unsigned char * flog_lz_put_len(unsigned char *op, size_t len)
+{
+	while(len>=255) {
+		*op++=255;
+		len-=255;
+	}
+	*op++=(unsigned char)len;
+	return(op);
+}
+
+
+//! Read the rest of a length which did not fit in its nibble
+
+//! @retval 0 success
+//! @retval -1 data ended
+static inline int flog_lz_get_len(const unsigned char **ip, const unsigned char *end, size_t *len)
+{
+	unsigned char b;
+	do {
+		if(*ip>=end)
+			return(-1);
+		b=*(*ip)++;
+		*len+=b;
+	} while(b==255);
+	return(0);
+}
+
+
+//! Write a little endian uint32
+static inline void flog_lz_put32(unsigned char *p, uint32_t v)
+{
+	p[0]=(unsigned char)v;
+	p[1]=(unsigned char)(v>>8);
+	p[2]=(unsigned char)(v>>16);
+	p[3]=(unsigned char)(v>>24);
+}
+
+
+//! Read a little endian uint32
+static inline uint32_t flog_lz_get32(const unsigned char *p)
+{
+	return((uint32_t)p[0] | (uint32_t)p[1]<<8 | (uint32_t)p[2]<<16 | (uint32_t)p[3]<<24);
+}
+
+
+//! Adler-32 checksum
+
+//! @param[in] *buf data
+//! @param[in] len length of data
+//! @return checksum
+uint32_t flog_lz_adler32(const void *buf, size_t len)
+{
+	const unsigned char *p=buf;
+	uint32_t a=1,b=0;
+	size_t n;
+	while(len) {
+		n=(len<5552) ? len : 5552; //most bytes before the sums can overflow
+		len-=n;
+		while(n--) {
+			a+=*p++;
+			b+=a;
+		}
+		a%=65521;
+		b%=65521;
+	}
+	return(b<<16 | a);
+}
+
+
+//! Compress a block
+
+//! @param[in] *src data
+//! @param[in] len length of data
+//! @param[out] *dst compressed data
+//! @param[in] dst_size size of dst, at least flog_lz_bound(len)
+//! @return length of compressed data, 0 if dst is too small
+size_t flog_lz_compress(const void *src, size_t len, void *dst, size_t dst_size)
+{
+	const unsigned char *base=src,*ip=base,*anchor=base,*end=base+len,*ref,*m,*r;
+	unsigned char *op=dst,*token;
+	uint32_t table[1<<FLOG_LZ_HASH_BITS],v;
+	size_t lit,match,off,step;
+	unsigned int h;
+	if(dst_size<flog_lz_bound(len))
+		return(0);
+	memset(table,0,sizeof(table));
+	while((size_t)(end-ip)>=FLOG_LZ_MIN_MATCH) {
+		v=flog_lz_read32(ip);
+		h=flog_lz_hash(v);
+		ref=base+table[h];
+		table[h]=(uint32_t)(ip-base);
+		if(ref>=ip || ip-ref>FLOG_LZ_MAX_OFFSET || flog_lz_read32(ref)!=v) {
+			step=1+((size_t)(ip-anchor)>>6); //step faster through data without matches
+			if((size_t)(end-ip)<step+FLOG_LZ_MIN_MATCH)
+				break;
+			ip+=step;
+			continue;
+		}
+		for(m=ip+FLOG_LZ_MIN_MATCH,r=ref+FLOG_LZ_MIN_MATCH;m<end && *m==*r;m++,r++)
+			;
+		lit=(size_t)(ip-anchor);
+		match=(size_t)(m-ip)-FLOG_LZ_MIN_MATCH;
+		off=(size_t)(ip-ref);
+		token=op++;
+		*token=(unsigned char)(((lit<15) ? lit : 15)<<4 | ((match<15) ? match : 15));
+		if(lit>=15)
+			op=flog_lz_put_len(op,lit-15);
+		memcpy(op,anchor,lit);
+		op+=lit;
+		*op++=(unsigned char)off;
+		*op++=(unsigned char)(off>>8);
+		if(match>=15)
+			op=flog_lz_put_len(op,match-15);
+		ip=anchor=m;
+	}
+	lit=(size_t)(end-anchor);
+	*op++=(unsigned char)(((lit<15) ? lit : 15)<<4);
+	if(lit>=15)
+		op=flog_lz_put_len(op,lit-15);
+	memcpy(op,anchor,lit);
+	op+=lit;
+	return((size_t)(op-(unsigned char *)dst));
+}
+
+
+//! Decompress a block
+
+//! @param[in] *src compressed data
+//! @param[in] len length of compressed data
+//! @param[out] *dst data
+//! @param[in] dst_size size of dst
+//! @param[out] *out_len length of data
+//! @retval 0 success
+//! @retval -1 damaged data, or dst is too small
+int flog_lz_decompress(const void *src, size_t len, void *dst, size_t dst_size, size_t *out_len)
+{
+	const unsigned char *ip=src,*end=ip+len,*r;
+	unsigned char *op=dst,*oend=op+dst_size;
+	size_t lit,match,off;
+	unsigned int token;
+	while(ip<end) {
+		token=*ip++;
+		lit=token>>4;
+		if(lit==15 && flog_lz_get_len(&ip,end,&lit))
+			return(-1);
+		if((size_t)(end-ip)<lit || (size_t)(oend-op)<lit)
+			return(-1);
+		memcpy(op,ip,lit);
+		op+=lit;
+		ip+=lit;
+		if(ip==end)
+			break; //last sequence
+		if(end-ip<2)
+			return(-1);
+		off=(size_t)ip[0] | (size_t)ip[1]<<8;
+		ip+=2;
+		if(off==0 || off>(size_t)(op-(unsigned char *)dst))
+			return(-1);
+		match=token&15;
+		if(match==15 && flog_lz_get_len(&ip,end,&match))
+			return(-1);
+		match+=FLOG_LZ_MIN_MATCH;
+		if((size_t)(oend-op)<match)
+			return(-1);
+		for(r=op-off;match--;) //byte by byte, matches may overlap the output
+			*op++=*r++;
+	}
+	*out_len=(size_t)(op-(unsigned char *)dst);
+	return(0);
+}
+
+
+//! Write a frame header
+static void flog_lz_put_header(unsigned char *header, const void *src, size_t len, uint32_t stored)
+{
+	memcpy(header,FLOG_LZ_FRAME_MAGIC,4);
+	flog_lz_put32(header+4,(uint32_t)len);
+	flog_lz_put32(header+8,stored);
+	flog_lz_put32(header+12,flog_lz_adler32(src,len));
+}
+
+
+//! Make the header of a frame which stores data as it is
+
+//! For when there is no memory to compress into, such as in a signal
+//! handler. The data follows the header unchanged.
+//! @param[out] *header FLOG_LZ_FRAME_HEADER_SIZE bytes
+//! @param[in] *src data
+//! @param[in] len length of data (at most FLOG_LZ_FRAME_MAX)
+void flog_lz_frame_stored(void *header, const void *src, size_t len)
+{
+	flog_lz_put_header(header,src,len,(uint32_t)len|FLOG_LZ_FRAME_STORED);
+}
+
+
+//! Make a frame of a block
+
+//! The data is stored as it is if it does not compress.
+//! @param[out] *dst frame
+//! @param[in] dst_size size of dst, at least flog_lz_frame_bound(len)
+//! @param[in] *src data
+//! @param[in] len length of data (at most FLOG_LZ_FRAME_MAX)
+//! @return length of frame, 0 if dst is too small
+size_t flog_lz_frame(void *dst, size_t dst_size, const void *src, size_t len)
+{
+	unsigned char *header=dst;
+	uint32_t stored;
+	size_t n;
+	if(len>FLOG_LZ_FRAME_MAX || dst_size<flog_lz_frame_bound(len))
+		return(0);
+	n=flog_lz_compress(src,len,header+FLOG_LZ_FRAME_HEADER_SIZE,dst_size-FLOG_LZ_FRAME_HEADER_SIZE);
+	if(n && n<len)
+		stored=(uint32_t)n;
+	else {
+		memcpy(header+FLOG_LZ_FRAME_HEADER_SIZE,src,len);
+		n=len;
+		stored=(uint32_t)n|FLOG_LZ_FRAME_STORED;
+	}
+	flog_lz_put_header(header,src,len,stored);
+	return(FLOG_LZ_FRAME_HEADER_SIZE+n);
+}
+
+
+//! Parse a frame header
+
+//! @param[in] *header FLOG_LZ_FRAME_HEADER_SIZE bytes
+//! @param[out] *frame parsed header
+//! @retval 0 success
+//! @retval -1 not a frame header
+int flog_lz_frame_header(const void *header, FLOG_LZ_FRAME_T *frame)
+{
+	const unsigned char *p=header;
+	uint32_t stored;
+	if(memcmp(p,FLOG_LZ_FRAME_MAGIC,4))
+		return(-1);
+	frame->raw_len=flog_lz_get32(p+4);
+	stored=flog_lz_get32(p+8);
+	frame->compressed=!(stored & FLOG_LZ_FRAME_STORED);
+	frame->stored_len=stored & ~FLOG_LZ_FRAME_STORED;
+	frame->check=flog_lz_get32(p+12);
+	if(frame->raw_len>FLOG_LZ_FRAME_MAX || (!frame->compressed && frame->stored_len!=frame->raw_len))
+		return(-1);
+	return(0);
+}
+
+
+//! Decode the payload of a frame
+
+//! @param[in] *frame parsed header
+//! @param[in] *payload frame->stored_len bytes following the header
+//! @param[out] *dst frame->raw_len bytes of data
+//! @retval 0 success
+//! @retval -1 damaged frame
+int flog_lz_frame_decode(const FLOG_LZ_FRAME_T *frame, const void *payload, void *dst)
+{
+	size_t len;
+	if(frame->compressed) {
+		if(flog_lz_decompress(payload,frame->stored_len,dst,frame->raw_len,&len) || len!=frame->raw_len)
+			return(-1);
+	} else
+		memcpy(dst,payload,frame->raw_len);
+	if(flog_lz_adler32(dst,frame->raw_len)!=frame->check)
+		return(-1);
+	return(0);
+}
+
+#endif //FLOG_CONFIG_OUTPUT_COMPRESSED
@@ -0,0 +1,71 @@
+//! Block compression for Flog
+
+//! @file flog_lz.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! A small LZ77 codec in the style of LZ4, and the frame format of
+//! compressed log files. Each frame is compressed on its own, so a reader
+//! can skip frames by their header and decompress only a range.
+//!
+//! Frame header, 16 bytes, numbers in little endian:
+//! - "FLZ1"
+//! - uint32 length of the data
+//! - uint32 length of the stored payload, FLOG_LZ_FRAME_STORED is set
+//!   when the payload is the data itself instead of compressed data
+//! - uint32 Adler-32 checksum of the data
+//!
+//! Compressed data is a list of sequences: a token byte with the amount
+//! of literals in the high and the match length minus 4 in the low
+//! nibble (15 means more length bytes follow, each adding up to 255),
+//! the literals, then a 2 byte offset back in the output and more match
+//! length bytes. The last sequence has only literals.
+
+
+#ifndef FLOG_LZ_H
+#define FLOG_LZ_H
+
+#include "config.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef FLOG_CONFIG_OUTPUT_COMPRESSED
+
+//! Magic bytes starting each frame
+#define FLOG_LZ_FRAME_MAGIC "FLZ1"
+
+//! Size of a frame header
+#define FLOG_LZ_FRAME_HEADER_SIZE 16
+
+//! Flag in the stored length of a frame whose payload is not compressed
+#define FLOG_LZ_FRAME_STORED 0x80000000u
+
+//! Largest data a frame can hold
+#define FLOG_LZ_FRAME_MAX (FLOG_LZ_FRAME_STORED-1)
+
+//! Most bytes compressing len bytes can produce
+#define flog_lz_bound(len) ((len)+(len)/255+16)
+
+//! Most bytes a frame of len bytes of data can take
+#define flog_lz_frame_bound(len) (FLOG_LZ_FRAME_HEADER_SIZE+flog_lz_bound(len))
+
+
+//! Parsed frame header
+typedef struct {
+	uint32_t raw_len;                       //!< length of the data
+	uint32_t stored_len;                    //!< length of the payload following the header
+	uint_fast8_t compressed;                //!< payload is compressed
+	uint32_t check;                         //!< Adler-32 checksum of the data
+} FLOG_LZ_FRAME_T;
+
+
+uint32_t flog_lz_adler32(const void *buf, size_t len);
+size_t flog_lz_compress(const void *src, size_t len, void *dst, size_t dst_size);
+int flog_lz_decompress(const void *src, size_t len, void *dst, size_t dst_size, size_t *out_len);
+void flog_lz_frame_stored(void *header, const void *src, size_t len);
+size_t flog_lz_frame(void *dst, size_t dst_size, const void *src, size_t len);
+int flog_lz_frame_header(const void *header, FLOG_LZ_FRAME_T *frame);
+int flog_lz_frame_decode(const FLOG_LZ_FRAME_T *frame, const void *payload, void *dst);
+
+#endif //FLOG_CONFIG_OUTPUT_COMPRESSED
+
+#endif //FLOG_LZ_H
@@ -60,6 +60,45 @@ X(FLOG_MSG_SET_OUTPUT_FILE,        "Please set output file")
 #endif
 
 
+//! Message ids for shared memory output module
+#if defined(FLOG_CONFIG_OUTPUT_SHM) || defined(FLOG_CONFIG_MSG_ID_STRINGS_EXTENDED)
+#define FLOG_MSG_IDS_OUTPUT_SHM \
+X(FLOG_MSG_CANNOT_OPEN_SHM,        "Cannot open shared memory") \
+X(FLOG_MSG_SET_OUTPUT_SHM,         "Please set shared memory")
+#else
+#define FLOG_MSG_IDS_OUTPUT_SHM
+#endif
+
+
+//! Message ids for trace output module
+#if defined(FLOG_CONFIG_TRACE) || defined(FLOG_CONFIG_MSG_ID_STRINGS_EXTENDED)
+#define FLOG_MSG_IDS_TRACE \
+X(FLOG_MSG_CANNOT_WRITE_TRACE,     "Cannot write trace"    ) \
+X(FLOG_MSG_SET_OUTPUT_TRACE,       "Please set trace file" )
+#else
+#define FLOG_MSG_IDS_TRACE
+#endif
+
+
+//! Message ids for load shedding governor module
+#if defined(FLOG_CONFIG_GOVERNOR) || defined(FLOG_CONFIG_MSG_ID_STRINGS_EXTENDED)
+#define FLOG_MSG_IDS_GOVERNOR \
+X(FLOG_MSG_SHEDDING_MESSAGES,      "Shedding messages"     ) \
+X(FLOG_MSG_STOPPED_SHEDDING,       "Stopped shedding"      )
+#else
+#define FLOG_MSG_IDS_GOVERNOR
+#endif
+
+
+//! Message ids for configuration loader module
+#if defined(FLOG_CONFIG_LOADER) || defined(FLOG_CONFIG_MSG_ID_STRINGS_EXTENDED)
+#define FLOG_MSG_IDS_LOADER \
+X(FLOG_MSG_CONF_ERROR,             "Configuration error"   )
+#else
+#define FLOG_MSG_IDS_LOADER
+#endif
+
+
 // Custom message ids, if they are not defined, define to null
 #ifndef FLOG_MSG_IDS_CUSTOM
 #define FLOG_MSG_IDS_CUSTOM
@@ -72,6 +111,10 @@ FLOG_MSG_IDS_BUILTIN \
 FLOG_MSG_IDS_EXTENDED \
 FLOG_MSG_IDS_OUTPUT_STDIO \
 FLOG_MSG_IDS_OUTPUT_FILE \
+FLOG_MSG_IDS_OUTPUT_SHM \
+FLOG_MSG_IDS_TRACE \
+FLOG_MSG_IDS_GOVERNOR \
+FLOG_MSG_IDS_LOADER \
 FLOG_MSG_IDS_CUSTOM
 
 
@@ -0,0 +1,349 @@
+//! compressed file output for Flog
+
+//! @file flog_output_compressed.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! When you want flog to write a compressed file
+//! Rendered messages are collected in blocks, and a background thread
+//! compresses each full block into a frame of its own (see flog_lz.h) and
+//! appends it to the file. Read the file with flogcat.
+//!
+//! Emitting threads take the producer lock and render straight into the
+//! block being filled, and only take the worker lock to hand a full block
+//! to the worker. They wait when every block is queued, so a slow disk
+//! slows logging down instead of using more memory. Errors of the worker
+//! are reported by the next output.
+
+
+#include "flog_output_compressed.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_OUTPUT_COMPRESSED
+
+#include "flog_lz.h"
+#include "flog_string.h"
+#include "flog_stats.h"
+#include "flog_detach.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+
+//! write a whole buffer to a file descriptor (async-signal-safe)
+
+//! @retval 0 success
+//! @return errno on error
+static int flog_output_compressed_write(int fd,const char *buf,size_t len)
+{
+	ssize_t r;
+	while(len) {
+		if((r=write(fd,buf,len))<0) {
+			if(errno==EINTR)
+				continue;
+			return(errno);
+		}
+		buf+=r;
+		len-=(size_t)r;
+	}
+	return(0);
+}
+
+
+//! write a frame header and its payload with one writev()
+
+//! A single call keeps the frame from interleaving with one written by
+//! the worker. Only a partial write falls back to writing the rest.
+//! @retval 0 success
+//! @return errno on error
+static int flog_output_compressed_writev(int fd,const char *header,size_t header_len,const char *buf,size_t len)
+{
+	struct iovec iov[2]={{(void *)header,header_len},{(void *)buf,len}};
+	ssize_t r;
+	while((r=writev(fd,iov,2))<0) {
+		if(errno!=EINTR)
+			return(errno);
+	}
+	if((size_t)r<header_len)
+		return(flog_output_compressed_writev(fd,header+r,header_len-(size_t)r,buf,len));
+	r-=(ssize_t)header_len;
+	return(flog_output_compressed_write(fd,buf+r,len-(size_t)r));
+}
+
+
+//! worker thread compressing and writing queued blocks
+static void * flog_output_compressed_worker(void *arg)
+{
+	FLOG_OUTPUT_COMPRESSED_T *f=arg;
+	unsigned int i;
+	size_t n;
+	int e;
+	pthread_mutex_lock(&f->lock);
+	for(;;) {
+		while(!f->queued && !f->stop)
+			pthread_cond_wait(&f->work,&f->lock);
+		if(!f->queued)
+			break;
+		i=f->head;
+		pthread_mutex_unlock(&f->lock);
+		n=flog_lz_frame(f->frame,flog_lz_frame_bound(f->block_size),f->block[i],f->block_len[i]);
+		if((e=flog_output_compressed_write(f->fd,f->frame,n)))
+			__atomic_store_n(&f->error,e,__ATOMIC_RELAXED);
+		f->block_len[i]=0;
+		pthread_mutex_lock(&f->lock);
+		f->head=(f->head+1)%FLOG_OUTPUT_COMPRESSED_BLOCKS;
+		f->queued--;
+		pthread_cond_broadcast(&f->space);
+	}
+	pthread_mutex_unlock(&f->lock);
+	return(NULL);
+}
+
+
+//! hand the block being filled to the worker and start on the next one
+
+//! Called with f->produce held. Waits while every other block is queued.
+static void flog_output_compressed_queue(FLOG_OUTPUT_COMPRESSED_T *f)
+{
+	pthread_mutex_lock(&f->lock);
+	while(f->queued==FLOG_OUTPUT_COMPRESSED_BLOCKS-1)
+		pthread_cond_wait(&f->space,&f->lock);
+	f->queued++;
+	f->cur=(f->cur+1)%FLOG_OUTPUT_COMPRESSED_BLOCKS;
+	pthread_cond_signal(&f->work);
+	pthread_mutex_unlock(&f->lock);
+}
+
+
+//! append to the blocks, queueing each block as it fills up (called with f->produce held)
+static void flog_output_compressed_append(FLOG_OUTPUT_COMPRESSED_T *f,const char *str,size_t len)
+{
+	size_t n;
+	while(len) {
+		n=f->block_size-f->block_len[f->cur];
+		if(n>len)
+			n=len;
+		memcpy(f->block[f->cur]+f->block_len[f->cur],str,n);
+		f->block_len[f->cur]+=n;
+		str+=n;
+		len-=n;
+		if(f->block_len[f->cur]==f->block_size)
+			flog_output_compressed_queue(f);
+	}
+}
+
+
+//! report an error of the worker, if there was one
+
+//! @retval 0 no error
+//! @return errno of the worker
+static int flog_output_compressed_check(FLOG_T *log,FLOG_OUTPUT_COMPRESSED_T *f)
+{
+	int e;
+	if((e=__atomic_exchange_n(&f->error,0,__ATOMIC_RELAXED))) {
+		log->output_error=e;
+		flog_printf(log->error_log,"write",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", f->filename, strerror(e));
+	}
+	return(e);
+}
+
+
+//! Output function for compressed log output to a file
+//! FLOG_OUTPUT_COMPRESSED_T is stored in log.output_func_data
+
+//! Messages are collected in blocks which are compressed and written by
+//! a worker thread when full or by flog_flush()
+//! @retval 0 success
+int flog_output_compressed(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	FLOG_OUTPUT_COMPRESSED_T *f=log->output_func_data;
+	char *str,*free_part;
+	size_t len;
+	int e;
+	if(f==NULL) {
+		log->output_error=-1;
+		flog_print(log->error_log,"flog_output_compressed",FLOG_ERROR,FLOG_MSG_SET_OUTPUT_FILE,NULL);
+		return(log->output_error);
+	}
+	//reported before locking, the error log may lead back to this output
+	e=flog_output_compressed_check(log,f);
+	pthread_mutex_lock(&f->produce);
+	//render straight into the free part of the block, if it fits
+	free_part=f->block[f->cur]+f->block_len[f->cur];
+	if(flog_get_str_message_log(&str,&len,free_part,f->block_size-f->block_len[f->cur],log,msg)) {
+		pthread_mutex_unlock(&f->produce);
+		return(-1);
+	}
+	if(!str) {
+		pthread_mutex_unlock(&f->produce);
+		return(e);
+	}
+	if(str==free_part) {
+		f->block_len[f->cur]+=len;
+		if(f->block_len[f->cur]==f->block_size)
+			flog_output_compressed_queue(f);
+	} else {
+		//start the message in a new block, long messages span several
+		if(f->block_len[f->cur])
+			flog_output_compressed_queue(f);
+		flog_output_compressed_append(f,str,len);
+		free(str);
+	}
+	pthread_mutex_unlock(&f->produce);
+	flog_stats_add_bytes(log,len);
+	return(e);
+}
+
+
+//! Flush function for compressed log output to a file
+
+//! Waits until the worker has written every block. From a signal handler
+//! the worker can't be waited for, so the block being filled is written
+//! uncompressed as one frame with writev(), and blocks already queued may
+//! be lost.
+//! @retval 0 success
+int flog_output_compressed_flush(FLOG_T *log,int signal_safe)
+{
+	FLOG_OUTPUT_COMPRESSED_T *f=log->output_func_data;
+	char header[FLOG_LZ_FRAME_HEADER_SIZE];
+	unsigned int cur;
+	size_t len;
+	int e;
+	if(f==NULL)
+		return(0);
+	if(signal_safe) {
+		//the block being filled is never held by the worker
+		cur=f->cur;
+		if(!(len=f->block_len[cur]))
+			return(0);
+		flog_lz_frame_stored(header,f->block[cur],len);
+		if((e=flog_output_compressed_writev(f->fd,header,sizeof(header),f->block[cur],len)))
+			return(e);
+		f->block_len[cur]=0;
+		return(0);
+	}
+	pthread_mutex_lock(&f->produce);
+	if(f->block_len[f->cur])
+		flog_output_compressed_queue(f);
+	pthread_mutex_unlock(&f->produce);
+	pthread_mutex_lock(&f->lock);
+	while(f->queued)
+		pthread_cond_wait(&f->space,&f->lock);
+	pthread_mutex_unlock(&f->lock);
+	return(flog_output_compressed_check(log,f));
+}
+
+
+//! create and return a log that writes to a compressed file
+
+//! The file is opened for appending here, and blocks are written when
+//! full, on flog_flush() and when the log is destroyed
+//! @param[in] *name name of log
+//! @param[in] accepted_msg_type bitmask of which messages to accept
+//! @param[in] *filename file to append frames to
+//! @param[in] block_size size of each block in bytes, 0 for FLOG_OUTPUT_COMPRESSED_BLOCK_SIZE
+//! @retval NULL error (see errno)
+FLOG_T * create_flog_output_compressed(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *filename, size_t block_size)
+{
+	FLOG_T *p;
+	FLOG_OUTPUT_COMPRESSED_T *f;
+	unsigned int i;
+	int e;
+	if(filename==NULL || !filename[0]) {
+		errno=EINVAL;
+		return(NULL);
+	}
+	if(!block_size)
+		block_size=FLOG_OUTPUT_COMPRESSED_BLOCK_SIZE;
+	if(block_size>FLOG_LZ_FRAME_MAX) {
+		errno=EINVAL;
+		return(NULL);
+	}
+	if((p=create_flog_t(name,accepted_msg_type))==NULL)
+		return(NULL);
+	if((f=flog_calloc(1,sizeof(FLOG_OUTPUT_COMPRESSED_T)))==NULL) {
+		destroy_flog_t(p);
+		return(NULL);
+	}
+	f->fd=-1;
+	f->block_size=block_size;
+	if((f->filename=flog_strdup(filename))==NULL)
+		goto error;
+	for(i=0;i<FLOG_OUTPUT_COMPRESSED_BLOCKS;i++) {
+		if((f->block[i]=flog_malloc(block_size))==NULL)
+			goto error;
+	}
+	if((f->frame=flog_malloc(flog_lz_frame_bound(block_size)))==NULL)
+		goto error;
+	if((f->fd=open(f->filename,O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC,0666))==-1)
+		goto error;
+	pthread_mutex_init(&f->produce,NULL);
+	pthread_mutex_init(&f->lock,NULL);
+	pthread_cond_init(&f->work,NULL);
+	pthread_cond_init(&f->space,NULL);
+	if((errno=pthread_create(&f->thread,NULL,flog_output_compressed_worker,f))) {
+		pthread_cond_destroy(&f->space);
+		pthread_cond_destroy(&f->work);
+		pthread_mutex_destroy(&f->lock);
+		pthread_mutex_destroy(&f->produce);
+		goto error;
+	}
+	p->output_func=flog_output_compressed;
+	p->output_flush_func=flog_output_compressed_flush;
+	p->output_func_data=f;
+	return(p);
+error:
+	e=errno;
+	if(f->fd!=-1)
+		close(f->fd);
+	flog_free(f->frame);
+	for(i=0;i<FLOG_OUTPUT_COMPRESSED_BLOCKS;i++)
+		flog_free(f->block[i]);
+	flog_free(f->filename);
+	flog_free(f);
+	destroy_flog_t(p);
+	errno=e;
+	return(NULL);
+}
+
+
+//! free a compressed output FLOG_T
+
+//! Writes every block, stops the worker and closes the file
+void destroy_flog_output_compressed(FLOG_T *p)
+{
+	FLOG_OUTPUT_COMPRESSED_T *f;
+	unsigned int i;
+	if(p!=NULL) {
+#ifdef FLOG_CONFIG_DETACH
+		//stop the worker before the output is freed
+		flog_attach(p);
+#endif
+		if((f=p->output_func_data)) {
+			flog_output_compressed_flush(p,0);
+			pthread_mutex_lock(&f->lock);
+			f->stop=1;
+			pthread_cond_signal(&f->work);
+			pthread_mutex_unlock(&f->lock);
+			pthread_join(f->thread,NULL);
+			pthread_cond_destroy(&f->space);
+			pthread_cond_destroy(&f->work);
+			pthread_mutex_destroy(&f->lock);
+			pthread_mutex_destroy(&f->produce);
+			close(f->fd);
+			flog_free(f->frame);
+			for(i=0;i<FLOG_OUTPUT_COMPRESSED_BLOCKS;i++)
+				flog_free(f->block[i]);
+			flog_free(f->filename);
+			flog_free(f);
+			p->output_func_data=NULL;
+		}
+		destroy_flog_t(p);
+	}
+}
+
+
+#endif //FLOG_CONFIG_OUTPUT_COMPRESSED
@@ -0,0 +1,67 @@
+//! compressed file output for Flog
+
+//! @file flog_output_compressed.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! When you want flog to write a compressed file
+//! Rendered messages are collected in blocks, and a background thread
+//! compresses each full block into a frame of its own (see flog_lz.h) and
+//! appends it to the file. Read the file with flogcat. Several threads can
+//! log to it at once.
+
+
+#ifndef FLOG_OUTPUT_COMPRESSED_H
+#define FLOG_OUTPUT_COMPRESSED_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_OUTPUT_COMPRESSED
+
+// Sanity checks
+#ifndef FLOG_CONFIG_STRING_OUTPUT
+#error FLOG_CONFIG_OUTPUT_COMPRESSED requires FLOG_CONFIG_STRING_OUTPUT
+#endif
+#ifndef FLOG_CONFIG_MSG_ID_STRINGS
+#error FLOG_CONFIG_OUTPUT_COMPRESSED requires FLOG_CONFIG_MSG_ID_STRINGS
+#endif
+#ifndef FLOG_CONFIG_ERRNO_STRINGS
+#error FLOG_CONFIG_OUTPUT_COMPRESSED requires FLOG_CONFIG_ERRNO_STRINGS
+#endif
+
+#include <stddef.h>
+#include <pthread.h>
+
+//! Amount of blocks, one is filled while the others wait for compression
+#define FLOG_OUTPUT_COMPRESSED_BLOCKS 4
+
+//! Block size used when 0 is given
+#define FLOG_OUTPUT_COMPRESSED_BLOCK_SIZE (256*1024)
+
+//! Compressed file output data - stored in log.output_func_data
+typedef struct {
+	char *filename;                         //!< name of file
+	int fd;                                 //!< file descriptor
+	size_t block_size;                      //!< size of each block
+	char *block[FLOG_OUTPUT_COMPRESSED_BLOCKS]; //!< rendered messages
+	size_t block_len[FLOG_OUTPUT_COMPRESSED_BLOCKS]; //!< bytes used in each block
+	unsigned int cur;                       //!< block being filled (protected by produce)
+	unsigned int head;                      //!< oldest queued block
+	unsigned int queued;                    //!< full blocks waiting for the worker
+	char *frame;                            //!< frame being written by the worker
+	pthread_t thread;                       //!< worker thread
+	pthread_mutex_t produce;                //!< serializes emitting threads, protects cur and the block being filled
+	pthread_mutex_t lock;                   //!< protects head, queued and stop
+	pthread_cond_t work;                    //!< signalled when a block is queued
+	pthread_cond_t space;                   //!< signalled when a block is written
+	int stop;                               //!< tells the worker to exit
+	int error;                              //!< last error of the worker, reported by the next output
+} FLOG_OUTPUT_COMPRESSED_T;
+
+int flog_output_compressed(FLOG_T *log,const FLOG_MSG_T *msg);
+int flog_output_compressed_flush(FLOG_T *log,int signal_safe);
+FLOG_T * create_flog_output_compressed(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *filename, size_t block_size);
+void destroy_flog_output_compressed(FLOG_T *p);
+
+#endif //FLOG_CONFIG_OUTPUT_COMPRESSED
+
+#endif //FLOG_OUTPUT_COMPRESSED_H
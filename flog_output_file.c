@@ -4,18 +4,25 @@
 //! @author Nabeel Sowan (nabeel.sowan@vibes.se)
 //!
 //! When you want flog to write to a file
-//! Choose logfile name by setting data to string
+//! Choose logfile name by setting data to string, or use the buffered
+//! variant which keeps the file open and writes in larger blocks
 
 
 #include "flog_output_file.h"
+#include "flog_alloc.h"
 
 #ifdef FLOG_CONFIG_OUTPUT_FILE
 
 #include "flog_string.h"
+#include "flog_stats.h"
+#include "flog_detach.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
 
 
 //! Output function for simple log output to a file
@@ -29,34 +36,325 @@ int flog_output_file(FLOG_T *log,const FLOG_MSG_T *msg)
 		flog_print(log->error_log,"flog_output_file",FLOG_ERROR,FLOG_MSG_SET_OUTPUT_FILE,NULL);
 		return(log->output_error);
 	}
-	char *str;
-	if(flog_get_str_message(&str,msg))
+	char buf[FLOG_STRING_BUF_SIZE],*str;
+	size_t len;
+	if(flog_get_str_message_log(&str,&len,buf,sizeof(buf),log,msg))
 		return(-1);
+	if(!str)
+		return(0);
 
 	FILE *f;
 	if((f = fopen(log->output_func_data,"a+t"))==NULL) {
 		log->output_error=errno;
-		free(str);
-		flog_printf(log->error_log,"fopen",FLOG_ERROR,FLOG_MSG_CANNOT_OPEN_FILE,"%s (%s)", log->output_func_data, strerror(log->output_error));
+		if(str!=buf)
+			free(str);
+		flog_printf(log->error_log,"fopen",FLOG_ERROR,FLOG_MSG_CANNOT_OPEN_FILE,"%s (%s)", (const char *)log->output_func_data, strerror(log->output_error));
 		return(log->output_error);
 	}
-	if(fputs(str,f)==EOF) {
+	if(fwrite(str,1,len,f)!=len) {
 		log->output_error=errno;
-		free(str);
+		if(str!=buf)
+			free(str);
 		fclose(f); //close to avoid multiple fp recursion
-		flog_printf(log->error_log,"fprintf",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", log->output_func_data, strerror(log->output_error));
+		flog_printf(log->error_log,"fprintf",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", (const char *)log->output_func_data, strerror(log->output_error));
 		return(log->output_error);
 	}
-	free(str);
+	flog_stats_add_bytes(log,len);
+	if(str!=buf)
+		free(str);
 	if(fclose(f)==EOF) {
 		log->output_error=errno;
-		flog_printf(log->error_log,"fclose",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", log->output_func_data, strerror(log->output_error));
+		flog_printf(log->error_log,"fclose",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", (const char *)log->output_func_data, strerror(log->output_error));
 		return(log->output_error);
 	}
 	return(0);
 }
 
 
+//! write a whole buffer to a file descriptor (async-signal-safe)
+
+//! @retval 0 success
+//! @return errno on error
+static int flog_output_file_write(int fd,const char *buf,size_t len)
+{
+	ssize_t r;
+	while(len) {
+		if((r=write(fd,buf,len))<0) {
+			if(errno==EINTR)
+				continue;
+			return(errno);
+		}
+		buf+=r;
+		len-=(size_t)r;
+	}
+	return(0);
+}
+
+
+//! open the file of a buffered file output if it isn't open (async-signal-safe)
+
+//! @retval 0 success
+//! @return errno on error
+static int flog_output_file_open(FLOG_OUTPUT_FILE_T *f)
+{
+	if(f->fd==-1) {
+		if((f->fd=open(f->filename,O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC,0666))==-1)
+			return(errno);
+#ifdef FLOG_CONFIG_INDEX
+		off_t end=lseek(f->fd,0,SEEK_END);
+		f->offset=(end==-1) ? 0 : (uint64_t)end;
+#endif
+	}
+	return(0);
+}
+
+
+//! write out the buffer of a buffered file output (async-signal-safe)
+
+//! @retval 0 success
+//! @return errno on error
+static int flog_output_file_write_buffer(FLOG_OUTPUT_FILE_T *f)
+{
+	int e;
+	if(f->buf_used) {
+		if((e=flog_output_file_open(f)))
+			return(e);
+		if((e=flog_output_file_write(f->fd,f->buf,f->buf_used)))
+			return(e);
+#ifdef FLOG_CONFIG_INDEX
+		f->offset+=f->buf_used;
+#endif
+#ifdef FLOG_CONFIG_DURABILITY
+		f->written+=f->buf_used;
+#endif
+		f->buf_used=0;
+	}
+#ifdef FLOG_CONFIG_INDEX
+	//entries are written after their records
+	if(f->index)
+		return(flog_index_write(f->index));
+#endif
+	return(0);
+}
+
+
+#ifdef FLOG_CONFIG_INDEX
+//! add a record of a buffered file output to its index
+static void flog_output_file_index(FLOG_T *log,FLOG_OUTPUT_FILE_T *f,uint64_t offset,size_t len,const FLOG_MSG_T *msg)
+{
+	int e;
+	if(f->index && (e=flog_index_add(f->index,offset,len,msg)))
+		flog_printf(log->error_log,"flog_index_add",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", f->index->filename, strerror(e));
+}
+#else
+#define flog_output_file_index(log,f,offset,len,msg) (void)(0)
+#endif
+
+
+//! add a message to the buffer of a buffered file output
+static int flog_output_file_buffered_msg(FLOG_T *log,FLOG_OUTPUT_FILE_T *f,const FLOG_MSG_T *msg)
+{
+	if(f==NULL || f->filename==NULL) {
+		log->output_error=-1;
+		flog_print(log->error_log,"flog_output_file",FLOG_ERROR,FLOG_MSG_SET_OUTPUT_FILE,NULL);
+		return(log->output_error);
+	}
+	char *str;
+	size_t len;
+	int e;
+	//output_error is only stored on failure, other threads read it unlocked
+	if((e=flog_output_file_open(f))) {
+		log->output_error=e;
+		flog_printf(log->error_log,"open",FLOG_ERROR,FLOG_MSG_CANNOT_OPEN_FILE,"%s (%s)", f->filename, strerror(e));
+		return(e);
+	}
+	//render straight into the free part of the buffer, if it fits
+	if(flog_get_str_message_log(&str,&len,f->buf+f->buf_used,f->buf_size-f->buf_used,log,msg))
+		return(-1);
+	if(!str)
+		return(0);
+	if(str==f->buf+f->buf_used) {
+		flog_output_file_index(log,f,f->offset+f->buf_used,len,msg);
+		f->buf_used+=len;
+		flog_stats_add_bytes(log,len);
+		return(0);
+	}
+
+	if(f->buf_used+len > f->buf_size) {
+		if((e=flog_output_file_write_buffer(f))) {
+			log->output_error=e;
+			free(str);
+			flog_printf(log->error_log,"write",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", f->filename, strerror(e));
+			return(e);
+		}
+	}
+	if(len > f->buf_size) {
+		//message doesn't fit in buffer, write it directly
+		if((e=flog_output_file_write(f->fd,str,len))) {
+			log->output_error=e;
+			free(str);
+			flog_printf(log->error_log,"write",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", f->filename, strerror(e));
+			return(e);
+		}
+		flog_output_file_index(log,f,f->offset,len,msg);
+#ifdef FLOG_CONFIG_INDEX
+		f->offset+=len;
+#endif
+#ifdef FLOG_CONFIG_DURABILITY
+		f->written+=len;
+#endif
+	} else {
+		flog_output_file_index(log,f,f->offset+f->buf_used,len,msg);
+		memcpy(f->buf+f->buf_used,str,len);
+		f->buf_used+=len;
+	}
+	flog_stats_add_bytes(log,len);
+	free(str);
+	return(0);
+}
+
+
+#ifdef FLOG_CONFIG_DURABILITY
+//! Buffered file outputs with a durability entered by this thread (error reports may re-enter them)
+static __thread unsigned int flog_output_file_depth;
+
+
+//! wait until everything written to a buffered file output is on disk
+
+//! Called with f->lock held once. The first thread to wait runs
+//! fdatasync() for everyone written so far, threads arriving meanwhile
+//! wait for it and then run the next one, so concurrent callers share
+//! syncs. For a group commit the syncing thread first lets other threads
+//! write for wait_ms, cut short once every other thread in the output
+//! waits for the sync.
+//! @retval 0 success
+//! @return errno on error
+static int flog_output_file_sync(FLOG_OUTPUT_FILE_T *f,uint32_t wait_ms)
+{
+	uint64_t target=f->written,upto;
+	struct timespec ts;
+	int fd,e;
+	while(f->synced<target) {
+		if(f->sync_failed>=target)
+			return(f->sync_error);
+		if(f->syncing) {
+			f->waiting++;
+			if(f->waiting+1>=__atomic_load_n(&f->users,__ATOMIC_RELAXED))
+				pthread_cond_signal(&f->group_cond);
+			pthread_cond_wait(&f->synced_cond,&f->lock);
+			f->waiting--;
+			continue;
+		}
+		f->syncing=1;
+		if(wait_ms) {
+			clock_gettime(CLOCK_REALTIME,&ts);
+			ts.tv_sec+=wait_ms/1000;
+			ts.tv_nsec+=(long)(wait_ms%1000)*1000000;
+			if(ts.tv_nsec>=1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec-=1000000000;
+			}
+			//let other threads write, until the window ends or all threads in the output wait for this sync
+			while(!(f->waiting && f->waiting+1>=__atomic_load_n(&f->users,__ATOMIC_RELAXED)) &&
+			      pthread_cond_timedwait(&f->group_cond,&f->lock,&ts)!=ETIMEDOUT);
+		}
+		upto=f->written;
+		fd=f->fd;
+		pthread_mutex_unlock(&f->lock);
+		e=fdatasync(fd) ? errno : 0;
+		pthread_mutex_lock(&f->lock);
+		f->syncing=0;
+		f->syncs++;
+		if(e) {
+			f->sync_error=e;
+			f->sync_failed=upto;
+		} else if(upto>f->synced)
+			f->synced=upto;
+		pthread_cond_broadcast(&f->synced_cond);
+	}
+	return(0);
+}
+#endif //FLOG_CONFIG_DURABILITY
+
+
+//! Output function for buffered log output to a file
+//! FLOG_OUTPUT_FILE_T is stored in log.output_func_data
+
+//! Messages are collected in a buffer which is written when full or by flog_flush(),
+//! or at once for types with a durability (see flog_output_file_set_durability())
+//! @retval 0 success
+int flog_output_file_buffered(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	FLOG_OUTPUT_FILE_T *f=log->output_func_data;
+#ifdef FLOG_CONFIG_DURABILITY
+	FLOG_MSG_TYPE_T durable;
+	if(f && (durable=f->flush_types|f->sync_types|f->group_types)) {
+		int e;
+		//counted before locking, so a group commit waits for threads queued on the lock too
+		__atomic_add_fetch(&f->users,1,__ATOMIC_RELAXED);
+		pthread_mutex_lock(&f->lock);
+		flog_output_file_depth++;
+		if(!(e=flog_output_file_buffered_msg(log,f,msg)) && (msg->type & durable)) {
+			if((e=flog_output_file_write_buffer(f))) {
+				log->output_error=e;
+				flog_printf(log->error_log,"write",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", f->filename, strerror(e));
+			} else if((msg->type & (f->sync_types|f->group_types)) && flog_output_file_depth==1) {
+				//a report to the error log re-entering the output is not synced, as the lock can't be released there
+				if((e=flog_output_file_sync(f,(msg->type & f->group_types) ? f->group_ms : 0))) {
+					log->output_error=e;
+					flog_printf(log->error_log,"fdatasync",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", f->filename, strerror(e));
+				}
+			}
+		}
+		__atomic_sub_fetch(&f->users,1,__ATOMIC_RELAXED);
+		flog_output_file_depth--;
+		pthread_mutex_unlock(&f->lock);
+		return(e);
+	}
+#endif
+	if(f==NULL)
+		return(flog_output_file_buffered_msg(log,f,msg));
+	int e;
+	pthread_mutex_lock(&f->lock);
+	e=flog_output_file_buffered_msg(log,f,msg);
+	pthread_mutex_unlock(&f->lock);
+	return(e);
+}
+
+
+//! Flush function for buffered log output to a file
+
+//! Only uses open() and write() so it can be called from a signal handler
+//! @retval 0 success
+int flog_output_file_buffered_flush(FLOG_T *log,int signal_safe)
+{
+	FLOG_OUTPUT_FILE_T *f=log->output_func_data;
+	int e;
+	if(f==NULL || f->filename==NULL)
+		return(0);
+	//a signal handler can't wait for the lock, it writes what it finds
+	if(!signal_safe) {
+		pthread_mutex_lock(&f->lock);
+#ifdef FLOG_CONFIG_DURABILITY
+		flog_output_file_depth++;
+#endif
+	}
+	if((e=flog_output_file_write_buffer(f))) {
+		if(!signal_safe) {
+			log->output_error=e;
+			flog_printf(log->error_log,"write",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_FILE,"%s (%s)", f->filename, strerror(e));
+		}
+	}
+	if(!signal_safe) {
+#ifdef FLOG_CONFIG_DURABILITY
+		flog_output_file_depth--;
+#endif
+		pthread_mutex_unlock(&f->lock);
+	}
+	return(e);
+}
+
+
 //! create and return a log that writes to file
 
 //! @retval NULL error
@@ -67,7 +365,7 @@ FLOG_T * create_flog_output_file(const char *name, FLOG_MSG_TYPE_T accepted_msg_
 		return(NULL);
 	p->output_func=flog_output_file;
 	if(filename && filename[0]) {
-		if((p->output_func_data=strdup(filename))==NULL) {
+		if((p->output_func_data=flog_strdup(filename))==NULL) {
 			destroy_flog_t(p);
 			return(NULL);
 		}
@@ -76,11 +374,138 @@ FLOG_T * create_flog_output_file(const char *name, FLOG_MSG_TYPE_T accepted_msg_
 }
 
 
-//! free an output_file FLOG_T
+//! create and return a log that writes to file through a buffer
+
+//! The buffer is written when full, on flog_flush() and when the log is destroyed
+//! @param[in] *name name of log
+//! @param[in] accepted_msg_type bitmask of which messages to accept
+//! @param[in] *filename file to append messages to
+//! @param[in] buffer_size size of buffer in bytes
+//! @retval NULL error
+FLOG_T * create_flog_output_file_buffered(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *filename, size_t buffer_size)
+{
+	FLOG_T *p;
+	FLOG_OUTPUT_FILE_T *f;
+	if((p=create_flog_t(name,accepted_msg_type))==NULL)
+		return(NULL);
+	p->output_func=flog_output_file_buffered;
+	p->output_flush_func=flog_output_file_buffered_flush;
+	if((f=flog_calloc(1,sizeof(FLOG_OUTPUT_FILE_T)))==NULL) {
+		destroy_flog_t(p);
+		return(NULL);
+	}
+	p->output_func_data=f;
+	f->fd=-1;
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr,PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&f->lock,&attr);
+	pthread_mutexattr_destroy(&attr);
+#ifdef FLOG_CONFIG_DURABILITY
+	pthread_cond_init(&f->synced_cond,NULL);
+	pthread_cond_init(&f->group_cond,NULL);
+#endif
+	if(filename && filename[0]) {
+		if((f->filename=flog_strdup(filename))==NULL) {
+			destroy_flog_output_file(p);
+			return(NULL);
+		}
+	}
+	if((f->buf=flog_malloc(buffer_size ? buffer_size : 1))==NULL) {
+		destroy_flog_output_file(p);
+		return(NULL);
+	}
+	f->buf_size=buffer_size;
+	return(p);
+}
+
+
+#ifdef FLOG_CONFIG_INDEX
+//! write a sidecar index of a buffered file output
+
+//! The index is named like the file with FLOG_INDEX_SUFFIX appended, see
+//! flog_index.h. Offsets in the index are only right if nothing else
+//! appends to the file while the log has it open.
+//! @param[in] *log buffered file output
+//! @param[in] every records per index entry, 0 for FLOG_INDEX_EVERY
+//! @retval 0 success
+//! @return errno on error
+int flog_output_file_set_index(FLOG_T *log, uint32_t every)
+{
+	FLOG_OUTPUT_FILE_T *f=log->output_func_data;
+	if(log->output_func!=flog_output_file_buffered || f==NULL || f->filename==NULL || f->index)
+		return(EINVAL);
+	if((f->index=create_flog_index(f->filename,every))==NULL)
+		return(errno);
+	return(0);
+}
+#endif //FLOG_CONFIG_INDEX
+
+
+#ifdef FLOG_CONFIG_DURABILITY
+//! set how soon a buffered file output puts messages of some types on disk
+
+//! Set durability before the log is used by other threads.
+//! @param[in,out] *log buffered file output
+//! @param[in] types bitmask of message types to set durability for
+//! @param[in] durability one of FLOG_DURABILITY
+//! @param[in] group_ms group commit window of FLOG_DURABILITY_GROUP, 0 for FLOG_DURABILITY_GROUP_MS
+//! @retval 0 success
+//! @return errno on error
+int flog_output_file_set_durability(FLOG_T *log, FLOG_MSG_TYPE_T types, uint_fast8_t durability, uint32_t group_ms)
+{
+	FLOG_OUTPUT_FILE_T *f=log->output_func_data;
+	if(log->output_func!=flog_output_file_buffered || f==NULL || durability>FLOG_DURABILITY_GROUP)
+		return(EINVAL);
+	f->flush_types&=(FLOG_MSG_TYPE_T)~types;
+	f->sync_types&=(FLOG_MSG_TYPE_T)~types;
+	f->group_types&=(FLOG_MSG_TYPE_T)~types;
+	switch(durability) {
+	case FLOG_DURABILITY_FLUSH:
+		f->flush_types|=types;
+		break;
+	case FLOG_DURABILITY_SYNC:
+		f->sync_types|=types;
+		break;
+	case FLOG_DURABILITY_GROUP:
+		f->group_types|=types;
+		f->group_ms=group_ms ? group_ms : FLOG_DURABILITY_GROUP_MS;
+		break;
+	}
+	return(0);
+}
+#endif //FLOG_CONFIG_DURABILITY
+
+
+//! free an output_file FLOG_T (buffered or not)
 void destroy_flog_output_file(FLOG_T *p)
 {
 	if(p!=NULL) {
-		free(p->output_func_data);
+#ifdef FLOG_CONFIG_DETACH
+		//stop the worker before the output is freed
+		flog_attach(p);
+#endif
+		if(p->output_func==flog_output_file_buffered && p->output_func_data) {
+			FLOG_OUTPUT_FILE_T *f=p->output_func_data;
+#ifdef FLOG_CONFIG_INDEX
+			if(f->index)
+				flog_index_end_entry(f->index);
+#endif
+			flog_output_file_buffered_flush(p,0);
+#ifdef FLOG_CONFIG_INDEX
+			destroy_flog_index(f->index);
+#endif
+			if(f->fd!=-1)
+				close(f->fd);
+#ifdef FLOG_CONFIG_DURABILITY
+			pthread_cond_destroy(&f->group_cond);
+			pthread_cond_destroy(&f->synced_cond);
+#endif
+			pthread_mutex_destroy(&f->lock);
+			flog_free(f->filename);
+			flog_free(f->buf);
+		}
+		flog_free(p->output_func_data);
 		p->output_func_data=NULL;
 		destroy_flog_t(p);
 	}
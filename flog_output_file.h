@@ -4,7 +4,14 @@
 //! @author Nabeel Sowan (nabeel.sowan@vibes.se)
 //!
 //! When you want flog to write to a file
-//! Choose logfile name by setting data to string
+//! Choose logfile name by setting data to string, or use the buffered
+//! variant which keeps the file open and writes in larger blocks
+//!
+//! A buffered file output takes a lock around its buffer, so several
+//! threads can use it at once. It can put important message types on disk
+//! before returning, and keep buffering the rest (see
+//! flog_output_file_set_durability()), threads syncing at the same time
+//! share one fdatasync().
 
 
 #ifndef FLOG_OUTPUT_FILE_H
@@ -25,8 +32,72 @@
 #error FLOG_CONFIG_OUTPUT_FILE requires FLOG_CONFIG_ERRNO_STRINGS
 #endif
 
+#include "flog_index.h"
+#include <stddef.h>
+#include <pthread.h>
+#ifdef FLOG_CONFIG_DURABILITY
+#include <stdint.h>
+
+//! @addtogroup FLOG_DURABILITY
+//! @brief How soon a buffered file output puts messages of a type on disk
+//! @{
+
+//! Written with the buffer when full or by flog_flush()
+#define FLOG_DURABILITY_NONE    0
+//! Written to the file at once, survives a crash of the process
+#define FLOG_DURABILITY_FLUSH   1
+//! Written and on disk (fdatasync()) before the output returns, survives a crash of the system
+#define FLOG_DURABILITY_SYNC    2
+//! Like FLOG_DURABILITY_SYNC, but waits up to group_ms for other threads in the output to share the fdatasync()
+#define FLOG_DURABILITY_GROUP   3
+
+//! @}
+
+//! Group commit window used when 0 is given
+#define FLOG_DURABILITY_GROUP_MS 2
+#endif //FLOG_CONFIG_DURABILITY
+
+//! Buffered file output data - stored in log.output_func_data
+typedef struct {
+	char *filename;                         //!< name of file
+	int fd;                                 //!< file descriptor (-1 when not open)
+	char *buf;                              //!< rendered messages not yet written
+	size_t buf_size;                        //!< size of buf
+	size_t buf_used;                        //!< bytes used in buf
+#ifdef FLOG_CONFIG_INDEX
+	uint64_t offset;                        //!< offset in the file where buf will be written
+	FLOG_INDEX_T *index;                    //!< sidecar index (NULL if none, see flog_output_file_set_index())
+#endif
+	pthread_mutex_t lock;                   //!< serializes the output (recursive, error reports may re-enter it)
+#ifdef FLOG_CONFIG_DURABILITY
+	FLOG_MSG_TYPE_T flush_types;            //!< types written at once (FLOG_DURABILITY_FLUSH)
+	FLOG_MSG_TYPE_T sync_types;             //!< types synced at once (FLOG_DURABILITY_SYNC)
+	FLOG_MSG_TYPE_T group_types;            //!< types synced by a group commit (FLOG_DURABILITY_GROUP)
+	uint32_t group_ms;                      //!< time a group commit waits for other threads
+	pthread_cond_t synced_cond;             //!< signalled when a sync is done
+	pthread_cond_t group_cond;              //!< signalled when every thread in the output waits for the sync
+	int users;                              //!< threads in the output or waiting for lock (atomic)
+	int waiting;                            //!< threads waiting for a running sync
+	int syncing;                            //!< a thread is running fdatasync()
+	int sync_error;                         //!< errno of the last failed sync
+	uint64_t written;                       //!< bytes written to the file
+	uint64_t synced;                        //!< bytes written before the last successful sync
+	uint64_t sync_failed;                   //!< bytes written before the last failed sync
+	uint64_t syncs;                         //!< fdatasync() calls
+#endif
+} FLOG_OUTPUT_FILE_T;
+
 int flog_output_file(FLOG_T *log,const FLOG_MSG_T *msg);
+int flog_output_file_buffered(FLOG_T *log,const FLOG_MSG_T *msg);
+int flog_output_file_buffered_flush(FLOG_T *log,int signal_safe);
 FLOG_T * create_flog_output_file(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *filename);
+FLOG_T * create_flog_output_file_buffered(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *filename, size_t buffer_size);
+#ifdef FLOG_CONFIG_INDEX
+int flog_output_file_set_index(FLOG_T *log, uint32_t every);
+#endif
+#ifdef FLOG_CONFIG_DURABILITY
+int flog_output_file_set_durability(FLOG_T *log, FLOG_MSG_TYPE_T types, uint_fast8_t durability, uint32_t group_ms);
+#endif
 void destroy_flog_output_file(FLOG_T *p);
 
 #endif //FLOG_CONFIG_OUTPUT_FILE
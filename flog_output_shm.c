@@ -0,0 +1,279 @@
+//! shared memory ring output for Flog
+
+//! @file flog_output_shm.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! A writer costs one atomic increment of the head, a compare and swap
+//! and a store of the record stamp, and copying the record, there are no
+//! locks and no system calls. Rendered records are rendered straight into the shared
+//! memory when they fit.
+
+#define _GNU_SOURCE
+
+#include "flog_output_shm.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_OUTPUT_SHM
+
+#include "flog_string.h"
+#include "flog_stats.h"
+#ifdef FLOG_CONFIG_DETACH
+#include "flog_detach.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//! Time to wait for another process to finish creating a ring
+#define FLOG_SHM_OPEN_WAIT_MS 1000
+
+
+//! Wait for the creator of a ring to size and set it up
+
+//! @return size of the ring, 0 on error
+static size_t flog_shm_wait_created(int fd)
+{
+	const struct timespec ms={0,1000000};
+	FLOG_SHM_HEADER_T h;
+	struct stat st;
+	unsigned int i;
+	for(i=0;i<FLOG_SHM_OPEN_WAIT_MS;i++) {
+		if(fstat(fd,&st))
+			return(0);
+		if((size_t)st.st_size>=sizeof(h) && pread(fd,&h,sizeof(h),0)==(ssize_t)sizeof(h) && h.magic==FLOG_SHM_MAGIC)
+			return((size_t)st.st_size);
+		nanosleep(&ms,NULL);
+	}
+	errno=ETIMEDOUT;
+	return(0);
+}
+
+
+//! Map a ring, creating it if needed
+
+//! A writable ring is created with the given geometry if it does not
+//! exist, an existing ring keeps its own. A reader only maps existing
+//! rings, read only.
+//! @param[in] *name name of shared memory object, such as "/app.log"
+//! @param[in] writable create or map for writing
+//! @param[in] record_size bytes per record, 0 for FLOG_SHM_RECORD_SIZE
+//! @param[in] record_amount records in ring (a power of two), 0 for FLOG_SHM_RECORD_AMOUNT
+//! @param[out] *size size of mapping, for munmap()
+//! @return mapped ring, NULL on error (errno is set)
+FLOG_SHM_HEADER_T * flog_shm_map(const char *name, int writable, uint32_t record_size, uint32_t record_amount, size_t *size)
+{
+	FLOG_SHM_HEADER_T *h;
+	size_t len=0;
+	int fd,e,created=0;
+	record_size=record_size ? (record_size+7) & ~7u : FLOG_SHM_RECORD_SIZE;
+	record_amount=record_amount ? record_amount : FLOG_SHM_RECORD_AMOUNT;
+	if(writable) {
+		if(record_size<sizeof(FLOG_SHM_RECORD_T)+8 || record_size>sizeof(FLOG_SHM_RECORD_T)+UINT16_MAX ||
+		   record_amount<2 || (record_amount & (record_amount-1))) {
+			errno=EINVAL;
+			return(NULL);
+		}
+		if((fd=shm_open(name,O_RDWR|O_CREAT|O_EXCL,0644))!=-1) {
+			created=1;
+			len=sizeof(FLOG_SHM_HEADER_T)+(size_t)record_size*record_amount;
+			if(ftruncate(fd,(off_t)len))
+				goto error;
+		} else if(errno!=EEXIST || (fd=shm_open(name,O_RDWR,0))==-1)
+			return(NULL);
+	} else if((fd=shm_open(name,O_RDONLY,0))==-1)
+		return(NULL);
+	if(!created && (len=flog_shm_wait_created(fd))==0)
+		goto error;
+	if((h=mmap(NULL,len,writable ? PROT_READ|PROT_WRITE : PROT_READ,MAP_SHARED,fd,0))==MAP_FAILED)
+		goto error;
+	close(fd);
+	if(created) {
+		//zero filled by ftruncate(), so every record is empty
+		h->record_size=record_size;
+		h->record_amount=record_amount;
+		__atomic_store_n(&h->magic,FLOG_SHM_MAGIC,__ATOMIC_RELEASE);
+	} else if(h->record_size<sizeof(FLOG_SHM_RECORD_T)+8 || (h->record_size & 7) || h->record_amount<2 ||
+	          (h->record_amount & (h->record_amount-1)) ||
+	          len<sizeof(FLOG_SHM_HEADER_T)+(size_t)h->record_size*h->record_amount) {
+		munmap(h,len);
+		errno=EINVAL;
+		return(NULL);
+	}
+	*size=len;
+	return(h);
+error:
+	e=errno;
+	close(fd);
+	if(created)
+		shm_unlink(name);
+	errno=e;
+	return(NULL);
+}
+
+
+//! Copy record seq of a ring, without blocking writers
+
+//! @param[in] *h ring
+//! @param[in] seq sequence number
+//! @param[out] *r record of h->record_size bytes
+//! @return one of FLOG_SHM_READ
+int flog_shm_read(const FLOG_SHM_HEADER_T *h, uint64_t seq, FLOG_SHM_RECORD_T *r)
+{
+	const FLOG_SHM_RECORD_T *src=flog_shm_record(h,seq);
+	uint64_t stamp=__atomic_load_n(&src->stamp,__ATOMIC_ACQUIRE);
+	if(stamp<FLOG_SHM_STAMP_DONE(seq))
+		return(FLOG_SHM_READ_AGAIN);
+	if(stamp>FLOG_SHM_STAMP_DONE(seq))
+		return(FLOG_SHM_READ_LOST);
+	memcpy(r,src,h->record_size);
+	//the copy is only whole if no writer took the record meanwhile
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(__atomic_load_n(&src->stamp,__ATOMIC_RELAXED)!=stamp)
+		return(FLOG_SHM_READ_LOST);
+	if(r->subsystem_len+(size_t)r->text_len>h->record_size-sizeof(FLOG_SHM_RECORD_T))
+		return(FLOG_SHM_READ_LOST);
+	return(FLOG_SHM_READ_OK);
+}
+
+
+//! Take record seq of a ring for writing
+
+//! A record still being filled, however many laps earlier, is never
+//! taken: its writer may only be descheduled, and would go on writing
+//! into the record after it was taken, tearing a record readers accept.
+//! @return record, NULL if the record can not be taken
+static FLOG_SHM_RECORD_T * flog_shm_take(FLOG_SHM_HEADER_T *h, uint64_t seq)
+{
+	FLOG_SHM_RECORD_T *r=flog_shm_record(h,seq);
+	uint64_t stamp=__atomic_load_n(&r->stamp,__ATOMIC_RELAXED);
+	do {
+		if(stamp>=FLOG_SHM_STAMP_BUSY(seq) || (stamp & 1))
+			return(NULL);
+	} while(!__atomic_compare_exchange_n(&r->stamp,&stamp,FLOG_SHM_STAMP_BUSY(seq),0,__ATOMIC_RELAXED,__ATOMIC_RELAXED));
+	//readers must see the busy stamp before any of the new contents
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	return(r);
+}
+
+
+//! Write a message to a shared memory ring
+int flog_output_shm(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	FLOG_OUTPUT_SHM_T *s=log->output_func_data;
+	if(s==NULL) {
+		log->output_error=-1;
+		flog_print(log->error_log,"flog_output_shm",FLOG_ERROR,FLOG_MSG_SET_OUTPUT_SHM,NULL);
+		return(log->output_error);
+	}
+	FLOG_SHM_HEADER_T *h=s->ring;
+	uint64_t seq=__atomic_fetch_add(&h->head,1,__ATOMIC_RELAXED);
+	FLOG_SHM_RECORD_T *r;
+	size_t room=h->record_size-sizeof(FLOG_SHM_RECORD_T),len=0;
+	char *str;
+	int ret=0;
+	if((r=flog_shm_take(h,seq))==NULL) {
+		__atomic_fetch_add(&h->dropped,1,__ATOMIC_RELAXED);
+		return(0);
+	}
+#ifdef FLOG_CONFIG_TIMESTAMP
+#ifdef FLOG_CONFIG_TIMESTAMP_USEC
+	r->time=(int64_t)msg->timestamp.tv_sec*1000000+msg->timestamp.tv_usec;
+#else
+	r->time=(int64_t)msg->timestamp*1000000;
+#endif
+#else
+	r->time=0;
+#endif
+	r->pid=(uint32_t)getpid();
+	r->msg_id=(uint32_t)msg->msg_id;
+	r->type=(uint8_t)msg->type;
+	r->flags=0;
+	r->subsystem_len=0;
+	if(msg->subsystem) {
+		r->subsystem_len=(uint16_t)strnlen(msg->subsystem,room);
+		memcpy(r->data,msg->subsystem,r->subsystem_len);
+		room-=r->subsystem_len;
+	}
+	str=r->data+r->subsystem_len;
+	if(s->flags & FLOG_OUTPUT_SHM_RAW) {
+		r->flags|=FLOG_SHM_RECORD_RAW;
+		if(msg->text) {
+			len=strnlen(msg->text,room+1);
+			memcpy(str,msg->text,len>room ? room : len);
+		}
+	} else if(flog_get_str_message_log(&str,&len,str,room,log,msg))
+		ret=-1;
+	else if(str && str!=r->data+r->subsystem_len) {
+		//did not fit, keep the start
+		memcpy(r->data+r->subsystem_len,str,len>room ? room : len);
+		free(str);
+	}
+	if(len>room) {
+		r->flags|=FLOG_SHM_RECORD_TRUNCATED;
+		len=room;
+	}
+	r->text_len=(uint16_t)len;
+	//no other writer takes a busy record, so it is still ours
+	__atomic_store_n(&r->stamp,FLOG_SHM_STAMP_DONE(seq),__ATOMIC_RELEASE);
+	flog_stats_add_bytes(log,len);
+	return(ret);
+}
+
+
+//! create a shared memory ring output
+
+//! @param[in] *name name of log
+//! @param[in] accepted_msg_type message types accepted
+//! @param[in] *shm_name name of shared memory object, such as "/app.log"
+//! @param[in] record_size bytes per record, 0 for FLOG_SHM_RECORD_SIZE
+//! @param[in] record_amount records in ring (a power of two), 0 for FLOG_SHM_RECORD_AMOUNT
+//! @param[in] flags FLOG_OUTPUT_SHM_RAW, or 0 to write rendered messages
+//! @return log, NULL on error
+FLOG_T * create_flog_output_shm(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *shm_name, uint32_t record_size, uint32_t record_amount, uint_fast8_t flags)
+{
+	FLOG_T *p;
+	FLOG_OUTPUT_SHM_T *s;
+	if((p=create_flog_t(name,accepted_msg_type))==NULL)
+		return(NULL);
+	p->output_func=flog_output_shm;
+	if((s=flog_calloc(1,sizeof(FLOG_OUTPUT_SHM_T)))==NULL) {
+		destroy_flog_t(p);
+		return(NULL);
+	}
+	p->output_func_data=s;
+	s->flags=flags;
+	if(shm_name==NULL || (s->name=flog_strdup(shm_name))==NULL ||
+	   (s->ring=flog_shm_map(shm_name,1,record_size,record_amount,&s->size))==NULL) {
+		destroy_flog_output_shm(p);
+		return(NULL);
+	}
+	return(p);
+}
+
+
+//! free a shared memory output FLOG_T, the ring is kept for readers
+void destroy_flog_output_shm(FLOG_T *p)
+{
+	if(p!=NULL) {
+#ifdef FLOG_CONFIG_DETACH
+		//stop the worker before the output is freed
+		flog_attach(p);
+#endif
+		FLOG_OUTPUT_SHM_T *s=p->output_func_data;
+		if(s) {
+			if(s->ring)
+				munmap(s->ring,s->size);
+			flog_free(s->name);
+			flog_free(s);
+			p->output_func_data=NULL;
+		}
+		destroy_flog_t(p);
+	}
+}
+
+#endif //FLOG_CONFIG_OUTPUT_SHM
@@ -0,0 +1,132 @@
+//! shared memory ring output for Flog
+
+//! @file flog_output_shm.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! When several processes should log to one place without touching the
+//! filesystem. Messages are written as fixed size records into a ring in
+//! a named POSIX shared memory object, which any amount of processes can
+//! write to at once, and flogtail follows and renders.
+//!
+//! The ring starts with a FLOG_SHM_HEADER_T, followed by record_amount
+//! records of record_size bytes. A writer takes the next sequence number
+//! from the header, and the record at that number modulo record_amount.
+//! Each record has a stamp, which is odd while a writer fills the record,
+//! and FLOG_SHM_STAMP_DONE(seq) once it holds record seq. Readers copy a
+//! record and check the stamp before and after, so they never block
+//! writers, and see from the stamp when a record was overwritten before
+//! they got to it.
+//!
+//! A record holds the subsystem, and either the message rendered like any
+//! other output (using the layout of the log), or with FLOG_OUTPUT_SHM_RAW
+//! only the message text, for the reader to render. Text not fitting in a
+//! record is cut short.
+//!
+//! Writers only drop their record if another writer is still filling the
+//! same record from an earlier lap of the ring. A busy record is never
+//! taken over, so a writer that died while filling one makes later writers
+//! drop the records falling on it, once a lap, until the ring is created
+//! anew. The shared memory object is kept when the last process closes
+//! it, remove it with shm_unlink().
+
+
+#ifndef FLOG_OUTPUT_SHM_H
+#define FLOG_OUTPUT_SHM_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_OUTPUT_SHM
+
+// Sanity checks
+#ifndef FLOG_CONFIG_STRING_OUTPUT
+#error FLOG_CONFIG_OUTPUT_SHM requires FLOG_CONFIG_STRING_OUTPUT
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+//! Magic number starting a ring ("FLR1" on little endian machines)
+#define FLOG_SHM_MAGIC 0x31524c46u
+
+//! Record size used when 0 is given
+#define FLOG_SHM_RECORD_SIZE 256
+
+//! Amount of records used when 0 is given
+#define FLOG_SHM_RECORD_AMOUNT 4096
+
+//! Stamp of a record holding sequence number seq
+#define FLOG_SHM_STAMP_DONE(seq) ((uint64_t)(seq)*2+2)
+
+//! Stamp of a record being filled with sequence number seq
+#define FLOG_SHM_STAMP_BUSY(seq) ((uint64_t)(seq)*2+1)
+
+//! Record holds only the message text (see FLOG_OUTPUT_SHM_RAW)
+#define FLOG_SHM_RECORD_RAW       0x01
+//! Text of the record was cut short
+#define FLOG_SHM_RECORD_TRUNCATED 0x02
+
+//! Write only the message text, to be rendered by the reader
+#define FLOG_OUTPUT_SHM_RAW 0x01
+
+//! @addtogroup FLOG_SHM_READ
+//! @brief Results of flog_shm_read()
+//! @{
+
+//! The record was copied
+#define FLOG_SHM_READ_OK    0
+//! The record is not written yet
+#define FLOG_SHM_READ_AGAIN 1
+//! The record was overwritten by a later one
+#define FLOG_SHM_READ_LOST  2
+
+//! @}
+
+
+//! Header of a ring
+typedef struct {
+	uint32_t magic;                         //!< FLOG_SHM_MAGIC, set last when the ring is created (atomic)
+	uint32_t record_size;                   //!< bytes per record, a multiple of 8
+	uint32_t record_amount;                 //!< records in ring, a power of two
+	uint32_t reserved[13];                  //!< keeps head on its own cache line
+	uint64_t head;                          //!< next sequence number (atomic)
+	uint64_t dropped;                       //!< records dropped by writers (atomic)
+	uint64_t reserved2[6];                  //!< pads the header to 128 bytes
+} FLOG_SHM_HEADER_T;
+
+
+//! Record of a ring
+typedef struct {
+	uint64_t stamp;                         //!< FLOG_SHM_STAMP_DONE(seq) when complete (atomic)
+	int64_t time;                           //!< timestamp in microseconds since the epoch (0 if none)
+	uint32_t pid;                           //!< process id of writer
+	uint32_t msg_id;                        //!< message id
+	uint8_t type;                           //!< message type
+	uint8_t flags;                          //!< FLOG_SHM_RECORD_* flags
+	uint16_t subsystem_len;                 //!< length of subsystem at the start of data
+	uint16_t text_len;                      //!< length of text after the subsystem
+	uint16_t reserved;                      //!< unused
+	char data[];                            //!< subsystem and text, not NUL terminated
+} FLOG_SHM_RECORD_T;
+
+
+//! Shared memory output data - stored in log.output_func_data
+typedef struct {
+	char *name;                             //!< name of shared memory object
+	FLOG_SHM_HEADER_T *ring;                //!< mapped ring
+	size_t size;                            //!< size of mapping
+	uint_fast8_t flags;                     //!< FLOG_OUTPUT_SHM_* options
+} FLOG_OUTPUT_SHM_T;
+
+
+//! Get record seq of a ring
+#define flog_shm_record(h,seq) ((FLOG_SHM_RECORD_T *)((char *)(h)+sizeof(FLOG_SHM_HEADER_T)+((seq) & ((h)->record_amount-1))*(size_t)(h)->record_size))
+
+FLOG_SHM_HEADER_T * flog_shm_map(const char *name, int writable, uint32_t record_size, uint32_t record_amount, size_t *size);
+int flog_shm_read(const FLOG_SHM_HEADER_T *h, uint64_t seq, FLOG_SHM_RECORD_T *r);
+int flog_output_shm(FLOG_T *log,const FLOG_MSG_T *msg);
+FLOG_T * create_flog_output_shm(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *shm_name, uint32_t record_size, uint32_t record_amount, uint_fast8_t flags);
+void destroy_flog_output_shm(FLOG_T *p);
+
+#endif //FLOG_CONFIG_OUTPUT_SHM
+
+#endif //FLOG_OUTPUT_SHM_H
@@ -11,6 +11,7 @@
 #ifdef FLOG_CONFIG_OUTPUT_STDIO
 
 #include "flog_string.h"
+#include "flog_stats.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -22,16 +23,22 @@
 //! @retval 0 success
 int flog_output_stdout(FLOG_T *log,const FLOG_MSG_T *msg)
 {
-	char *str;
-	if(flog_get_str_message(&str,msg))
+	char buf[FLOG_STRING_BUF_SIZE],*str;
+	size_t len;
+	if(flog_get_str_message_log(&str,&len,buf,sizeof(buf),log,msg))
 		return(-1);
-	if(fputs(str,stdout)==EOF) {
+	if(!str)
+		return(0);
+	if(fwrite(str,1,len,stdout)!=len) {
 		log->output_error=errno;
-		free(str);
+		if(str!=buf)
+			free(str);
 		flog_print(log->error_log,NULL,FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_TO_STDOUT,strerror(log->output_error));
 		return(log->output_error);
 	}
-	free(str);
+	flog_stats_add_bytes(log,len);
+	if(str!=buf)
+		free(str);
 	return(0);
 }
 
@@ -41,20 +48,52 @@ int flog_output_stdout(FLOG_T *log,const FLOG_MSG_T *msg)
 //! @retval 0 success
 int flog_output_stderr(FLOG_T *log,const FLOG_MSG_T *msg)
 {
-	char *str;
-	if(flog_get_str_message(&str,msg))
+	char buf[FLOG_STRING_BUF_SIZE],*str;
+	size_t len;
+	if(flog_get_str_message_log(&str,&len,buf,sizeof(buf),log,msg))
 		return(-1);
-	if(fputs(str,stderr)==EOF) {
+	if(!str)
+		return(0);
+	if(fwrite(str,1,len,stderr)!=len) {
 		log->output_error=errno;
-		free(str);
+		if(str!=buf)
+			free(str);
 		flog_print(log->error_log,NULL,FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_TO_STDERR,strerror(log->output_error));
 		return(log->output_error);
 	}
-	free(str);
+	flog_stats_add_bytes(log,len);
+	if(str!=buf)
+		free(str);
 	return(0);
 }
 
 
+//! Flush function for log output to stdout
+
+//! stdio can not be flushed from a signal handler, so signal safe flushing does nothing
+//! @retval 0 success
+int flog_output_stdout_flush(FLOG_T *log,int signal_safe)
+{
+	(void)log;
+	if(signal_safe)
+		return(0);
+	return(fflush(stdout)==EOF);
+}
+
+
+//! Flush function for log output to stderr
+
+//! stderr is unbuffered, so this only matters if the program changed that
+//! @retval 0 success
+int flog_output_stderr_flush(FLOG_T *log,int signal_safe)
+{
+	(void)log;
+	if(signal_safe)
+		return(0);
+	return(fflush(stderr)==EOF);
+}
+
+
 //! create and return a log that writes to stdout
 
 //! @retval NULL error
@@ -64,6 +103,7 @@ FLOG_T * create_flog_output_stdout(const char *name, FLOG_MSG_TYPE_T accepted_ms
 	if((p=create_flog_t(name,accepted_msg_type))==NULL)
 		return(NULL);
 	p->output_func=flog_output_stdout;
+	p->output_flush_func=flog_output_stdout_flush;
 	return(p);
 }
 
@@ -77,6 +117,7 @@ FLOG_T * create_flog_output_stderr(const char *name, FLOG_MSG_TYPE_T accepted_ms
 	if((p=create_flog_t(name,accepted_msg_type))==NULL)
 		return(NULL);
 	p->output_func=flog_output_stderr;
+	p->output_flush_func=flog_output_stderr_flush;
 	return(p);
 }
 
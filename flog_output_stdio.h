@@ -26,6 +26,8 @@
 
 int flog_output_stdout(FLOG_T *log,const FLOG_MSG_T *msg);
 int flog_output_stderr(FLOG_T *log,const FLOG_MSG_T *msg);
+int flog_output_stdout_flush(FLOG_T *log,int signal_safe);
+int flog_output_stderr_flush(FLOG_T *log,int signal_safe);
 
 FLOG_T * create_flog_output_stdout(const char *name, FLOG_MSG_TYPE_T accepted_msg_type);
 FLOG_T * create_flog_output_stderr(const char *name, FLOG_MSG_TYPE_T accepted_msg_type);
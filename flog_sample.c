@@ -0,0 +1,155 @@
+//! Sampling for Flog
+
+//! @file flog_sample.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Keep only a fraction of high volume messages (such as FLOG_DEBUG)
+//! instead of all or nothing. Samplers are consulted before formatting
+//! when attached to the log passed to flog_print[f], so dropped messages
+//! never reach flog_vasprintf().
+
+#include "flog_sample.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_SAMPLING
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+
+
+//! State of the per thread random number generator (xorshift64*)
+static __thread uint64_t flog_sample_random_state;
+
+
+//! Get a fast, thread local, pseudo random number
+static uint32_t flog_sample_random(void)
+{
+	uint64_t x=flog_sample_random_state;
+	if(!x) {
+		//seed from the address of the thread local state and the time
+		x=(uint64_t)(uintptr_t)&flog_sample_random_state ^ ((uint64_t)time(NULL)<<32) ^ 0x9e3779b97f4a7c15ull;
+	}
+	x^=x>>12;
+	x^=x<<25;
+	x^=x>>27;
+	flog_sample_random_state=x;
+	return((uint32_t)((x*0x2545f4914f6cdd1dull)>>32));
+}
+
+
+#ifdef FLOG_CONFIG_SRC_INFO
+//! Find or claim the counter of a call site (thread safe)
+
+//! Call sites are identified by the __FILE__ pointer and line, colliding
+//! sites probe on to the next slot.
+//! @param[in,out] *s sampler
+//! @param[in] *src_file source file of message
+//! @param[in] src_line source line of message
+//! @retval NULL all counters are taken by other call sites
+static uint32_t * flog_sample_site(FLOG_SAMPLER_T *s,const char *src_file,uint_fast16_t src_line)
+{
+	uint32_t h=(uint32_t)(((uintptr_t)src_file>>3)^(src_line*2654435761u));
+	unsigned int i,n;
+	h^=h>>16;
+	for(n=0;n<FLOG_SAMPLE_SITES;n++) {
+		FLOG_SAMPLE_SITE_T *site=&s->site[(h+n)%FLOG_SAMPLE_SITES];
+		uint32_t state=__atomic_load_n(&site->state,__ATOMIC_ACQUIRE);
+		if(state==0) {
+			if(__atomic_compare_exchange_n(&site->state,&state,1,0,__ATOMIC_ACQUIRE,__ATOMIC_ACQUIRE)) {
+				site->file=src_file;
+				site->line=src_line;
+				__atomic_store_n(&site->state,2,__ATOMIC_RELEASE);
+				return(&site->count);
+			}
+		}
+		//another thread is claiming the slot, it may be for this call site
+		for(i=0;state==1;i++) {
+			if(i>=64)
+				sched_yield();
+			state=__atomic_load_n(&site->state,__ATOMIC_ACQUIRE);
+		}
+		if(site->file==src_file && site->line==src_line)
+			return(&site->count);
+	}
+	return(NULL);
+}
+#endif
+
+
+//! Set up sampling of messages in a log
+
+//! The sampler is created on first use and freed by destroy_flog_t().
+//! Set up sampling before the log is used by other threads.
+//! @param[in,out] *p log
+//! @param[in] types bitmask of message types to set sampling for
+//! @param[in] mode one of the FLOG_SAMPLE_* modes
+//! @param[in] rate keep 1 in rate messages (0 or 1 keeps all)
+//! @retval 0 success
+//! @retval 1 error
+int flog_set_sampling(FLOG_T *p,FLOG_MSG_TYPE_T types,uint_fast8_t mode,uint32_t rate)
+{
+	unsigned int i;
+	if(!p || mode>FLOG_SAMPLE_RANDOM)
+		return(1);
+	if(!p->sampler) {
+		if((p->sampler=flog_calloc(1,sizeof(FLOG_SAMPLER_T)))==NULL)
+			return(1);
+	}
+	if(rate<2)
+		mode=FLOG_SAMPLE_NONE;
+	for(i=0;i<FLOG_MSG_TYPE_AMOUNT;i++) {
+		if(types & (1u<<i)) {
+			p->sampler->mode[i]=mode;
+			p->sampler->rate[i]=rate;
+		}
+	}
+	return(0);
+}
+
+
+//! Decide whether a message should be kept by a sampler (thread safe)
+
+//! @param[in,out] *s sampler
+//! @param[in] type type of message
+//! @param[in] *src_file source file of message (only with FLOG_CONFIG_SRC_INFO)
+//! @param[in] src_line source line of message (only with FLOG_CONFIG_SRC_INFO)
+//! @retval 0 drop the message
+//! @return sampling rate of the kept message (1 if not sampled)
+#ifdef FLOG_CONFIG_SRC_INFO
+uint32_t flog_sample_msg(FLOG_SAMPLER_T *s,FLOG_MSG_TYPE_T type,const char *src_file,uint_fast16_t src_line)
+#else
+uint32_t flog_sample_msg(FLOG_SAMPLER_T *s,FLOG_MSG_TYPE_T type)
+#endif
+{
+	unsigned int i=flog_msg_type_index(type);
+	uint32_t rate,n;
+	if(i>=FLOG_MSG_TYPE_AMOUNT)
+		return(1);
+	rate=s->rate[i];
+	switch(s->mode[i]) {
+		case FLOG_SAMPLE_EVERY_TYPE:
+			n=__atomic_fetch_add(&s->type_count[i],1,__ATOMIC_RELAXED);
+			break;
+		case FLOG_SAMPLE_EVERY_SITE:
+#ifdef FLOG_CONFIG_SRC_INFO
+			{
+				uint32_t *count=flog_sample_site(s,src_file,src_line);
+				n=__atomic_fetch_add(count ? count : &s->type_count[i],1,__ATOMIC_RELAXED);
+			}
+#else
+			n=__atomic_fetch_add(&s->type_count[i],1,__ATOMIC_RELAXED);
+#endif
+			break;
+		case FLOG_SAMPLE_RANDOM:
+			//map the random number to 0..rate-1 without division
+			n=(uint32_t)(((uint64_t)flog_sample_random()*rate)>>32);
+			break;
+		default:
+			return(1);
+	}
+	return(n%rate ? 0 : rate);
+}
+
+#endif //FLOG_CONFIG_SAMPLING
@@ -0,0 +1,69 @@
+//! Sampling for Flog
+
+//! @file flog_sample.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Keep only a fraction of high volume messages (such as FLOG_DEBUG)
+//! instead of all or nothing. Kept messages carry the sampling rate
+//! in FLOG_MSG_T->sample_rate so counts can be scaled back up.
+
+
+#ifndef FLOG_SAMPLE_H
+#define FLOG_SAMPLE_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_SAMPLING
+
+//! @addtogroup FLOG_SAMPLE_MODES
+//! @brief How a sampler picks the messages to keep
+//! @{
+
+//! Keep all messages
+#define FLOG_SAMPLE_NONE        0
+//! Keep every rate:th message of each type
+#define FLOG_SAMPLE_EVERY_TYPE  1
+//! Keep every rate:th message from each call site (same as FLOG_SAMPLE_EVERY_TYPE without FLOG_CONFIG_SRC_INFO)
+#define FLOG_SAMPLE_EVERY_SITE  2
+//! Keep each message with a probability of 1/rate
+#define FLOG_SAMPLE_RANDOM      3
+
+//! @}
+
+
+//! Amount of call site counters in a sampler
+
+//! Each call site sampled with FLOG_SAMPLE_EVERY_SITE gets its own
+//! counter. Once all are taken, further call sites share the counter of
+//! their message type.
+#define FLOG_SAMPLE_SITES 64
+
+
+//! Call site counter of a sampler
+typedef struct flog_sample_site_t {
+	const char *file;   //!< __FILE__ pointer of the call site
+	uint32_t line;      //!< line of the call site
+	uint32_t state;     //!< 0 free, 1 being claimed, 2 in use
+	uint32_t count;     //!< message counter
+} FLOG_SAMPLE_SITE_T;
+
+
+//! Sampler structure - attached to a log with flog_set_sampling()
+typedef struct flog_sampler_t {
+	uint_fast8_t mode[FLOG_MSG_TYPE_AMOUNT];    //!< sampling mode per message type
+	uint32_t rate[FLOG_MSG_TYPE_AMOUNT];        //!< keep 1 in rate messages per message type
+	uint32_t type_count[FLOG_MSG_TYPE_AMOUNT];  //!< message counter per message type
+	FLOG_SAMPLE_SITE_T site[FLOG_SAMPLE_SITES]; //!< call site counters (open addressing on file and line)
+} FLOG_SAMPLER_T;
+
+
+int flog_set_sampling(FLOG_T *p,FLOG_MSG_TYPE_T types,uint_fast8_t mode,uint32_t rate);
+#ifdef FLOG_CONFIG_SRC_INFO
+uint32_t flog_sample_msg(FLOG_SAMPLER_T *s,FLOG_MSG_TYPE_T type,const char *src_file,uint_fast16_t src_line);
+#else
+uint32_t flog_sample_msg(FLOG_SAMPLER_T *s,FLOG_MSG_TYPE_T type);
+#endif
+
+#endif //FLOG_CONFIG_SAMPLING
+
+#endif //FLOG_SAMPLE_H
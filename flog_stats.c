@@ -0,0 +1,266 @@
+//! Statistics for Flog
+
+//! @file flog_stats.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Per log counters for sizing buffers and finding slow outputs,
+//! and self timing of flog_print[f] calls. The counters themselves are
+//! updated by flog.c and the output functions, this module reads and
+//! reports them.
+
+#include "flog_stats.h"
+#include "flog_alloc.h"
+#include "flog_detach.h"
+#include "flog_breaker.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FLOG_CONFIG_STATS
+
+
+//! Take a snapshot of the statistics of a log
+
+//! Safe to call while other threads are emitting messages
+//! @param[in] *p log
+//! @param[out] *stats snapshot
+void flog_get_stats(const FLOG_T *p,FLOG_STATS_T *stats)
+{
+	unsigned int i;
+	for(i=0;i<FLOG_MSG_TYPE_AMOUNT;i++) {
+		stats->seen[i]=__atomic_load_n(&p->stats.seen[i],__ATOMIC_RELAXED);
+		stats->accepted[i]=__atomic_load_n(&p->stats.accepted[i],__ATOMIC_RELAXED);
+		stats->emitted[i]=__atomic_load_n(&p->stats.emitted[i],__ATOMIC_RELAXED);
+		stats->dropped[i]=__atomic_load_n(&p->stats.dropped[i],__ATOMIC_RELAXED);
+	}
+	stats->bytes_written=__atomic_load_n(&p->stats.bytes_written,__ATOMIC_RELAXED);
+	stats->last_error=__atomic_load_n(&p->stats.last_error,__ATOMIC_RELAXED);
+	stats->last_print=__atomic_load_n(&p->stats.last_print,__ATOMIC_RELAXED);
+	flog_histogram_snapshot(&p->stats.write_latency,&stats->write_latency);
+}
+
+
+//! Reset the statistics of a log (not its sublogs)
+void flog_reset_stats(FLOG_T *p)
+{
+	unsigned int i;
+	for(i=0;i<FLOG_MSG_TYPE_AMOUNT;i++) {
+		__atomic_store_n(&p->stats.seen[i],0,__ATOMIC_RELAXED);
+		__atomic_store_n(&p->stats.accepted[i],0,__ATOMIC_RELAXED);
+		__atomic_store_n(&p->stats.emitted[i],0,__ATOMIC_RELAXED);
+		__atomic_store_n(&p->stats.dropped[i],0,__ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&p->stats.bytes_written,0,__ATOMIC_RELAXED);
+	__atomic_store_n(&p->stats.last_error,0,__ATOMIC_RELAXED);
+	flog_histogram_reset(&p->stats.write_latency);
+}
+
+
+//! Recursive part of flog_walk_stats()
+static int flog_walk_stats_depth(FLOG_T *p,FLOG_STATS_FUNC_T func,void *data,unsigned int depth)
+{
+	FLOG_STATS_T stats;
+	uint_fast8_t i;
+	int e;
+#ifdef FLOG_CONFIG_RECURSIVE_MAX_STACK_DEPTH
+	if(depth>=FLOG_CONFIG_RECURSIVE_MAX_STACK_DEPTH)
+		return(0);
+#endif
+	flog_get_stats(p,&stats);
+	if((e=func(p,&stats,depth,data)))
+		return(e);
+	for(i=0;i<p->sublog_amount;i++) {
+		if((e=flog_walk_stats_depth(__atomic_load_n(&p->sublog[i],__ATOMIC_ACQUIRE),func,data,depth+1)))
+			return(e);
+	}
+	return(0);
+}
+
+
+//! Call a function with a statistics snapshot of a log and all its sublogs
+
+//! @param[in] *p log tree to walk
+//! @param[in] func function to call for every log, walking stops if it returns non-zero
+//! @param[in] *data user data passed to func
+//! @retval 0 success
+//! @return the non-zero value returned by func
+int flog_walk_stats(FLOG_T *p,FLOG_STATS_FUNC_T func,void *data)
+{
+	if(!p || !func)
+		return(1);
+	return(flog_walk_stats_depth(p,func,data,0));
+}
+
+
+//! flog_walk_stats() callback used by flog_print_stats()
+static int flog_print_stats_func(FLOG_T *log,const FLOG_STATS_T *stats,unsigned int depth,void *data)
+{
+	uint64_t seen=0,accepted=0,emitted=0,dropped=0;
+	unsigned int i;
+	for(i=0;i<FLOG_MSG_TYPE_AMOUNT;i++) {
+		seen+=stats->seen[i];
+		accepted+=stats->accepted[i];
+		emitted+=stats->emitted[i];
+		dropped+=stats->dropped[i];
+	}
+	flog_printf((FLOG_T *)data,"stats",FLOG_INFO,0,
+		"%*s%s: seen %" PRIu64 " accepted %" PRIu64 " emitted %" PRIu64 " dropped %" PRIu64 " bytes %" PRIu64
+		" write p50 %" PRIu64 "ns p99 %" PRIu64 "ns max %" PRIu64 "ns last error %d",
+		(int)depth*2,"",log->name ? log->name : "(unnamed)",seen,accepted,emitted,dropped,stats->bytes_written,
+		flog_histogram_percentile(&stats->write_latency,50.0),flog_histogram_percentile(&stats->write_latency,99.0),
+		stats->write_latency.max,stats->last_error);
+#ifdef FLOG_CONFIG_DETACH
+	FLOG_DETACH_STATS_T d;
+	if(!flog_get_detach_stats(log,&d))
+		flog_printf((FLOG_T *)data,"stats",FLOG_INFO,0,
+			"%*s%s: queue depth %" PRIu32 " max %" PRIu32 " of %" PRIu32 " queued %" PRIu64 " dropped %" PRIu64,
+			(int)depth*2,"",log->name ? log->name : "(unnamed)",d.depth,d.depth_max,d.size,d.queued,d.dropped);
+#endif
+#ifdef FLOG_CONFIG_BREAKER
+	static const char *breaker_state[]={"closed","open","half-open"};
+	FLOG_BREAKER_STATS_T b;
+	if(!flog_get_breaker_stats(log,&b))
+		flog_printf((FLOG_T *)data,"stats",FLOG_INFO,0,
+			"%*s%s: breaker %s opened %" PRIu64 " failed %" PRIu64 " skipped %" PRIu64 " backoff %" PRIu32 "ms last error %d",
+			(int)depth*2,"",log->name ? log->name : "(unnamed)",breaker_state[b.state],b.opened,b.failed,b.skipped,b.backoff_ms,b.last_error);
+#endif
+	return(0);
+}
+
+
+//! Emit the statistics of a log tree as messages
+
+//! One FLOG_INFO message with subsystem "stats" is emitted for each log.
+//! @param[in,out] *target log to emit statistics to
+//! @param[in] *p log tree to report
+//! @retval 0 success
+int flog_print_stats(FLOG_T *target,FLOG_T *p)
+{
+	if(!target)
+		return(1);
+	return(flog_walk_stats(p,flog_print_stats_func,target));
+}
+
+
+//! Emit the statistics of a log tree if interval_ms has passed since the last time
+
+//! Call this regularly (e.g. from a main loop), only one caller per interval will print
+//! @param[in,out] *target log to emit statistics to
+//! @param[in] *p log tree to report
+//! @param[in] interval_ms minimum time between reports
+//! @retval 0 success (or nothing to do)
+int flog_print_stats_interval(FLOG_T *target,FLOG_T *p,uint32_t interval_ms)
+{
+	uint64_t now,last;
+	if(!p)
+		return(1);
+	now=flog_get_time_ns();
+	last=__atomic_load_n(&p->stats.last_print,__ATOMIC_RELAXED);
+	if(last && now-last<(uint64_t)interval_ms*1000000u)
+		return(0);
+	if(!__atomic_compare_exchange_n(&p->stats.last_print,&last,now,0,__ATOMIC_RELAXED,__ATOMIC_RELAXED))
+		return(0); //someone else is printing
+	return(flog_print_stats(target,p));
+}
+
+#endif //FLOG_CONFIG_STATS
+
+
+#ifdef FLOG_CONFIG_SELF_TIMING
+//! Start timing flog_print[f] calls made with this log
+
+//! Calls are timed when p is the log passed to flog_print[f] (normally the root of a log tree)
+//! @retval 0 success
+//! @retval 1 error
+int flog_timing_enable(FLOG_T *p)
+{
+	FLOG_TIMING_T *timing,*expected=NULL;
+	if(!p)
+		return(1);
+	if(__atomic_load_n(&p->timing,__ATOMIC_ACQUIRE))
+		return(0);
+	if((timing=flog_calloc(1,sizeof(FLOG_TIMING_T)))==NULL)
+		return(1);
+	if(!__atomic_compare_exchange_n(&p->timing,&expected,timing,0,__ATOMIC_RELEASE,__ATOMIC_RELAXED))
+		flog_free(timing); //enabled by someone else
+	return(0);
+}
+
+
+//! Stop timing flog_print[f] calls made with this log
+
+//! Frees the histograms, so do not call while other threads emit messages to p
+void flog_timing_disable(FLOG_T *p)
+{
+	if(p)
+		flog_free(__atomic_exchange_n(&p->timing,NULL,__ATOMIC_ACQ_REL));
+}
+
+
+//! Take a snapshot of the self timing histograms of a log
+
+//! @retval 0 success
+//! @retval 1 timing is not enabled for p
+int flog_get_timing(const FLOG_T *p,FLOG_TIMING_T *timing)
+{
+	const FLOG_TIMING_T *t;
+	if(!p || !(t=__atomic_load_n(&p->timing,__ATOMIC_ACQUIRE)))
+		return(1);
+	flog_histogram_snapshot(&t->total,&timing->total);
+	flog_histogram_snapshot(&t->format,&timing->format);
+	flog_histogram_snapshot(&t->route,&timing->route);
+	flog_histogram_snapshot(&t->output,&timing->output);
+	return(0);
+}
+
+
+//! Clear the self timing histograms of a log
+void flog_reset_timing(FLOG_T *p)
+{
+	FLOG_TIMING_T *t;
+	if(!p || !(t=__atomic_load_n(&p->timing,__ATOMIC_ACQUIRE)))
+		return;
+	flog_histogram_reset(&t->total);
+	flog_histogram_reset(&t->format);
+	flog_histogram_reset(&t->route);
+	flog_histogram_reset(&t->output);
+}
+
+
+//! Emit one histogram summary for flog_print_timing()
+static void flog_print_timing_histogram(FLOG_T *target,const char *name,const FLOG_HISTOGRAM_T *h)
+{
+	uint64_t n=flog_histogram_count(h);
+	flog_printf(target,"timing",FLOG_INFO,0,
+		"%s: calls %" PRIu64 " mean %" PRIu64 "ns p50 %" PRIu64 "ns p99 %" PRIu64 "ns p99.9 %" PRIu64 "ns max %" PRIu64 "ns",
+		name,n,n ? h->total/n : 0,flog_histogram_percentile(h,50.0),flog_histogram_percentile(h,99.0),
+		flog_histogram_percentile(h,99.9),h->max);
+}
+
+
+//! Emit the self timing histograms of a log as messages
+
+//! A snapshot is taken first, so target may be p itself.
+//! @param[in,out] *target log to emit timing to
+//! @param[in] *p timed log
+//! @retval 0 success
+//! @retval 1 timing is not enabled for p, or no target
+int flog_print_timing(FLOG_T *target,FLOG_T *p)
+{
+	FLOG_TIMING_T *timing;
+	if(!target)
+		return(1);
+	if((timing=flog_malloc(sizeof(FLOG_TIMING_T)))==NULL)
+		return(1);
+	if(flog_get_timing(p,timing)) {
+		flog_free(timing);
+		return(1);
+	}
+	flog_print_timing_histogram(target,"total",&timing->total);
+	flog_print_timing_histogram(target,"format",&timing->format);
+	flog_print_timing_histogram(target,"route",&timing->route);
+	flog_print_timing_histogram(target,"output",&timing->output);
+	flog_free(timing);
+	return(0);
+}
+#endif //FLOG_CONFIG_SELF_TIMING
@@ -0,0 +1,63 @@
+//! Statistics for Flog
+
+//! @file flog_stats.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Per log counters for sizing buffers and finding slow outputs,
+//! and self timing of flog_print[f] calls. The counting macros are
+//! safe to use when FLOG_CONFIG_STATS is not defined, they then
+//! compile to nothing.
+
+
+#ifndef FLOG_STATS_H
+#define FLOG_STATS_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_STATS
+
+//! Count a message in one of the FLOG_STATS_T counter arrays
+
+//! @param[in,out] p log
+//! @param counter name of counter (seen, accepted, emitted or dropped)
+//! @param[in] type_index index from flog_msg_type_index()
+#define flog_stats_count(p, counter, type_index) \
+do { \
+	if((type_index)<FLOG_MSG_TYPE_AMOUNT) \
+		__atomic_fetch_add(&(p)->stats.counter[(type_index)],1,__ATOMIC_RELAXED); \
+} while(0)
+
+//! Count bytes written by an output function
+#define flog_stats_add_bytes(p, n) __atomic_fetch_add(&(p)->stats.bytes_written,(uint64_t)(n),__ATOMIC_RELAXED)
+
+//! Callback for flog_walk_stats()
+
+//! @param[in] *log log being visited
+//! @param[in] *stats snapshot of the log's statistics
+//! @param[in] depth depth in the log tree (0 for the log passed to flog_walk_stats())
+//! @param[in] *data user data
+//! @retval 0 continue walking
+typedef int (*FLOG_STATS_FUNC_T)(FLOG_T *log,const FLOG_STATS_T *stats,unsigned int depth,void *data);
+
+void flog_get_stats(const FLOG_T *p,FLOG_STATS_T *stats);
+void flog_reset_stats(FLOG_T *p);
+int flog_walk_stats(FLOG_T *p,FLOG_STATS_FUNC_T func,void *data);
+int flog_print_stats(FLOG_T *target,FLOG_T *p);
+int flog_print_stats_interval(FLOG_T *target,FLOG_T *p,uint32_t interval_ms);
+
+#else //FLOG_CONFIG_STATS
+
+#define flog_stats_count(p, counter, type_index) (void)(0)
+#define flog_stats_add_bytes(p, n) (void)(0)
+
+#endif //FLOG_CONFIG_STATS
+
+#ifdef FLOG_CONFIG_SELF_TIMING
+int flog_timing_enable(FLOG_T *p);
+void flog_timing_disable(FLOG_T *p);
+int flog_get_timing(const FLOG_T *p,FLOG_TIMING_T *timing);
+void flog_reset_timing(FLOG_T *p);
+int flog_print_timing(FLOG_T *target,FLOG_T *p);
+#endif //FLOG_CONFIG_SELF_TIMING
+
+#endif //FLOG_STATS_H
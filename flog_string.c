@@ -10,6 +10,9 @@
 
 #ifdef FLOG_CONFIG_STRING_OUTPUT
 
+#include "flog_layout.h"
+#include "flog_trace.h"
+
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,46 +46,143 @@ int flog_get_str_iso_timestamp(char **strp, const FLOG_TIMESTAMP_T ts)
 #endif //FLOG_CONFIG_TIMESTAMP
 
 
+//! Labels for each message type, indexed by flog_msg_type_index()
+
+//! NULL means that the message type is rendered without a label
+static const char *flog_msg_type_label[FLOG_MSG_TYPE_AMOUNT] = {
+	"Critical",   // FLOG_CRITICAL
+	"Error",      // FLOG_ERROR
+	"Warning",    // FLOG_WARNING
+	"!",          // FLOG_NOTIFY
+	NULL,         // FLOG_INFO
+	NULL,         // FLOG_VERBOSE
+	"Debug",      // FLOG_DEBUG
+	"Deep debug"  // FLOG_DEEP_DEBUG
+};
+
+
+//! Lengths of the strings in flog_msg_type_label
+static size_t flog_msg_type_label_len[FLOG_MSG_TYPE_AMOUNT] = {8, 5, 7, 1, 0, 0, 5, 10};
+
+
+//! Sequence of each label and its length, odd while flog_set_msg_type_label() changes them
+static unsigned int flog_msg_type_label_seq[FLOG_MSG_TYPE_AMOUNT];
+
+
+//! Get the label of a message type without allocating
+
+//! The label and its length are read as a pair, retried if the label is
+//! set meanwhile, so they always match.
+//! @param[in] type type of message
+//! @param[out] *len length of the label (may be NULL)
+//! @return constant label string, or NULL if the type has no label
+const char * flog_get_msg_type_label(const FLOG_MSG_TYPE_T type, size_t *len)
+{
+	unsigned int i=flog_msg_type_index(type),seq;
+	const char *label;
+	size_t label_len;
+	if(i>=FLOG_MSG_TYPE_AMOUNT) {
+		if(len)
+			*len=0;
+		return(NULL);
+	}
+	do {
+		seq=__atomic_load_n(&flog_msg_type_label_seq[i],__ATOMIC_ACQUIRE);
+		label=__atomic_load_n(&flog_msg_type_label[i],__ATOMIC_RELAXED);
+		label_len=__atomic_load_n(&flog_msg_type_label_len[i],__ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while((seq & 1) || __atomic_load_n(&flog_msg_type_label_seq[i],__ATOMIC_RELAXED)!=seq);
+	if(len)
+		*len=label_len;
+	return(label);
+}
+
+
+//! Set the label of a message type
+
+//! The string is not copied and must stay valid for as long as flog uses
+//! it. May be called while logging, readers see the old or the new label.
+//! @param[in] type type of message (a single FLOG_* type)
+//! @param[in] *label new label, NULL or "" to render the type without a label
+//! @retval 0 success
+//! @retval 1 invalid message type
+int flog_set_msg_type_label(const FLOG_MSG_TYPE_T type, const char *label)
+{
+	unsigned int i=flog_msg_type_index(type),seq;
+	if(i>=FLOG_MSG_TYPE_AMOUNT)
+		return(1);
+	if(label && !label[0])
+		label=NULL;
+	//make the sequence odd, waiting for another thread setting the label
+	seq=__atomic_load_n(&flog_msg_type_label_seq[i],__ATOMIC_RELAXED);
+	while((seq & 1) || !__atomic_compare_exchange_n(&flog_msg_type_label_seq[i],&seq,seq+1,1,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED))
+		seq=__atomic_load_n(&flog_msg_type_label_seq[i],__ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&flog_msg_type_label[i],label,__ATOMIC_RELAXED);
+	__atomic_store_n(&flog_msg_type_label_len[i],label ? strlen(label) : 0,__ATOMIC_RELAXED);
+	__atomic_store_n(&flog_msg_type_label_seq[i],seq+2,__ATOMIC_RELEASE);
+	return(0);
+}
+
+
+#ifdef FLOG_CONFIG_OUTPUT_ANSI_COLOR
+//! ANSI color escape codes for each message type, indexed by flog_msg_type_index()
+static const char *flog_msg_type_color[FLOG_MSG_TYPE_AMOUNT] = {
+	"\033[1;31m", // FLOG_CRITICAL (bold red)
+	"\033[31m",   // FLOG_ERROR (red)
+	"\033[33m",   // FLOG_WARNING (yellow)
+	"\033[1m",    // FLOG_NOTIFY (bold)
+	NULL,         // FLOG_INFO
+	NULL,         // FLOG_VERBOSE
+	"\033[36m",   // FLOG_DEBUG (cyan)
+	"\033[34m"    // FLOG_DEEP_DEBUG (blue)
+};
+
+
+//! Get the ANSI color escape code of a message type
+
+//! @param[in] type type of message
+//! @return constant escape code, or NULL if the type is not colored
+const char * flog_get_msg_type_color(const FLOG_MSG_TYPE_T type)
+{
+	unsigned int i=flog_msg_type_index(type);
+	if(i>=FLOG_MSG_TYPE_AMOUNT)
+		return(NULL);
+	return(flog_msg_type_color[i]);
+}
+
+
+//! Set the ANSI color escape code of a message type
+
+//! The string is not copied and must stay valid for as long as flog uses it.
+//! @param[in] type type of message (a single FLOG_* type)
+//! @param[in] *color escape code such as "\033[32m", NULL or "" for no color
+//! @retval 0 success
+//! @retval 1 invalid message type
+int flog_set_msg_type_color(const FLOG_MSG_TYPE_T type, const char *color)
+{
+	unsigned int i=flog_msg_type_index(type);
+	if(i>=FLOG_MSG_TYPE_AMOUNT)
+		return(1);
+	flog_msg_type_color[i]=(color && color[0]) ? color : NULL;
+	return(0);
+}
+#endif //FLOG_CONFIG_OUTPUT_ANSI_COLOR
+
+
 //! Create a string or NULL according to message type
 
+//! Allocates a copy of the label, prefer flog_get_msg_type_label()
 //! @param[out] **strp string to set (NULL on error)
 //! @param[in] type type of message
 //! @retval 0 success
 int flog_get_str_msg_type(char **strp, const FLOG_MSG_TYPE_T type)
 {
+	const char *label;
 	*strp=NULL;
-	switch(type)
-	{
-		case FLOG_CRITICAL:
-			if(!(*strp=strdup("Critical")))
-				return(-1);
-			break;
-		case FLOG_ERROR:
-			if(!(*strp=strdup("Error")))
-				return(-1);
-			break;
-		case FLOG_WARNING:
-			if(!(*strp=strdup("Warning")))
-				return(-1);
-			break;
-		case FLOG_NOTIFY:
-			if(!(*strp=strdup("!")))
-				return(-1);
-			break;
-		case FLOG_INFO:
-			break;
-		case FLOG_VERBOSE:
-			break;
-		case FLOG_DEBUG:
-			if(!(*strp=strdup("Debug")))
-				return(-1);
-			break;
-		case FLOG_DEEP_DEBUG:
-			if(!(*strp=strdup("Deep debug")))
-				return(-1);
-			break;
-		default:
-			break;
+	if((label=flog_get_msg_type_label(type,NULL))) {
+		if(!(*strp=strdup(label)))
+			return(-1);
 	}
 	return(0);
 }
@@ -319,95 +419,148 @@ int flog_get_str_message_header(char **strp, const FLOG_MSG_T *p)
 //! @param[in] type type of message
 //! @param[in] msg_id msg ID
 //! @param[in] *text custom message string
+//! @param[in] flags output options (see FLOG_OUTPUT_FLAG_*)
 //! @retval 0 success
-int flog_get_str_message_content(char **strp, const FLOG_MSG_TYPE_T type, const FLOG_MSG_ID_T msg_id, const char *text)
+int flog_get_str_message_content_ex(char **strp, const FLOG_MSG_TYPE_T type, const FLOG_MSG_ID_T msg_id, const char *text, const uint_fast8_t flags)
 {
-	char *str_type,*str_msg_id;
+	const char *str_type, *color="", *reset="";
+	size_t str_type_len;
+	char *str_msg_id;
+	int r=0;
 	*strp=NULL;
-	if(flog_get_str_msg_type(&str_type,type))
-		return(-1);
-	if(flog_get_str_msg_id(&str_msg_id,msg_id)) {
-		free(str_type);
-		return(-1);
+	str_type=flog_get_msg_type_label(type,&str_type_len);
+#ifdef FLOG_CONFIG_OUTPUT_ANSI_COLOR
+	if(str_type && (flags & FLOG_OUTPUT_FLAG_ANSI_COLOR)) {
+		if((color=flog_get_msg_type_color(type)))
+			reset=FLOG_ANSI_COLOR_RESET;
+		else
+			color="";
 	}
+#else //FLOG_CONFIG_OUTPUT_ANSI_COLOR
+	(void)flags;
+#endif //FLOG_CONFIG_OUTPUT_ANSI_COLOR
+	if(flog_get_str_msg_id(&str_msg_id,msg_id))
+		return(-1);
 	if(str_type) {
 		if(str_msg_id) {
-			if(text) {
-				if(asprintf(strp,"%s: %s: %s",str_type,str_msg_id,text)==-1) {
-					free(str_type);
-					free(str_msg_id);
-					*strp=NULL;
-					return(-1);
-				}
-			} else {
-				if(asprintf(strp,"%s: %s",str_type,str_msg_id)==-1) {
-					free(str_type);
-					free(str_msg_id);
-					*strp=NULL;
-					return(-1);
-				}
-			}
-			free(str_msg_id);
+			if(text)
+				r=asprintf(strp,"%s%.*s%s: %s: %s",color,(int)str_type_len,str_type,reset,str_msg_id,text);
+			else
+				r=asprintf(strp,"%s%.*s%s: %s",color,(int)str_type_len,str_type,reset,str_msg_id);
 		} else {
-			if(text) {
-				if(asprintf(strp,"%s: %s",str_type,text)==-1) {
-					free(str_type);
-					*strp=NULL;
-					return(-1);
-				}
-			} else {
-				if(!(*strp=strdup(str_type))) {
-					free(str_type);
-					return(-1);
-				}
-			}
+			if(text)
+				r=asprintf(strp,"%s%.*s%s: %s",color,(int)str_type_len,str_type,reset,text);
+			else
+				r=asprintf(strp,"%s%.*s%s",color,(int)str_type_len,str_type,reset);
 		}
-		free(str_type);
 	} else {
 		if(str_msg_id) {
-			if(text) {
-				if(asprintf(strp,"%s: %s",str_msg_id,text)==-1) {
-					free(str_msg_id);
-					*strp=NULL;
-					return(-1);
-				}
-			} else {
-				if(!(*strp=strdup(str_msg_id))) {
-					free(str_msg_id);
-					return(-1);
-				}
+			if(text)
+				r=asprintf(strp,"%s: %s",str_msg_id,text);
+			else {
+				*strp=str_msg_id; //hand over the allocated string
+				return(0);
 			}
-			free(str_msg_id);
 		} else {
 			if(text) {
 				if(!(*strp=strdup(text)))
 					return(-1);
-			} else
-				*strp=NULL;
+			}
 		}
 	}
+	free(str_msg_id);
+	if(r==-1) {
+		*strp=NULL;
+		return(-1);
+	}
+	return(0);
+}
+
+
+//! Create a string with message contents
+
+//! @param[out] **strp string to set (NULL on error)
+//! @param[in] type type of message
+//! @param[in] msg_id msg ID
+//! @param[in] *text custom message string
+//! @retval 0 success
+int flog_get_str_message_content(char **strp, const FLOG_MSG_TYPE_T type, const FLOG_MSG_ID_T msg_id, const char *text)
+{
+	return(flog_get_str_message_content_ex(strp,type,msg_id,text,0));
+}
+
+
+#ifdef FLOG_CONFIG_LAYOUT
+//! Render a message with a layout, into buf when it fits
+
+//! A string that does not fit buf comes from malloc(), free() it after
+//! use, it is not counted by FLOG_CONFIG_ALLOC (see flog_alloc.h).
+//! @param[out] **strp rendered string: buf, an allocated string or NULL if there is nothing to output
+//! @param[out] *len length of rendered string
+//! @param[out] *buf buffer to try first
+//! @param[in] size size of buf
+//! @param[in] *l compiled layout, NULL for the default layout
+//! @param[in] *p flog message struct
+//! @param[in] flags output options (see FLOG_OUTPUT_FLAG_*)
+//! @retval 0 success
+int flog_get_str_message_layout(char **strp, size_t *len, char *buf, size_t size, const FLOG_LAYOUT_T *l, const FLOG_MSG_T *p, const uint_fast8_t flags)
+{
+	*strp=NULL;
+	if(l==NULL && (l=flog_get_default_layout())==NULL)
+		return(-1);
+	if((*len=flog_layout_render(l,buf,size,p,flags))==0)
+		return(0);
+	if(*len<size) {
+		*strp=buf;
+		return(0);
+	}
+	if((*strp=malloc(*len+1))==NULL)
+		return(-1);
+	flog_layout_render(l,*strp,*len+1,p,flags);
 	return(0);
 }
+#endif //FLOG_CONFIG_LAYOUT
 
 
 //! Create and return a string from FLOG_MSG_T type
 
 //! @param[out] **strp string to set (NULL on error)
 //! @param[in] *p flog message struct
+//! @param[in] flags output options (see FLOG_OUTPUT_FLAG_*)
 //! @retval 0 success
-int flog_get_str_message(char **strp, const FLOG_MSG_T *p)
+int flog_get_str_message_ex(char **strp, const FLOG_MSG_T *p, const uint_fast8_t flags)
 {
+#ifdef FLOG_CONFIG_LAYOUT
+	char buf[FLOG_STRING_BUF_SIZE];
+	size_t len;
+	if(flog_get_str_message_layout(strp,&len,buf,sizeof(buf),NULL,p,flags))
+		return(-1);
+	if(*strp==buf && (*strp=strndup(buf,len))==NULL)
+		return(-1);
+	return(0);
+#else //FLOG_CONFIG_LAYOUT
 	char *str_msg_header, *str_msg_content;
+	char str_notes[96]="";
 	*strp=NULL;
+#ifdef FLOG_CONFIG_TRACE
+	if(p->span_depth) {
+		str_notes[0]=' ';
+		flog_trace_str_span(str_notes+1,sizeof(str_notes)-1,p);
+	}
+#endif
+#ifdef FLOG_CONFIG_SAMPLING
+	if(p->sample_rate>1)
+		snprintf(str_notes+strlen(str_notes),sizeof(str_notes)-strlen(str_notes)," (sampled 1/%u)",(unsigned int)p->sample_rate);
+#endif
 	if(flog_get_str_message_header(&str_msg_header,p))
 		return(-1);
-	if(flog_get_str_message_content(&str_msg_content, p->type, p->msg_id, p->text)) {
+	if(flog_get_str_message_content_ex(&str_msg_content, p->type, p->msg_id, p->text, flags)) {
 		free(str_msg_header);
 		return(-1);
 	}
 	if(str_msg_header) {
 		if(str_msg_content) {
-			if(asprintf(strp,"[%s] %s\n", str_msg_header, str_msg_content)==-1) {
+			if(asprintf(strp,"[%s] %s%s\n", str_msg_header, str_msg_content, str_notes)==-1) {
 				free(str_msg_content);
 				free(str_msg_header);
 				*strp=NULL;
@@ -415,7 +568,7 @@ int flog_get_str_message(char **strp, const FLOG_MSG_T *p)
 			}
 			free(str_msg_content);
 		} else {
-			if(asprintf(strp,"[%s]\n", str_msg_header)==-1) {
+			if(asprintf(strp,"[%s]%s\n", str_msg_header, str_notes)==-1) {
 				free(str_msg_header);
 				*strp=NULL;
 				return(-1);
@@ -424,7 +577,7 @@ int flog_get_str_message(char **strp, const FLOG_MSG_T *p)
 		free(str_msg_header);
 	} else {
 		if(str_msg_content) {
-			if(asprintf(strp,"%s\n", str_msg_content)==-1) {
+			if(asprintf(strp,"%s%s\n", str_msg_content, str_notes)==-1) {
 			free(str_msg_content);
 			*strp=NULL;
 			return(-1);
@@ -434,6 +587,130 @@ int flog_get_str_message(char **strp, const FLOG_MSG_T *p)
 			*strp=NULL;
 	}
 	return(0);
+#endif //FLOG_CONFIG_LAYOUT
+}
+
+
+//! Create and return a string from FLOG_MSG_T type
+
+//! @param[out] **strp string to set (NULL on error)
+//! @param[in] *p flog message struct
+//! @retval 0 success
+int flog_get_str_message(char **strp, const FLOG_MSG_T *p)
+{
+	return(flog_get_str_message_ex(strp,p,0));
+}
+
+
+//! Render a message with the layout and output flags of a log
+static int flog_get_str_message_log_render(char **strp, size_t *len, char *buf, size_t size, const FLOG_T *log, const FLOG_MSG_T *p)
+{
+#ifdef FLOG_CONFIG_LAYOUT
+	return(flog_get_str_message_layout(strp,len,buf,size,log->layout,p,log->output_flags));
+#else //FLOG_CONFIG_LAYOUT
+	(void)buf;
+	(void)size;
+	if(flog_get_str_message_ex(strp,p,log->output_flags))
+		return(-1);
+	*len=*strp ? strlen(*strp) : 0;
+	return(0);
+#endif //FLOG_CONFIG_LAYOUT
+}
+
+
+#ifdef FLOG_CONFIG_RENDER_CACHE_SIZE
+#ifdef FLOG_CONFIG_LAYOUT
+//! Layout of a log as a render cache key
+#define flog_render_cache_layout(log) ((const void *)(log)->layout)
+#else
+#define flog_render_cache_layout(log) ((const void *)NULL)
+#endif
+
+
+//! Find the line of a message rendered for a log with the same layout, flags and subsystem path
+
+//! @return entry index, -1 if not rendered yet
+static int flog_render_cache_find(const FLOG_RENDER_CACHE_T *c, const FLOG_T *log, const FLOG_MSG_T *p)
+{
+	unsigned int i;
+	for(i=0;i<c->amount;i++) {
+		if(c->entry[i].layout!=flog_render_cache_layout(log) || c->entry[i].flags!=log->output_flags)
+			continue;
+#ifdef FLOG_CONFIG_SAMPLING
+		if(c->entry[i].sample_rate!=p->sample_rate)
+			continue;
+#endif
+		if(p->subsystem ? (c->entry[i].subsystem && !strcmp(c->entry[i].subsystem,p->subsystem)) : !c->entry[i].subsystem)
+			return((int)i);
+	}
+	return(-1);
+}
+
+
+//! Keep a rendered line for the other outputs of a message, if there is room
+static void flog_render_cache_store(FLOG_RENDER_CACHE_T *c, const FLOG_T *log, const FLOG_MSG_T *p, const char *str, size_t len)
+{
+	size_t subsystem_size=p->subsystem ? strlen(p->subsystem)+1 : 0;
+	char *dst;
+	if(c->amount>=FLOG_RENDER_CACHE_ENTRIES || c->used+subsystem_size+len > sizeof(c->buf))
+		return;
+	dst=c->buf+c->used;
+	c->entry[c->amount].layout=flog_render_cache_layout(log);
+	c->entry[c->amount].flags=log->output_flags;
+#ifdef FLOG_CONFIG_SAMPLING
+	c->entry[c->amount].sample_rate=p->sample_rate;
+#endif
+	//the subsystem path may be freed before the next output, keep a copy
+	c->entry[c->amount].subsystem=subsystem_size ? memcpy(dst,p->subsystem,subsystem_size) : NULL;
+	c->entry[c->amount].str=str ? memcpy(dst+subsystem_size,str,len) : NULL;
+	c->entry[c->amount].len=len;
+	c->used+=subsystem_size+len;
+	c->amount++;
+}
+#endif //FLOG_CONFIG_RENDER_CACHE_SIZE
+
+
+//! Render a message for the output of a log, into buf when it fits
+
+//! Uses the layout and output flags of the log. Free *strp with free()
+//! after use when it is not buf, it comes from malloc() and is not
+//! counted by FLOG_CONFIG_ALLOC (see flog_alloc.h). With FLOG_CONFIG_RENDER_CACHE_SIZE the first
+//! output of a message renders it, and other outputs with the same
+//! layout, flags and subsystem path get a copy.
+//! @param[out] **strp rendered string: buf, an allocated string or NULL if there is nothing to output
+//! @param[out] *len length of rendered string
+//! @param[out] *buf buffer to try first
+//! @param[in] size size of buf
+//! @param[in] *log log outputting the message
+//! @param[in] *p flog message struct
+//! @retval 0 success
+int flog_get_str_message_log(char **strp, size_t *len, char *buf, size_t size, const FLOG_T *log, const FLOG_MSG_T *p)
+{
+#ifdef FLOG_CONFIG_RENDER_CACHE_SIZE
+	FLOG_RENDER_CACHE_T *c=p->render;
+	int i;
+	if(c && (i=flog_render_cache_find(c,log,p))!=-1) {
+		*len=c->entry[i].len;
+		if(c->entry[i].str==NULL) {
+			*strp=NULL;
+			return(0);
+		}
+		if(*len<size)
+			*strp=buf;
+		else if((*strp=malloc(*len+1))==NULL)
+			return(-1);
+		memcpy(*strp,c->entry[i].str,*len);
+		(*strp)[*len]=0;
+		return(0);
+	}
+	if(flog_get_str_message_log_render(strp,len,buf,size,log,p))
+		return(-1);
+	if(c)
+		flog_render_cache_store(c,log,p,*strp,*len);
+	return(0);
+#else //FLOG_CONFIG_RENDER_CACHE_SIZE
+	return(flog_get_str_message_log_render(strp,len,buf,size,log,p));
+#endif //FLOG_CONFIG_RENDER_CACHE_SIZE
 }
 
 
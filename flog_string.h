@@ -9,20 +9,39 @@
 #define FLOG_STRING_H
 
 #include "flog.h"
+#include <stddef.h>
 
 #ifdef FLOG_CONFIG_STRING_OUTPUT
 
+//! Size of stack buffers messages are rendered into before allocating (see flog_get_str_message_log())
+#define FLOG_STRING_BUF_SIZE 512
+
+
 #ifdef FLOG_CONFIG_TIMESTAMP
 int flog_get_str_iso_timestamp(char **strp, const FLOG_TIMESTAMP_T ts);
 #endif //FLOG_CONFIG_TIMESTAMP
+const char * flog_get_msg_type_label(const FLOG_MSG_TYPE_T type, size_t *len);
+int flog_set_msg_type_label(const FLOG_MSG_TYPE_T type, const char *label);
+#ifdef FLOG_CONFIG_OUTPUT_ANSI_COLOR
+//! ANSI escape code to reset colors after a colored label
+#define FLOG_ANSI_COLOR_RESET "\033[0m"
+const char * flog_get_msg_type_color(const FLOG_MSG_TYPE_T type);
+int flog_set_msg_type_color(const FLOG_MSG_TYPE_T type, const char *color);
+#endif //FLOG_CONFIG_OUTPUT_ANSI_COLOR
 int flog_get_str_msg_type(char **strp, const FLOG_MSG_TYPE_T type);
 int flog_get_str_msg_id(char **strp, const FLOG_MSG_ID_T msg_id);
 #ifdef FLOG_CONFIG_SRC_INFO
 int flog_get_str_src_info(char **strp, const char *src_file, const uint_fast16_t src_line, const char *src_func);
 #endif //FLOG_CONFIG_SRC_INFO
 int flog_get_str_message_header(char **strp, const FLOG_MSG_T *p);
+int flog_get_str_message_content_ex(char **strp, const FLOG_MSG_TYPE_T type, const FLOG_MSG_ID_T msg_id, const char *text, const uint_fast8_t flags);
 int flog_get_str_message_content(char **strp, const FLOG_MSG_TYPE_T type, const FLOG_MSG_ID_T msg_id, const char *text);
+int flog_get_str_message_ex(char **strp, const FLOG_MSG_T *p, const uint_fast8_t flags);
 int flog_get_str_message(char **strp, const FLOG_MSG_T *p);
+#ifdef FLOG_CONFIG_LAYOUT
+int flog_get_str_message_layout(char **strp, size_t *len, char *buf, size_t size, const struct flog_layout_t *l, const FLOG_MSG_T *p, const uint_fast8_t flags);
+#endif //FLOG_CONFIG_LAYOUT
+int flog_get_str_message_log(char **strp, size_t *len, char *buf, size_t size, const FLOG_T *log, const FLOG_MSG_T *p);
 
 #endif //FLOG_CONFIG_STRING_OUTPUT
 
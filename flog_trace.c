@@ -0,0 +1,385 @@
+//! Scoped spans and Chrome trace output for Flog
+
+//! @file flog_trace.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! A span reads the monotonic clock when it begins and ends, the wall
+//! clock only for the timestamp of its message. Trace events are put
+//! together on the stack and written with a single fwrite(), so events of
+//! concurrent threads don't mix.
+
+#define _GNU_SOURCE
+
+#include "flog_trace.h"
+#include "flog_alloc.h"
+
+#ifdef FLOG_CONFIG_TRACE
+
+#include "flog_string.h"
+#include "flog_escape.h"
+#include "flog_stats.h"
+#include "flog_context.h"
+#ifdef FLOG_CONFIG_BREAKER
+#include "flog_breaker.h"
+#endif
+#ifdef FLOG_CONFIG_DETACH
+#include "flog_detach.h"
+#endif
+#ifdef FLOG_CONFIG_GOVERNOR
+#include "flog_governor.h"
+#endif
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+
+//! Spans of this thread being timed
+static __thread uint16_t flog_trace_depth;
+
+//! Thread id of this thread (0 until flog_trace_tid() is called)
+static __thread uint32_t flog_trace_thread_id;
+
+
+//! Get the id of the calling thread, as shown by ps and in traces
+uint32_t flog_trace_tid(void)
+{
+	if(!flog_trace_thread_id)
+		flog_trace_thread_id=(uint32_t)syscall(SYS_gettid);
+	return(flog_trace_thread_id);
+}
+
+
+//! do not call directly, use the flog_trace() macro instead
+
+//! Begin a span, if the log uses messages of its type
+//! @param[in,out] *p log to emit the span to
+//! @param[in] *subsystem subsystem of the span
+//! @param[in] *src_file source code file (flog_trace() uses __FILE__)
+//! @param[in] src_line source code line (flog_trace() uses __LINE__)
+//! @param[in] *src_func source code function (flog_trace() uses __FUNCTION__)
+//! @param[in] type message type of the span
+//! @param[in] *name name of the span
+//! @return span, with log NULL if it is not used
+FLOG_TRACE_SPAN_T flog_trace_begin(FLOG_T *p,const char *subsystem,
+#ifdef FLOG_CONFIG_SRC_INFO
+                                   const char *src_file,uint_fast16_t src_line,const char *src_func,
+#endif
+                                   FLOG_MSG_TYPE_T type,const char *name)
+{
+	FLOG_TRACE_SPAN_T s={0};
+	if(!p)
+		return(s);
+	if(!flog_is_message_used(p,type)) {
+#ifdef FLOG_CONFIG_GOVERNOR
+		flog_governor_count(p,type);
+#endif
+		return(s);
+	}
+	s.log=p;
+	s.subsystem=subsystem;
+	s.name=name;
+#ifdef FLOG_CONFIG_SRC_INFO
+	s.src_file=src_file;
+	s.src_line=src_line;
+	s.src_func=src_func;
+#endif
+	s.type=type;
+	flog_trace_depth++;
+	s.start=flog_get_time_ns();
+	return(s);
+}
+
+
+//! End a span and emit it, called when the variable of flog_trace() goes out of scope
+void flog_trace_end(FLOG_TRACE_SPAN_T *s)
+{
+	if(!s->log)
+		return;
+	uint64_t ns=flog_get_time_ns()-s->start;
+	uint16_t depth=flog_trace_depth--;
+#ifdef FLOG_CONFIG_BREAKER
+	//discard spans of an output running with a breaker
+	if(flog_breaker_quiet)
+		return;
+#endif
+	FLOG_MSG_T msg;
+	init_flog_msg_t(&msg);
+	if(gettimeofday(&msg.timestamp,NULL))
+		return;
+	if(s->subsystem && s->subsystem[0])
+		msg.subsystem=(char *)s->subsystem;
+#ifdef FLOG_CONFIG_SRC_INFO
+	if(s->src_file && s->src_file[0])
+		msg.src_file=(char *)s->src_file;
+	msg.src_line=s->src_line;
+	if(s->src_func && s->src_func[0])
+		msg.src_func=(char *)s->src_func;
+	msg.flags=FLOG_MSG_FLAG_STATIC_SRC;
+#endif
+	msg.type=s->type;
+	if(s->name && s->name[0])
+		msg.text=(char *)s->name;
+	msg.span_ns=ns;
+	msg.span_tid=flog_trace_tid();
+	msg.span_depth=depth;
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+	msg.context=flog_context();
+#endif
+	flog_add_msg(s->log,&msg);
+}
+
+
+//! Describe the span of a message, such as "(1.250 ms, depth 2)"
+
+//! Like snprintf(), the buffer is only written up to size and always
+//! terminated, but the full length is returned.
+//! @return length of description, 0 if the message is not a span
+int flog_trace_str_span(char *buf,size_t size,const FLOG_MSG_T *msg)
+{
+	uint64_t ns=msg->span_ns;
+	if(!msg->span_depth) {
+		if(size)
+			buf[0]=0;
+		return(0);
+	}
+	if(ns<1000)
+		return(snprintf(buf,size,"(%" PRIu64 " ns, depth %u)",ns,(unsigned int)msg->span_depth));
+	if(ns<1000000)
+		return(snprintf(buf,size,"(%" PRIu64 ".%03" PRIu64 " us, depth %u)",ns/1000,ns%1000,(unsigned int)msg->span_depth));
+	if(ns<1000000000)
+		return(snprintf(buf,size,"(%" PRIu64 ".%03" PRIu64 " ms, depth %u)",ns/1000000,ns/1000%1000,(unsigned int)msg->span_depth));
+	return(snprintf(buf,size,"(%" PRIu64 ".%03" PRIu64 " s, depth %u)",ns/1000000000,ns/1000000%1000,(unsigned int)msg->span_depth));
+}
+
+
+//! Trace event being put together, len counts past size like snprintf()
+typedef struct {
+	char *buf;                              //!< event
+	size_t size;                            //!< size of buf
+	size_t len;                             //!< length of event
+} FLOG_TRACE_OUT_T;
+
+
+//! Append to an event, as much as fits
+static void flog_trace_put(FLOG_TRACE_OUT_T *o,const char *s,size_t len)
+{
+	if(o->len<o->size)
+		memcpy(o->buf+o->len,s,(len<o->size-o->len) ? len : o->size-o->len);
+	o->len+=len;
+}
+
+
+//! Append len bytes of s escaped for a JSON string to an event
+static void flog_trace_put_escaped(FLOG_TRACE_OUT_T *o,const char *s,size_t len)
+{
+	if(o->len<o->size)
+		o->len+=flog_escape(o->buf+o->len,o->size-o->len,s,len,FLOG_ESCAPE_JSON);
+	else
+		o->len+=flog_escape(NULL,0,s,len,FLOG_ESCAPE_JSON);
+}
+
+
+//! Append a JSON string to an event
+static void flog_trace_put_json(FLOG_TRACE_OUT_T *o,const char *s)
+{
+	flog_trace_put(o,"\"",1);
+	if(s)
+		flog_trace_put_escaped(o,s,strlen(s));
+	flog_trace_put(o,"\"",1);
+}
+
+
+//! Append formatted text to an event
+static void __attribute__((format(printf,2,3))) flog_trace_putf(FLOG_TRACE_OUT_T *o,const char *format,...)
+{
+	va_list ap;
+	int n;
+	va_start(ap,format);
+	n=vsnprintf(o->len<o->size ? o->buf+o->len : NULL,o->len<o->size ? o->size-o->len : 0,format,ap);
+	va_end(ap);
+	if(n>0)
+		o->len+=(size_t)n;
+}
+
+
+//! Put a message together as a trace event, followed by ",\n"
+static void flog_trace_event(FLOG_TRACE_OUT_T *o,const FLOG_OUTPUT_TRACE_T *t,const FLOG_MSG_T *msg,const char *name)
+{
+	uint64_t us=(uint64_t)msg->timestamp.tv_sec*1000000+(uint64_t)msg->timestamp.tv_usec;
+	flog_trace_put(o,"{\"name\":",8);
+	flog_trace_put_json(o,name);
+	if(msg->subsystem) {
+		flog_trace_put(o,",\"cat\":",7);
+		flog_trace_put_json(o,msg->subsystem);
+	}
+	if(msg->span_depth) {
+		//the timestamp is taken when the span ends
+		uint64_t start=us*1000-msg->span_ns;
+		flog_trace_putf(o,",\"ph\":\"X\",\"ts\":%" PRIu64 ".%03" PRIu64 ",\"dur\":%" PRIu64 ".%03" PRIu64
+		                ",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32 ",\"args\":{\"depth\":%u",
+		                start/1000,start%1000,msg->span_ns/1000,msg->span_ns%1000,
+		                t->pid,msg->span_tid,(unsigned int)msg->span_depth);
+	} else {
+		uint32_t tid;
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+		if(msg->context)
+			tid=msg->context->tid;
+		else
+#endif
+		//without a context, instant events are shown in the thread writing them
+		tid=flog_trace_tid();
+		flog_trace_putf(o,",\"ph\":\"i\",\"s\":\"t\",\"ts\":%" PRIu64 ",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32 ",\"args\":{\"type\":",
+		                us,t->pid,tid);
+		flog_trace_put_json(o,flog_get_msg_type_label(msg->type,NULL));
+	}
+#ifdef FLOG_CONFIG_CONTEXT_SIZE
+	if(msg->context && msg->context->stored) {
+		const FLOG_CONTEXT_T *c=msg->context;
+		const char *value;
+		size_t len;
+		unsigned int i;
+		flog_trace_put(o,",\"context\":{",12);
+		for(i=0;i<c->stored;i++) {
+			value=flog_context_value(c,i,&len);
+			flog_trace_put(o,i ? ",\"" : "\"",i ? 2 : 1);
+			flog_trace_put_escaped(o,c->text+c->entry[i].start,c->entry[i].key_len);
+			flog_trace_put(o,"\":\"",3);
+			flog_trace_put_escaped(o,value,len);
+			flog_trace_put(o,"\"",1);
+		}
+		flog_trace_put(o,"}",1);
+	}
+#endif
+#ifdef FLOG_CONFIG_SRC_INFO
+	if(msg->src_file) {
+		flog_trace_put(o,",\"src\":",7);
+		flog_trace_put_json(o,msg->src_file);
+		flog_trace_putf(o,",\"line\":%u",(unsigned int)msg->src_line);
+	}
+#endif
+	flog_trace_put(o,"}},\n",4);
+}
+
+
+//! Write a message to a Chrome trace event file
+int flog_output_trace(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	FLOG_OUTPUT_TRACE_T *t=log->output_func_data;
+	if(t==NULL || t->f==NULL) {
+		log->output_error=-1;
+		flog_print(log->error_log,"flog_output_trace",FLOG_ERROR,FLOG_MSG_SET_OUTPUT_TRACE,NULL);
+		return(log->output_error);
+	}
+	char buf[FLOG_STRING_BUF_SIZE],*content=NULL;
+	const char *name=msg->text;
+	FLOG_TRACE_OUT_T o={buf,sizeof(buf),0};
+	//messages with an id are named like in text outputs, the type is in args
+	if(msg->msg_id || !msg->text) {
+		if(flog_get_str_message_content_ex(&content,FLOG_NONE,msg->msg_id,msg->text,0))
+			return(-1);
+		name=content;
+	}
+	flog_trace_event(&o,t,msg,name);
+	if(o.len>=o.size) {
+		//did not fit, put it together again in a buffer of the right size
+		if((o.buf=flog_malloc(o.len+1))==NULL) {
+			free(content);
+			return(-1);
+		}
+		o.size=o.len+1;
+		o.len=0;
+		flog_trace_event(&o,t,msg,name);
+	}
+	free(content);
+	if(fwrite(o.buf,1,o.len,t->f)!=o.len) {
+		log->output_error=errno;
+		if(o.buf!=buf)
+			flog_free(o.buf);
+		flog_printf(log->error_log,"fwrite",FLOG_ERROR,FLOG_MSG_CANNOT_WRITE_TRACE,"%s (%s)",t->filename,strerror(log->output_error));
+		return(log->output_error);
+	}
+	flog_stats_add_bytes(log,o.len);
+	if(o.buf!=buf)
+		flog_free(o.buf);
+	return(0);
+}
+
+
+//! Flush function of trace outputs
+int flog_output_trace_flush(FLOG_T *log,int signal_safe)
+{
+	FLOG_OUTPUT_TRACE_T *t=log->output_func_data;
+	if(signal_safe || t==NULL || t->f==NULL)
+		return(0);
+	return(fflush(t->f)==EOF);
+}
+
+
+//! create and return a log that writes a Chrome trace event file
+
+//! The file is replaced, and holds a JSON array of events. The array is
+//! closed when the log is destroyed, trace viewers also load the file of
+//! a program which did not get that far.
+//! @param[in] *name name of log
+//! @param[in] accepted_msg_type bitmask of which messages to accept
+//! @param[in] *filename file to write
+//! @retval NULL error
+FLOG_T * create_flog_output_trace(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *filename)
+{
+	FLOG_T *p;
+	FLOG_OUTPUT_TRACE_T *t;
+	if((p=create_flog_t(name,accepted_msg_type))==NULL)
+		return(NULL);
+	p->output_func=flog_output_trace;
+	p->output_flush_func=flog_output_trace_flush;
+	if((t=flog_calloc(1,sizeof(FLOG_OUTPUT_TRACE_T)))==NULL) {
+		destroy_flog_t(p);
+		return(NULL);
+	}
+	p->output_func_data=t;
+	t->pid=(uint32_t)getpid();
+	if(filename==NULL || (t->filename=flog_strdup(filename))==NULL ||
+	   (t->f=fopen(filename,"we"))==NULL || fputs("[\n",t->f)==EOF) {
+		destroy_flog_output_trace(p);
+		return(NULL);
+	}
+	return(p);
+}
+
+
+//! free a trace output FLOG_T, closing the array of events
+void destroy_flog_output_trace(FLOG_T *p)
+{
+	if(p!=NULL) {
+#ifdef FLOG_CONFIG_DETACH
+		//stop the worker before the output is freed
+		flog_attach(p);
+#endif
+		FLOG_OUTPUT_TRACE_T *t=p->output_func_data;
+		if(t) {
+			if(t->f) {
+				//the last event has no ',' after it
+				fprintf(t->f,"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%" PRIu32 ",\"args\":{\"name\":",t->pid);
+				char buf[FLOG_STRING_BUF_SIZE];
+				FLOG_TRACE_OUT_T o={buf,sizeof(buf),0};
+				flog_trace_put_json(&o,p->name ? p->name : "flog");
+				if(o.len<o.size)
+					fwrite(buf,1,o.len,t->f);
+				else
+					fputs("\"flog\"",t->f);
+				fputs("}}\n]\n",t->f);
+				fclose(t->f);
+			}
+			flog_free(t->filename);
+			flog_free(t);
+			p->output_func_data=NULL;
+		}
+		destroy_flog_t(p);
+	}
+}
+
+#endif //FLOG_CONFIG_TRACE
@@ -0,0 +1,137 @@
+//! Scoped spans and Chrome trace output for Flog
+
+//! @file flog_trace.h
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! flog_function_start() and flog_function_end() emit two messages which
+//! nothing pairs. A span instead times a scope, and emits one message when
+//! the scope is left, with the time spent in it and how deeply it is
+//! nested in other spans of the same thread:
+//!
+//!     int parse(FLOG_T *log)
+//!     {
+//!         flog_trace(log,"parser",FLOG_DEBUG);
+//!         ...
+//!     } //emits "parse" with its duration
+//!
+//! The span ends through the cleanup attribute of the variable declared by
+//! flog_trace(), on return as well as on break or goto out of the scope.
+//! When the log does not use the message type as the span begins, the span
+//! costs that check and nothing else, not even reading the clock. From C++
+//! use flog::trace_scope of flog.hpp.
+//!
+//! Span messages have FLOG_MSG_T->span_depth set, and show their duration
+//! through the %D field of layouts (see flog_layout.h). A trace output
+//! (create_flog_output_trace()) writes every message it gets as a Chrome
+//! trace event, spans as complete events and other messages as instant
+//! events, so a log opens as a timeline in chrome://tracing or Perfetto.
+//! Events are shown in the thread emitting them, with the entries of its
+//! context in their args (see flog_context.h). Without
+//! FLOG_CONFIG_CONTEXT_SIZE instant events are shown in the thread writing
+//! them, which for a detached log (see flog_detach.h) is its worker.
+
+
+#ifndef FLOG_TRACE_H
+#define FLOG_TRACE_H
+
+#include "flog.h"
+
+#ifdef FLOG_CONFIG_TRACE
+
+// Sanity checks
+#if !defined(FLOG_CONFIG_TIMESTAMP) || !defined(FLOG_CONFIG_TIMESTAMP_USEC)
+#error FLOG_CONFIG_TRACE requires FLOG_CONFIG_TIMESTAMP and FLOG_CONFIG_TIMESTAMP_USEC
+#endif
+#ifndef FLOG_CONFIG_STRING_OUTPUT
+#error FLOG_CONFIG_TRACE requires FLOG_CONFIG_STRING_OUTPUT
+#endif
+#ifndef FLOG_CONFIG_ESCAPE
+#error FLOG_CONFIG_TRACE requires FLOG_CONFIG_ESCAPE
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+
+//! Span being timed - declared by flog_trace(), ended by flog_trace_end()
+typedef struct {
+	FLOG_T *log;                            //!< log to emit to (NULL if the span is not used)
+	const char *subsystem;                  //!< subsystem of the span message
+	const char *name;                       //!< name of the span, the message text
+#ifdef FLOG_CONFIG_SRC_INFO
+	const char *src_file;                   //!< source file of the span
+	uint_fast16_t src_line;                 //!< source line of the span
+	const char *src_func;                   //!< source function of the span
+#endif
+	FLOG_MSG_TYPE_T type;                   //!< message type
+	uint64_t start;                         //!< begin of the span (flog_get_time_ns())
+} FLOG_TRACE_SPAN_T;
+
+
+//! Trace output data - stored in log.output_func_data
+typedef struct {
+	char *filename;                         //!< file written to
+	FILE *f;                                //!< open file
+	uint32_t pid;                           //!< process id written in events
+} FLOG_OUTPUT_TRACE_T;
+
+
+//! Unique name of the span variable of a line
+#define FLOG_TRACE_VAR_(line) flog_trace_span_##line
+#define FLOG_TRACE_VAR(line) FLOG_TRACE_VAR_(line)
+
+
+//! Time the rest of the scope as a span named name
+
+//! Declares a variable, so use it where a declaration may be. The span is
+//! emitted as message type to p when the scope is left.
+//! @param[in,out] p log to emit the span to
+//! @param[in] subsystem subsystem of the span
+//! @param[in] type message type of the span, use one of the FLOG_* defines
+//! @param[in] name name of the span, copied if the message is buffered
+#ifdef FLOG_CONFIG_SRC_INFO
+#define flog_trace_named(p, subsystem, type, name) \
+	FLOG_TRACE_SPAN_T FLOG_TRACE_VAR(__LINE__) __attribute__((cleanup(flog_trace_end)))= \
+		flog_trace_begin(p,subsystem,__FILE__,__LINE__,__FUNCTION__,type,name)
+#else
+#define flog_trace_named(p, subsystem, type, name) \
+	FLOG_TRACE_SPAN_T FLOG_TRACE_VAR(__LINE__) __attribute__((cleanup(flog_trace_end)))= \
+		flog_trace_begin(p,subsystem,type,name)
+#endif
+
+
+//! Time the rest of the function as a span named after it
+
+//! @see flog_trace_named()
+#define flog_trace(p, subsystem, type) flog_trace_named(p,subsystem,type,__FUNCTION__)
+
+
+//! Same as flog_trace() but only timed if DEBUG is set
+
+//! Use this macro to allow removal of spans from release builds
+//! @see flog_trace()
+#ifdef DEBUG
+#define flog_debug_trace(p, subsystem, type) flog_trace(p,subsystem,type)
+#else
+#define flog_debug_trace(p, subsystem, type) (void)(0)
+#endif
+
+
+FLOG_TRACE_SPAN_T flog_trace_begin(FLOG_T *p,const char *subsystem,
+#ifdef FLOG_CONFIG_SRC_INFO
+                                   const char *src_file,uint_fast16_t src_line,const char *src_func,
+#endif
+                                   FLOG_MSG_TYPE_T type,const char *name);
+void flog_trace_end(FLOG_TRACE_SPAN_T *s);
+uint32_t flog_trace_tid(void);
+int flog_trace_str_span(char *buf,size_t size,const FLOG_MSG_T *msg);
+
+int flog_output_trace(FLOG_T *log,const FLOG_MSG_T *msg);
+int flog_output_trace_flush(FLOG_T *log,int signal_safe);
+FLOG_T * create_flog_output_trace(const char *name, FLOG_MSG_TYPE_T accepted_msg_type, const char *filename);
+void destroy_flog_output_trace(FLOG_T *p);
+
+#endif //FLOG_CONFIG_TRACE
+
+#endif //FLOG_TRACE_H
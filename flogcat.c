@@ -0,0 +1,154 @@
+//! Reader of compressed Flog files
+
+//! @file flogcat.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Writes the text of a file made by flog_output_compressed to stdout.
+//!
+//!     flogcat [-l] [-f first] [-n count] file
+//!
+//! - -l lists the frames (number, offset, length of data and payload)
+//!   instead of writing their data
+//! - -f skips frames before frame number first, without decompressing them
+//! - -n stops after count frames
+//!
+//! Damaged frames are reported on stderr and skipped by searching for the
+//! next frame header, so the rest of a damaged file can still be read.
+
+#define _FILE_OFFSET_BITS 64
+
+#include "flog_lz.h"
+
+#ifndef FLOG_CONFIG_OUTPUT_COMPRESSED
+#error flogcat requires FLOG_CONFIG_OUTPUT_COMPRESSED
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+//! Find the next frame header after a damaged frame
+
+//! @param[in] *f file
+//! @param[in] offset offset of the damaged frame
+//! @return offset of the next frame header, -1 if there is none
+static off_t flogcat_resync(FILE *f, off_t offset)
+{
+	const char *magic=FLOG_LZ_FRAME_MAGIC;
+	int c,n=0;
+	if(fseeko(f,++offset,SEEK_SET))
+		return(-1);
+	while((c=getc(f))!=EOF) {
+		offset++;
+		if(c==magic[n]) {
+			if(++n==4)
+				return(offset-4);
+		} else
+			n=(c==magic[0]);
+	}
+	return(-1);
+}
+
+
+//! Grow a buffer to at least len bytes
+
+//! @retval 0 success
+static int flogcat_reserve(char **buf, size_t *size, size_t len)
+{
+	char *p;
+	if(len<=*size)
+		return(0);
+	if((p=realloc(*buf,len))==NULL)
+		return(-1);
+	*buf=p;
+	*size=len;
+	return(0);
+}
+
+
+int main(int argc, char *argv[])
+{
+	unsigned long first=0,count=(unsigned long)-1,frame_no=0,done=0;
+	unsigned char header[FLOG_LZ_FRAME_HEADER_SIZE];
+	char *payload=NULL,*raw=NULL;
+	size_t payload_size=0,raw_size=0,n;
+	FLOG_LZ_FRAME_T frame;
+	int c,list=0,status=0;
+	off_t offset=0;
+	FILE *f;
+	while((c=getopt(argc,argv,"lf:n:"))!=-1) {
+		switch(c) {
+		case 'l':
+			list=1;
+			break;
+		case 'f':
+			first=strtoul(optarg,NULL,0);
+			break;
+		case 'n':
+			count=strtoul(optarg,NULL,0);
+			break;
+		default:
+			fprintf(stderr,"usage: %s [-l] [-f first] [-n count] file\n",argv[0]);
+			return(2);
+		}
+	}
+	if(optind!=argc-1) {
+		fprintf(stderr,"usage: %s [-l] [-f first] [-n count] file\n",argv[0]);
+		return(2);
+	}
+	if((f=fopen(argv[optind],"rb"))==NULL) {
+		perror(argv[optind]);
+		return(1);
+	}
+	while(done<count) {
+		if(fseeko(f,offset,SEEK_SET))
+			break;
+		if((n=fread(header,1,sizeof(header),f))!=sizeof(header)) {
+			if(n) {
+				fprintf(stderr,"%s: truncated frame at offset %lld\n",argv[optind],(long long)offset);
+				status=1;
+			}
+			break;
+		}
+		if(flog_lz_frame_header(header,&frame) ||
+		   (frame.compressed && frame.stored_len>flog_lz_bound((size_t)frame.raw_len)))
+			goto damaged;
+		if(frame_no<first) {
+			//skip by the header alone
+			offset+=FLOG_LZ_FRAME_HEADER_SIZE+(off_t)frame.stored_len;
+			frame_no++;
+			continue;
+		}
+		if(list) {
+			printf("%lu %lld %lu %lu%s\n",frame_no,(long long)offset,(unsigned long)frame.raw_len,
+			       (unsigned long)frame.stored_len,frame.compressed ? "" : " stored");
+		} else {
+			if(flogcat_reserve(&payload,&payload_size,frame.stored_len) ||
+			   flogcat_reserve(&raw,&raw_size,frame.raw_len))
+				goto damaged;
+			if(fread(payload,1,frame.stored_len,f)!=frame.stored_len) {
+				fprintf(stderr,"%s: truncated frame at offset %lld\n",argv[optind],(long long)offset);
+				status=1;
+				break;
+			}
+			if(flog_lz_frame_decode(&frame,payload,raw))
+				goto damaged;
+			fwrite(raw,1,frame.raw_len,stdout);
+		}
+		offset+=FLOG_LZ_FRAME_HEADER_SIZE+(off_t)frame.stored_len;
+		frame_no++;
+		done++;
+		continue;
+damaged:
+		fprintf(stderr,"%s: damaged frame at offset %lld\n",argv[optind],(long long)offset);
+		status=1;
+		if((offset=flogcat_resync(f,offset))==-1)
+			break;
+	}
+	free(payload);
+	free(raw);
+	fclose(f);
+	return(status);
+}
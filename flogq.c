@@ -0,0 +1,210 @@
+//! Query of indexed Flog files
+
+//! @file flogq.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Writes the parts of a log file matching a time range and message types
+//! to stdout, using the sidecar index written by a buffered file output
+//! (see flog_index.h) to skip everything else without reading it.
+//!
+//!     flogq [-l] [-s start] [-e end] [-t types] file
+//!
+//! - -s and -e limit the time range, as seconds since the epoch or local
+//!   time such as "2024-05-01 12:00:00", "2024-05-01 12:00" or "2024-05-01"
+//! - -t selects message types like the accept key of flog_conf.h, such as
+//!   "ERROR+" or "WARN,DEBUG"
+//! - -l lists the matching index entries instead of writing records
+//!
+//! Records are selected a whole index entry at a time, so some records
+//! outside the range or of other types are written too. Records after the
+//! last index entry are not indexed and always written.
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "flog_index.h"
+
+#ifndef FLOG_CONFIG_INDEX
+#error flogq requires FLOG_CONFIG_INDEX
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+
+//! Parse a time argument
+
+//! @param[in] *str seconds since the epoch, or local time
+//! @param[out] *usec microseconds since the epoch
+//! @retval 0 success
+//! @retval -1 invalid time
+static int flogq_parse_time(const char *str, int64_t *usec)
+{
+	static const char *format[]={"%Y-%m-%d %H:%M:%S","%Y-%m-%d %H:%M","%Y-%m-%d"};
+	struct tm tm;
+	const char *end;
+	char *num_end;
+	unsigned int i;
+	long long sec=strtoll(str,&num_end,10);
+	if(num_end!=str && !*num_end) {
+		*usec=(int64_t)sec*1000000;
+		return(0);
+	}
+	for(i=0;i<sizeof(format)/sizeof(format[0]);i++) {
+		memset(&tm,0,sizeof(tm));
+		if((end=strptime(str,format[i],&tm)) && !*end) {
+			tm.tm_isdst=-1;
+			*usec=(int64_t)mktime(&tm)*1000000;
+			return(0);
+		}
+	}
+	return(-1);
+}
+
+
+//! Parse a types argument, actions separated by ',' applied to no types
+static int flogq_parse_types(const char *value, uint32_t *types)
+{
+	FLOG_MSG_TYPE_T clear,set,mask=FLOG_NONE;
+	const char *end;
+	size_t len;
+	for(;;value=end+1) {
+		for(end=value;*end && *end!=',';end++);
+		while(isspace((unsigned char)*value))
+			value++;
+		for(len=(size_t)(end-value);len && isspace((unsigned char)value[len-1]);len--);
+		if(flog_parse_msg_type_action(value,len,&clear,&set))
+			return(-1);
+		mask=(mask & ~clear) | set;
+		if(!*end)
+			break;
+	}
+	*types=mask;
+	return(0);
+}
+
+
+//! Copy a range of the log file to stdout
+
+//! @retval 0 success
+//! @retval -1 read error
+static int flogq_copy(FILE *f, uint64_t offset, uint64_t len)
+{
+	char buf[65536];
+	size_t n;
+	if(fseeko(f,(off_t)offset,SEEK_SET))
+		return(-1);
+	while(len) {
+		n=(len<sizeof(buf)) ? (size_t)len : sizeof(buf);
+		if((n=fread(buf,1,n,f))==0)
+			return(ferror(f) ? -1 : 0);
+		fwrite(buf,1,n,stdout);
+		len-=n;
+	}
+	return(0);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int64_t start=INT64_MIN,end=INT64_MAX;
+	uint32_t types=UINT32_MAX,every;
+	unsigned char buf[FLOG_INDEX_ENTRY_SIZE];
+	FLOG_INDEX_ENTRY_T e;
+	uint64_t copy_offset=0,copy_len=0,indexed_end=0;
+	unsigned long skipped=0,selected=0;
+	char *index_name;
+	FILE *f,*x;
+	int c,list=0,status=0;
+	while((c=getopt(argc,argv,"ls:e:t:"))!=-1) {
+		switch(c) {
+		case 'l':
+			list=1;
+			break;
+		case 's':
+			if(flogq_parse_time(optarg,&start)) {
+				fprintf(stderr,"%s: invalid time\n",optarg);
+				return(2);
+			}
+			break;
+		case 'e':
+			if(flogq_parse_time(optarg,&end)) {
+				fprintf(stderr,"%s: invalid time\n",optarg);
+				return(2);
+			}
+			break;
+		case 't':
+			if(flogq_parse_types(optarg,&types)) {
+				fprintf(stderr,"%s: invalid message types\n",optarg);
+				return(2);
+			}
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if(optind!=argc-1)
+		goto usage;
+	if(asprintf(&index_name,"%s%s",argv[optind],FLOG_INDEX_SUFFIX)==-1)
+		return(1);
+	if((f=fopen(argv[optind],"rb"))==NULL) {
+		perror(argv[optind]);
+		return(1);
+	}
+	if((x=fopen(index_name,"rb"))==NULL) {
+		perror(index_name);
+		return(1);
+	}
+	if(fread(buf,1,FLOG_INDEX_HEADER_SIZE,x)!=FLOG_INDEX_HEADER_SIZE || flog_index_read_header(buf,&every)) {
+		fprintf(stderr,"%s: not an index file\n",index_name);
+		return(1);
+	}
+	while(fread(buf,1,sizeof(buf),x)==sizeof(buf)) {
+		flog_index_read_entry(buf,&e);
+		if(e.offset+e.length>indexed_end)
+			indexed_end=e.offset+e.length;
+		if(e.time_max<start || e.time_min>end || !(e.types & types)) {
+			skipped++;
+			continue;
+		}
+		selected++;
+		if(list) {
+			printf("%" PRIu64 " %" PRIu64 " %" PRId64 ".%06d %" PRId64 ".%06d 0x%02x %u\n",e.offset,e.length,
+			       e.time_min/1000000,(int)(e.time_min%1000000),e.time_max/1000000,(int)(e.time_max%1000000),
+			       (unsigned int)e.types,(unsigned int)e.records);
+			continue;
+		}
+		//join adjacent entries into one copy
+		if(copy_len && copy_offset+copy_len==e.offset) {
+			copy_len+=e.length;
+			continue;
+		}
+		if(copy_len && flogq_copy(f,copy_offset,copy_len))
+			status=1;
+		copy_offset=e.offset;
+		copy_len=e.length;
+	}
+	if(!list) {
+		if(copy_len && flogq_copy(f,copy_offset,copy_len))
+			status=1;
+		//records after the last entry are not indexed
+		if(flogq_copy(f,indexed_end,UINT64_MAX))
+			status=1;
+		if(status)
+			perror(argv[optind]);
+	}
+	if(list)
+		printf("%lu entries of %u records selected, %lu skipped\n",selected,(unsigned int)every,skipped);
+	fclose(x);
+	fclose(f);
+	free(index_name);
+	return(status);
+usage:
+	fprintf(stderr,"usage: %s [-l] [-s start] [-e end] [-t types] file\n",argv[0]);
+	return(2);
+}
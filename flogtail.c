@@ -0,0 +1,240 @@
+//! Live tail of Flog shared memory rings
+
+//! @file flogtail.c
+//! @author Nabeel Sowan (nabeel.sowan@vibes.se)
+//!
+//! Writes the records of a shared memory ring (see flog_output_shm.h) to
+//! stdout as they are written, without ever blocking the writers.
+//!
+//!     flogtail [-x] [-n count] [-t types] [-s subsystem] [-p pid] [-L layout] name
+//!
+//! - -n starts count records back, instead of the last 10
+//! - -x exits once all records are written, instead of following the ring
+//! - -t selects message types like the accept key of flog_conf.h, such as
+//!   "ERROR+" or "WARN,DEBUG"
+//! - -s selects records whose subsystem contains the given string
+//! - -p selects records written by a process
+//! - -L renders raw records with a layout (see flog_layout.h)
+//!
+//! Records overwritten before they were read are counted, and reported to
+//! stderr. A record a writer never finished is skipped after
+//! FLOGTAIL_STUCK_MS.
+
+#define _GNU_SOURCE
+
+#include "flog_output_shm.h"
+
+#ifndef FLOG_CONFIG_OUTPUT_SHM
+#error flogtail requires FLOG_CONFIG_OUTPUT_SHM
+#endif
+
+#include "flog_string.h"
+#ifdef FLOG_CONFIG_LAYOUT
+#include "flog_layout.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+
+//! Time to wait for a record a writer is filling before skipping it
+#define FLOGTAIL_STUCK_MS 100
+
+
+//! Parse a types argument, actions separated by ',' applied to no types
+static int flogtail_parse_types(const char *value, FLOG_MSG_TYPE_T *types)
+{
+	FLOG_MSG_TYPE_T clear,set,mask=FLOG_NONE;
+	const char *end;
+	size_t len;
+	for(;;value=end+1) {
+		for(end=value;*end && *end!=',';end++);
+		while(isspace((unsigned char)*value))
+			value++;
+		for(len=(size_t)(end-value);len && isspace((unsigned char)value[len-1]);len--);
+		if(flog_parse_msg_type_action(value,len,&clear,&set))
+			return(-1);
+		mask=(mask & ~clear) | set;
+		if(!*end)
+			break;
+	}
+	*types=mask;
+	return(0);
+}
+
+
+//! Render a raw record with the layout of log
+
+//! @param[in] *r record, its data is modified
+//! @retval 0 success
+//! @retval -1 error
+static int flogtail_write_raw(const FLOG_T *log, FLOG_SHM_RECORD_T *r)
+{
+	char buf[FLOG_STRING_BUF_SIZE],*str,subsystem[UINT16_MAX+1];
+	FLOG_MSG_T msg;
+	size_t len;
+	init_flog_msg_t(&msg);
+	memcpy(subsystem,r->data,r->subsystem_len);
+	subsystem[r->subsystem_len]=0;
+	msg.subsystem=subsystem;
+	//the text is moved over the subsystem to terminate it in place
+	memmove(r->data,r->data+r->subsystem_len,r->text_len);
+	r->data[r->text_len]=0;
+	msg.text=r->text_len ? r->data : NULL;
+#ifdef FLOG_CONFIG_TIMESTAMP
+#ifdef FLOG_CONFIG_TIMESTAMP_USEC
+	msg.timestamp.tv_sec=(time_t)(r->time/1000000);
+	msg.timestamp.tv_usec=(suseconds_t)(r->time%1000000);
+#else
+	msg.timestamp=(time_t)(r->time/1000000);
+#endif
+#endif
+	msg.type=r->type;
+	msg.msg_id=(FLOG_MSG_ID_T)r->msg_id;
+	msg.flags=FLOG_MSG_FLAG_STATIC_TEXT|FLOG_MSG_FLAG_STATIC_SRC;
+	if(flog_get_str_message_log(&str,&len,buf,sizeof(buf),log,&msg))
+		return(-1);
+	if(str) {
+		fwrite(str,1,len,stdout);
+		if(str!=buf)
+			free(str);
+	}
+	return(0);
+}
+
+
+//! Write a record to stdout, if it is selected
+static void flogtail_write(const FLOG_T *log, FLOG_SHM_RECORD_T *r, FLOG_MSG_TYPE_T types, const char *subsystem, long pid)
+{
+	if(!(r->type & types) || (pid && r->pid!=(uint32_t)pid))
+		return;
+	if(subsystem && !memmem(r->data,r->subsystem_len,subsystem,strlen(subsystem)))
+		return;
+	if(r->flags & FLOG_SHM_RECORD_RAW) {
+		if(flogtail_write_raw(log,r))
+			fputs("flogtail: cannot render record\n",stderr);
+		return;
+	}
+	fwrite(r->data+r->subsystem_len,1,r->text_len,stdout);
+	if(!r->text_len || r->data[r->subsystem_len+r->text_len-1]!='\n')
+		putchar('\n');
+}
+
+
+int main(int argc, char *argv[])
+{
+	const struct timespec ms={0,1000000};
+	FLOG_MSG_TYPE_T types=FLOG_ACCEPT_ALL;
+	FLOG_SHM_HEADER_T *h;
+	FLOG_SHM_RECORD_T *r;
+	FLOG_T *log;
+	uint64_t seq,head,lost=0,count=10;
+	unsigned int stuck=0;
+	size_t size;
+	const char *subsystem=NULL,*layout=NULL;
+	long pid=0;
+	int c,follow=1,idle;
+	while((c=getopt(argc,argv,"xn:t:s:p:L:"))!=-1) {
+		switch(c) {
+		case 'x':
+			follow=0;
+			break;
+		case 'n':
+			count=strtoull(optarg,NULL,10);
+			break;
+		case 't':
+			if(flogtail_parse_types(optarg,&types)) {
+				fprintf(stderr,"%s: invalid message types\n",optarg);
+				return(2);
+			}
+			break;
+		case 's':
+			subsystem=optarg;
+			break;
+		case 'p':
+			pid=strtol(optarg,NULL,10);
+			break;
+		case 'L':
+			layout=optarg;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if(optind!=argc-1)
+		goto usage;
+	if((h=flog_shm_map(argv[optind],0,0,0,&size))==NULL) {
+		perror(argv[optind]);
+		return(1);
+	}
+	if((log=create_flog_t("",FLOG_ACCEPT_ALL))==NULL || (r=malloc(h->record_size+1))==NULL)
+		return(1);
+	if(layout) {
+#ifdef FLOG_CONFIG_LAYOUT
+		if(flog_set_layout(log,layout)) {
+			fprintf(stderr,"%s: invalid layout\n",layout);
+			return(2);
+		}
+#else
+		fputs("layouts are not supported\n",stderr);
+		return(2);
+#endif
+	}
+	head=__atomic_load_n(&h->head,__ATOMIC_ACQUIRE);
+	seq=head>count ? head-count : 0;
+	for(;;) {
+		idle=1;
+		head=__atomic_load_n(&h->head,__ATOMIC_ACQUIRE);
+		//records more than a lap behind are gone
+		if(head-seq>h->record_amount) {
+			lost+=head-h->record_amount-seq;
+			seq=head-h->record_amount;
+		}
+		while(seq<head) {
+			switch(flog_shm_read(h,seq,r)) {
+			case FLOG_SHM_READ_OK:
+				flogtail_write(log,r,types,subsystem,pid);
+				break;
+			case FLOG_SHM_READ_LOST:
+				lost++;
+				break;
+			default:
+				//being written, or dropped by its writer
+				if(++stuck<FLOGTAIL_STUCK_MS) {
+					idle=1;
+					goto wait;
+				}
+				lost++;
+			}
+			stuck=0;
+			idle=0;
+			seq++;
+		}
+		if(!follow)
+			break;
+wait:
+		if(lost) {
+			fflush(stdout);
+			fprintf(stderr,"flogtail: %" PRIu64 " records lost\n",lost);
+			lost=0;
+		}
+		if(idle) {
+			fflush(stdout);
+			nanosleep(&ms,NULL);
+		}
+	}
+	fflush(stdout);
+	if(lost)
+		fprintf(stderr,"flogtail: %" PRIu64 " records lost\n",lost);
+	munmap(h,size);
+	free(r);
+	destroy_flog_t(log);
+	return(0);
+usage:
+	fprintf(stderr,"usage: %s [-x] [-n count] [-t types] [-s subsystem] [-p pid] [-L layout] name\n",argv[0]);
+	return(2);
+}
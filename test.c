@@ -3,9 +3,105 @@
 #include "flog.h"
 #include "flog_output_stdio.h"
 #include "flog_output_file.h"
+#include "flog_stats.h"
+#include "flog_crash.h"
+#include "flog_conf.h"
+#include "flog_alloc.h"
+#include "flog_string.h"
+#include "flog_layout.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <string.h>
+
+
+#ifdef FLOG_CONFIG_ALLOC
+//! Output rendering a message into a stack buffer and dropping it
+static int test_output_render(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	char buf[256],*str;
+	size_t len;
+	if(flog_get_str_message_log(&str,&len,buf,sizeof(buf),log,msg))
+		return(-1);
+	if(str!=buf)
+		free(str);
+	return(0);
+}
+
+
+//! Output allocating a buffer per message, failing if it can't
+static int test_output_alloc(FLOG_T *log,const FLOG_MSG_T *msg)
+{
+	char *buf;
+	(void)log;
+	(void)msg;
+	if((buf=flog_malloc(1024))==NULL)
+		return(-1);
+	flog_free(buf);
+	return(0);
+}
+
+
+//! Check allocation counting, the budget and the pool allocator
+
+//! @return name of the failed check, NULL if all passed
+static const char * test_alloc(void)
+{
+	FLOG_ALLOC_STATS_T before,after;
+	FLOG_ALLOC_POOL_T pool;
+	FLOG_T *root,*out;
+	char *p,*q;
+	int i;
+
+	root=create_flog_t("root",FLOG_ACCEPT_ALL);
+	out=create_flog_t("out",FLOG_ACCEPT_ALL);
+	out->output_func=test_output_render;
+	flog_append_sublog(root,out);
+	flog_printf(root,"alloc_test",FLOG_INFO,0,"warm up %d",0);
+	flog_get_alloc_stats(&before);
+	for(i=0;i<100;i++)
+		flog_printf(root,"alloc_test",FLOG_INFO,0,"message %d",i);
+	flog_get_alloc_stats(&after);
+#if defined(FLOG_CONFIG_INTERN_TABLE_SIZE) && defined(FLOG_CONFIG_INLINE_TEXT_SIZE)
+	//a short message to a text output allocates nothing, once its subsystem path is interned
+	if(after.allocs!=before.allocs)
+		return("short messages allocate");
+#endif
+
+	//an output refused memory by the budget drops the message but does not fail
+	out->output_func=test_output_alloc;
+	flog_set_alloc_budget(after.used+256);
+	flog_printf(root,"alloc_test",FLOG_INFO,0,"over budget");
+	flog_set_alloc_budget(0);
+	flog_get_alloc_stats(&before);
+	if(before.refused==after.refused)
+		return("budget not enforced");
+	if(out->output_error)
+		return("budget refusal set output_error");
+	destroy_flog_t(out);
+	destroy_flog_t(root);
+
+	//pool blocks keep their contents across size classes and go back to the pool
+	if(flog_alloc_pool_init(&pool,NULL,64*1024))
+		return("pool init");
+	if(flog_set_allocator_pool(&pool))
+		return("pool allocator");
+	if((p=flog_strdup("pool"))==NULL || (p=flog_realloc(p,4000))==NULL || strcmp(p,"pool"))
+		return("pool realloc");
+	if(pool.used==0)
+		return("pool unused");
+	flog_set_allocator(NULL);
+	//freed to the pool it came from after the allocator changed
+	flog_free(p);
+	if((q=flog_malloc(4000))==NULL)
+		return("malloc after pool");
+	flog_free(q);
+	flog_alloc_pool_destroy(&pool);
+	return(NULL);
+}
+#endif //FLOG_CONFIG_ALLOC
 
 
 int main(void)
@@ -26,6 +122,10 @@ int main(void)
 	flog_append_sublog(log_main,log_stdout);
 	log_stderr = create_flog_output_stderr("stderr",FLOG_ACCEPT_DEEP_DEBUG);
 	log_stderr->error_log=log_main;
+#ifdef FLOG_CONFIG_OUTPUT_ANSI_COLOR
+	if(isatty(fileno(stderr)))
+		log_stderr->output_flags|=FLOG_OUTPUT_FLAG_ANSI_COLOR;
+#endif
 	flog_append_sublog(log_main,log_stderr);
 #endif
 #ifdef FLOG_CONFIG_OUTPUT_FILE
@@ -35,6 +135,10 @@ int main(void)
 	flog_append_sublog(log_main,log_file);
 #endif
 
+#ifdef FLOG_CONFIG_CRASH_HANDLER
+	flog_crash_install(log_main);
+#endif
+
 	flog_function_start(log_subfunc,NULL);
 	flog_print(log_subfunc,"print_test",FLOG_ERROR,0,"testing...");
 	flog_printf(log_subfunc,"printf_test",FLOG_INFO,0,"testing... %d %d %d",1,2,3);
@@ -57,6 +161,24 @@ int main(void)
 
 	flog_function_end(log_subfunc,NULL);
 
+#if defined(FLOG_CONFIG_LOADER) && defined(FLOG_CONFIG_OUTPUT_STDIO)
+	FLOG_CONF_T *conf;
+	if((conf=create_flog_conf("conf",log_main))) {
+		flog_conf_load_str(conf,"[console]\noutput = stderr\naccept = WARN+\n");
+		flog_print(conf->root,"conf_test",FLOG_WARNING,0,"configured log");
+		flog_conf_load_str(conf,"[console]\noutput = stderr\naccept = off\n");
+		flog_print(conf->root,"conf_test",FLOG_WARNING,0,"reloaded, not shown");
+		destroy_flog_conf(conf);
+	}
+#endif
+
+#ifdef FLOG_CONFIG_STATS
+	flog_print_stats(log_main,log_subfunc);
+#endif
+
+#ifdef FLOG_CONFIG_CRASH_HANDLER
+	flog_crash_uninstall();
+#endif
 	destroy_flog_t(log_subfunc);
 	destroy_flog_t(log_main);
 #ifdef FLOG_CONFIG_OUTPUT_STDIO
@@ -65,6 +187,30 @@ int main(void)
 #endif
 #ifdef FLOG_CONFIG_OUTPUT_FILE
 	destroy_flog_output_file(log_file);
+#endif
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+	flog_intern_clear();
+#endif
+#ifdef FLOG_CONFIG_ALLOC
+	const char *failed;
+	FLOG_ALLOC_STATS_T alloc_stats;
+	if((failed=test_alloc())) {
+		fprintf(stderr,"allocation check failed: %s\n",failed);
+		return(1);
+	}
+#ifdef FLOG_CONFIG_INTERN_TABLE_SIZE
+	flog_intern_clear();
+#endif
+#ifdef FLOG_CONFIG_LAYOUT
+	flog_layout_clear();
+#endif
+	flog_get_alloc_stats(&alloc_stats);
+	fprintf(stderr,"allocations: %" PRIu64 " made, %" PRIu64 " freed, %zu bytes in use, %zu bytes at peak\n",
+	        alloc_stats.allocs,alloc_stats.frees,alloc_stats.used,alloc_stats.peak);
+	if(alloc_stats.allocs!=alloc_stats.frees || alloc_stats.used) {
+		fprintf(stderr,"allocation check failed: memory left after teardown\n");
+		return(1);
+	}
 #endif
 	return(0);
 }